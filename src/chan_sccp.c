@@ -33,6 +33,7 @@
 #include "sccp_devstate.h"
 #endif
 #include "sccp_management.h"	// use __constructor__ to remove this entry
+#include "sccp_featurestore.h"
 #include <signal.h>
 
 SCCP_FILE_VERSION(__FILE__, "");
@@ -52,6 +53,8 @@ int load_config(void)
 	int newPort = 0;
 	int returnvalue = FALSE;
 	char addrStr[INET6_ADDRSTRLEN];
+	struct timeval phase_start = pbx_tvnow();
+	int64_t config_ms = 0, general_ms = 0, objects_ms = 0;
 
 	oldPort = sccp_netsock_getPort(&GLOB(bindaddr));
 
@@ -75,12 +78,19 @@ int load_config(void)
 		pbx_log(LOG_ERROR, "Error loading configfile !\n");
 		return FALSE;
 	}
+	config_ms = ast_tvdiff_ms(pbx_tvnow(), phase_start);
+	phase_start = pbx_tvnow();
 
 	if (!sccp_config_general(SCCP_CONFIG_READINITIAL)) {
 		pbx_log(LOG_ERROR, "Error parsing configfile !\n");
 		return FALSE;
 	}
+	general_ms = ast_tvdiff_ms(pbx_tvnow(), phase_start);
+	phase_start = pbx_tvnow();
+
 	sccp_config_readDevicesLines(SCCP_CONFIG_READINITIAL);
+	objects_ms = ast_tvdiff_ms(pbx_tvnow(), phase_start);
+	phase_start = pbx_tvnow();
 
 	/* ok the config parse is done */
 	newPort = sccp_netsock_getPort(&GLOB(bindaddr));
@@ -137,6 +147,7 @@ int load_config(void)
 				GLOB(reload_in_progress) = FALSE;
 				pbx_pthread_create(&GLOB(socket_thread), NULL, sccp_netsock_thread, NULL);
 				returnvalue = TRUE;
+				pbx_log(LOG_NOTICE, "SCCP: startup: read config %" PRId64 " ms, general %" PRId64 " ms, devices/lines %" PRId64 " ms, listener %" PRId64 " ms\n", config_ms, general_ms, objects_ms, ast_tvdiff_ms(pbx_tvnow(), phase_start));
 			}
 		} while(0);
 		freeaddrinfo(res);
@@ -174,10 +185,17 @@ boolean_t sccp_prePBXLoad(void)
 
 	/* init refcount */
 	sccp_refcount_init();
+	sccp_packet_pool_init();
 
 	SCCP_RWLIST_HEAD_INIT(&GLOB(sessions));
 	SCCP_RWLIST_HEAD_INIT(&GLOB(devices));
 	SCCP_RWLIST_HEAD_INIT(&GLOB(lines));
+	GLOB(session_index) = sccp_hashtable_create(0, sccp_hash_sockaddr, sccp_hash_match_sockaddr);
+	GLOB(device_index) = sccp_hashtable_create(0, sccp_hash_string_nocase, sccp_hash_match_string_nocase);
+	GLOB(line_index) = sccp_hashtable_create(0, sccp_hash_string_nocase, sccp_hash_match_string_nocase);
+	pbx_rwlock_init(&GLOB(channel_index_lock));
+	GLOB(channel_callid_index) = sccp_hashtable_create(0, sccp_hash_uint32, sccp_hash_match_uint32);
+	GLOB(channel_passthrupartyid_index) = sccp_hashtable_create(0, sccp_hash_uint32, sccp_hash_match_uint32);
 
 	GLOB(general_threadpool) = sccp_threadpool_init(THREADPOOL_MIN_SIZE);
 
@@ -302,6 +320,7 @@ int sccp_preUnload(void)
 	/* unsubscribe from services */
 	sccp_event_unsubscribe(SCCP_EVENT_FEATURE_CHANGED, sccp_device_featureChangedDisplay);
 	sccp_event_unsubscribe(SCCP_EVENT_FEATURE_CHANGED, sccp_util_featureStorageBackend);
+	sccp_featurestore_unload();									/* write pending feature changes, from now on the database is used directly */
 
 	/* close accept thread by shutdown the socket descriptor read side -> interrupt polling and break accept loop */
 	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_2 "SCCP: Closing Socket Accept Descriptor\n");
@@ -365,6 +384,14 @@ int sccp_preUnload(void)
 	sccp_hint_module_stop();
 	sccp_event_module_stop();
 	sccp_threadpool_destroy(GLOB(general_threadpool));
+	sccp_packet_pool_destroy();
+	sccp_hashtable_destroy(&GLOB(session_index));
+	sccp_hashtable_destroy(&GLOB(device_index));
+	sccp_hashtable_destroy(&GLOB(line_index));
+	pbx_rwlock_wrlock(&GLOB(channel_index_lock));
+	sccp_hashtable_destroy(&GLOB(channel_callid_index));
+	sccp_hashtable_destroy(&GLOB(channel_passthrupartyid_index));
+	pbx_rwlock_unlock(&GLOB(channel_index_lock));
 	sccp_refcount_destroy();
 
 	/* free resources */
@@ -387,6 +414,7 @@ int sccp_preUnload(void)
 #ifndef SCCP_ATOMIC
 	pbx_mutex_destroy(&GLOB(usecnt_lock));
 #endif	
+	pbx_rwlock_destroy(&GLOB(channel_index_lock));
 	pbx_rwlock_destroy(&GLOB(lock));
 	return 0;
 }
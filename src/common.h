@@ -130,6 +130,7 @@ __END_C_EXTERN__
 #include "sccp_enum.h"
 #include "sccp_dllists.h"
 #include "sccp_threadpool.h"
+#include "sccp_hash.h"
 #include "sccp_debug.h"
 #include "sccp_globals.h"
 #include "sccp_rtp.h"
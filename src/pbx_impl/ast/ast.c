@@ -632,6 +632,29 @@ boolean_t sccp_asterisk_removeTreeFromDatabase(const char *family, const char *k
 	return (!res) ? TRUE : FALSE;
 }
 
+/*!
+ * \brief Read a whole family from the database in one go
+ * \note callback is called with the full key of every entry ("/family/subfamily/key") and its value
+ * \return FALSE when the family could not be read, an empty family counts as read
+ */
+boolean_t sccp_asterisk_getTreeFromDatabase(const char *family, void (*callback) (const char *key, const char *value, void *data), void *data)
+{
+	struct ast_db_entry *tree = NULL;
+	struct ast_db_entry *entry = NULL;
+
+	if (sccp_strlen_zero(family) || !callback) {
+		return FALSE;
+	}
+	tree = ast_db_gettree(family, NULL);
+	for (entry = tree; entry; entry = entry->next) {
+		callback(entry->key, entry->data, data);
+	}
+	if (tree) {
+		pbx_db_freetree(tree);
+	}
+	return TRUE;
+}
+
 /* end - database */
 
 /*!
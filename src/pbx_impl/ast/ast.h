@@ -304,6 +304,7 @@ boolean_t sccp_asterisk_addToDatabase(const char *family, const char *key, const
 boolean_t sccp_asterisk_getFromDatabase(const char *family, const char *key, char *out, int outlen);
 boolean_t sccp_asterisk_removeFromDatabase(const char *family, const char *key);
 boolean_t sccp_asterisk_removeTreeFromDatabase(const char *family, const char *key);
+boolean_t sccp_asterisk_getTreeFromDatabase(const char *family, void (*callback) (const char *key, const char *value, void *data), void *data);
 
 /***** end - database *****/
 
@@ -2886,6 +2886,7 @@ const PbxInterface iPbx = {
 	feature_getFromDatabase:	sccp_asterisk_getFromDatabase,
 	feature_removeFromDatabase:	sccp_asterisk_removeFromDatabase,
 	feature_removeTreeFromDatabase:	sccp_asterisk_removeTreeFromDatabase,
+	feature_getTreeFromDatabase:	sccp_asterisk_getTreeFromDatabase,
 	feature_monitor:		sccp_wrapper_asterisk_featureMonitor,
 	getFeatureExtension:		sccp_wrapper_asterisk16_getFeatureExtension,
 	getPickupExtension:		sccp_wrapper_asterisk16_getPickupExtension,
@@ -3012,6 +3013,7 @@ const PbxInterface iPbx = {
 	.feature_getFromDatabase 	= sccp_asterisk_getFromDatabase,
 	.feature_removeFromDatabase     = sccp_asterisk_removeFromDatabase,	
 	.feature_removeTreeFromDatabase = sccp_asterisk_removeTreeFromDatabase,
+	.feature_getTreeFromDatabase	= sccp_asterisk_getTreeFromDatabase,
 	.feature_monitor		= sccp_wrapper_asterisk_featureMonitor,
 	
 	
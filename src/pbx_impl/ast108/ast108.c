@@ -3036,6 +3036,7 @@ const PbxInterface iPbx = {
 	feature_getFromDatabase:	sccp_asterisk_getFromDatabase,
 	feature_removeFromDatabase:	sccp_asterisk_removeFromDatabase,
 	feature_removeTreeFromDatabase:	sccp_asterisk_removeTreeFromDatabase,
+	feature_getTreeFromDatabase:	sccp_asterisk_getTreeFromDatabase,
 	feature_monitor:		sccp_wrapper_asterisk_featureMonitor,
 	getFeatureExtension:		sccp_wrapper_asterisk18_getFeatureExtension,
 	getPickupExtension:		sccp_wrapper_asterisk18_getPickupExtension,
@@ -3160,6 +3161,7 @@ const PbxInterface iPbx = {
 	.feature_getFromDatabase 	= sccp_asterisk_getFromDatabase,
 	.feature_removeFromDatabase     = sccp_asterisk_removeFromDatabase,	
 	.feature_removeTreeFromDatabase = sccp_asterisk_removeTreeFromDatabase,
+	.feature_getTreeFromDatabase	= sccp_asterisk_getTreeFromDatabase,
 	
 	
 	.feature_park			= sccp_wrapper_asterisk18_park,
@@ -2712,6 +2712,7 @@ const PbxInterface iPbx = {
 	feature_getFromDatabase:	sccp_asterisk_getFromDatabase,
 	feature_removeFromDatabase:	sccp_asterisk_removeFromDatabase,
 	feature_removeTreeFromDatabase:	sccp_asterisk_removeTreeFromDatabase,
+	feature_getTreeFromDatabase:	sccp_asterisk_getTreeFromDatabase,
 	feature_monitor:		sccp_wrapper_asterisk_featureMonitor,
 	getFeatureExtension:		sccp_asterisk110_getFeatureExtension,
 	getPickupExtension:		sccp_wrapper_asterisk110_getPickupExtension,
@@ -2837,6 +2838,7 @@ const PbxInterface iPbx = {
 	.feature_getFromDatabase 	= sccp_asterisk_getFromDatabase,
 	.feature_removeFromDatabase     = sccp_asterisk_removeFromDatabase,	
 	.feature_removeTreeFromDatabase = sccp_asterisk_removeTreeFromDatabase,
+	.feature_getTreeFromDatabase	= sccp_asterisk_getTreeFromDatabase,
 	.feature_monitor		= sccp_wrapper_asterisk_featureMonitor,
 	
 	
@@ -2865,6 +2865,7 @@ const PbxInterface iPbx = {
 	feature_getFromDatabase:	sccp_asterisk_getFromDatabase,
 	feature_removeFromDatabase:	sccp_asterisk_removeFromDatabase,
 	feature_removeTreeFromDatabase:	sccp_asterisk_removeTreeFromDatabase,
+	feature_getTreeFromDatabase:	sccp_asterisk_getTreeFromDatabase,
 	feature_monitor:		sccp_wrapper_asterisk_featureMonitor,
 	getFeatureExtension:		sccp_wrapper_asterisk111_getFeatureExtension,
 	getPickupExtension:		sccp_wrapper_asterisk111_getPickupExtension,
@@ -2993,6 +2994,7 @@ const PbxInterface iPbx = {
 	.feature_getFromDatabase 	= sccp_asterisk_getFromDatabase,
 	.feature_removeFromDatabase     = sccp_asterisk_removeFromDatabase,
 	.feature_removeTreeFromDatabase = sccp_asterisk_removeTreeFromDatabase,
+	.feature_getTreeFromDatabase	= sccp_asterisk_getTreeFromDatabase,
 	.feature_monitor		= sccp_wrapper_asterisk_featureMonitor,
 
 	.feature_park			= sccp_wrapper_asterisk111_park,
@@ -121,6 +121,7 @@ typedef struct _PbxInterface {
 	boolean_t(*const feature_getFromDatabase) (const char *family, const char *key, char *out, int outlen);
 	boolean_t(*const feature_removeFromDatabase) (const char *family, const char *key);
 	boolean_t(*const feature_removeTreeFromDatabase) (const char *family, const char *key);
+	boolean_t(*const feature_getTreeFromDatabase) (const char *family, void (*callback) (const char *key, const char *value, void *data), void *data);
 	boolean_t(*const feature_monitor) (const sccp_channel_t *channel);
 	boolean_t(*const getFeatureExtension) (constChannelPtr channel, const char *featureName, char featureExtension[SCCP_MAX_EXTENSION]);
 	boolean_t(*const getPickupExtension) (constChannelPtr channel, char pickupExtension[SCCP_MAX_EXTENSION]);
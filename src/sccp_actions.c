@@ -48,6 +48,7 @@ SCCP_FILE_VERSION(__FILE__, "");
 #  include <asterisk/acl.h>
 #endif
 #include <math.h>
+#include <asterisk/cli.h>
 
 /* prototypes */
 void handle_unknown_message(constSessionPtr s, devicePtr d, constMessagePtr msg_in)			__NONNULL(1,2,3);
@@ -199,6 +200,116 @@ static const struct messageMap_cb spcpMessagesCbMap[SPCP_MESSAGE_HIGH_BOUNDARY +
 	//[UnknownVGMessage - SPCP_MESSAGE_OFFSET] = {NULL, FALSE},
 };
 
+/* =========================================================================================== Registration Timings */
+/*!
+ * \brief Registration Phases we keep timing statistics for
+ */
+enum sccp_registration_phase {
+	SCCP_REGISTRATION_PHASE_REGISTER,
+	SCCP_REGISTRATION_PHASE_BUTTONTEMPLATE,
+	SCCP_REGISTRATION_PHASE_SOFTKEYTEMPLATE,
+	SCCP_REGISTRATION_PHASE_SOFTKEYSET,
+	SCCP_REGISTRATION_PHASE_OTHER,										/*!< any other message handled while in RS_PROGRESS */
+	SCCP_REGISTRATION_PHASE_TOTAL,										/*!< RegisterMessage until registrationFinishedMessageId */
+};
+
+/*!
+ * \brief Registration Phase Timing Statistics (microseconds)
+ */
+static struct sccp_registration_timing {
+	const char *const name;
+	uint32_t count;
+	uint64_t total_us;
+	uint64_t max_us;
+} registration_timings[] = {
+	[SCCP_REGISTRATION_PHASE_REGISTER] = {"Register", 0, 0, 0},
+	[SCCP_REGISTRATION_PHASE_BUTTONTEMPLATE] = {"ButtonTemplate", 0, 0, 0},
+	[SCCP_REGISTRATION_PHASE_SOFTKEYTEMPLATE] = {"SoftKeyTemplate", 0, 0, 0},
+	[SCCP_REGISTRATION_PHASE_SOFTKEYSET] = {"SoftKeySet", 0, 0, 0},
+	[SCCP_REGISTRATION_PHASE_OTHER] = {"Other", 0, 0, 0},
+	[SCCP_REGISTRATION_PHASE_TOTAL] = {"Total", 0, 0, 0},
+};
+AST_MUTEX_DEFINE_STATIC(registration_timings_lock);
+
+/*!
+ * \brief Add the time passed since start to the statistics of a registration phase
+ */
+static void sccp_registration_timing_add(enum sccp_registration_phase phase, struct timeval start)
+{
+	struct timeval now = pbx_tvnow();
+	int64_t elapsed_us = ((int64_t) (now.tv_sec - start.tv_sec) * 1000000) + (now.tv_usec - start.tv_usec);
+
+	if (elapsed_us < 0) {
+		elapsed_us = 0;
+	}
+	pbx_mutex_lock(&registration_timings_lock);
+	registration_timings[phase].count++;
+	registration_timings[phase].total_us += elapsed_us;
+	if ((uint64_t) elapsed_us > registration_timings[phase].max_us) {
+		registration_timings[phase].max_us = elapsed_us;
+	}
+	pbx_mutex_unlock(&registration_timings_lock);
+}
+
+/*!
+ * \brief Map a message received during registration to its registration phase
+ */
+static enum sccp_registration_phase sccp_registration_timing_phase(uint32_t mid)
+{
+	switch (mid) {
+		case RegisterMessage:
+			return SCCP_REGISTRATION_PHASE_REGISTER;
+		case ButtonTemplateReqMessage:
+			return SCCP_REGISTRATION_PHASE_BUTTONTEMPLATE;
+		case SoftKeyTemplateReqMessage:
+			return SCCP_REGISTRATION_PHASE_SOFTKEYTEMPLATE;
+		case SoftKeySetReqMessage:
+			return SCCP_REGISTRATION_PHASE_SOFTKEYSET;
+		default:
+			return SCCP_REGISTRATION_PHASE_OTHER;
+	}
+}
+
+/*!
+ * \brief Show Registration Phase Timings
+ * \param fd Fd as int
+ * \param totals Total number of lines as int
+ * \param s AMI Session
+ * \param m Message
+ * \param argc Argc as int
+ * \param argv[] Argv[] as char
+ * \return Result as int
+ *
+ * \called_from_asterisk
+ */
+int sccp_cli_show_registration_timings(int fd, sccp_cli_totals_t *totals, struct mansession *s, const struct message *m, int argc, char *argv[])
+{
+	int local_line_total = 0;
+	uint32_t phase;
+	struct sccp_registration_timing snapshot[ARRAY_LEN(registration_timings)];
+
+	pbx_mutex_lock(&registration_timings_lock);
+	memcpy(snapshot, registration_timings, sizeof(snapshot));
+	pbx_mutex_unlock(&registration_timings_lock);
+
+#define CLI_AMI_TABLE_NAME RegistrationTimings
+#define CLI_AMI_TABLE_PER_ENTRY_NAME Phase
+#define CLI_AMI_TABLE_ITERATOR for(phase = 0; phase < ARRAY_LEN(snapshot); phase++)
+#define CLI_AMI_TABLE_FIELDS 												\
+	CLI_AMI_TABLE_FIELD(Phase,		"-17.17",	s,	17,	snapshot[phase].name)			\
+	CLI_AMI_TABLE_FIELD(Count,		"-10.10",	d,	10,	snapshot[phase].count)			\
+	CLI_AMI_TABLE_FIELD(AvgUs,		"-10",		lu,	10,	(unsigned long) (snapshot[phase].count ? snapshot[phase].total_us / snapshot[phase].count : 0))	\
+	CLI_AMI_TABLE_FIELD(MaxUs,		"-10",		lu,	10,	(unsigned long) snapshot[phase].max_us)
+#include "sccp_cli_table.h"
+	local_line_total++;
+
+	if (s) {
+		totals->lines = local_line_total;
+		totals->tables = 1;
+	}
+	return RESULT_SUCCESS;
+}
+
 /*!
  * \brief       Controller function to handle Received Messages
  * \param       msg Message as sccp_msg_t
@@ -242,11 +353,22 @@ int sccp_handle_message(constMessagePtr msg, constSessionPtr s)
 		return -3;
 	}
 	if (messageMap_cb->messageHandler_cb) {
-		messageMap_cb->messageHandler_cb(s, device, msg);
+		if (mid == RegisterMessage || (device && sccp_device_getRegistrationState(device) == SKINNY_DEVICE_RS_PROGRESS)) {
+			struct timeval handler_start = pbx_tvnow();
+
+			messageMap_cb->messageHandler_cb(s, device, msg);
+			sccp_registration_timing_add(sccp_registration_timing_phase(mid), handler_start);
+		} else {
+			messageMap_cb->messageHandler_cb(s, device, msg);
+		}
 	}
 
 	if (device && sccp_device_getRegistrationState(device) == SKINNY_DEVICE_RS_PROGRESS && mid == device->protocol->registrationFinishedMessageId) {
 		sccp_dev_set_registered(device, SKINNY_DEVICE_RS_OK);
+		if (device->registrationStart.tv_sec) {
+			sccp_registration_timing_add(SCCP_REGISTRATION_PHASE_TOTAL, device->registrationStart);
+			memset(&device->registrationStart, 0, sizeof(device->registrationStart));
+		}
 		char servername[StationMaxDisplayNotifySize];
 
 		snprintf(servername, sizeof(servername), "%s %s", GLOB(servername), SKINNY_DISP_CONNECTED);
@@ -575,6 +697,16 @@ void handle_token_request(constSessionPtr s, devicePtr no_d, constMessagePtr msg
 			if (last_digit % 2 == 0) {
 				sendAck = TRUE;
 			}
+		} else if (!strcasecmp("load", GLOB(token_fallback))) {
+			/* shed phones to the other servers in their list while we are overloaded, the busier we are the longer they stay away */
+			sccp_session_load_t load;
+
+			sccp_session_getLoad(&load);
+			if (load.score >= GLOB(token_load_threshold)) {
+				sendAck = FALSE;
+				token_backoff_time = sccp_session_loadBackoff(load.score, GLOB(token_load_threshold), token_backoff_time);
+				sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "%s: (token_request), load score %d (jobs:%d, sessions:%d, registrations:%d, sendqueue:%d) reached threshold %d\n", deviceName, load.score, load.jobs_score, load.sessions_score, load.registrations_score, load.sendqueue_score, GLOB(token_load_threshold));
+			}
 		} else if (strstr(GLOB(token_fallback), "/") != NULL) {
 			struct stat sb = { 0 };
 			if (stat(GLOB(token_fallback), &sb) == 0 && sb.st_mode & S_IXUSR) {
@@ -624,7 +756,7 @@ void handle_token_request(constSessionPtr s, devicePtr no_d, constMessagePtr msg
 		sccp_log_and((DEBUGCAT_CORE)) (VERBOSE_PREFIX_2 "%s: Acknowledging phone token request\n", deviceName);
 		sccp_session_tokenAck(s);
 	} else {
-		sccp_log_and((DEBUGCAT_CORE)) (VERBOSE_PREFIX_2 "%s: Sending phone a token rejection (sccp.conf:fallback=%s, serverPriority=%d), ask again in '%d' seconds\n", deviceName, GLOB(token_fallback), serverPriority, GLOB(token_backoff_time));
+		sccp_log_and((DEBUGCAT_CORE)) (VERBOSE_PREFIX_2 "%s: Sending phone a token rejection (sccp.conf:fallback=%s, serverPriority=%d), ask again in '%d' seconds\n", deviceName, GLOB(token_fallback), serverPriority, token_backoff_time);
 		sccp_session_tokenReject(s, token_backoff_time);
 	}
 
@@ -958,6 +1090,7 @@ void handle_register(constSessionPtr s, devicePtr maybe_d, constMessagePtr msg_i
 	sccp_device_preregistration(device);
 	device->protocol->sendRegisterAck(device, device->keepaliveinterval, device->keepaliveinterval, GLOB(dateformat));
 
+	device->registrationStart = pbx_tvnow();								/* registration timing, until registrationFinishedMessageId */
 	sccp_dev_set_registered(device, SKINNY_DEVICE_RS_PROGRESS);
 
 	/*
@@ -2499,10 +2632,20 @@ void sccp_handle_soft_key_template_req(constSessionPtr s, devicePtr d, constMess
 {
 	uint8_t i;
 	sccp_msg_t *msg_out = NULL;
+	uint32_t key = 0;
 
 	/* ok the device support the softkey map */
 	d->softkeysupport = 1;
 
+#ifdef CS_SCCP_CONFERENCE
+	key = d->allow_conference ? 1 : 0;								/* the only device setting the template depends on */
+#endif
+	if ((msg_out = sccp_softkey_msgcache_fetch(SoftKeyTemplateResMessage, NULL, key))) {
+		sccp_log((DEBUGCAT_SOFTKEY + DEBUGCAT_DEVICE)) (VERBOSE_PREFIX_3 "%s: Sending cached SoftKeyTemplate\n", d->id);
+		sccp_dev_send(d, msg_out);
+		return;
+	}
+
 	int arrayLen = ARRAY_LEN(softkeysmap);
 	int dummy_len = arrayLen * (sizeof(StationSoftKeyDefinition));
 	int hdr_len = sizeof(msg_out->data.SoftKeyTemplateResMessage);
@@ -2544,26 +2687,156 @@ void sccp_handle_soft_key_template_req(constSessionPtr s, devicePtr d, constMess
 
 	msg_out->data.SoftKeyTemplateResMessage.lel_softKeyCount = htolel(arrayLen);
 	msg_out->data.SoftKeyTemplateResMessage.lel_totalSoftKeyCount = htolel(arrayLen);
+	sccp_softkey_msgcache_store(SoftKeyTemplateResMessage, NULL, key, msg_out);
 	sccp_dev_send(d, msg_out);
 }
 
+/*!
+ * \brief Features a SoftKeySetResMessage is filtered on (key into the softkey message cache)
+ */
+#define SOFTKEYSET_FEATURE_PARK		(1 << 0)
+#define SOFTKEYSET_FEATURE_TRANSFER	(1 << 1)
+#define SOFTKEYSET_FEATURE_DND		(1 << 2)
+#define SOFTKEYSET_FEATURE_CFWDALL	(1 << 3)
+#define SOFTKEYSET_FEATURE_CFWDBUSY	(1 << 4)
+#define SOFTKEYSET_FEATURE_CFWDNOANSWER	(1 << 5)
+#define SOFTKEYSET_FEATURE_TRNSFVM	(1 << 6)
+#define SOFTKEYSET_FEATURE_MEETME	(1 << 7)
+#define SOFTKEYSET_FEATURE_PICKUP	(1 << 8)
+#define SOFTKEYSET_FEATURE_GPICKUP	(1 << 9)
+#define SOFTKEYSET_FEATURE_PRIVATE	(1 << 10)
+
+/*!
+ * \brief Build the SoftKeySetResMessage for a softkeyset, leaving out the softkeys for disabled features
+ * \param d SCCP Device (only used for logging)
+ * \param v SoftKey Modes
+ * \param v_count Number of SoftKey Modes
+ * \param features SOFTKEYSET_FEATURE_* Bitmask
+ * \return SCCP Message
+ */
+static sccp_msg_t *sccp_build_softkeyset_msg(constDevicePtr d, const softkey_modes * v, const uint8_t v_count, const uint32_t features)
+{
+	int iKeySetCount = 0;
+	sccp_msg_t *msg_out = NULL;
+	const uint8_t *b;
+	uint8_t i = 0;
+
+	REQ(msg_out, SoftKeySetResMessage);
+	msg_out->data.SoftKeySetResMessage.lel_softKeySetOffset = htolel(0);
+
+	size_t buffersize = 20 + (15 * sizeof(softkeysmap));
+	struct ast_str *outputStr = ast_str_create(buffersize);
+
+	for (i = 0; i < v_count; i++) {
+		b = v->ptr;
+		uint8_t c, j, cp = 0;
+
+		ast_str_append(&outputStr, buffersize, "%-15s => |", skinny_keymode2str(v->id));
+
+		for (c = 0, cp = 0; c < v->count; c++, cp++) {
+			msg_out->data.SoftKeySetResMessage.definition[v->id].softKeyTemplateIndex[cp] = 0;
+			/* look for the SKINNY_LBL_ number in the softkeysmap */
+			if ((b[c] == SKINNY_LBL_PARK) && !(features & SOFTKEYSET_FEATURE_PARK)) {
+				continue;
+			}
+			if ((b[c] == SKINNY_LBL_TRANSFER) && !(features & SOFTKEYSET_FEATURE_TRANSFER)) {
+				continue;
+			}
+			if ((b[c] == SKINNY_LBL_DND) && !(features & SOFTKEYSET_FEATURE_DND)) {
+				continue;
+			}
+			if ((b[c] == SKINNY_LBL_CFWDALL) && !(features & SOFTKEYSET_FEATURE_CFWDALL)) {
+				continue;
+			}
+			if ((b[c] == SKINNY_LBL_CFWDBUSY) && !(features & SOFTKEYSET_FEATURE_CFWDBUSY)) {
+				continue;
+			}
+			if ((b[c] == SKINNY_LBL_CFWDNOANSWER) && !(features & SOFTKEYSET_FEATURE_CFWDNOANSWER)) {
+				continue;
+			}
+			if ((b[c] == SKINNY_LBL_TRNSFVM) && !(features & SOFTKEYSET_FEATURE_TRNSFVM)) {
+				continue;
+			}
+			if ((b[c] == SKINNY_LBL_IDIVERT) && !(features & SOFTKEYSET_FEATURE_TRNSFVM)) {
+				continue;
+			}
+			if ((b[c] == SKINNY_LBL_MEETME) && !(features & SOFTKEYSET_FEATURE_MEETME)) {
+				continue;
+			}
+#ifndef CS_ADV_FEATURES
+			if ((b[c] == SKINNY_LBL_BARGE)) {
+				continue;
+			}
+			if ((b[c] == SKINNY_LBL_CBARGE)) {
+				continue;
+			}
+#endif
+#ifndef CS_SCCP_CONFERENCE
+			if ((b[c] == SKINNY_LBL_JOIN)) {
+				continue;
+			}
+			if ((b[c] == SKINNY_LBL_CONFRN)) {
+				continue;
+			}
+#endif
+#ifdef CS_SCCP_PICKUP
+			if ((b[c] == SKINNY_LBL_PICKUP) && !(features & SOFTKEYSET_FEATURE_PICKUP)) {
+				continue;
+			}
+			if ((b[c] == SKINNY_LBL_GPICKUP) && !(features & SOFTKEYSET_FEATURE_GPICKUP)) {
+				continue;
+			}
+#endif
+			if ((b[c] == SKINNY_LBL_PRIVATE) && !(features & SOFTKEYSET_FEATURE_PRIVATE)) {
+				continue;
+			}
+			if (b[c] == SKINNY_LBL_EMPTY) {
+				continue;
+			}
+			for (j = 0; j < sizeof(softkeysmap); j++) {
+				if (b[c] == softkeysmap[j]) {
+					ast_str_append(&outputStr, buffersize, "%-2d:%-9s|", c, label2str(softkeysmap[j]));
+					msg_out->data.SoftKeySetResMessage.definition[v->id].softKeyTemplateIndex[cp] = (j + 1);
+					msg_out->data.SoftKeySetResMessage.definition[v->id].les_softKeyInfoIndex[cp] = htoles(j + 301);
+					break;
+				}
+			}
+
+		}
+
+		sccp_log((DEBUGCAT_DEVICE | DEBUGCAT_SOFTKEY)) (VERBOSE_PREFIX_3 "%s: %s\n", d->id, ast_str_buffer(outputStr));
+		ast_str_reset(outputStr);
+		v++;
+		iKeySetCount++;
+	};
+	sccp_free(outputStr);
+
+	sccp_log((DEBUGCAT_DEVICE + DEBUGCAT_SOFTKEY)) (VERBOSE_PREFIX_3 "There are %d SoftKeySets.\n", iKeySetCount);
+
+	msg_out->data.SoftKeySetResMessage.lel_softKeySetCount = htolel(iKeySetCount);
+	msg_out->data.SoftKeySetResMessage.lel_totalSoftKeySetCount = htolel(iKeySetCount);			// <<-- for now, but should be: iTotalKeySetCount;
+	return msg_out;
+}
+
 /*!
  * \brief Handle Set Soft Key Request Message for Session
  * \param s SCCP Session
  * \param d SCCP Device
  * \param msg_in SCCP Message
  *
+ * \note The encoded message is cached per (softkeyset, enabled features), so that a registration storm of similar devices
+ *       only builds it once. The cache is flushed when the softkeysets are released on reload.
+ *
  * \warning
  *   - device->buttonconfig is not always locked
  */
 void handle_soft_key_set_req(constSessionPtr s, devicePtr d, constMessagePtr msg_in)
 {
-
-	int iKeySetCount = 0;
 	sccp_msg_t *msg_out = NULL;
 	uint8_t i = 0;
 	uint8_t trnsfvm = 0;
 	uint8_t meetme = 0;
+	uint32_t features = 0;
 
 #ifdef CS_SCCP_PICKUP
 	uint8_t pickupgroup = 0;
@@ -2604,10 +2877,6 @@ void handle_soft_key_set_req(constSessionPtr s, devicePtr d, constMessagePtr msg
 	/* end softkey definition */
 	const softkey_modes *v = d->softKeyConfiguration.modes;
 	const uint8_t v_count = d->softKeyConfiguration.size;
-	const uint8_t *b;
-
-	REQ(msg_out, SoftKeySetResMessage);
-	msg_out->data.SoftKeySetResMessage.lel_softKeySetOffset = htolel(0);
 
 	/* look for line trnsvm */
 	sccp_buttonconfig_t *buttonconfig;
@@ -2657,92 +2926,28 @@ void handle_soft_key_set_req(constSessionPtr s, devicePtr d, constMessagePtr msg
 	sccp_log((DEBUGCAT_DEVICE + DEBUGCAT_SOFTKEY)) (VERBOSE_PREFIX_3 "%s: PICKUPGROUP     is  %s\n", d->id, (pickupgroup) ? "enabled" : "disabled");
 	sccp_log((DEBUGCAT_DEVICE + DEBUGCAT_SOFTKEY)) (VERBOSE_PREFIX_3 "%s: PICKUPEXTEN     is  %s\n", d->id, (d->directed_pickup) ? "enabled" : "disabled");
 #endif
-	size_t buffersize = 20 + (15 * sizeof(softkeysmap));
-	struct ast_str *outputStr = ast_str_create(buffersize);
-
-	for (i = 0; i < v_count; i++) {
-		b = v->ptr;
-		uint8_t c, j, cp = 0;
-
-		ast_str_append(&outputStr, buffersize, "%-15s => |", skinny_keymode2str(v->id));
-
-		for (c = 0, cp = 0; c < v->count; c++, cp++) {
-			msg_out->data.SoftKeySetResMessage.definition[v->id].softKeyTemplateIndex[cp] = 0;
-			/* look for the SKINNY_LBL_ number in the softkeysmap */
-			if ((b[c] == SKINNY_LBL_PARK) && (!d->park)) {
-				continue;
-			}
-			if ((b[c] == SKINNY_LBL_TRANSFER) && (!d->transfer)) {
-				continue;
-			}
-			if ((b[c] == SKINNY_LBL_DND) && (!d->dndFeature.enabled)) {
-				continue;
-			}
-			if ((b[c] == SKINNY_LBL_CFWDALL) && (!d->cfwdall)) {
-				continue;
-			}
-			if ((b[c] == SKINNY_LBL_CFWDBUSY) && (!d->cfwdbusy)) {
-				continue;
-			}
-			if ((b[c] == SKINNY_LBL_CFWDNOANSWER) && (!d->cfwdnoanswer)) {
-				continue;
-			}
-			if ((b[c] == SKINNY_LBL_TRNSFVM) && (!trnsfvm)) {
-				continue;
-			}
-			if ((b[c] == SKINNY_LBL_IDIVERT) && (!trnsfvm)) {
-				continue;
-			}
-			if ((b[c] == SKINNY_LBL_MEETME) && (!meetme)) {
-				continue;
-			}
-#ifndef CS_ADV_FEATURES
-			if ((b[c] == SKINNY_LBL_BARGE)) {
-				continue;
-			}
-			if ((b[c] == SKINNY_LBL_CBARGE)) {
-				continue;
-			}
-#endif
-#ifndef CS_SCCP_CONFERENCE
-			if ((b[c] == SKINNY_LBL_JOIN)) {
-				continue;
-			}
-			if ((b[c] == SKINNY_LBL_CONFRN)) {
-				continue;
-			}
-#endif
+	features |= d->park ? SOFTKEYSET_FEATURE_PARK : 0;
+	features |= d->transfer ? SOFTKEYSET_FEATURE_TRANSFER : 0;
+	features |= d->dndFeature.enabled ? SOFTKEYSET_FEATURE_DND : 0;
+	features |= d->cfwdall ? SOFTKEYSET_FEATURE_CFWDALL : 0;
+	features |= d->cfwdbusy ? SOFTKEYSET_FEATURE_CFWDBUSY : 0;
+	features |= d->cfwdnoanswer ? SOFTKEYSET_FEATURE_CFWDNOANSWER : 0;
+	features |= trnsfvm ? SOFTKEYSET_FEATURE_TRNSFVM : 0;
+	features |= meetme ? SOFTKEYSET_FEATURE_MEETME : 0;
 #ifdef CS_SCCP_PICKUP
-			if ((b[c] == SKINNY_LBL_PICKUP) && (!d->directed_pickup)) {
-				continue;
-			}
-			if ((b[c] == SKINNY_LBL_GPICKUP) && (!pickupgroup)) {
-				continue;
-			}
+	features |= d->directed_pickup ? SOFTKEYSET_FEATURE_PICKUP : 0;
+	features |= pickupgroup ? SOFTKEYSET_FEATURE_GPICKUP : 0;
 #endif
-			if ((b[c] == SKINNY_LBL_PRIVATE) && (!d->privacyFeature.enabled)) {
-				continue;
-			}
-			if (b[c] == SKINNY_LBL_EMPTY) {
-				continue;
-			}
-			for (j = 0; j < sizeof(softkeysmap); j++) {
-				if (b[c] == softkeysmap[j]) {
-					ast_str_append(&outputStr, buffersize, "%-2d:%-9s|", c, label2str(softkeysmap[j]));
-					msg_out->data.SoftKeySetResMessage.definition[v->id].softKeyTemplateIndex[cp] = (j + 1);
-					msg_out->data.SoftKeySetResMessage.definition[v->id].les_softKeyInfoIndex[cp] = htoles(j + 301);
-					break;
-				}
-			}
+	features |= d->privacyFeature.enabled ? SOFTKEYSET_FEATURE_PRIVATE : 0;
 
+	if (d->softkeyset && (msg_out = sccp_softkey_msgcache_fetch(SoftKeySetResMessage, d->softkeyset, features))) {
+		sccp_log((DEBUGCAT_DEVICE + DEBUGCAT_SOFTKEY)) (VERBOSE_PREFIX_3 "%s: Using cached SoftKeySet '%s' (features:0x%x)\n", d->id, d->softkeyset->name, features);
+	} else {
+		msg_out = sccp_build_softkeyset_msg(d, v, v_count, features);
+		if (d->softkeyset) {
+			sccp_softkey_msgcache_store(SoftKeySetResMessage, d->softkeyset, features, msg_out);
 		}
-
-		sccp_log((DEBUGCAT_DEVICE | DEBUGCAT_SOFTKEY)) (VERBOSE_PREFIX_3 "%s: %s\n", d->id, ast_str_buffer(outputStr));
-		ast_str_reset(outputStr);
-		v++;
-		iKeySetCount++;
-	};
-	sccp_free(outputStr);
+	}
 
 	/* disable videomode and join softkey for all softkeysets */
 	for (i = 0; i < KEYMODE_ONHOOKSTEALABLE; i++) {
@@ -2750,11 +2955,6 @@ void handle_soft_key_set_req(constSessionPtr s, devicePtr d, constMessagePtr msg
 		sccp_softkey_setSoftkeyState(d, i, SKINNY_LBL_JOIN, FALSE);
 	}
 
-	sccp_log((DEBUGCAT_DEVICE + DEBUGCAT_SOFTKEY)) (VERBOSE_PREFIX_3 "There are %d SoftKeySets.\n", iKeySetCount);
-
-	msg_out->data.SoftKeySetResMessage.lel_softKeySetCount = htolel(iKeySetCount);
-	msg_out->data.SoftKeySetResMessage.lel_totalSoftKeySetCount = htolel(iKeySetCount);			// <<-- for now, but should be: iTotalKeySetCount;
-
 	sccp_dev_send(d, msg_out);
 	sccp_dev_set_keyset(d, 0, 0, KEYMODE_ONHOOK);
 }
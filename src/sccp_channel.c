@@ -2612,6 +2612,39 @@ sccp_channel_t *sccp_find_channel_by_lineInstance_and_callid(const sccp_device_t
 	return c;
 }
 
+/*!
+ * \brief Add a channel to the global callid / passthrupartyid indexes
+ * \param channel SCCP Channel
+ *
+ * \note called when the channel is added to line->channels; the index does not hold a reference of its own, the entry
+ * has to be removed (sccp_channel_removeFromIndex) before the line releases its reference.
+ */
+void sccp_channel_addToIndex(constChannelPtr channel)
+{
+	if (!channel) {
+		return;
+	}
+	pbx_rwlock_wrlock(&GLOB(channel_index_lock));
+	sccp_hashtable_insert(GLOB(channel_callid_index), &channel->callid, (sccp_channel_t *) channel);
+	sccp_hashtable_insert(GLOB(channel_passthrupartyid_index), &channel->passthrupartyid, (sccp_channel_t *) channel);
+	pbx_rwlock_unlock(&GLOB(channel_index_lock));
+}
+
+/*!
+ * \brief Remove a channel from the global callid / passthrupartyid indexes
+ * \param channel SCCP Channel
+ */
+void sccp_channel_removeFromIndex(constChannelPtr channel)
+{
+	if (!channel) {
+		return;
+	}
+	pbx_rwlock_wrlock(&GLOB(channel_index_lock));
+	sccp_hashtable_remove(GLOB(channel_callid_index), &channel->callid, channel);
+	sccp_hashtable_remove(GLOB(channel_passthrupartyid_index), &channel->passthrupartyid, channel);
+	pbx_rwlock_unlock(&GLOB(channel_index_lock));
+}
+
 /*!
  * \brief Find Line by ID
  *
@@ -2626,18 +2659,16 @@ sccp_channel_t *sccp_find_channel_by_lineInstance_and_callid(const sccp_device_t
 sccp_channel_t *sccp_channel_find_byid(uint32_t callid)
 {
 	sccp_channel_t *channel = NULL;
-	sccp_line_t *l = NULL;
 
 	sccp_log((DEBUGCAT_CHANNEL)) (VERBOSE_PREFIX_3 "SCCP: Looking for channel by id %u\n", callid);
 
-	SCCP_RWLIST_RDLOCK(&GLOB(lines));
-	SCCP_RWLIST_TRAVERSE(&GLOB(lines), l, list) {
-		channel = sccp_find_channel_on_line_byid(l, callid);
-		if (channel) {
-			break;
-		}
+	pbx_rwlock_rdlock(&GLOB(channel_index_lock));
+	if ((channel = sccp_hashtable_find(GLOB(channel_callid_index), &callid)) && channel->state != SCCP_CHANNELSTATE_DOWN) {
+		channel = sccp_channel_retain(channel);
+	} else {
+		channel = NULL;
 	}
-	SCCP_RWLIST_UNLOCK(&GLOB(lines));
+	pbx_rwlock_unlock(&GLOB(channel_index_lock));
 	if (!channel) {
 		sccp_log((DEBUGCAT_CHANNEL)) (VERBOSE_PREFIX_3 "SCCP: Could not find channel for callid:%d on device\n", callid);
 	}
@@ -2659,20 +2690,16 @@ sccp_channel_t *sccp_channel_find_byid(uint32_t callid)
 sccp_channel_t *sccp_channel_find_bypassthrupartyid(uint32_t passthrupartyid)
 {
 	sccp_channel_t *c = NULL;
-	sccp_line_t *l = NULL;
 
 	sccp_log((DEBUGCAT_CHANNEL)) (VERBOSE_PREFIX_3 "SCCP: Looking for channel by PassThruId %u\n", passthrupartyid);
 
-	SCCP_RWLIST_RDLOCK(&GLOB(lines));
-	SCCP_RWLIST_TRAVERSE(&GLOB(lines), l, list) {
-		SCCP_LIST_LOCK(&l->channels);
-		c = SCCP_LIST_FIND(&l->channels, sccp_channel_t, tmpc, list, (tmpc->passthrupartyid == passthrupartyid && tmpc->state != SCCP_CHANNELSTATE_DOWN), TRUE, __FILE__, __LINE__, __PRETTY_FUNCTION__);
-		SCCP_LIST_UNLOCK(&l->channels);
-		if (c) {
-			break;
-		}
+	pbx_rwlock_rdlock(&GLOB(channel_index_lock));
+	if ((c = sccp_hashtable_find(GLOB(channel_passthrupartyid_index), &passthrupartyid)) && c->state != SCCP_CHANNELSTATE_DOWN) {
+		c = sccp_channel_retain(c);
+	} else {
+		c = NULL;
 	}
-	SCCP_RWLIST_UNLOCK(&GLOB(lines));
+	pbx_rwlock_unlock(&GLOB(channel_index_lock));
 
 	if (!c) {
 		sccp_log((DEBUGCAT_CHANNEL)) (VERBOSE_PREFIX_3 "SCCP: Could not find active channel with Passthrupartyid %u\n", passthrupartyid);
@@ -201,6 +201,8 @@ SCCP_API const char *sccp_channel_getLinkedId(const sccp_channel_t * channel);
 #endif
 
 // find channel
+SCCP_API void SCCP_CALL sccp_channel_addToIndex(constChannelPtr channel);
+SCCP_API void SCCP_CALL sccp_channel_removeFromIndex(constChannelPtr channel);
 SCCP_API sccp_channel_t * SCCP_CALL sccp_channel_find_byid(uint32_t callid);
 SCCP_API sccp_channel_t * SCCP_CALL sccp_find_channel_on_line_byid(constLinePtr l, uint32_t id);
 SCCP_API sccp_channel_t * SCCP_CALL sccp_channel_find_bypassthrupartyid(uint32_t passthrupartyid);
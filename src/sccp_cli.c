@@ -47,6 +47,7 @@
 #include "config.h"
 #include "common.h"
 #include "sccp_channel.h"
+#include "sccp_actions.h"
 #include "sccp_cli.h"
 
 SCCP_FILE_VERSION(__FILE__, "");
@@ -58,8 +59,10 @@ SCCP_FILE_VERSION(__FILE__, "");
 #include "sccp_utils.h"
 #include "sccp_config.h"
 #include "sccp_features.h"
+#include "sccp_featurestore.h"
 #include "sccp_mwi.h"
 #include "sccp_hint.h"
+#include "sccp_devstate.h"
 #include "sys/stat.h"
 #include <asterisk/cli.h>
 #include <asterisk/paths.h>
@@ -293,7 +296,7 @@ static char *sccp_complete_set(OLDCONST char *line, OLDCONST char *word, int pos
 
 	char *properties_channel[] = { "hold" };
 	char *properties_device[] = { "ringtone", "backgroundImage" };
-	char *properties_fallback[] = { "true", "false", "odd", "even", "path" };
+	char *properties_fallback[] = { "true", "false", "odd", "even", "load", "path" };
 
 	char *values_hold[] = { "on", "off" };
 
@@ -474,6 +477,11 @@ static int sccp_show_globals(int fd, sccp_cli_totals_t *totals, struct mansessio
 	pbx_str_t *ha_localnet_buf = pbx_str_alloca(DEFAULT_PBX_STR_BUFFERSIZE);
 	char *debugcategories;
 	int local_line_total = 0;
+	int packet_pool_hits = 0, packet_pool_misses = 0, packet_pool_free = 0;
+	uint keepalive_armed = 0, keepalive_expired = 0, keepalive_expired_interval = 0, keepalive_rescheduled = 0;
+	uint admission_admitted = 0, admission_deferred = 0, admission_rejected = 0, admission_inprogress = 0;
+	uint32_t softkey_msgcache_entries = 0, softkey_msgcache_hits = 0, softkey_msgcache_misses = 0;
+	char config_summary[320];
 	const char *actionid = "";
 
 	pbx_rwlock_rdlock(&GLOB(lock));
@@ -572,10 +580,31 @@ static int sccp_show_globals(int fd, sccp_cli_totals_t *totals, struct mansessio
 #endif
 	CLI_AMI_OUTPUT_PARAM("Token FallBack", CLI_AMI_LIST_WIDTH, "%s", GLOB(token_fallback));
 	CLI_AMI_OUTPUT_PARAM("Token Backoff-Time", CLI_AMI_LIST_WIDTH, "%d", GLOB(token_backoff_time));
+	CLI_AMI_OUTPUT_PARAM("Token Load Threshold", CLI_AMI_LIST_WIDTH, "%d", GLOB(token_load_threshold));
+	CLI_AMI_OUTPUT_PARAM("Token Load Max Sessions", CLI_AMI_LIST_WIDTH, "%d", GLOB(token_load_max_sessions));
 	CLI_AMI_OUTPUT_BOOL("Hotline_Enabled", CLI_AMI_LIST_WIDTH, GLOB(allowAnonymous));
 	CLI_AMI_OUTPUT_PARAM("Hotline_Context", CLI_AMI_LIST_WIDTH, "%s", GLOB(hotline)->line->context ? GLOB(hotline)->line->context : "<not set>");
 	CLI_AMI_OUTPUT_PARAM("Hotline_Exten", CLI_AMI_LIST_WIDTH, "%s", GLOB(hotline->exten));
 	CLI_AMI_OUTPUT_PARAM("Threadpool Size", CLI_AMI_LIST_WIDTH, "%d/%d", sccp_threadpool_jobqueue_count(GLOB(general_threadpool)), sccp_threadpool_thread_count(GLOB(general_threadpool)));
+	CLI_AMI_OUTPUT_BOOL("Session Eventloop", CLI_AMI_LIST_WIDTH, GLOB(session_eventloop));
+	CLI_AMI_OUTPUT_PARAM("Session Eventloop Threads", CLI_AMI_LIST_WIDTH, "%d", sccp_session_eventloop_count());
+	sccp_packet_pool_stats(&packet_pool_hits, &packet_pool_misses, &packet_pool_free);
+	CLI_AMI_OUTPUT_PARAM("Packet Pool Hits/Misses", CLI_AMI_LIST_WIDTH, "%d/%d", packet_pool_hits, packet_pool_misses);
+	CLI_AMI_OUTPUT_PARAM("Packet Pool Free Buffers", CLI_AMI_LIST_WIDTH, "%d", packet_pool_free);
+	sccp_session_keepalive_stats(&keepalive_armed, &keepalive_expired, &keepalive_expired_interval, &keepalive_rescheduled);
+	CLI_AMI_OUTPUT_PARAM("Keepalive Supervised", CLI_AMI_LIST_WIDTH, "%u", keepalive_armed);
+	CLI_AMI_OUTPUT_PARAM("Keepalive Timeouts", CLI_AMI_LIST_WIDTH, "%u (last minute: %u)", keepalive_expired, keepalive_expired_interval);
+	CLI_AMI_OUTPUT_PARAM("Keepalive Rescheduled", CLI_AMI_LIST_WIDTH, "%u", keepalive_rescheduled);
+	CLI_AMI_OUTPUT_PARAM("Admission Rate", CLI_AMI_LIST_WIDTH, "%d", GLOB(session_admission_rate));
+	CLI_AMI_OUTPUT_PARAM("Admission Max Pending", CLI_AMI_LIST_WIDTH, "%d", GLOB(session_admission_max_pending));
+	sccp_session_admission_stats(&admission_admitted, &admission_deferred, &admission_rejected, &admission_inprogress);
+	CLI_AMI_OUTPUT_PARAM("Admission Admitted/Deferred/Rejected", CLI_AMI_LIST_WIDTH, "%u/%u/%u", admission_admitted, admission_deferred, admission_rejected);
+	CLI_AMI_OUTPUT_PARAM("Admission In Progress", CLI_AMI_LIST_WIDTH, "%u", admission_inprogress);
+	sccp_softkey_msgcache_stats(&softkey_msgcache_entries, &softkey_msgcache_hits, &softkey_msgcache_misses);
+	CLI_AMI_OUTPUT_PARAM("Softkey Message Cache", CLI_AMI_LIST_WIDTH, "%u entries, %u/%u hits/misses", softkey_msgcache_entries, softkey_msgcache_hits, softkey_msgcache_misses);
+	sccp_config_reloadSummary(config_summary, sizeof(config_summary));
+	CLI_AMI_OUTPUT_PARAM("Config Load Threads", CLI_AMI_LIST_WIDTH, "%d", GLOB(config_load_threads));
+	CLI_AMI_OUTPUT_PARAM("Last Config Load", CLI_AMI_LIST_WIDTH, "%s", config_summary);
 
 	if (sccp_netsock_is_any_addr(&GLOB(externip)) && GLOB(externhost)) {
 		struct sockaddr_storage externip;
@@ -1467,6 +1496,54 @@ CLI_AMI_ENTRY(show_channels, sccp_show_channels, "Lists active SCCP channels", c
 #undef CLI_COMMAND
 #endif														/* DOXYGEN_SHOULD_SKIP_THIS */
 
+/* ----------------------------------------------------------------------------------------------------------SHOW LOAD- */
+static char cli_load_usage[] = "Usage: sccp show load\n" "	Show the SCCP Load Score used by fallback=load, and the load signals it is made of.\n";
+static char ami_load_usage[] = "Usage: SCCPShowLoad\n" "Show the SCCP Load Score.\n\n" "PARAMS: None\n";
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+#define CLI_COMMAND "sccp", "show", "load"
+#define AMI_COMMAND "SCCPShowLoad"
+#define CLI_COMPLETE SCCP_CLI_NULL_COMPLETER
+#define CLI_AMI_PARAMS ""
+CLI_AMI_ENTRY(show_load, sccp_cli_show_load, "Show SCCP load score", cli_load_usage, FALSE, FALSE)
+#undef CLI_AMI_PARAMS
+#undef CLI_COMPLETE
+#undef AMI_COMMAND
+#undef CLI_COMMAND
+#endif														/* DOXYGEN_SHOULD_SKIP_THIS */
+
+/* -----------------------------------------------------------------------------------------SHOW REGISTRATION TIMINGS- */
+static char cli_registration_timings_usage[] = "Usage: sccp show registration timings\n" "	Show the time spent per registration phase (register, button template, softkey template, softkey set, total).\n";
+static char ami_registration_timings_usage[] = "Usage: SCCPShowRegistrationTimings\n" "Show the time spent per registration phase.\n\n" "PARAMS: None\n";
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+#define CLI_COMMAND "sccp", "show", "registration", "timings"
+#define AMI_COMMAND "SCCPShowRegistrationTimings"
+#define CLI_COMPLETE SCCP_CLI_NULL_COMPLETER
+#define CLI_AMI_PARAMS ""
+CLI_AMI_ENTRY(show_registration_timings, sccp_cli_show_registration_timings, "Show SCCP registration timings", cli_registration_timings_usage, FALSE, TRUE)
+#undef CLI_AMI_PARAMS
+#undef CLI_COMPLETE
+#undef AMI_COMMAND
+#undef CLI_COMMAND
+#endif														/* DOXYGEN_SHOULD_SKIP_THIS */
+
+/* ---------------------------------------------------------------------------------------------------SHOW FEATURESTORE- */
+static char cli_featurestore_usage[] = "Usage: sccp show featurestore\n" "	Show the SCCP Feature Store: keys held in memory, pending database writes and flush latency.\n";
+static char ami_featurestore_usage[] = "Usage: SCCPShowFeatureStore\n" "Show the SCCP Feature Store.\n\n" "PARAMS: None\n";
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+#define CLI_COMMAND "sccp", "show", "featurestore"
+#define AMI_COMMAND "SCCPShowFeatureStore"
+#define CLI_COMPLETE SCCP_CLI_NULL_COMPLETER
+#define CLI_AMI_PARAMS ""
+CLI_AMI_ENTRY(show_featurestore, sccp_cli_show_featurestore, "Show SCCP feature store", cli_featurestore_usage, FALSE, FALSE)
+#undef CLI_AMI_PARAMS
+#undef CLI_COMPLETE
+#undef AMI_COMMAND
+#undef CLI_COMMAND
+#endif														/* DOXYGEN_SHOULD_SKIP_THIS */
+
 /* -------------------------------------------------------------------------------------------------------SHOW SESSIONS- */
 static char cli_sessions_usage[] = "Usage: sccp show sessions [all]\n" "	Show [All] SCCP Sessions.\n";
 static char ami_sessions_usage[] = "Usage: SCCPShowSessions\n" "Show [All] SCCP Sessions.\n\n" "Optional PARAMS: all\n";
@@ -1576,6 +1653,38 @@ CLI_AMI_ENTRY(show_hint_subscriptions, sccp_show_hint_subscriptions, "Show all S
 #undef AMI_COMMAND
 #undef CLI_COMMAND
 #endif														/* DOXYGEN_SHOULD_SKIP_THIS */
+    /* -------------------------------------------------------------------------------------------------SHOW_HINT STATS - */
+static char cli_show_hint_stats_usage[] = "Usage: sccp show hint stats\n" "	Show SCCP Hint notification statistics: notifications sent and suppressed by coalescing, batched device writes.\n";
+static char ami_show_hint_stats_usage[] = "Usage: SCCPShowHintStats\n" "Show SCCP Hint notification statistics.\n\n" "PARAMS: None\n";
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+#define CLI_COMMAND "sccp", "show", "hint", "stats"
+#define AMI_COMMAND "SCCPShowHintStats"
+#define CLI_COMPLETE SCCP_CLI_NULL_COMPLETER
+#define CLI_AMI_PARAMS ""
+CLI_AMI_ENTRY(show_hint_stats, sccp_show_hint_stats, "Show SCCP Hint notification statistics", cli_show_hint_stats_usage, FALSE, FALSE)
+#undef CLI_AMI_PARAMS
+#undef CLI_COMPLETE
+#undef AMI_COMMAND
+#undef CLI_COMMAND
+#endif														/* DOXYGEN_SHOULD_SKIP_THIS */
+#ifdef CS_DEVSTATE_FEATURE
+    /* ---------------------------------------------------------------------------------------------SHOW_DEVSTATE STATS - */
+static char cli_show_devstate_stats_usage[] = "Usage: sccp show devstate stats\n" "	Show SCCP Devstate notification statistics: state changes, notifications sent, threadpool fan-out and latency percentiles.\n";
+static char ami_show_devstate_stats_usage[] = "Usage: SCCPShowDevstateStats\n" "Show SCCP Devstate notification statistics.\n\n" "PARAMS: None\n";
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+#define CLI_COMMAND "sccp", "show", "devstate", "stats"
+#define AMI_COMMAND "SCCPShowDevstateStats"
+#define CLI_COMPLETE SCCP_CLI_NULL_COMPLETER
+#define CLI_AMI_PARAMS ""
+CLI_AMI_ENTRY(show_devstate_stats, sccp_show_devstate_stats, "Show SCCP Devstate notification statistics", cli_show_devstate_stats_usage, FALSE, FALSE)
+#undef CLI_AMI_PARAMS
+#undef CLI_COMPLETE
+#undef AMI_COMMAND
+#undef CLI_COMMAND
+#endif														/* DOXYGEN_SHOULD_SKIP_THIS */
+#endif
     /* -------------------------------------------------------------------------------------------------------TEST- */
 #ifdef CS_EXPERIMENTAL
 /*!
@@ -1907,6 +2016,38 @@ CLI_AMI_ENTRY(show_refcount, sccp_show_refcount, "Show all Refcount Entries", cl
 #undef CLI_COMPLETE
 #undef AMI_COMMAND
 #undef CLI_COMMAND
+#endif														/* DOXYGEN_SHOULD_SKIP_THIS */
+
+    /* ---------------------------------------------------------------------------------------------SHOW_REFCOUNT_POOLS - */
+static char cli_show_refcount_pools_usage[] = "Usage: sccp show refcount pools\n" "	Show the SCCP Refcount Object Pool Statistics (live objects, pool hits and high-water marks per type).\n";
+static char ami_show_refcount_pools_usage[] = "Usage: SCCPShowRefcountPools\n" "Show the Refcount Object Pool Statistics.\n\n" "PARAMS: None\n";
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+#define CLI_COMMAND "sccp", "show", "refcount", "pools"
+#define AMI_COMMAND "SCCPShowRefcountPools"
+#define CLI_COMPLETE SCCP_CLI_NULL_COMPLETER
+#define CLI_AMI_PARAMS ""
+CLI_AMI_ENTRY(show_refcount_pools, sccp_show_refcount_pools, "Show Refcount Pool Statistics", cli_show_refcount_pools_usage, FALSE, TRUE)
+#undef CLI_AMI_PARAMS
+#undef CLI_COMPLETE
+#undef AMI_COMMAND
+#undef CLI_COMMAND
+#endif														/* DOXYGEN_SHOULD_SKIP_THIS */
+
+    /* -------------------------------------------------------------------------------------------------SHOW_THREADPOOL - */
+static char cli_show_threadpool_usage[] = "Usage: sccp show threadpool\n" "	Show the SCCP Threadpool Statistics (queued jobs, runs, steals and queue latency per worker queue).\n";
+static char ami_show_threadpool_usage[] = "Usage: SCCPShowThreadpool\n" "Show the Threadpool Statistics.\n\n" "PARAMS: None\n";
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+#define CLI_COMMAND "sccp", "show", "threadpool"
+#define AMI_COMMAND "SCCPShowThreadpool"
+#define CLI_COMPLETE SCCP_CLI_NULL_COMPLETER
+#define CLI_AMI_PARAMS ""
+CLI_AMI_ENTRY(show_threadpool, sccp_show_threadpool, "Show Threadpool Statistics", cli_show_threadpool_usage, FALSE, TRUE)
+#undef CLI_AMI_PARAMS
+#undef CLI_COMPLETE
+#undef AMI_COMMAND
+#undef CLI_COMMAND
 #endif														/* DOXYGEN_SHOULD_SKIP_THIS */
 
     /* --------------------------------------------------------------------------------------------------SHOW_SOKFTKEYSETS- */
@@ -2150,7 +2291,7 @@ static int sccp_system_message(int fd, sccp_cli_totals_t *totals, struct mansess
 		return RESULT_SHOWUSAGE;
 	}
 
-	if (!(iPbx.feature_addToDatabase("SCCP/message", "text", argv[3]))) {
+	if (!(sccp_featurestore_put("SCCP/message", "text", argv[3]))) {
 		CLI_AMI_OUTPUT(fd, s, "Failed to store the SCCP system message text\n");
 	} else {
 		sccp_log((DEBUGCAT_CLI)) (VERBOSE_PREFIX_3 "SCCP system message text stored successfully\n");
@@ -2167,7 +2308,7 @@ static int sccp_system_message(int fd, sccp_cli_totals_t *totals, struct mansess
 	}
 
 	snprintf(timeoutStr, sizeof(timeoutStr), "%d", timeout);
-	if (!(iPbx.feature_addToDatabase("SCCP/message", "timeout", timeoutStr))) {
+	if (!(sccp_featurestore_put("SCCP/message", "timeout", timeoutStr))) {
 		CLI_AMI_OUTPUT(fd, s, "Failed to store the SCCP system message timeout\n");
 	} else {
 		sccp_log((DEBUGCAT_CLI)) (VERBOSE_PREFIX_3 "SCCP system message timeout stored successfully\n");
@@ -2470,6 +2611,7 @@ static int sccp_cli_reload(int fd, int argc, char *argv[])
 	boolean_t force_reload = FALSE;
 	int returnval = RESULT_FAILURE;
 	sccp_configurationchange_t change;
+	char summary[320];
 
 	if (argc < 2 || argc > 4) {
 		return RESULT_SHOWUSAGE;
@@ -2519,6 +2661,7 @@ static int sccp_cli_reload(int fd, int argc, char *argv[])
 				}
 				if (v) {
 					change = sccp_config_applyDeviceConfiguration(device, v);
+					device->configHash = 0;							/* applied outside of a full reload, make sure the next one rebuilds it */
 					sccp_log((DEBUGCAT_CORE)) ("%s: device has %s\n", device->id, change ? "major changes -> restarting device" : "no major changes -> skipping restart (minor changes applied)");
 					pbx_cli(fd, "%s: device has %s\n", device->id, change ? "major changes -> restarting device" : "no major changes -> restart not required");
 					if (change == SCCP_CONFIG_NEEDDEVICERESET) {
@@ -2576,6 +2719,7 @@ static int sccp_cli_reload(int fd, int argc, char *argv[])
 				}
 				if (v) {
 					change = sccp_config_applyLineConfiguration(line, v);
+					line->configHash = 0;							/* applied outside of a full reload, make sure the next one rebuilds it */
 					sccp_log((DEBUGCAT_CORE)) ("%s: line has %s\n", line->name, change ? "major changes -> restarting attached devices" : "no major changes -> skipping restart (minor changes applied)");
 					pbx_cli(fd, "%s: device has %s\n", line->name, change ? "major changes -> restarting attached devices" : "no major changes -> restart not required");
 					if (change == SCCP_CONFIG_NEEDDEVICERESET) {
@@ -2679,6 +2823,8 @@ static int sccp_cli_reload(int fd, int argc, char *argv[])
 					goto EXIT;
 				}
 				sccp_config_readDevicesLines(readingtype);
+				sccp_config_reloadSummary(summary, sizeof(summary));
+				pbx_cli(fd, "SCCP %s\n", summary);
 				returnval = RESULT_SUCCESS;
 			}
 			break;
@@ -3119,7 +3265,7 @@ static int sccp_set_object(int fd, int argc, char *argv[])
 		}
 		char *fallback_option = pbx_strdupa(argv[3]);
 
-		if (sccp_strcaseequals(fallback_option, "odd") || sccp_strcaseequals(fallback_option, "even") || sccp_true(fallback_option) || sccp_false(fallback_option)) {
+		if (sccp_strcaseequals(fallback_option, "odd") || sccp_strcaseequals(fallback_option, "even") || sccp_strcaseequals(fallback_option, "load") || sccp_true(fallback_option) || sccp_false(fallback_option)) {
 			if (GLOB(token_fallback)) {
 				sccp_free(GLOB(token_fallback));
 			}
@@ -3173,7 +3319,7 @@ static char set_object_usage[] = "Usage: sccp set channel|device|fallback|debug
 				"channel <channelId> hold <on/off>" \
 				"|device <deviceId> [ringtone <ringtone>|backgroundImage <url>" \
 				"|variable <variable>]" \
-				"|fallback [true|false|odd|even|script path]" \
+				"|fallback [true|false|odd|even|load|script path]" \
 				"|debug [[no] <debugcategory>|none]\n";
 
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
@@ -3401,6 +3547,9 @@ static struct pbx_cli_entry cli_entries[] = {
 	AST_CLI_DEFINE(cli_remove_line_from_device, "Remove a line from a device."),
 	AST_CLI_DEFINE(cli_add_line_to_device, "Add a line to a device."),
 	AST_CLI_DEFINE(cli_show_sessions, "Show All SCCP Sessions."),
+	AST_CLI_DEFINE(cli_show_load, "Show SCCP Load Score."),
+	AST_CLI_DEFINE(cli_show_featurestore, "Show SCCP Feature Store."),
+	AST_CLI_DEFINE(cli_show_registration_timings, "Show SCCP Registration Timings."),
 	AST_CLI_DEFINE(cli_dnd_device, "Set DND on a device"),
 	AST_CLI_DEFINE(cli_do_debug, "Enable SCCP debugging."),
 	AST_CLI_DEFINE(cli_no_debug, "Disable SCCP debugging."),
@@ -3420,6 +3569,8 @@ static struct pbx_cli_entry cli_entries[] = {
 	AST_CLI_DEFINE(cli_test, "Test message."),
 #endif
 	AST_CLI_DEFINE(cli_show_refcount, "Test message."),
+	AST_CLI_DEFINE(cli_show_refcount_pools, "Show refcount pool statistics."),
+	AST_CLI_DEFINE(cli_show_threadpool, "Show threadpool statistics."),
 	AST_CLI_DEFINE(cli_tokenack, "Send Token Acknowledgement."),
 #ifdef CS_SCCP_CONFERENCE
 	AST_CLI_DEFINE(cli_show_conferences, "Show running SCCP Conferences."),
@@ -3427,7 +3578,11 @@ static struct pbx_cli_entry cli_entries[] = {
 	AST_CLI_DEFINE(cli_conference_command, "SCCP Conference Commands."),
 #endif
 	AST_CLI_DEFINE(cli_show_hint_lineStates, "Show all hint lineStates"),
-	AST_CLI_DEFINE(cli_show_hint_subscriptions, "Show all hint subscriptions")
+	AST_CLI_DEFINE(cli_show_hint_subscriptions, "Show all hint subscriptions"),
+	AST_CLI_DEFINE(cli_show_hint_stats, "Show hint notification statistics"),
+#ifdef CS_DEVSTATE_FEATURE
+	AST_CLI_DEFINE(cli_show_devstate_stats, "Show devstate notification statistics"),
+#endif
 };
 
 /*!
@@ -3456,6 +3611,9 @@ void sccp_register_cli(void)
 	pbx_manager_register("SCCPShowLine", _MAN_REP_FLAGS, manager_show_line, "show line", ami_line_usage);
 	pbx_manager_register("SCCPShowChannels", _MAN_REP_FLAGS, manager_show_channels, "show channels", ami_channels_usage);
 	pbx_manager_register("SCCPShowSessions", _MAN_REP_FLAGS, manager_show_sessions, "show sessions", ami_sessions_usage);
+	pbx_manager_register("SCCPShowLoad", _MAN_REP_FLAGS, manager_show_load, "show load", ami_load_usage);
+	pbx_manager_register("SCCPShowFeatureStore", _MAN_REP_FLAGS, manager_show_featurestore, "show featurestore", ami_featurestore_usage);
+	pbx_manager_register("SCCPShowRegistrationTimings", _MAN_REP_FLAGS, manager_show_registration_timings, "show registration timings", ami_registration_timings_usage);
 	pbx_manager_register("SCCPShowMWISubscriptions", _MAN_REP_FLAGS, manager_show_mwi_subscriptions, "show mwi subscriptions", ami_mwi_subscriptions_usage);
 	pbx_manager_register("SCCPShowSoftkeySets", _MAN_REP_FLAGS, manager_show_softkeysets, "show softkey sets", ami_show_softkeysets_usage);
 	pbx_manager_register("SCCPMessageDevices", _MAN_REP_FLAGS, manager_message_devices, "message devices", ami_message_devices_usage);
@@ -3471,7 +3629,13 @@ void sccp_register_cli(void)
 #endif
 	pbx_manager_register("SCCPShowHintLineStates", _MAN_REP_FLAGS, manager_show_hint_lineStates, "show hint lineStates", ami_show_hint_lineStates_usage);
 	pbx_manager_register("SCCPShowHintSubscriptions", _MAN_REP_FLAGS, manager_show_hint_subscriptions, "show hint subscriptions", ami_show_hint_subscriptions_usage);
+	pbx_manager_register("SCCPShowHintStats", _MAN_REP_FLAGS, manager_show_hint_stats, "show hint stats", ami_show_hint_stats_usage);
+#ifdef CS_DEVSTATE_FEATURE
+	pbx_manager_register("SCCPShowDevstateStats", _MAN_REP_FLAGS, manager_show_devstate_stats, "show devstate stats", ami_show_devstate_stats_usage);
+#endif
 	pbx_manager_register("SCCPShowRefcount", _MAN_REP_FLAGS, manager_show_refcount, "show refcount", ami_show_refcount_usage);
+	pbx_manager_register("SCCPShowRefcountPools", _MAN_REP_FLAGS, manager_show_refcount_pools, "show refcount pools", ami_show_refcount_pools_usage);
+	pbx_manager_register("SCCPShowThreadpool", _MAN_REP_FLAGS, manager_show_threadpool, "show threadpool", ami_show_threadpool_usage);
 }
 
 /*!
@@ -3493,6 +3657,9 @@ void sccp_unregister_cli(void)
 	pbx_manager_unregister("SCCPShowLine");
 	pbx_manager_unregister("SCCPShowChannels");
 	pbx_manager_unregister("SCCPShowSessions");
+	pbx_manager_unregister("SCCPShowLoad");
+	pbx_manager_unregister("SCCPShowFeatureStore");
+	pbx_manager_unregister("SCCPShowRegistrationTimings");
 	pbx_manager_unregister("SCCPShowMWISubscriptions");
 	pbx_manager_unregister("SCCPShowSoftkeySets");
 	pbx_manager_unregister("SCCPMessageDevices");
@@ -3508,7 +3675,13 @@ void sccp_unregister_cli(void)
 #endif
 	pbx_manager_unregister("SCCPShowHintLineStates");
 	pbx_manager_unregister("SCCPShowHintSubscriptions");
+	pbx_manager_unregister("SCCPShowHintStats");
+#ifdef CS_DEVSTATE_FEATURE
+	pbx_manager_unregister("SCCPShowDevstateStats");
+#endif
 	pbx_manager_unregister("SCCPShowRefcount");
+	pbx_manager_unregister("SCCPShowRefcountPools");
+	pbx_manager_unregister("SCCPShowThreadpool");
 }
 
 // kate: indent-width 8; replace-tabs off; indent-mode cstyle; auto-insert-doxygen on; line-numbers on; tab-indents on; keep-extra-spaces off; auto-brackets off;
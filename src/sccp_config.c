@@ -87,6 +87,8 @@
 #include "sccp_config.h"
 #include "sccp_device.h"
 #include "sccp_featureButton.h"
+#include "sccp_featurestore.h"
+#include "sccp_hint.h"
 #include "sccp_line.h"
 #include "sccp_mwi.h"
 #include "sccp_session.h"
@@ -232,6 +234,10 @@ static const SCCPConfigSegment *sccp_find_segment(const sccp_config_segment_t se
 {
 	uint8_t i = 0;
 
+	/* sccpConfigSegments is ordered by segment, so this is a direct hit */
+	if ((uint) segment < ARRAY_LEN(sccpConfigSegments) && sccpConfigSegments[segment].segment == segment) {
+		return &sccpConfigSegments[segment];
+	}
 	for (i = 0; i < ARRAY_LEN(sccpConfigSegments); i++) {
 		if (sccpConfigSegments[i].segment == segment) {
 			return &sccpConfigSegments[i];
@@ -241,27 +247,132 @@ static const SCCPConfigSegment *sccp_find_segment(const sccp_config_segment_t se
 }
 
 /*!
- * \brief Find of SCCP Config Options
+ * \brief Config Option Name Index Entry
+ *
+ * name points into the (static) SCCPConfigOption name, only the first len characters belong to this entry, so that both
+ * the full "a|b" name and each of its aliases can be indexed without copying.
  */
-static const SCCPConfigOption *sccp_find_config(const sccp_config_segment_t segment, const char *name)
+typedef struct SCCPConfigIndexEntry {
+	const char *name;
+	size_t len;
+	const SCCPConfigOption *option;
+} SCCPConfigIndexEntry;
+
+/*!
+ * \brief Sorted (case insensitive) Config Option Name Index per Segment, built once at module load
+ */
+static struct {
+	SCCPConfigIndexEntry *entries;
+	uint size;
+} sccpConfigIndex[ARRAY_LEN(sccpConfigSegments)];
+
+static int sccp_config_index_namecmp(const char *a, size_t alen, const char *b, size_t blen)
+{
+	int res = strncasecmp(a, b, alen < blen ? alen : blen);
+
+	if (res) {
+		return res;
+	}
+	return (alen > blen) - (alen < blen);
+}
+
+static int sccp_config_index_sortcmp(const void *a, const void *b)
+{
+	const SCCPConfigIndexEntry *entry_a = (const SCCPConfigIndexEntry *) a;
+	const SCCPConfigIndexEntry *entry_b = (const SCCPConfigIndexEntry *) b;
+	int res = sccp_config_index_namecmp(entry_a->name, entry_a->len, entry_b->name, entry_b->len);
+
+	if (res) {
+		return res;
+	}
+	return (entry_a->option > entry_b->option) - (entry_a->option < entry_b->option);		/* keep config table order for duplicates */
+}
+
+/*!
+ * \brief Build the Config Option Name Index (full names and each of their '|' separated aliases)
+ * \note When this fails the index stays empty and sccp_find_config falls back to scanning the config table
+ */
+static void __attribute__((constructor)) sccp_config_index_build(void)
+{
+	uint seg, i, entries, size;
+	const char *name, *sep;
+
+	for (seg = 0; seg < ARRAY_LEN(sccpConfigSegments); seg++) {
+		const SCCPConfigSegment *sccpConfigSegment = &sccpConfigSegments[seg];
+
+		entries = 0;
+		for (i = 0; i < sccpConfigSegment->config_size; i++) {
+			entries++;
+			if (strchr(sccpConfigSegment->config[i].name, '|')) {
+				for (name = sccpConfigSegment->config[i].name; name; name = (sep = strchr(name, '|')) ? sep + 1 : NULL) {
+					entries++;
+				}
+			}
+		}
+		if (!(sccpConfigIndex[seg].entries = sccp_calloc(entries, sizeof(SCCPConfigIndexEntry)))) {
+			continue;
+		}
+		size = 0;
+		for (i = 0; i < sccpConfigSegment->config_size; i++) {
+			const SCCPConfigOption *option = &sccpConfigSegment->config[i];
+
+			sccpConfigIndex[seg].entries[size++] = (SCCPConfigIndexEntry) {option->name, strlen(option->name), option};
+			if (strchr(option->name, '|')) {
+				for (name = option->name; name; name = sep ? sep + 1 : NULL) {
+					sep = strchr(name, '|');
+					sccpConfigIndex[seg].entries[size++] = (SCCPConfigIndexEntry) {name, sep ? (size_t) (sep - name) : strlen(name), option};
+				}
+			}
+		}
+		qsort(sccpConfigIndex[seg].entries, size, sizeof(SCCPConfigIndexEntry), sccp_config_index_sortcmp);
+
+		/* drop duplicate names, the first option in config table order wins (like the linear scan did) */
+		entries = size ? 1 : 0;
+		for (i = 1; i < size; i++) {
+			SCCPConfigIndexEntry *prev = &sccpConfigIndex[seg].entries[entries - 1];
+
+			if (sccp_config_index_namecmp(prev->name, prev->len, sccpConfigIndex[seg].entries[i].name, sccpConfigIndex[seg].entries[i].len)) {
+				sccpConfigIndex[seg].entries[entries++] = sccpConfigIndex[seg].entries[i];
+			}
+		}
+		sccpConfigIndex[seg].size = entries;
+	}
+}
+
+static void __attribute__((destructor)) sccp_config_index_destroy(void)
+{
+	uint seg;
+
+	for (seg = 0; seg < ARRAY_LEN(sccpConfigSegments); seg++) {
+		if (sccpConfigIndex[seg].entries) {
+			sccp_free(sccpConfigIndex[seg].entries);
+		}
+		sccpConfigIndex[seg].size = 0;
+	}
+}
+
+/*!
+ * \brief Find of SCCP Config Options, by scanning the config table
+ */
+static const SCCPConfigOption *sccp_find_config_linear(const SCCPConfigSegment *sccpConfigSegment, const char *name)
 {
 	long unsigned int i = 0;
-	const SCCPConfigSegment *sccpConfigSegment = sccp_find_segment(segment);
 	const SCCPConfigOption *config = sccpConfigSegment->config;
 
 	char delims[] = "|";
 	char *token = NULL;
 	char *config_name = NULL;
+	char *config_name_saveptr = NULL;
 
 	for (i = 0; i < sccpConfigSegment->config_size; i++) {
 		if (strstr(config[i].name, delims) != NULL) {
 			config_name = pbx_strdupa(config[i].name);
-			token = strtok(config_name, delims);
+			token = strtok_r(config_name, delims, &config_name_saveptr);
 			while (token != NULL) {
 				if (!strcasecmp(token, name)) {
 					return &config[i];
 				}
-				token = strtok(NULL, delims);
+				token = strtok_r(NULL, delims, &config_name_saveptr);
 			}
 		}
 		if (!strcasecmp(config[i].name, name)) {
@@ -272,6 +383,40 @@ static const SCCPConfigOption *sccp_find_config(const sccp_config_segment_t segm
 	return NULL;
 }
 
+/*!
+ * \brief Find of SCCP Config Options
+ * \note binary search on the config option name index, falls back to a scan of the config table if the index is not available
+ */
+static const SCCPConfigOption *sccp_find_config(const sccp_config_segment_t segment, const char *name)
+{
+	const SCCPConfigSegment *sccpConfigSegment = sccp_find_segment(segment);
+	const SCCPConfigIndexEntry *entries = NULL;
+	size_t len = strlen(name);
+	uint low = 0, high = 0, mid = 0;
+	int res;
+
+	if (!sccpConfigSegment) {
+		return NULL;
+	}
+	entries = sccpConfigIndex[sccpConfigSegment - sccpConfigSegments].entries;
+	if (!entries) {
+		return sccp_find_config_linear(sccpConfigSegment, name);
+	}
+	high = sccpConfigIndex[sccpConfigSegment - sccpConfigSegments].size;
+	while (low < high) {
+		mid = low + (high - low) / 2;
+		res = sccp_config_index_namecmp(name, len, entries[mid].name, entries[mid].len);
+		if (res == 0) {
+			return entries[mid].option;
+		} else if (res < 0) {
+			high = mid;
+		} else {
+			low = mid + 1;
+		}
+	}
+	return NULL;
+}
+
 /* Create new variable structure for Multi Entry Parameters */
 static PBX_VARIABLE_TYPE *createVariableSetForMultiEntryParameters(PBX_VARIABLE_TYPE * cat_root, const char *configOptionName, PBX_VARIABLE_TYPE * out)
 {
@@ -280,9 +425,10 @@ static PBX_VARIABLE_TYPE *createVariableSetForMultiEntryParameters(PBX_VARIABLE_
 	char delims[] = "|";
 	char option_name[strlen(configOptionName) + 2];
 	char *token = NULL;
+	char *option_name_saveptr = NULL;
 	
 	snprintf(option_name, sizeof(option_name), "%s%s", configOptionName, delims);
-	token = strtok(option_name, delims);
+	token = strtok_r(option_name, delims, &option_name_saveptr);
 	while (token != NULL) {
 		sccp_log_and((DEBUGCAT_CONFIG + DEBUGCAT_HIGH)) (VERBOSE_PREFIX_4 "Token %s/%s\n", option_name, token);
 		for (v = cat_root; v; v = v->next) {
@@ -305,7 +451,7 @@ static PBX_VARIABLE_TYPE *createVariableSetForMultiEntryParameters(PBX_VARIABLE_
 				}
 			}
 		}
-		token = strtok(NULL, delims);
+		token = strtok_r(NULL, delims, &option_name_saveptr);
 	}
 EXIT:
 	return out;
@@ -2304,6 +2450,356 @@ void cleanup_stale_contexts(char *new, char *old)
 	}
 }
 
+/*!
+ * \brief Statistics of the last Device/Line (re)load
+ */
+static struct sccp_config_reload_stats {
+	uint devices_added;
+	uint devices_changed;
+	uint devices_unchanged;
+	uint devices_removed;
+	uint lines_added;
+	uint lines_changed;
+	uint lines_unchanged;
+	uint lines_removed;
+	int64_t compare_ms;										/*!< hashing sections and comparing them with the previous load */
+	int64_t apply_ms;										/*!< applying the changed sections */
+	int64_t post_ms;										/*!< removing / restarting devices and lines */
+	uint load_threads;										/*!< number of config load threads used (0 = sequential) */
+	int64_t build_ms;										/*!< building the new devices and lines on the config load threads */
+	int64_t insert_ms;										/*!< inserting the batch into the global lists */
+	boolean_t reload;
+} sccp_config_reload_stats;
+
+/*!
+ * \brief Hash the variables of a config section (FNV-1a, case insensitive names, order sensitive)
+ */
+static uint32_t sccp_config_hash_variables(uint32_t hash, PBX_VARIABLE_TYPE * v)
+{
+	const unsigned char *c;
+
+	for (; v; v = v->next) {
+		for (c = (const unsigned char *) v->name; *c; c++) {
+			hash = (hash ^ tolower(*c)) * 16777619U;
+		}
+		hash = (hash ^ '=') * 16777619U;
+		for (c = (const unsigned char *) v->value; *c; c++) {
+			hash = (hash ^ *c) * 16777619U;
+		}
+		hash = (hash ^ '\n') * 16777619U;
+	}
+	return hash;
+}
+
+/*!
+ * \brief Hash of a device/line section, seeded with the hash of [general] (defaults are inherited from there)
+ * \return hash, never 0 (0 marks objects not built from sccp.conf)
+ */
+static uint32_t sccp_config_section_hash(uint32_t general_hash, const char *cat)
+{
+	uint32_t hash = sccp_config_hash_variables(general_hash, ast_variable_browse(GLOB(cfg), cat));
+
+	return hash ? hash : 1;
+}
+
+/*!
+ * \brief Mark all devices and lines whose section did not change since they were last built
+ *
+ * Marked objects are skipped by pre_reload, the section parsing and post_reload, so they are not touched at all.
+ */
+static void sccp_config_markUnchangedSections(uint32_t general_hash)
+{
+	char *cat = NULL;
+	const char *utype = NULL;
+	sccp_device_t *d = NULL;
+	sccp_line_t *l = NULL;
+
+	SCCP_RWLIST_WRLOCK(&GLOB(devices));
+	SCCP_RWLIST_TRAVERSE(&GLOB(devices), d, list) {
+		d->configUnchanged = FALSE;
+	}
+	SCCP_RWLIST_UNLOCK(&GLOB(devices));
+	SCCP_RWLIST_WRLOCK(&GLOB(lines));
+	SCCP_RWLIST_TRAVERSE(&GLOB(lines), l, list) {
+		l->configUnchanged = FALSE;
+	}
+	SCCP_RWLIST_UNLOCK(&GLOB(lines));
+
+	while ((cat = pbx_category_browse(GLOB(cfg), cat))) {
+		if (!strcasecmp(cat, "general") || !(utype = pbx_variable_retrieve(GLOB(cfg), cat, "type"))) {
+			continue;
+		}
+		if (!strcasecmp(utype, "device")) {
+			AUTO_RELEASE sccp_device_t *device = sccp_device_find_byid(cat, FALSE);
+
+			if (device && !device->realtime && device->configHash && !device->pendingDelete && device->configHash == sccp_config_section_hash(general_hash, cat)) {
+				device->configUnchanged = TRUE;
+			}
+		} else if (!strcasecmp(utype, "line")) {
+			AUTO_RELEASE sccp_line_t *line = sccp_line_find_byname(cat, FALSE);
+
+			if (line && line->configHash && !line->pendingDelete && line->configHash == sccp_config_section_hash(general_hash, cat)) {
+#ifdef CS_SCCP_REALTIME
+				if (line->realtime) {
+					continue;
+				}
+#endif
+				line->configUnchanged = TRUE;
+			}
+		}
+	}
+}
+
+/*!
+ * \brief Summary of the last Device/Line (re)load
+ */
+void sccp_config_reloadSummary(char *buf, size_t size)
+{
+	const struct sccp_config_reload_stats *stats = &sccp_config_reload_stats;
+
+	int len = snprintf(buf, size, "%s: devices %u added, %u changed, %u unchanged, %u removed; lines %u added, %u changed, %u unchanged, %u removed; compare %" PRId64 " ms, apply %" PRId64 " ms, post %" PRId64 " ms",
+		stats->reload ? "reload" : "load",
+		stats->devices_added, stats->devices_changed, stats->devices_unchanged, stats->devices_removed,
+		stats->lines_added, stats->lines_changed, stats->lines_unchanged, stats->lines_removed,
+		stats->compare_ms, stats->apply_ms, stats->post_ms);
+
+	if (stats->load_threads && len > 0 && (size_t) len < size) {
+		snprintf(buf + len, size - len, " (%u threads: build %" PRId64 " ms, insert %" PRId64 " ms)", stats->load_threads, stats->build_ms, stats->insert_ms);
+	}
+}
+
+/*!
+ * \brief Create or update the Device of a sccp.conf section
+ */
+static void sccp_config_loadDeviceSection(const char *cat, uint32_t general_hash)
+{
+	struct sccp_config_reload_stats *stats = &sccp_config_reload_stats;
+	PBX_VARIABLE_TYPE *v = ast_variable_browse(GLOB(cfg), cat);
+
+	// Try to find out if we have the device already on file.
+	// However, do not look into realtime, since
+	// we might have been asked to create a device for realtime addition,
+	// thus causing an infinite loop / recursion.
+	AUTO_RELEASE sccp_device_t *d = sccp_device_find_byid(cat, FALSE);
+	sccp_nat_t nat = SCCP_NAT_AUTO;
+
+	/* create new device with default values */
+	if (!d) {
+		d = sccp_device_create(cat);
+		// sccp_copy_string(d->id, cat, sizeof(d->id));         /* set device name */
+		sccp_device_addToGlobals(d);
+		stats->devices_added++;
+	} else if (d->configUnchanged) {
+		sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_3 "device %s unchanged, skipping\n", cat);
+		stats->devices_unchanged++;
+		return;
+	} else {
+		if (d->pendingDelete) {
+			nat = d->nat;
+			d->pendingDelete = 0;
+		}
+		stats->devices_changed++;
+	}
+	sccp_config_buildDevice(d, v, cat, FALSE);
+	d->configHash = sccp_config_section_hash(general_hash, cat);
+	sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_3 "found device: %s\n", cat);
+	/* load saved settings from ast db */
+	sccp_config_restoreDeviceFeatureStatus(d);
+
+	/* restore current nat status, if device does not get restarted */
+	if (0 == d->pendingDelete && sccp_device_getRegistrationState(d) != SKINNY_DEVICE_RS_NONE) {
+		if (SCCP_NAT_AUTO == d->nat && (SCCP_NAT_AUTO == nat || SCCP_NAT_AUTO_OFF == nat || SCCP_NAT_AUTO_ON == nat)) {
+			d->nat = nat;
+		}
+	}
+}
+
+/*!
+ * \brief Create or update the Line of a sccp.conf section
+ */
+static void sccp_config_loadLineSection(const char *cat, uint32_t general_hash)
+{
+	struct sccp_config_reload_stats *stats = &sccp_config_reload_stats;
+	PBX_VARIABLE_TYPE *v = ast_variable_browse(GLOB(cfg), cat);
+	AUTO_RELEASE sccp_line_t *l = sccp_line_find_byname(cat, FALSE);
+
+	/* check if we have this line already */
+	//    SCCP_RWLIST_WRLOCK(&GLOB(lines));
+	if (l && l->configUnchanged) {
+		sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_3 "line %s unchanged, skipping\n", cat);
+		stats->lines_unchanged++;
+	} else if (l) {
+		sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_3 "found line: %s, do update\n", cat);
+		sccp_config_buildLine(l, v, cat, FALSE);
+		l->configHash = sccp_config_section_hash(general_hash, cat);
+		stats->lines_changed++;
+	} else if ((l = sccp_line_create(cat))) {
+		sccp_config_buildLine(l, v, cat, FALSE);
+		l->configHash = sccp_config_section_hash(general_hash, cat);
+		sccp_line_addToGlobals(l);							/* may find another line instance create by another thread, in that case the newly created line is going to be dropped when l is released */
+		stats->lines_added++;
+	}
+	//    SCCP_RWLIST_UNLOCK(&GLOB(lines));
+}
+
+#define SCCP_CONFIG_LOAD_MAX_THREADS 32
+
+/*!
+ * \brief New Device/Line section, built by one of the config load threads
+ */
+typedef struct sccp_config_load_item {
+	const char *cat;
+	sccp_config_segment_t segment;									/*!< SCCP_CONFIG_DEVICE_SEGMENT or SCCP_CONFIG_LINE_SEGMENT */
+	boolean_t deferred;										/*!< duplicate section name, applied one by one after the batch has been inserted */
+	char lineId[SCCP_MAX_LINE_ID];									/*!< line id the sequential load would have assigned */
+	sccp_device_t *device;
+	sccp_line_t *line;
+} sccp_config_load_item_t;
+
+struct sccp_config_load_job {
+	sccp_config_load_item_t *items;
+	uint count;
+	uint offset;
+	uint stride;
+	uint32_t general_hash;
+};
+
+/*!
+ * \brief Config load thread: builds every stride'th item of the batch
+ *
+ * The items are not in the global lists yet, so nobody else can see them while they are being built. Only reads GLOB(cfg), which
+ * is not changed while the load is in progress. Everything on the build path has to be reentrant: the option parsers tokenize with
+ * strtok_r, the option index is built once at module load, feature status is read through the (locked) feature store and the hint
+ * cache generation is bumped atomically.
+ */
+static void *sccp_config_load_thread(void *data)
+{
+	struct sccp_config_load_job *job = data;
+	sccp_config_load_item_t *item = NULL;
+	uint i;
+
+	for (i = job->offset; i < job->count; i += job->stride) {
+		item = &job->items[i];
+		if (item->deferred) {
+			continue;
+		}
+		if (item->segment == SCCP_CONFIG_DEVICE_SEGMENT) {
+			if ((item->device = sccp_device_create(item->cat))) {
+				sccp_config_buildDevice(item->device, ast_variable_browse(GLOB(cfg), item->cat), item->cat, FALSE);
+				item->device->configHash = sccp_config_section_hash(job->general_hash, item->cat);
+				/* load saved settings from ast db */
+				sccp_config_restoreDeviceFeatureStatus(item->device);
+			}
+		} else if ((item->line = sccp_line_create(item->cat))) {
+			sccp_copy_string(item->line->id, item->lineId, sizeof(item->line->id));
+			sccp_config_buildLine(item->line, ast_variable_browse(GLOB(cfg), item->cat), item->cat, FALSE);
+			item->line->configHash = sccp_config_section_hash(job->general_hash, item->cat);
+		}
+	}
+	return NULL;
+}
+
+/*!
+ * \brief Build a batch of new Devices and Lines using config_load_threads threads, then insert them into the global lists in one go
+ */
+static void sccp_config_loadBatch(sccp_config_load_item_t * items, uint count, uint32_t general_hash)
+{
+	struct sccp_config_reload_stats *stats = &sccp_config_reload_stats;
+	struct sccp_config_load_job jobs[SCCP_CONFIG_LOAD_MAX_THREADS];
+	pthread_t threads[SCCP_CONFIG_LOAD_MAX_THREADS];
+	boolean_t started[SCCP_CONFIG_LOAD_MAX_THREADS] = { FALSE };
+	sccp_device_t **devices = NULL;
+	sccp_line_t **lines = NULL;
+	uint ndevices = 0, nlines = 0;
+	uint nthreads = GLOB(config_load_threads);
+	uint i;
+	struct timeval phase_start = pbx_tvnow();
+
+	if (nthreads > SCCP_CONFIG_LOAD_MAX_THREADS) {
+		nthreads = SCCP_CONFIG_LOAD_MAX_THREADS;
+	}
+	if (nthreads > count) {
+		nthreads = count;
+	}
+	for (i = 0; i < nthreads; i++) {
+		jobs[i].items = items;
+		jobs[i].count = count;
+		jobs[i].offset = i;
+		jobs[i].stride = nthreads;
+		jobs[i].general_hash = general_hash;
+		/* thread 0 runs on the calling thread, the others are joined below */
+		if (i > 0 && !pbx_pthread_create(&threads[i], NULL, sccp_config_load_thread, &jobs[i])) {
+			started[i] = TRUE;
+		}
+	}
+	if (nthreads) {
+		sccp_config_load_thread(&jobs[0]);
+	}
+	for (i = 1; i < nthreads; i++) {
+		if (started[i]) {
+			pthread_join(threads[i], NULL);
+		} else {
+			pbx_log(LOG_WARNING, "SCCP: (sccp_config_loadBatch) Unable to start config load thread %u, building its share on this thread\n", i);
+			sccp_config_load_thread(&jobs[i]);
+		}
+	}
+	stats->load_threads = nthreads;
+	stats->build_ms = ast_tvdiff_ms(pbx_tvnow(), phase_start);
+	phase_start = pbx_tvnow();
+
+	devices = sccp_calloc(count, sizeof *devices);
+	lines = sccp_calloc(count, sizeof *lines);
+	if (!devices || !lines) {
+		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+	}
+	for (i = 0; i < count; i++) {
+		if (items[i].device) {
+			if (devices) {
+				devices[ndevices++] = items[i].device;
+			} else {
+				sccp_device_addToGlobals(items[i].device);
+			}
+			stats->devices_added++;
+		} else if (items[i].line) {
+			if (lines) {
+				lines[nlines++] = items[i].line;
+			} else {
+				sccp_line_addToGlobals(items[i].line);
+			}
+			stats->lines_added++;
+		}
+	}
+	sccp_device_addBatchToGlobals(devices, ndevices);
+	sccp_line_addBatchToGlobals(lines, nlines);
+	if (devices) {
+		sccp_free(devices);
+	}
+	if (lines) {
+		sccp_free(lines);
+	}
+
+	/* the lists hold their own reference now */
+	for (i = 0; i < count; i++) {
+		if (items[i].device) {
+			sccp_device_release(&items[i].device);					/* explicit release of created device */
+		} else if (items[i].line) {
+			sccp_line_release(&items[i].line);					/* explicit release of created line */
+		}
+	}
+
+	/* duplicate sections update the object created by the first one, just like the sequential load does */
+	for (i = 0; i < count; i++) {
+		if (items[i].deferred) {
+			if (items[i].segment == SCCP_CONFIG_DEVICE_SEGMENT) {
+				sccp_config_loadDeviceSection(items[i].cat, general_hash);
+			} else {
+				sccp_config_loadLineSection(items[i].cat, general_hash);
+			}
+		}
+	}
+	stats->insert_ms = ast_tvdiff_ms(pbx_tvnow(), phase_start);
+}
+
 /*!
  * \brief Read Lines from the Config File
  *
@@ -2321,13 +2817,36 @@ void sccp_config_readDevicesLines(sccp_readingtype_t readingtype)
 
 	char *cat = NULL;
 	PBX_VARIABLE_TYPE *v = NULL;
-	uint8_t device_count = 0;
-	uint8_t line_count = 0;
+	uint32_t general_hash = 0;
+	boolean_t parallel = (readingtype == SCCP_CONFIG_READINITIAL && GLOB(config_load_threads) > 0);
+	sccp_config_segment_t segment;
+	sccp_config_load_item_t *items = NULL;
+	sccp_config_load_item_t *item = NULL;
+	uint nitems = 0, maxitems = 0;
+	int line_base = 0;
+	sccp_hashtable_t *device_names = NULL;
+	sccp_hashtable_t *line_names = NULL;
+	struct sccp_config_reload_stats *stats = &sccp_config_reload_stats;
+	struct timeval start = pbx_tvnow();
+	struct timeval phase_start = start;
 
 	sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_1 "Loading Devices and Lines from config\n");
 
+	memset(stats, 0, sizeof(*stats));
+	stats->reload = (readingtype == SCCP_CONFIG_READRELOAD);
+	if (GLOB(cfg)) {
+		/* [general] seeds every section hash: the defaults of devices and lines are inherited from it */
+		general_hash = sccp_config_hash_variables(2166136261U, ast_variable_browse(GLOB(cfg), "general"));
+	}
+
 	sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_1 "Checking Reading Type\n");
 	if (readingtype == SCCP_CONFIG_READRELOAD) {
+		if (GLOB(cfg)) {
+			sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_2 "Comparing Sections\n");
+			sccp_config_markUnchangedSections(general_hash);
+		}
+		stats->compare_ms = ast_tvdiff_ms(pbx_tvnow(), phase_start);
+		phase_start = pbx_tvnow();
 		sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_2 "Device Pre Reload\n");
 		sccp_device_pre_reload();
 		sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_2 "Line Pre Reload\n");
@@ -2341,6 +2860,20 @@ void sccp_config_readDevicesLines(sccp_readingtype_t readingtype)
 		return;
 	}
 
+	/* (re)read the persisted feature state in one go, restoring devices reads it from memory */
+	sccp_featurestore_load();
+
+	if (parallel) {
+		device_names = sccp_hashtable_create(0, sccp_hash_string_nocase, sccp_hash_match_string_nocase);
+		line_names = sccp_hashtable_create(0, sccp_hash_string_nocase, sccp_hash_match_string_nocase);
+		if (!device_names || !line_names) {
+			sccp_hashtable_destroy(&device_names);
+			sccp_hashtable_destroy(&line_names);
+			parallel = FALSE;
+		}
+		line_base = SCCP_LIST_GETSIZE(&GLOB(lines));
+	}
+
 	while ((cat = pbx_category_browse(GLOB(cfg), cat))) {
 
 		const char *utype;
@@ -2359,62 +2892,23 @@ void sccp_config_readDevicesLines(sccp_readingtype_t readingtype)
 			if (sccp_strlen_zero(pbx_variable_retrieve(GLOB(cfg), cat, "devicetype"))) {
 				pbx_log(LOG_WARNING, "Unknown type '%s' for '%s' in %s\n", utype, cat, "sccp.conf");
 				continue;
-			} else {
-				v = ast_variable_browse(GLOB(cfg), cat);
-
-				// Try to find out if we have the device already on file.
-				// However, do not look into realtime, since
-				// we might have been asked to create a device for realtime addition,
-				// thus causing an infinite loop / recursion.
-				AUTO_RELEASE sccp_device_t *d = sccp_device_find_byid(cat, FALSE);
-				sccp_nat_t nat = SCCP_NAT_AUTO;
-
-				/* create new device with default values */
-				if (!d) {
-					d = sccp_device_create(cat);
-					// sccp_copy_string(d->id, cat, sizeof(d->id));         /* set device name */
-					sccp_device_addToGlobals(d);
-					device_count++;
-				} else {
-					if (d->pendingDelete) {
-						nat = d->nat;
-						d->pendingDelete = 0;
-					}
-				}
-				sccp_config_buildDevice(d, v, cat, FALSE);
-				sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_3 "found device %d: %s\n", device_count, cat);
-				/* load saved settings from ast db */
-				sccp_config_restoreDeviceFeatureStatus(d);
-				
-				/* restore current nat status, if device does not get restarted */
-				if (0 == d->pendingDelete && sccp_device_getRegistrationState(d) != SKINNY_DEVICE_RS_NONE) {
-					if (SCCP_NAT_AUTO == d->nat && (SCCP_NAT_AUTO == nat || SCCP_NAT_AUTO_OFF == nat || SCCP_NAT_AUTO_ON == nat)) {
-						d->nat = nat;
-					}
-				}
 			}
+			if (!parallel) {
+				sccp_config_loadDeviceSection(cat, general_hash);
+				continue;
+			}
+			segment = SCCP_CONFIG_DEVICE_SEGMENT;
 		} else if (!strcasecmp(utype, "line")) {
 			/* check minimum requirements for a line */
 			if ((!(!sccp_strlen_zero(pbx_variable_retrieve(GLOB(cfg), cat, "label"))) && (!sccp_strlen_zero(pbx_variable_retrieve(GLOB(cfg), cat, "cid_name"))) && (!sccp_strlen_zero(pbx_variable_retrieve(GLOB(cfg), cat, "cid_num"))))) {
 				pbx_log(LOG_WARNING, "Unknown type '%s' for '%s' in %s\n", utype, cat, "sccp.conf");
 				continue;
 			}
-			line_count++;
-
-			v = ast_variable_browse(GLOB(cfg), cat);
-			AUTO_RELEASE sccp_line_t *l = sccp_line_find_byname(cat, FALSE);
-
-			/* check if we have this line already */
-			//    SCCP_RWLIST_WRLOCK(&GLOB(lines));
-			if (l) {
-				sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_3 "found line %d: %s, do update\n", line_count, cat);
-				sccp_config_buildLine(l, v, cat, FALSE);
-			} else if ((l = sccp_line_create(cat))) {
-				sccp_config_buildLine(l, v, cat, FALSE);
-				sccp_line_addToGlobals(l);						/* may find another line instance create by another thread, in that case the newly created line is going to be dropped when l is released */
+			if (!parallel) {
+				sccp_config_loadLineSection(cat, general_hash);
+				continue;
 			}
-			//    SCCP_RWLIST_UNLOCK(&GLOB(lines));
-
+			segment = SCCP_CONFIG_LINE_SEGMENT;
 		} else if (!strcasecmp(utype, "softkeyset")) {
 			sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_3 "read set %s\n", cat);
 			if (sccp_strcaseequals(cat, "default")) {
@@ -2423,8 +2917,48 @@ void sccp_config_readDevicesLines(sccp_readingtype_t readingtype)
 				v = ast_variable_browse(GLOB(cfg), cat);
 				sccp_config_softKeySet(v, cat);
 			}
+			continue;
 		} else {
 			pbx_log(LOG_WARNING, "SCCP: (sccp_config_readDevicesLines) UNKNOWN SECTION / UTYPE, type: %s\n", utype);
+			continue;
+		}
+
+		/* parallel load: collect the new device/line, it is built and inserted after all sections have been read */
+		if (nitems == maxitems) {
+			sccp_config_load_item_t *tmp = sccp_realloc(items, (maxitems ? maxitems * 2 : 64) * sizeof(*items));
+
+			if (!tmp) {
+				pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+				if (segment == SCCP_CONFIG_DEVICE_SEGMENT) {
+					sccp_config_loadDeviceSection(cat, general_hash);
+				} else {
+					sccp_config_loadLineSection(cat, general_hash);
+				}
+				continue;
+			}
+			items = tmp;
+			maxitems = maxitems ? maxitems * 2 : 64;
+		}
+		item = &items[nitems++];
+		memset(item, 0, sizeof(*item));
+		item->cat = cat;
+		item->segment = segment;
+		if (segment == SCCP_CONFIG_DEVICE_SEGMENT) {
+			item->deferred = sccp_hashtable_find(device_names, cat) || !sccp_hashtable_insert(device_names, cat, (void *) cat);	/* items gets reallocated, only store the name */
+		} else {
+			item->deferred = sccp_hashtable_find(line_names, cat) || !sccp_hashtable_insert(line_names, cat, (void *) cat);
+			if (!item->deferred) {
+				/* same id as the sequential load, which numbers new lines by the size of the global line list */
+				snprintf(item->lineId, sizeof(item->lineId), "%04d", line_base++);
+			}
+		}
+	}
+	if (parallel) {
+		sccp_config_loadBatch(items, nitems, general_hash);
+		sccp_hashtable_destroy(&device_names);
+		sccp_hashtable_destroy(&line_names);
+		if (items) {
+			sccp_free(items);
 		}
 	}
 	sccp_config_add_default_softkeyset();
@@ -2513,8 +3047,25 @@ void sccp_config_readDevicesLines(sccp_readingtype_t readingtype)
 	}
 	GLOB(pendingUpdate) = 0;
 
+	stats->apply_ms = ast_tvdiff_ms(pbx_tvnow(), phase_start);
+	phase_start = pbx_tvnow();
+
 	sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_1 "Checking Reading Type\n");
 	if (readingtype == SCCP_CONFIG_READRELOAD) {
+		sccp_line_t *line = NULL;
+		sccp_device_t *device = NULL;
+
+		SCCP_RWLIST_RDLOCK(&GLOB(lines));
+		SCCP_RWLIST_TRAVERSE(&GLOB(lines), line, list) {
+			stats->lines_removed += line->pendingDelete ? 1 : 0;
+		}
+		SCCP_RWLIST_UNLOCK(&GLOB(lines));
+		SCCP_RWLIST_RDLOCK(&GLOB(devices));
+		SCCP_RWLIST_TRAVERSE(&GLOB(devices), device, list) {
+			stats->devices_removed += device->pendingDelete ? 1 : 0;
+		}
+		SCCP_RWLIST_UNLOCK(&GLOB(devices));
+
 		/* IMPORTANT: The line_post_reload function may change the pendingUpdate field of
 		 * devices, so it's really important to call it *before* calling device_post_real().
 		 */
@@ -2525,6 +3076,11 @@ void sccp_config_readDevicesLines(sccp_readingtype_t readingtype)
 		sccp_log((DEBUGCAT_CONFIG)) (VERBOSE_PREFIX_2 "Softkey Post Reload\n");
 		sccp_softkey_post_reload();
 	}
+	stats->post_ms = ast_tvdiff_ms(pbx_tvnow(), phase_start);
+
+	char summary[320];
+	sccp_config_reloadSummary(summary, sizeof(summary));
+	pbx_log(LOG_NOTICE, "SCCP: Devices/Lines %s (total %" PRId64 " ms)\n", summary, ast_tvdiff_ms(pbx_tvnow(), start));
 }
 
 /*!
@@ -2587,6 +3143,9 @@ sccp_configurationchange_t sccp_config_applyDeviceConfiguration(sccp_device_t *
 	if (d->keepalive < SCCP_MIN_KEEPALIVE) {
 		d->keepalive = SCCP_MIN_KEEPALIVE;
 	}
+	if (res != SCCP_CONFIG_NOUPDATENEEDED) {
+		sccp_hint_invalidateSubscriptionCache();						/* only now the new buttonconfig is complete, cached speeddial labels may refer to the old one */
+	}
 	return res;
 }
 
@@ -2935,9 +3494,9 @@ void sccp_config_restoreDeviceFeatureStatus(sccp_device_t * device)
 	int timeout = 0;
 
 	/* Message */
-	if (iPbx.feature_getFromDatabase("SCCP/message", "text", buffer, sizeof(buffer))) {
+	if (sccp_featurestore_get("SCCP/message", "text", buffer, sizeof(buffer))) {
 		if (!sccp_strlen_zero(buffer)) {
-			if (iPbx.feature_getFromDatabase && iPbx.feature_getFromDatabase("SCCP/message", "timeout", timebuffer, sizeof(timebuffer))) {
+			if (sccp_featurestore_get("SCCP/message", "timeout", timebuffer, sizeof(timebuffer))) {
 				sscanf(timebuffer, "%i", &timeout);
 			}
 			if (timeout) {
@@ -3518,11 +4077,164 @@ AST_TEST_DEFINE(sccp_config_setDefault)
 }
 */
 
+AST_TEST_DEFINE(sccp_config_section_hash)
+{
+	PBX_VARIABLE_TYPE *a = NULL, *b = NULL;
+	uint32_t hash_a, hash_b;
+
+	switch(cmd) {
+		case TEST_INIT:
+			info->name = "section_hash";
+			info->category = "/channels/chan_sccp/config/";
+			info->summary = "chan-sccp-b config section hash";
+			info->description = "chan-sccp-b config section hash used by the incremental reload to detect changed sections";
+			return AST_TEST_NOT_RUN;
+		case TEST_EXECUTE:
+			break;
+	}
+
+	a = ast_variable_new("type", "device", "");
+	a->next = ast_variable_new("button", "line, 98011", "");
+	b = ast_variable_new("TYPE", "device", "");
+	b->next = ast_variable_new("button", "line, 98011", "");
+
+	pbx_test_status_update(test, "equal sections (name case ignored)...\n");
+	hash_a = sccp_config_hash_variables(2166136261U, a);
+	hash_b = sccp_config_hash_variables(2166136261U, b);
+	pbx_test_validate(test, hash_a == hash_b);
+
+	pbx_test_status_update(test, "different seed ([general] changed)...\n");
+	pbx_test_validate(test, sccp_config_hash_variables(1, a) != hash_a);
+
+	pbx_test_status_update(test, "changed value...\n");
+	pbx_variables_destroy(b);
+	b = ast_variable_new("type", "device", "");
+	b->next = ast_variable_new("button", "line, 98012", "");
+	pbx_test_validate(test, sccp_config_hash_variables(2166136261U, b) != hash_a);
+
+	pbx_test_status_update(test, "value moved between name and value...\n");
+	pbx_variables_destroy(b);
+	b = ast_variable_new("type", "device", "");
+	b->next = ast_variable_new("buttonline", ", 98011", "");
+	pbx_test_validate(test, sccp_config_hash_variables(2166136261U, b) != hash_a);
+
+	pbx_variables_destroy(a);
+	pbx_variables_destroy(b);
+	return AST_TEST_PASS;
+}
+
+AST_TEST_DEFINE(sccp_config_option_index)
+{
+	uint seg, i;
+	const char *name, *sep;
+	char alias[80];
+
+	switch(cmd) {
+		case TEST_INIT:
+			info->name = "option_index";
+			info->category = "/channels/chan_sccp/config/";
+			info->summary = "chan-sccp-b config option index";
+			info->description = "chan-sccp-b config option index returns the same option as a scan of the config table for every name and alias";
+			return AST_TEST_NOT_RUN;
+		case TEST_EXECUTE:
+			break;
+	}
+
+	for (seg = 0; seg < ARRAY_LEN(sccpConfigSegments); seg++) {
+		const SCCPConfigSegment *sccpConfigSegment = &sccpConfigSegments[seg];
+
+		pbx_test_validate(test, sccp_find_segment(sccpConfigSegment->segment) == sccpConfigSegment);
+		pbx_test_validate(test, sccpConfigIndex[seg].entries != NULL);
+		for (i = 0; i < sccpConfigSegment->config_size; i++) {
+			name = sccpConfigSegment->config[i].name;
+			pbx_test_validate(test, sccp_find_config(sccpConfigSegment->segment, name) == sccp_find_config_linear(sccpConfigSegment, name));
+			for (; name; name = sep ? sep + 1 : NULL) {
+				sep = strchr(name, '|');
+				snprintf(alias, sizeof(alias), "%.*s", sep ? (int) (sep - name) : (int) strlen(name), name);
+				pbx_test_validate(test, sccp_find_config(sccpConfigSegment->segment, alias) != NULL);
+				pbx_test_validate(test, sccp_find_config(sccpConfigSegment->segment, alias) == sccp_find_config_linear(sccpConfigSegment, alias));
+			}
+		}
+	}
+	pbx_test_validate(test, sccp_find_config(SCCP_CONFIG_GLOBAL_SEGMENT, "DEBUG") == sccp_find_config(SCCP_CONFIG_GLOBAL_SEGMENT, "debug"));
+	pbx_test_validate(test, sccp_find_config(SCCP_CONFIG_GLOBAL_SEGMENT, "allow") == sccp_find_config(SCCP_CONFIG_GLOBAL_SEGMENT, "disallow"));
+	pbx_test_validate(test, sccp_find_config(SCCP_CONFIG_GLOBAL_SEGMENT, "allo") == NULL);
+	pbx_test_validate(test, sccp_find_config(SCCP_CONFIG_GLOBAL_SEGMENT, "allowed") == NULL);
+	pbx_test_validate(test, sccp_find_config(SCCP_CONFIG_GLOBAL_SEGMENT, "") == NULL);
+	pbx_test_validate(test, sccp_find_config(SCCP_CONFIG_DEVICE_SEGMENT, "no_such_option") == NULL);
+
+	return AST_TEST_PASS;
+}
+
+AST_TEST_DEFINE(sccp_config_lookup_benchmark)
+{
+	const int num_sections = 20000;
+	const int vars_per_section = 12;
+	struct timeval start;
+	int64_t linear_ms, indexed_ms;
+	int section, var, found;
+	uint seg;
+
+	switch(cmd) {
+		case TEST_INIT:
+			info->name = "lookup_benchmark";
+			info->category = "/channels/chan_sccp/config/";
+			info->summary = "chan-sccp-b config option lookup benchmark";
+			info->description = "chan-sccp-b compare config table scan with the option index for the lookups of a synthetic 20k device/line section reload";
+			return AST_TEST_NOT_RUN;
+		case TEST_EXECUTE:
+			break;
+	}
+
+	/* half of the sections are devices, half are lines, each setting vars_per_section options spread over the table */
+	for (seg = SCCP_CONFIG_DEVICE_SEGMENT; seg <= SCCP_CONFIG_LINE_SEGMENT; seg++) {
+		const SCCPConfigSegment *sccpConfigSegment = sccp_find_segment(seg);
+		const char *names[vars_per_section];
+
+		for (var = 0; var < vars_per_section; var++) {
+			names[var] = sccpConfigSegment->config[(var * 7) % sccpConfigSegment->config_size].name;
+		}
+		if (seg == SCCP_CONFIG_DEVICE_SEGMENT) {
+			names[vars_per_section - 1] = "permit";						/* alias of "deny|permit" */
+		}
+
+		found = 0;
+		start = pbx_tvnow();
+		for (section = 0; section < num_sections / 2; section++) {
+			for (var = 0; var < vars_per_section; var++) {
+				if (sccp_find_config_linear(sccpConfigSegment, names[var])) {
+					found++;
+				}
+			}
+		}
+		linear_ms = ast_tvdiff_ms(pbx_tvnow(), start);
+		pbx_test_validate(test, found == (num_sections / 2) * vars_per_section);
+
+		found = 0;
+		start = pbx_tvnow();
+		for (section = 0; section < num_sections / 2; section++) {
+			for (var = 0; var < vars_per_section; var++) {
+				if (sccp_find_config(seg, names[var])) {
+					found++;
+				}
+			}
+		}
+		indexed_ms = ast_tvdiff_ms(pbx_tvnow(), start);
+		pbx_test_validate(test, found == (num_sections / 2) * vars_per_section);
+
+		pbx_test_status_update(test, "%-7s %5d sections x %d options: scan %6" PRId64 " ms, index %6" PRId64 " ms\n", sccpConfigSegment->name, num_sections / 2, vars_per_section, linear_ms, indexed_ms);
+	}
+	return AST_TEST_PASS;
+}
+
 static void __attribute__((constructor)) sccp_register_tests(void)
 {
 	AST_TEST_REGISTER(sccp_config_base_functions);
 	AST_TEST_REGISTER(sccp_config_multientry);
 	AST_TEST_REGISTER(sccp_config_tokenized_default);
+	AST_TEST_REGISTER(sccp_config_option_index);
+	AST_TEST_REGISTER(sccp_config_section_hash);
+	AST_TEST_REGISTER(sccp_config_lookup_benchmark);
 	//AST_TEST_REGISTER(sccp_config_setValue);
 	//AST_TEST_REGISTER(sccp_config_setDefault);
 }
@@ -3532,6 +4244,9 @@ static void __attribute__((destructor)) sccp_unregister_tests(void)
 	AST_TEST_UNREGISTER(sccp_config_base_functions);
 	AST_TEST_UNREGISTER(sccp_config_multientry);
 	AST_TEST_UNREGISTER(sccp_config_tokenized_default);
+	AST_TEST_UNREGISTER(sccp_config_option_index);
+	AST_TEST_UNREGISTER(sccp_config_section_hash);
+	AST_TEST_UNREGISTER(sccp_config_lookup_benchmark);
 	//AST_TEST_UNREGISTER(sccp_config_setValue);
 	//AST_TEST_UNREGISTER(sccp_config_setDefault);
 }
@@ -148,15 +148,33 @@ static const SCCPConfigOption sccpGlobalConfigOptions[]={
 	{"hotline_extension", 	offsize(sccp_hotline_t,exten), offsetof(struct sccp_global_vars,hotline),	TYPE_PARSER(sccp_config_parse_hotline_exten),	SCCP_CONFIG_FLAG_NONE,						SCCP_CONFIG_NEEDDEVICERESET,		"111",				""},
 	{"hotline_label", 	offsize(struct sccp_line,label), offsetof(struct sccp_global_vars,hotline),	TYPE_PARSER(sccp_config_parse_hotline_label),	SCCP_CONFIG_FLAG_NONE,						SCCP_CONFIG_NEEDDEVICERESET,		"hotline",			""},
 	{"fallback",			G_OBJ_REF(token_fallback),		TYPE_STRINGPTR,									SCCP_CONFIG_FLAG_NONE,						SCCP_CONFIG_NOUPDATENEEDED,		"no",				"Immediately fallback to primairy/master server when it becomes available (master/slave asterisk cluster) (TokenRequest)\n"
-																																					"Possible values are: true/false/odd/even/script.\n" 
+																																					"Possible values are: true/false/odd/even/load/script.\n" 
 																																					"active/passive cluster: true on active/false on passive\n" 
 																																					"active/active cluster: even on active1/off on active2\n"
+																																					"overload protection: load. Rejects the token while the load score (see 'sccp show load') is at or above load_threshold.\n"
 																																					"more complex cluster: use script. It will be called with three arguments, namely mac-address, ip-address, devicetype.\n"
 																																					"                      and it should return 'ACK' (without the quotes) to acknowledge the token, or a value for the number of seconds to backoff and try again.\n" 
-																																					"Value can be changed online via CLI/AMI command 'sccp set fallback true/false/odd/even/script'\n"},
+																																					"Value can be changed online via CLI/AMI command 'sccp set fallback true/false/odd/even/load/script'\n"},
 	{"backoff_time", 		G_OBJ_REF(token_backoff_time),		TYPE_INT,									SCCP_CONFIG_FLAG_NONE,						SCCP_CONFIG_NOUPDATENEEDED,		"60",				"Time to wait before re-asking to fallback to primairy server (Token Reject Backoff Time)\n"},
 	{"server_priority", 		G_OBJ_REF(server_priority),		TYPE_INT,									SCCP_CONFIG_FLAG_NONE,						SCCP_CONFIG_NOUPDATENEEDED,		"1",				"Server Priority for fallback: 1=Primairy, 2=Secundary, 3=Tertiary etc\n"
 																																					"For active-active (fallback=odd/even) use 1 for both\n"},
+	{"load_threshold", 		G_OBJ_REF(token_load_threshold),	TYPE_INT,									SCCP_CONFIG_FLAG_NONE,						SCCP_CONFIG_NOUPDATENEEDED,		"80",				"Load score (0-100) at which token requests are rejected when fallback=load. The backoff time sent to the phone grows from\n"
+																																					"backoff_time at the threshold to four times backoff_time at full load.\n"},
+	{"load_max_sessions", 		G_OBJ_REF(token_load_max_sessions),	TYPE_INT,									SCCP_CONFIG_FLAG_NONE,						SCCP_CONFIG_NOUPDATENEEDED,		"0",				"Number of phone sessions counted as full load when fallback=load. 0 means the number of sessions is not part of the load score.\n"},
+	{"eventloop",	 		G_OBJ_REF(session_eventloop),		TYPE_BOOLEAN,									SCCP_CONFIG_FLAG_NONE,						SCCP_CONFIG_NOUPDATENEEDED,		"no",				"Serve all phone sessions from a small number of epoll event loops, instead of starting a thread per phone.\n"
+																																					"Only available on platforms providing epoll. Only read when the module is loaded.\n"},
+	{"eventloop_threads", 		G_OBJ_REF(session_eventloop_threads),	TYPE_INT,									SCCP_CONFIG_FLAG_NONE,						SCCP_CONFIG_NOUPDATENEEDED,		"0",				"Number of session event loops to start when eventloop=yes. 0 means one per online cpu core.\n"},
+	{"sendqueue_depth", 		G_OBJ_REF(session_sendqueue_depth),	TYPE_INT,									SCCP_CONFIG_FLAG_NONE,						SCCP_CONFIG_NOUPDATENEEDED,		"256",				"Max number of outbound messages queued per phone session, while the phone is not reading them fast enough.\n"
+																																					"Applied to new sessions.\n"},
+	{"sendqueue_disconnect", 	G_OBJ_REF(session_sendqueue_disconnect),	TYPE_BOOLEAN,									SCCP_CONFIG_FLAG_NONE,						SCCP_CONFIG_NOUPDATENEEDED,		"no",				"Disconnect the phone when its send queue is full, instead of dropping the message that does not fit.\n"},
+	{"admission_rate", 		G_OBJ_REF(session_admission_rate),	TYPE_INT,									SCCP_CONFIG_FLAG_NONE,						SCCP_CONFIG_NOUPDATENEEDED,		"100",				"Max number of new phone connections admitted per second. Phones over the limit get a TokenReject with a backoff time.\n"
+																																					"0 means unlimited.\n"},
+	{"admission_max_pending", 	G_OBJ_REF(session_admission_max_pending),	TYPE_INT,									SCCP_CONFIG_FLAG_NONE,						SCCP_CONFIG_NOUPDATENEEDED,		"500",				"Max number of phone registrations in progress at the same time. Phones over the limit get a TokenReject with a backoff time.\n"
+																																					"0 means unlimited.\n"},
+	{"config_load_threads", 	G_OBJ_REF(config_load_threads),		TYPE_INT,									SCCP_CONFIG_FLAG_NONE,						SCCP_CONFIG_NOUPDATENEEDED,		"0",				"Number of threads building the devices and lines from sccp.conf when the module is loaded. 0 builds them one by one.\n"
+																																					"Devices and lines are inserted into the global lists in one batch. Only used on initial load, a reload always runs one by one.\n"},
+	{"hint_notify_window", 		G_OBJ_REF(hint_notify_window),		TYPE_INT,									SCCP_CONFIG_FLAG_NONE,						SCCP_CONFIG_NOUPDATENEEDED,		"100",				"Millisecs hint state changes are collected before the BLF / speeddial subscribers are notified. Only the latest state of a hint\n"
+																																					"is sent, and all updates for the same phone go out in one write. 0 notifies the subscribers on every change.\n"},
 };
 
 /*!
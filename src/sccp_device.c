@@ -22,6 +22,7 @@
 #include "sccp_config.h"
 #include "sccp_device.h"
 #include "sccp_features.h"
+#include "sccp_featurestore.h"
 #include "sccp_line.h"
 #include "sccp_session.h"
 #include "sccp_indicate.h"
@@ -324,26 +325,25 @@ void sccp_device_pre_reload(void)
 
 	SCCP_RWLIST_WRLOCK(&GLOB(devices));
 	SCCP_RWLIST_TRAVERSE(&GLOB(devices), d, list) {
+		/* softkeysets are always rebuilt, so the pointers need to go */
+		d->softkeyset = NULL;
+		d->softKeyConfiguration.modes = NULL;
+		d->softKeyConfiguration.size = 0;
+		if (d->configUnchanged) {									/* section unchanged, leave the device alone */
+			continue;
+		}
 		//sccp_log((DEBUGCAT_CONFIG + DEBUGCAT_DEVICE)) (VERBOSE_PREFIX_2 "%s: Setting Device to Pending Delete=1\n", d->id);
 		if (!d->realtime) {										/* don't want to reset hotline devices. */
 			d->pendingDelete = 1;
 		}
 		d->pendingUpdate = 0;
 		
-		/* clear softkeyset */
-		d->softkeyset = NULL;
-		d->softKeyConfiguration.modes = NULL;
-		d->softKeyConfiguration.size = 0;
-		
 		SCCP_LIST_LOCK(&d->buttonconfig);
 		SCCP_LIST_TRAVERSE(&d->buttonconfig, config, list) {
 			config->pendingDelete = 1;
 			config->pendingUpdate = 0;
 		}
 		SCCP_LIST_UNLOCK(&d->buttonconfig);
-		d->softkeyset = NULL;
-		d->softKeyConfiguration.modes = 0;
-		d->softKeyConfiguration.size = 0;
 	}
 	SCCP_RWLIST_UNLOCK(&GLOB(devices));
 }
@@ -747,11 +747,61 @@ void sccp_device_addToGlobals(constDevicePtr device)
 	if (d) {
 		SCCP_RWLIST_WRLOCK(&GLOB(devices));
 		SCCP_RWLIST_INSERT_SORTALPHA(&GLOB(devices), d, list, id);
+		sccp_hashtable_insert(GLOB(device_index), d->id, d);
 		SCCP_RWLIST_UNLOCK(&GLOB(devices));
 		sccp_log((DEBUGCAT_DEVICE)) (VERBOSE_PREFIX_3 "Added device '%s' to Glob(devices)\n", d->id);
 	}
 }
 
+static int sccp_device_sortcmp(const void *a, const void *b)
+{
+	return sccp_strversioncmp((*(sccp_device_t * const *) a)->id, (*(sccp_device_t * const *) b)->id);
+}
+
+/*!
+ * \brief Add a batch of devices to the global sccp_device list, taking the list lock only once
+ * \param devices array of devices (sorted in place)
+ * \param count number of devices in the array
+ *
+ * The batch is sorted first and then merged into the sorted list in one pass, instead of walking the list for every device.
+ *
+ * \note needs to be called with retained devices
+ * \note adds a retained device to the list for every entry (refcount + 1)
+ */
+void sccp_device_addBatchToGlobals(sccp_device_t ** devices, uint count)
+{
+	sccp_device_t *cur = NULL;
+	sccp_device_t *prev = NULL;
+	sccp_device_t *d = NULL;
+	uint i;
+
+	if (!devices || !count) {
+		return;
+	}
+	qsort(devices, count, sizeof(*devices), sccp_device_sortcmp);
+
+	SCCP_RWLIST_WRLOCK(&GLOB(devices));
+	cur = SCCP_RWLIST_FIRST(&GLOB(devices));
+	for (i = 0; i < count; i++) {
+		if (!(d = sccp_device_retain(devices[i]))) {
+			continue;
+		}
+		while (cur && sccp_strversioncmp(cur->id, d->id) < 0) {
+			cur = SCCP_RWLIST_NEXT(cur, list);
+		}
+		if (!cur) {
+			SCCP_RWLIST_INSERT_TAIL(&GLOB(devices), d, list);
+		} else if (!(prev = cur->list.prev)) {
+			SCCP_RWLIST_INSERT_HEAD(&GLOB(devices), d, list);
+		} else {
+			SCCP_RWLIST_INSERT_AFTER(&GLOB(devices), prev, d, list);
+		}
+		sccp_hashtable_insert(GLOB(device_index), d->id, d);
+	}
+	SCCP_RWLIST_UNLOCK(&GLOB(devices));
+	sccp_log((DEBUGCAT_DEVICE)) (VERBOSE_PREFIX_3 "Added %u devices to Glob(devices)\n", count);
+}
+
 /*!
  * \brief Removes a device from the global sccp_device list
  * \param device SCCP Device
@@ -770,6 +820,7 @@ void sccp_device_removeFromGlobals(devicePtr device)
 
 	SCCP_RWLIST_WRLOCK(&GLOB(devices));
 	if ((d = SCCP_RWLIST_REMOVE(&GLOB(devices), device, list))) {
+		sccp_hashtable_remove(GLOB(device_index), d->id, d);
 		sccp_log((DEBUGCAT_CORE + DEBUGCAT_DEVICE)) (VERBOSE_PREFIX_3 "Removed device '%s' from Glob(devices)\n", DEV_ID_LOG(device));
 		sccp_device_release(&d);					/* explicit release of device after removing from list */
 	}
@@ -1139,23 +1190,151 @@ uint8_t sccp_dev_build_buttontemplate(devicePtr d, btnlist * btn)
 	return btn_index;
 }
 
+/*
+ * Packet Buffer Pool
+ * Outbound messages are built in buffers taken from per size-class free lists instead of being calloc'ed and freed for every
+ * message. Every size class has a couple of shards (free list + lock on its own cache line), the calling thread picks one by
+ * hashing pthread_self(). Buffers are only allocated when a shard runs empty and only freed when it is full.
+ */
+#define SCCP_PACKET_POOL_SHARDS 4
+#define SCCP_PACKET_POOL_SHARD_SIZE 32										/* max number of free buffers per size class per shard */
+#define SCCP_PACKET_POOL_CACHELINE 64
+
+typedef struct sccp_packet_buffer sccp_packet_buffer_t;
+
+struct sccp_packet_buffer {
+	union {
+		sccp_packet_buffer_t *next;									/*!< next free buffer, while on a free list */
+		int64_t align;
+	};
+	int sizeclass;												/*!< index into sccp_packet_pool, -1 for unpooled buffers */
+	int pad;
+	/* sccp_msg_t follows */
+};
+
+static const size_t sccp_packet_pool_sizes[] = { 64, 128, 256, 512, 1024, SCCP_MAX_PACKET };
+
+static struct sccp_packet_pool_shard {
+	ast_mutex_t lock;
+	sccp_packet_buffer_t *freelist;
+	int numfree;
+	int hits;												/*!< buffers served from the free list */
+	int misses;												/*!< buffers which had to be allocated */
+} __attribute__ ((aligned(SCCP_PACKET_POOL_CACHELINE))) sccp_packet_pool[ARRAY_LEN(sccp_packet_pool_sizes)][SCCP_PACKET_POOL_SHARDS];
+
+static gcc_inline struct sccp_packet_pool_shard *sccp_packet_pool_shard(int sizeclass)
+{
+	uintptr_t hash = (uintptr_t) pthread_self();
+
+	hash ^= hash >> 17;
+	hash ^= hash >> 11;
+	hash = (hash * 0x9E3779B1U) & 0xFFFFFFFF;
+	return &sccp_packet_pool[sizeclass][(hash >> 16) % SCCP_PACKET_POOL_SHARDS];
+}
+
+void sccp_packet_pool_init(void)
+{
+	uint32_t sizeclass;
+	int shard;
+
+	memset(sccp_packet_pool, 0, sizeof(sccp_packet_pool));
+	for (sizeclass = 0; sizeclass < ARRAY_LEN(sccp_packet_pool_sizes); sizeclass++) {
+		for (shard = 0; shard < SCCP_PACKET_POOL_SHARDS; shard++) {
+			ast_mutex_init(&sccp_packet_pool[sizeclass][shard].lock);
+		}
+	}
+}
+
+void sccp_packet_pool_destroy(void)
+{
+	sccp_packet_buffer_t *buffer = NULL;
+	uint32_t sizeclass;
+	int shard;
+
+	for (sizeclass = 0; sizeclass < ARRAY_LEN(sccp_packet_pool_sizes); sizeclass++) {
+		for (shard = 0; shard < SCCP_PACKET_POOL_SHARDS; shard++) {
+			struct sccp_packet_pool_shard *pool = &sccp_packet_pool[sizeclass][shard];
+
+			ast_mutex_lock(&pool->lock);
+			while ((buffer = pool->freelist)) {
+				pool->freelist = buffer->next;
+				sccp_free(buffer);
+			}
+			pool->numfree = 0;
+			ast_mutex_unlock(&pool->lock);
+			ast_mutex_destroy(&pool->lock);
+		}
+	}
+}
+
+/*!
+ * \brief Sum up the packet pool statistics
+ * \param[out] hits Number of buffers served from the pool
+ * \param[out] misses Number of buffers which had to be allocated
+ * \param[out] numfree Number of buffers currently available in the pool
+ */
+void sccp_packet_pool_stats(int *hits, int *misses, int *numfree)
+{
+	uint32_t sizeclass;
+	int shard;
+
+	*hits = *misses = *numfree = 0;
+	for (sizeclass = 0; sizeclass < ARRAY_LEN(sccp_packet_pool_sizes); sizeclass++) {
+		for (shard = 0; shard < SCCP_PACKET_POOL_SHARDS; shard++) {
+			*hits += sccp_packet_pool[sizeclass][shard].hits;
+			*misses += sccp_packet_pool[sizeclass][shard].misses;
+			*numfree += sccp_packet_pool[sizeclass][shard].numfree;
+		}
+	}
+}
+
 /*!
  * \brief Build an SCCP Message Packet
  * \param[in] t SCCP Message Text
  * \param[out] pkt_len Packet Length
- * \return SCCP Message
+ * \return SCCP Message (to be released using sccp_free_packet, sccp_dev_send / sccp_session_send do that for you)
  */
 sccp_msg_t __attribute__ ((malloc)) * sccp_build_packet(sccp_mid_t t, size_t pkt_len)
 {
+	sccp_packet_buffer_t *buffer = NULL;
+	struct sccp_packet_pool_shard *pool = NULL;
+	int sizeclass = -1;
+	uint32_t idx;
 	int padding = ((pkt_len + 8) % 4);
 	padding = (padding > 0) ? 4 - padding : 0;
-	
-	sccp_msg_t *msg = sccp_calloc(1, pkt_len + SCCP_PACKET_HEADER + padding);
+	size_t msg_len = pkt_len + SCCP_PACKET_HEADER + padding;
 
-	if (!msg) {
+	for (idx = 0; idx < ARRAY_LEN(sccp_packet_pool_sizes); idx++) {
+		if (msg_len <= sccp_packet_pool_sizes[idx]) {
+			sizeclass = idx;
+			break;
+		}
+	}
+	if (do_expect(sizeclass >= 0)) {
+		pool = sccp_packet_pool_shard(sizeclass);
+		ast_mutex_lock(&pool->lock);
+		if ((buffer = pool->freelist)) {
+			pool->freelist = buffer->next;
+			pool->numfree--;
+			pool->hits++;
+		} else {
+			pool->misses++;
+		}
+		ast_mutex_unlock(&pool->lock);
+		if (!buffer) {
+			buffer = sccp_malloc(sizeof(sccp_packet_buffer_t) + sccp_packet_pool_sizes[sizeclass]);
+		}
+	} else {
+		buffer = sccp_malloc(sizeof(sccp_packet_buffer_t) + msg_len);
+	}
+	if (!buffer) {
 		pbx_log(LOG_WARNING, "SCCP: Packet memory allocation error\n");
 		return NULL;
 	}
+	buffer->sizeclass = sizeclass;
+	
+	sccp_msg_t *msg = (sccp_msg_t *) (buffer + 1);
+	memset(msg, 0, msg_len);
 	msg->header.length = htolel(pkt_len + 4 + padding);
 	msg->header.lel_messageId = htolel(t);
 	
@@ -1163,6 +1342,57 @@ sccp_msg_t __attribute__ ((malloc)) * sccp_build_packet(sccp_mid_t t, size_t pkt
 	return msg;
 }
 
+/*!
+ * \brief Create a copy of an already encoded SCCP Message Packet
+ * \param msg SCCP Message to copy
+ * \return SCCP Message (to be released using sccp_free_packet, sccp_dev_send / sccp_session_send do that for you)
+ *
+ * \note Used to send the same pre-encoded message to multiple devices, as sending a message consumes it.
+ */
+sccp_msg_t __attribute__ ((malloc)) * sccp_clone_packet(const sccp_msg_t * msg)
+{
+	sccp_msg_t *copy = NULL;
+	uint32_t length = letohl(msg->header.length);
+
+	if (length < 4) {
+		return NULL;
+	}
+	/* header.length already contains the padding, so sccp_build_packet will not add any more */
+	if ((copy = sccp_build_packet(letohl(msg->header.lel_messageId), length - 4))) {
+		memcpy(copy, msg, SCCP_PACKET_HEADER + length - 4);
+	}
+	return copy;
+}
+
+/*!
+ * \brief Release an SCCP Message Packet created by sccp_build_packet
+ * \param msg SCCP Message (can be NULL)
+ */
+void sccp_free_packet(sccp_msg_t * msg)
+{
+	sccp_packet_buffer_t *buffer = NULL;
+	struct sccp_packet_pool_shard *pool = NULL;
+
+	if (!msg) {
+		return;
+	}
+	buffer = ((sccp_packet_buffer_t *) msg) - 1;
+	if (buffer->sizeclass >= 0) {
+		pool = sccp_packet_pool_shard(buffer->sizeclass);
+		ast_mutex_lock(&pool->lock);
+		if (pool->numfree < SCCP_PACKET_POOL_SHARD_SIZE) {
+			buffer->next = pool->freelist;
+			pool->freelist = buffer;
+			pool->numfree++;
+			buffer = NULL;
+		}
+		ast_mutex_unlock(&pool->lock);
+	}
+	if (buffer) {
+		sccp_free(buffer);
+	}
+}
+
 /*!
  * \brief Send SCCP Message to Device
  * \param d SCCP Device
@@ -1179,7 +1409,7 @@ int sccp_dev_send(constDevicePtr d, sccp_msg_t * msg)
 		sccp_log((DEBUGCAT_MESSAGE)) (VERBOSE_PREFIX_3 "%s: >> Send message %s\n", d->id, msgtype2str(letohl(msg->header.lel_messageId)));
 		result = sccp_session_send(d, msg);
 	} else {
-		sccp_free(msg);
+		sccp_free_packet(msg);
 	}
 	return result;
 }
@@ -1503,8 +1733,8 @@ void sccp_dev_set_message(devicePtr d, const char *msg, const int timeout, const
 		char msgtimeout[10];
 
 		snprintf(msgtimeout, sizeof(msgtimeout), "%d", timeout);
-		iPbx.feature_addToDatabase("SCCP/message", "timeout", pbx_strdup(msgtimeout));
-		iPbx.feature_addToDatabase("SCCP/message", "text", msg);
+		sccp_featurestore_put("SCCP/message", "timeout", msgtimeout);
+		sccp_featurestore_put("SCCP/message", "text", msg);
 	}
 
 	if (timeout) {
@@ -1528,8 +1758,8 @@ void sccp_dev_set_message(devicePtr d, const char *msg, const int timeout, const
 void sccp_dev_clear_message(devicePtr d, const boolean_t cleardb)
 {
 	if (cleardb) {
-		iPbx.feature_removeTreeFromDatabase("SCCP/message", "timeout");
-		iPbx.feature_removeTreeFromDatabase("SCCP/message", "text");
+		sccp_featurestore_remove("SCCP/message", "timeout");
+		sccp_featurestore_remove("SCCP/message", "text");
 	}
 
 	sccp_device_clearMessageFromStack(d, SCCP_MESSAGE_PRIORITY_IDLE);
@@ -2051,12 +2281,12 @@ void sccp_dev_postregistration(void *data)
 			AUTO_RELEASE sccp_linedevices_t *linedevice = sccp_linedevice_retain(d->lineButtons.instance[instance]);
 
 			snprintf(family, sizeof(family), "SCCP/%s/%s", d->id, linedevice->line->name);
-			if (iPbx.feature_getFromDatabase(family, "cfwdAll", buffer, sizeof(buffer)) && strcmp(buffer, "")) {
+			if (sccp_featurestore_get(family, "cfwdAll", buffer, sizeof(buffer)) && strcmp(buffer, "")) {
 				linedevice->cfwdAll.enabled = TRUE;
 				sccp_copy_string(linedevice->cfwdAll.number, buffer, sizeof(linedevice->cfwdAll.number));
 				sccp_feat_changed(d, linedevice, SCCP_FEATURE_CFWDALL);
 			}
-			if (iPbx.feature_getFromDatabase(family, "cfwdBusy", buffer, sizeof(buffer)) && strcmp(buffer, "")) {
+			if (sccp_featurestore_get(family, "cfwdBusy", buffer, sizeof(buffer)) && strcmp(buffer, "")) {
 				linedevice->cfwdBusy.enabled = TRUE;
 				sccp_copy_string(linedevice->cfwdBusy.number, buffer, sizeof(linedevice->cfwdAll.number));
 				sccp_feat_changed(d, linedevice, SCCP_FEATURE_CFWDBUSY);
@@ -2064,23 +2294,23 @@ void sccp_dev_postregistration(void *data)
 		}
 	}
 	snprintf(family, sizeof(family), "SCCP/%s", d->id);
-	if (iPbx.feature_getFromDatabase(family, "dnd", buffer, sizeof(buffer)) && strcmp(buffer, "")) {
+	if (sccp_featurestore_get(family, "dnd", buffer, sizeof(buffer)) && strcmp(buffer, "")) {
 		d->dndFeature.status = sccp_dndmode_str2val(buffer);
 		sccp_feat_changed(d, NULL, SCCP_FEATURE_DND);
 	}
 
-	if (iPbx.feature_getFromDatabase(family, "privacy", buffer, sizeof(buffer)) && strcmp(buffer, "")) {
+	if (sccp_featurestore_get(family, "privacy", buffer, sizeof(buffer)) && strcmp(buffer, "")) {
 		d->privacyFeature.status = TRUE;
 		sccp_feat_changed(d, NULL, SCCP_FEATURE_PRIVACY);
 	}
 
-	if (iPbx.feature_getFromDatabase(family, "monitor", buffer, sizeof(buffer)) && strcmp(buffer, "")) {
+	if (sccp_featurestore_get(family, "monitor", buffer, sizeof(buffer)) && strcmp(buffer, "")) {
 		sccp_feat_monitor(d, NULL, 0, NULL);
 		sccp_feat_changed(d, NULL, SCCP_FEATURE_MONITOR);
 	}
 
 	char lastNumber[SCCP_MAX_EXTENSION] = "";
-	if (iPbx.feature_getFromDatabase(family, "lastDialedNumber", buffer, sizeof(buffer))) {
+	if (sccp_featurestore_get(family, "lastDialedNumber", buffer, sizeof(buffer))) {
 		sscanf(buffer,"%79[^;];lineInstance=%d", lastNumber, &instance);
 		AUTO_RELEASE sccp_linedevices_t *linedevice = sccp_linedevice_findByLineinstance(d, instance);
 		if(linedevice){ 
@@ -2211,11 +2441,11 @@ void __sccp_dev_clean(devicePtr device, boolean_t remove_from_global, uint8_t cl
 		d->mwilight = 0;										/* reset mwi light */
 		d->linesRegistered = FALSE;
 		snprintf(family, sizeof(family), "SCCP/%s", d->id);
-		iPbx.feature_removeFromDatabase(family, "lastDialedNumber");
+		sccp_featurestore_remove(family, "lastDialedNumber");
 		char buffer[SCCP_MAX_EXTENSION+16] = "\0";
 		if (!sccp_strlen_zero(d->redialInformation.number)) {
 			snprintf (buffer, sizeof(buffer), "%s;lineInstance=%d", d->redialInformation.number, d->redialInformation.lineInstance);
-			iPbx.feature_addToDatabase(family, "lastDialedNumber", buffer);
+			sccp_featurestore_put(family, "lastDialedNumber", buffer);
 		}
 
 		if (d->active_channel) {
@@ -3068,7 +3298,9 @@ sccp_device_t *sccp_device_find_byid(const char *id, boolean_t useRealtime)
 	}
 
 	SCCP_RWLIST_RDLOCK(&GLOB(devices));
-	d = SCCP_RWLIST_FIND(&GLOB(devices), sccp_device_t, tmpd, list, (sccp_strcaseequals(tmpd->id, id)), TRUE, __FILE__, __LINE__, __PRETTY_FUNCTION__);
+	if ((d = sccp_hashtable_find(GLOB(device_index), id))) {
+		d = sccp_device_retain(d);
+	}
 	SCCP_RWLIST_UNLOCK(&GLOB(devices));
 
 #ifdef CS_SCCP_REALTIME
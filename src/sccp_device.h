@@ -221,6 +221,7 @@ struct sccp_device {
 
 	//uint8_t earlyrtp;											/*!< RTP Channel State where to open the RTP Media Stream */
 	time_t registrationTime;
+	struct timeval registrationStart;										/*!< Time the current Registration Started (RegisterMessage received) */
 
 	struct sccp_ha *ha;											/*!< Permit or Deny Connections to the Main Socket */
 
@@ -343,6 +344,8 @@ struct sccp_device {
 
 	boolean_t pendingDelete;										/*!< this bit will tell the scheduler to delete this line when unused */
 	boolean_t pendingUpdate;										/*!< this will contain the updated line struct once reloaded from config to update the line when unused */
+	uint32_t configHash;											/*!< hash of the sccp.conf section (and [general]) this device was last built from (0: not built from sccp.conf) */
+	boolean_t configUnchanged;										/*!< section did not change since the last (re)load, skipped by the running reload */
 };
 
 // Number of additional keys per addon -FS
@@ -399,6 +402,7 @@ SCCP_API int SCCP_CALL sccp_device_setRegistrationState(constDevicePtr d, const
 SCCP_API sccp_device_t * SCCP_CALL sccp_device_create(const char *id);
 SCCP_API sccp_device_t * SCCP_CALL sccp_device_createAnonymous(const char *name);
 SCCP_API void SCCP_CALL sccp_device_addToGlobals(constDevicePtr device);
+SCCP_API void SCCP_CALL sccp_device_addBatchToGlobals(sccp_device_t ** devices, uint count);
 
 SCCP_API sccp_line_t * SCCP_CALL sccp_dev_getActiveLine(constDevicePtr device);
 SCCP_API void SCCP_CALL sccp_dev_setActiveLine(devicePtr device, constLinePtr l);
@@ -410,6 +414,11 @@ SCCP_API sccp_buttonconfig_t * SCCP_CALL sccp_dev_serviceURL_find_byindex(device
 #define REQ(x,y) x = sccp_build_packet(y, sizeof(x->data.y))
 #define REQCMD(x,y) x = sccp_build_packet(y, 0)
 SCCP_API sccp_msg_t * SCCP_CALL sccp_build_packet(sccp_mid_t t, size_t pkt_len);
+SCCP_API void SCCP_CALL sccp_free_packet(sccp_msg_t * msg);
+SCCP_API sccp_msg_t * SCCP_CALL sccp_clone_packet(const sccp_msg_t * msg);
+SCCP_API void SCCP_CALL sccp_packet_pool_init(void);
+SCCP_API void SCCP_CALL sccp_packet_pool_destroy(void);
+SCCP_API void SCCP_CALL sccp_packet_pool_stats(int *hits, int *misses, int *numfree);
 
 SCCP_API void SCCP_CALL sccp_dev_check_displayprompt(constDevicePtr d);
 SCCP_API void SCCP_CALL sccp_device_setLastNumberDialed(devicePtr device, const char *lastNumberDialed, const sccp_linedevices_t *linedevice);
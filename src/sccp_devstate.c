@@ -9,8 +9,11 @@
 
 #include "config.h"
 #include "common.h"
+#include "sccp_atomic.h"
 #include "sccp_device.h"
 #include "sccp_devstate.h"
+#include "sccp_hash.h"
+#include "sccp_threadpool.h"
 #include "sccp_utils.h"
 
 SCCP_FILE_VERSION(__FILE__, "");
@@ -18,8 +21,22 @@ SCCP_FILE_VERSION(__FILE__, "");
 #if defined(CS_AST_HAS_EVENT) && defined(HAVE_PBX_EVENT_H)							// ast_event_subscribe
 #  include <asterisk/event.h>
 #endif
+#include <asterisk/cli.h>
 
 #if CS_DEVSTATE_FEATURE
+#define SCCP_DEVSTATE_FANOUT_CHUNK 64										/* subscribers notified per threadpool job */
+#define SCCP_DEVSTATE_LATENCY_BUCKETS 24									/* log2(usecs) histogram, the last bucket holds everything above 4s */
+
+/*!
+ * \brief SCCP DevState Generation, tells a fan-out job whether a newer state is on its way
+ * \note shared between the deviceState and its outstanding fan-out jobs, freed by the last one to let go
+ */
+typedef struct sccp_devstate_generation {
+	volatile int refcount;
+	volatile int seq;											/*!< Bumped on every state change, after featureState has been set */
+	volatile uint32_t featureState;										/*!< Latest featureState */
+} sccp_devstate_generation_t;
+
 typedef struct sccp_devstate_SubscribingDevice sccp_devstate_SubscribingDevice_t;
 
 struct sccp_devstate_SubscribingDevice 
@@ -39,9 +56,41 @@ struct sccp_devstate_deviceState
 	char devicestate[StationMaxNameSize];
 	PBX_EVENT_SUBSCRIPTION *sub;
 	uint32_t featureState;
+	sccp_devstate_generation_t *generation;
 };
 
+/*!
+ * \brief SCCP DevState Fan-Out Job, notifies one chunk of the subscribers of a state change
+ */
+typedef struct sccp_devstate_fanout {
+	sccp_devstate_generation_t *generation;
+	int seq;												/*!< Generation this state belongs to */
+	uint32_t featureState;
+	struct timeval changed;											/*!< Time the state change was received */
+	uint count;
+	struct {
+		sccp_device_t *device;										/*!< Retained Device */
+		uint8_t instance;
+		char label[StationMaxNameSize];
+	} subscribers[SCCP_DEVSTATE_FANOUT_CHUNK];
+} sccp_devstate_fanout_t;
+
+/*!
+ * \brief SCCP DevState Notification Statistics (protected by devstate_stats_lock)
+ */
+static struct {
+	uint32_t changes;											/*!< Number of state changes received */
+	uint32_t notifications;											/*!< Number of subscriber notifications sent */
+	uint32_t skipped;											/*!< Number of notifications dropped because a newer state was on its way */
+	uint32_t resent;											/*!< Number of notifications repeated because the state changed while sending */
+	uint32_t jobs;												/*!< Number of fan-out jobs handed to the threadpool */
+	uint64_t latency[SCCP_DEVSTATE_LATENCY_BUCKETS];							/*!< Notification latency histogram, bucket n counts latencies below 2^n usecs */
+	int64_t latency_max;											/*!< Highest notification latency (usecs) */
+} devstate_stats;
+AST_MUTEX_DEFINE_STATIC(devstate_stats_lock);
+
 static SCCP_LIST_HEAD (, struct sccp_devstate_deviceState) deviceStates;
+static sccp_hashtable_t *deviceStateIndex;									/*!< devstate name -> deviceState (protected by the deviceStates lock) */
 
 void sccp_devstate_deviceRegisterListener(const sccp_event_t * event);
 sccp_devstate_deviceState_t *sccp_devstate_createDeviceStateHandler(const char *devstate);
@@ -57,10 +106,21 @@ void sccp_devstate_removeSubscriber(sccp_devstate_deviceState_t * deviceState, c
 void sccp_devstate_notifySubscriber(sccp_devstate_deviceState_t * deviceState, const sccp_devstate_SubscribingDevice_t * subscriber);
 void sccp_devstate_addSubscriber(sccp_devstate_deviceState_t * deviceState, const sccp_device_t * device, sccp_buttonconfig_t * buttonConfig);
 
+/*!
+ * \brief drop a reference on a devstate generation, the last one frees it
+ */
+static void sccp_devstate_generation_release(sccp_devstate_generation_t * generation)
+{
+	if (generation && ATOMIC_DECR(&generation->refcount, 1, &devstate_stats_lock) == 1) {
+		sccp_free(generation);
+	}
+}
+
 void sccp_devstate_module_start(void)
 {
 	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_2 "SCCP: Starting devstate system\n");
 	SCCP_LIST_HEAD_INIT(&deviceStates);
+	deviceStateIndex = sccp_hashtable_create(0, sccp_hash_string_nocase, sccp_hash_match_string_nocase);
 	sccp_event_subscribe(SCCP_EVENT_DEVICE_REGISTERED | SCCP_EVENT_DEVICE_UNREGISTERED, sccp_devstate_deviceRegisterListener, TRUE);
 }
 
@@ -73,16 +133,20 @@ void sccp_devstate_module_stop(void)
 
 		SCCP_LIST_LOCK(&deviceStates);
 		while ((deviceState = SCCP_LIST_REMOVE_HEAD(&deviceStates, list))) {
+			sccp_hashtable_remove(deviceStateIndex, deviceState->devicestate, deviceState);
 			pbx_event_unsubscribe(deviceState->sub);
 
 			SCCP_LIST_LOCK(&deviceState->subscribers);
 			while ((subscriber = SCCP_LIST_REMOVE_HEAD(&deviceState->subscribers, list))) {
 				sccp_device_release(&subscriber->device);		/* explicit release */
+				sccp_free(subscriber);
 			}
 			SCCP_LIST_UNLOCK(&deviceState->subscribers);
 			SCCP_LIST_HEAD_DESTROY(&deviceState->subscribers);
+			sccp_devstate_generation_release(deviceState->generation);			/* outstanding fan-out jobs keep their own reference */
 			sccp_free(deviceState);
 		}
+		sccp_hashtable_destroy(&deviceStateIndex);
 		SCCP_LIST_UNLOCK(&deviceStates);
 	}
 
@@ -165,15 +229,10 @@ sccp_devstate_deviceState_t *sccp_devstate_getDeviceStateHandler(const char *dev
 		return NULL;
 	}
 
-	sccp_devstate_deviceState_t *deviceState = NULL;
-
-	SCCP_LIST_TRAVERSE(&deviceStates, deviceState, list) {
-		if (!strncasecmp(devstate, deviceState->devicestate, sizeof(deviceState->devicestate))) {
-			break;
-		}
-	}
+	char key[StationMaxNameSize];
 
-	return deviceState;
+	sccp_copy_string(key, devstate, sizeof(key));							/* handlers are stored under their (truncated) devicestate name */
+	return sccp_hashtable_find(deviceStateIndex, key);
 }
 
 sccp_devstate_deviceState_t *sccp_devstate_createDeviceStateHandler(const char *devstate)
@@ -193,6 +252,13 @@ sccp_devstate_deviceState_t *sccp_devstate_createDeviceStateHandler(const char *
 		pbx_log(LOG_ERROR, "Memory Allocation for deviceState failed!\n");
 		return NULL;
 	}
+	deviceState->generation = sccp_calloc(sizeof *deviceState->generation, 1);
+	if (!deviceState->generation) {
+		pbx_log(LOG_ERROR, "Memory Allocation for deviceState failed!\n");
+		sccp_free(deviceState);
+		return NULL;
+	}
+	deviceState->generation->refcount = 1;
 	SCCP_LIST_HEAD_INIT(&deviceState->subscribers);
 	sccp_copy_string(deviceState->devicestate, devstate, sizeof(deviceState->devicestate));
 #if ASTERISK_VERSION_GROUP >= 112
@@ -205,6 +271,7 @@ sccp_devstate_deviceState_t *sccp_devstate_createDeviceStateHandler(const char *
 	deviceState->featureState = (ast_device_state(buf) == AST_DEVICE_NOT_INUSE) ? 0 : 1;
 
 	SCCP_LIST_INSERT_HEAD(&deviceStates, deviceState, list);
+	sccp_hashtable_insert(deviceStateIndex, deviceState->devicestate, deviceState);
 	return deviceState;
 }
 
@@ -213,13 +280,19 @@ void sccp_devstate_addSubscriber(sccp_devstate_deviceState_t * deviceState, cons
 	sccp_devstate_SubscribingDevice_t *subscriber;
 
 	subscriber = sccp_calloc(sizeof *subscriber, 1);
+	if (!subscriber) {
+		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, DEV_ID_LOG(device));
+		return;
+	}
 	subscriber->device = sccp_device_retain((sccp_device_t *) device);
 	subscriber->instance = buttonConfig->instance;
 	subscriber->buttonConfig = buttonConfig;
 	subscriber->buttonConfig->button.feature.status = deviceState->featureState;
 	sccp_copy_string(subscriber->label, buttonConfig->label, sizeof(subscriber->label));
 
+	SCCP_LIST_LOCK(&deviceState->subscribers);
 	SCCP_LIST_INSERT_HEAD(&deviceState->subscribers, subscriber, list);
+	SCCP_LIST_UNLOCK(&deviceState->subscribers);
 	sccp_devstate_notifySubscriber(deviceState, subscriber);						/* set initial state */
 }
 
@@ -227,36 +300,135 @@ void sccp_devstate_removeSubscriber(sccp_devstate_deviceState_t * deviceState, c
 {
 	sccp_devstate_SubscribingDevice_t *subscriber = NULL;
 
+	SCCP_LIST_LOCK(&deviceState->subscribers);
 	SCCP_LIST_TRAVERSE_SAFE_BEGIN(&deviceState->subscribers, subscriber, list) {
 		if (subscriber->device == device) {
 			SCCP_LIST_REMOVE_CURRENT(list);
 			sccp_device_release(&subscriber->device);				/* explicit release */
+			sccp_free(subscriber);
 		}
 
 	}
 	SCCP_LIST_TRAVERSE_SAFE_END;
+	SCCP_LIST_UNLOCK(&deviceState->subscribers);
 }
 
-void sccp_devstate_notifySubscriber(sccp_devstate_deviceState_t * deviceState, const sccp_devstate_SubscribingDevice_t * subscriber)
+static void sccp_devstate_sendFeatureState(constDevicePtr device, uint8_t instance, const char *label, uint32_t featureState)
 {
-	pbx_assert(subscriber->device != NULL);
 	sccp_msg_t *msg = NULL;
 
-	if (subscriber->device->inuseprotocolversion >= 15) {
+	if (device->inuseprotocolversion >= 15) {
 		REQ(msg, FeatureStatDynamicMessage);
-		msg->data.FeatureStatDynamicMessage.lel_featureIndex = htolel(subscriber->instance);
+		if (!msg) {
+			return;
+		}
+		msg->data.FeatureStatDynamicMessage.lel_featureIndex = htolel(instance);
 		msg->data.FeatureStatDynamicMessage.lel_featureID = htolel(SKINNY_BUTTONTYPE_FEATURE);
-		msg->data.FeatureStatDynamicMessage.lel_featureStatus = htolel(deviceState->featureState);
-		sccp_copy_string(msg->data.FeatureStatDynamicMessage.featureTextLabel, subscriber->label, sizeof(msg->data.FeatureStatDynamicMessage.featureTextLabel));
+		msg->data.FeatureStatDynamicMessage.lel_featureStatus = htolel(featureState);
+		sccp_copy_string(msg->data.FeatureStatDynamicMessage.featureTextLabel, label, sizeof(msg->data.FeatureStatDynamicMessage.featureTextLabel));
 	} else {
 		REQ(msg, FeatureStatMessage);
-		msg->data.FeatureStatMessage.lel_featureIndex = htolel(subscriber->instance);
+		if (!msg) {
+			return;
+		}
+		msg->data.FeatureStatMessage.lel_featureIndex = htolel(instance);
 		msg->data.FeatureStatMessage.lel_featureID = htolel(SKINNY_BUTTONTYPE_FEATURE);
-		msg->data.FeatureStatMessage.lel_featureStatus = htolel(deviceState->featureState);
-		sccp_copy_string(msg->data.FeatureStatMessage.featureTextLabel, subscriber->label, sizeof(msg->data.FeatureStatMessage.featureTextLabel));
+		msg->data.FeatureStatMessage.lel_featureStatus = htolel(featureState);
+		sccp_copy_string(msg->data.FeatureStatMessage.featureTextLabel, label, sizeof(msg->data.FeatureStatMessage.featureTextLabel));
+	}
+
+	sccp_dev_send(device, msg);
+}
+
+/*!
+ * \brief sends the featureState of the fan-out jobs (replaced by the fanout test to record what would go out)
+ */
+static void (*sccp_devstate_fanout_send) (constDevicePtr device, uint8_t instance, const char *label, uint32_t featureState) = sccp_devstate_sendFeatureState;
+
+void sccp_devstate_notifySubscriber(sccp_devstate_deviceState_t * deviceState, const sccp_devstate_SubscribingDevice_t * subscriber)
+{
+	pbx_assert(subscriber->device != NULL);
+
+	sccp_devstate_sendFeatureState(subscriber->device, subscriber->instance, subscriber->label, deviceState->featureState);
+}
+
+/*!
+ * \brief histogram bucket for a latency in usecs (bucket n holds latencies below 2^n usecs)
+ */
+static gcc_inline int sccp_devstate_latencyBucket(int64_t usecs)
+{
+	int bucket = 0;
+
+	while (bucket < SCCP_DEVSTATE_LATENCY_BUCKETS - 1 && usecs >= ((int64_t) 1 << bucket)) {
+		bucket++;
+	}
+	return bucket;
+}
+
+/*!
+ * \brief notify one chunk of subscribers, runs on the threadpool (or inline)
+ *
+ * Chunks of successive changes of the same devstate can run at the same time. A subscriber is skipped when a newer state
+ * arrived before it was notified (the newer fan-out covers it as well). When the state changes while a notification is
+ * being sent, the newer chunk may already have sent its state to the same button; so after every send the generation is
+ * checked again and the latest state is repeated until no change slipped in, which makes the latest state the last one
+ * each button receives.
+ */
+static void *sccp_devstate_fanout_run(void *data)
+{
+	sccp_devstate_fanout_t *fanout = data;
+	uint64_t latency[SCCP_DEVSTATE_LATENCY_BUCKETS] = { 0 };
+	int64_t latency_max = 0;
+	uint32_t sent = 0, skipped = 0, resent = 0;
+	int seq, current;
+	uint32_t featureState;
+	uint i;
+	int b;
+
+	for (i = 0; i < fanout->count; i++) {
+		seq = fanout->seq;
+		featureState = fanout->featureState;
+		if (ATOMIC_FETCH(&fanout->generation->seq, &devstate_stats_lock) == seq) {
+			struct timeval waited;
+			int64_t usecs;
+
+			sccp_devstate_fanout_send(fanout->subscribers[i].device, fanout->subscribers[i].instance, fanout->subscribers[i].label, featureState);
+			waited = ast_tvsub(pbx_tvnow(), fanout->changed);
+			usecs = (int64_t) waited.tv_sec * 1000000 + waited.tv_usec;
+			latency[sccp_devstate_latencyBucket(usecs)]++;
+			if (usecs > latency_max) {
+				latency_max = usecs;
+			}
+			sent++;
+
+			/* the state changed while we were sending, make sure the latest state is the last one sent to this button */
+			while ((current = ATOMIC_FETCH(&fanout->generation->seq, &devstate_stats_lock)) != seq) {
+				seq = current;
+				featureState = fanout->generation->featureState;
+				sccp_devstate_fanout_send(fanout->subscribers[i].device, fanout->subscribers[i].instance, fanout->subscribers[i].label, featureState);
+				resent++;
+			}
+		} else {
+			skipped++;
+		}
+		sccp_device_release(&fanout->subscribers[i].device);					/* explicit release */
+	}
+	sccp_devstate_generation_release(fanout->generation);
+
+	pbx_mutex_lock(&devstate_stats_lock);
+	devstate_stats.notifications += sent;
+	devstate_stats.skipped += skipped;
+	devstate_stats.resent += resent;
+	for (b = 0; b < SCCP_DEVSTATE_LATENCY_BUCKETS; b++) {
+		devstate_stats.latency[b] += latency[b];
 	}
+	if (latency_max > devstate_stats.latency_max) {
+		devstate_stats.latency_max = latency_max;
+	}
+	pbx_mutex_unlock(&devstate_stats_lock);
 
-	sccp_dev_send(subscriber->device, msg);
+	sccp_free(fanout);
+	return NULL;
 }
 
 //void sccp_devstate_changed_cb(const struct ast_event *ast_event, void *data)
@@ -268,6 +440,11 @@ void sccp_devstate_changed_cb(const struct ast_event *ast_event, void *data)
 {
 	sccp_devstate_deviceState_t *deviceState = NULL;
 	sccp_devstate_SubscribingDevice_t *subscriber = NULL;
+	sccp_devstate_fanout_t *fanout = NULL;
+	sccp_threadpool_work_t *work = NULL;
+	int count = 0, size = 0, queued = 0, i = 0;
+	struct timeval changed = pbx_tvnow();
+	int seq = 0;
 	enum ast_device_state state;
 
 #if ASTERISK_VERSION_GROUP >= 112
@@ -285,13 +462,345 @@ void sccp_devstate_changed_cb(const struct ast_event *ast_event, void *data)
 #endif
 	deviceState = (sccp_devstate_deviceState_t *) data;
 	deviceState->featureState = (state == AST_DEVICE_NOT_INUSE) ? 0 : 1;
+	deviceState->generation->featureState = deviceState->featureState;					/* set before seq is bumped, the atomic bump orders both */
+	seq = ATOMIC_INCR(&deviceState->generation->seq, 1, &devstate_stats_lock) + 1;			/* outstanding jobs of a previous state stop sending */
 
 	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "%s: (sccp_devstate_changed_cb) got new device state for %s, state: %d, deviceState->subscribers.count %d\n", "SCCP", deviceState->devicestate, state, deviceState->subscribers.size);
+
+	/* split the subscribers in chunks, the chunks are notified in parallel on the threadpool */
+	SCCP_LIST_LOCK(&deviceState->subscribers);
 	SCCP_LIST_TRAVERSE(&deviceState->subscribers, subscriber, list) {
 		sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "%s: (sccp_devstate_changed_cb) notify subscriber for state %d\n", DEV_ID_LOG(subscriber->device), deviceState->featureState);
 		subscriber->buttonConfig->button.feature.status = deviceState->featureState;
-		sccp_devstate_notifySubscriber(deviceState, subscriber);
+		if (!fanout || fanout->count == SCCP_DEVSTATE_FANOUT_CHUNK) {
+			if (count == size) {
+				int newsize = size ? size * 2 : 4;
+				sccp_threadpool_work_t *newwork = sccp_realloc(work, newsize * sizeof(*newwork));
+
+				if (!newwork) {
+					fanout = NULL;
+					sccp_devstate_notifySubscriber(deviceState, subscriber);		/* could not queue, notify right away */
+					continue;
+				}
+				work = newwork;
+				size = newsize;
+			}
+			if (!(fanout = sccp_calloc(sizeof *fanout, 1))) {
+				sccp_devstate_notifySubscriber(deviceState, subscriber);			/* could not queue, notify right away */
+				continue;
+			}
+			ATOMIC_INCR(&deviceState->generation->refcount, 1, &devstate_stats_lock);
+			fanout->generation = deviceState->generation;
+			fanout->seq = seq;
+			fanout->featureState = deviceState->featureState;
+			fanout->changed = changed;
+			work[count].function = sccp_devstate_fanout_run;
+			work[count].arg = fanout;
+			count++;
+		}
+		if ((fanout->subscribers[fanout->count].device = sccp_device_retain(subscriber->device))) {
+			fanout->subscribers[fanout->count].instance = subscriber->instance;
+			sccp_copy_string(fanout->subscribers[fanout->count].label, subscriber->label, sizeof(fanout->subscribers[fanout->count].label));
+			fanout->count++;
+		}
 	}
+	SCCP_LIST_UNLOCK(&deviceState->subscribers);
+
+	/* a single chunk is not worth the hand-over, run it on this thread */
+	queued = 0;
+	if (count > 1 && GLOB(general_threadpool)) {
+		queued = sccp_threadpool_add_work_batch(GLOB(general_threadpool), work, count);
+	}
+	for (i = queued; i < count; i++) {
+		sccp_devstate_fanout_run(work[i].arg);
+	}
+	if (work) {
+		sccp_free(work);
+	}
+
+	pbx_mutex_lock(&devstate_stats_lock);
+	devstate_stats.changes++;
+	devstate_stats.jobs += queued;
+	pbx_mutex_unlock(&devstate_stats_lock);
+}
+
+/*!
+ * \brief latency (usecs) below which pct percent of the notifications were sent, taken from the histogram
+ * \note devstate_stats_lock needs to be held
+ */
+static int64_t sccp_devstate_latencyPercentile(uint64_t total, int pct)
+{
+	uint64_t wanted = (total * pct + 99) / 100;
+	uint64_t seen = 0;
+	int b;
+
+	if (!total) {
+		return 0;
+	}
+	for (b = 0; b < SCCP_DEVSTATE_LATENCY_BUCKETS; b++) {
+		seen += devstate_stats.latency[b];
+		if (seen >= wanted) {
+			break;
+		}
+	}
+	if (b >= SCCP_DEVSTATE_LATENCY_BUCKETS - 1) {
+		return devstate_stats.latency_max;							/* open ended last bucket */
+	}
+	return (int64_t) 1 << b;
+}
+
+/*!
+ * \brief Show DevState Statistics
+ * \param fd Fd as int
+ * \param totals Total number of lines as int
+ * \param s AMI Session
+ * \param m Message
+ * \param argc Argc as int
+ * \param argv[] Argv[] as char
+ * \return Result as int
+ *
+ * \called_from_asterisk
+ */
+int sccp_show_devstate_stats(int fd, sccp_cli_totals_t *totals, struct mansession *s, const struct message *m, int argc, char *argv[])
+{
+	int local_line_total = 0;
+	const char *actionid = "";
+	uint32_t changes, notifications, skipped, resent, jobs;
+	int64_t p50, p90, p99, max;
+	uint64_t total = 0;
+	int b;
+
+	pbx_mutex_lock(&devstate_stats_lock);
+	changes = devstate_stats.changes;
+	notifications = devstate_stats.notifications;
+	skipped = devstate_stats.skipped;
+	resent = devstate_stats.resent;
+	jobs = devstate_stats.jobs;
+	for (b = 0; b < SCCP_DEVSTATE_LATENCY_BUCKETS; b++) {
+		total += devstate_stats.latency[b];
+	}
+	p50 = sccp_devstate_latencyPercentile(total, 50);
+	p90 = sccp_devstate_latencyPercentile(total, 90);
+	p99 = sccp_devstate_latencyPercentile(total, 99);
+	max = devstate_stats.latency_max;
+	pbx_mutex_unlock(&devstate_stats_lock);
+
+	if (!s) {
+		CLI_AMI_OUTPUT(fd, s, "\n--- SCCP devstate notifications ------------------------------------------------------------------------------------------\n");
+	} else {
+		astman_append(s, "Response: Success\r\n");
+		astman_append(s, "Message: SCCPDevstateStats\r\n");
+		actionid = astman_get_header(m, "ActionID");
+		if (!pbx_strlen_zero(actionid)) {
+			astman_append(s, "ActionID: %s\r\n", actionid);
+		}
+		local_line_total++;
+	}
+	CLI_AMI_OUTPUT_PARAM("Devstate Handlers", CLI_AMI_LIST_WIDTH, "%d", SCCP_LIST_GETSIZE(&deviceStates));
+	CLI_AMI_OUTPUT_PARAM("State Changes", CLI_AMI_LIST_WIDTH, "%u", changes);
+	CLI_AMI_OUTPUT_PARAM("Notifications Sent", CLI_AMI_LIST_WIDTH, "%u", notifications);
+	CLI_AMI_OUTPUT_PARAM("Notifications Superseded", CLI_AMI_LIST_WIDTH, "%u", skipped);
+	CLI_AMI_OUTPUT_PARAM("Notifications Repeated", CLI_AMI_LIST_WIDTH, "%u", resent);
+	CLI_AMI_OUTPUT_PARAM("Threadpool Jobs", CLI_AMI_LIST_WIDTH, "%u (%d subscribers each)", jobs, SCCP_DEVSTATE_FANOUT_CHUNK);
+	CLI_AMI_OUTPUT_PARAM("Latency p50", CLI_AMI_LIST_WIDTH, "< %" PRId64 " us", p50);
+	CLI_AMI_OUTPUT_PARAM("Latency p90", CLI_AMI_LIST_WIDTH, "< %" PRId64 " us", p90);
+	CLI_AMI_OUTPUT_PARAM("Latency p99", CLI_AMI_LIST_WIDTH, "< %" PRId64 " us", p99);
+	CLI_AMI_OUTPUT_PARAM("Latency max", CLI_AMI_LIST_WIDTH, "%" PRId64 " us", max);
+
+	if (s) {
+		totals->lines = local_line_total;
+	}
+	return RESULT_SUCCESS;
+}
+
+#if CS_TEST_FRAMEWORK
+#include <asterisk/test.h>
+#define test_category "/channels/chan_sccp/devstate/"
+#define DEVSTATE_TEST_INSTANCES 3
+#define DEVSTATE_TEST_GENERATIONS 5
+
+static struct {
+	sccp_devstate_generation_t *generation;
+	sccp_devstate_fanout_t *newer[DEVSTATE_TEST_GENERATIONS];
+	int next;												/* next newer generation to arrive */
+	int sends;
+	uint32_t last[DEVSTATE_TEST_INSTANCES + 1];								/* last featureState each instance received */
+} devstate_test;
+
+/* every send is overtaken by the next state change: its fan-out runs to completion before our send "lands" */
+static void sccp_devstate_test_send(constDevicePtr device, uint8_t instance, const char *label, uint32_t featureState)
+{
+	sccp_devstate_fanout_t *newer = NULL;
+
+	devstate_test.sends++;
+	if (devstate_test.next < DEVSTATE_TEST_GENERATIONS && (newer = devstate_test.newer[devstate_test.next])) {
+		devstate_test.newer[devstate_test.next++] = NULL;
+		devstate_test.generation->featureState = newer->featureState;
+		ATOMIC_INCR(&devstate_test.generation->seq, 1, &devstate_stats_lock);
+		sccp_devstate_fanout_run(newer);
+	}
+	devstate_test.last[instance] = featureState;
+}
+
+static sccp_devstate_fanout_t *sccp_devstate_test_fanout(sccp_devstate_generation_t * generation, int seq, uint32_t featureState, sccp_device_t * device)
+{
+	sccp_devstate_fanout_t *fanout = sccp_calloc(sizeof *fanout, 1);
+	uint8_t instance;
+
+	if (fanout) {
+		ATOMIC_INCR(&generation->refcount, 1, &devstate_stats_lock);
+		fanout->generation = generation;
+		fanout->seq = seq;
+		fanout->featureState = featureState;
+		fanout->changed = pbx_tvnow();
+		for (instance = 1; instance <= DEVSTATE_TEST_INSTANCES; instance++) {
+			fanout->subscribers[fanout->count].device = sccp_device_retain(device);
+			fanout->subscribers[fanout->count].instance = instance;
+			snprintf(fanout->subscribers[fanout->count].label, sizeof(fanout->subscribers[fanout->count].label), "Button %d", instance);
+			fanout->count++;
+		}
+	}
+	return fanout;
 }
+
+/* a fan-out job which never got to run: release its devices, running the empty job drops the generation and frees it */
+static void sccp_devstate_test_dropFanout(sccp_devstate_fanout_t * fanout)
+{
+	uint i;
+
+	for (i = 0; i < fanout->count; i++) {
+		sccp_device_release(&fanout->subscribers[i].device);						/* explicit release */
+	}
+	fanout->count = 0;
+	sccp_devstate_fanout_run(fanout);
+}
+
+AST_TEST_DEFINE(sccp_devstate_index_tests)
+{
+	sccp_devstate_deviceState_t *deviceState = NULL;
+	char devstate[StationMaxNameSize + 16];
+	int rc = AST_TEST_PASS;
+
+	switch (cmd) {
+		case TEST_INIT:
+			info->name = "index";
+			info->category = test_category;
+			info->summary = "chan-sccp-b devstate handler index";
+			info->description = "chan-sccp-b devstate handlers are found by their (truncated, case insensitive) name";
+			return AST_TEST_NOT_RUN;
+		case TEST_EXECUTE:
+			break;
+	}
+	if (!deviceStateIndex) {
+		pbx_test_status_update(test, "devstate system is not running. skipping\n");
+		return AST_TEST_PASS;
+	}
+	pbx_test_validate(test, (deviceState = sccp_calloc(sizeof *deviceState, 1)) != NULL);
+	memset(devstate, 'x', sizeof(devstate) - 1);
+	devstate[sizeof(devstate) - 1] = '\0';
+	memcpy(devstate, "sccp_devstate_test", 18);
+	sccp_copy_string(deviceState->devicestate, devstate, sizeof(deviceState->devicestate));
+
+	SCCP_LIST_LOCK(&deviceStates);
+	pbx_test_validate_cleanup(test, sccp_hashtable_insert(deviceStateIndex, deviceState->devicestate, deviceState), rc, cleanup);
+
+	pbx_test_status_update(test, "a name longer than StationMaxNameSize finds the handler stored under its truncated name\n");
+	pbx_test_validate_cleanup(test, strlen(devstate) >= sizeof(deviceState->devicestate), rc, cleanup);
+	pbx_test_validate_cleanup(test, sccp_devstate_getDeviceStateHandler(devstate) == deviceState, rc, cleanup);
+	pbx_test_validate_cleanup(test, sccp_devstate_getDeviceStateHandler(deviceState->devicestate) == deviceState, rc, cleanup);
+
+	pbx_test_status_update(test, "lookups are case insensitive, other names are not found\n");
+	memcpy(devstate, "SCCP_DEVSTATE_TEST", 18);
+	pbx_test_validate_cleanup(test, sccp_devstate_getDeviceStateHandler(devstate) == deviceState, rc, cleanup);
+	pbx_test_validate_cleanup(test, sccp_devstate_getDeviceStateHandler("sccp_devstate_test") == NULL, rc, cleanup);
+	pbx_test_validate_cleanup(test, sccp_devstate_getDeviceStateHandler(NULL) == NULL, rc, cleanup);
+
+cleanup:
+	sccp_hashtable_remove(deviceStateIndex, deviceState->devicestate, deviceState);
+	SCCP_LIST_UNLOCK(&deviceStates);
+	sccp_free(deviceState);
+	return rc;
+}
+
+AST_TEST_DEFINE(sccp_devstate_fanout_tests)
+{
+	sccp_device_t *device = NULL;
+	sccp_devstate_fanout_t *fanout = NULL;
+	uint32_t featureState = 0;
+	int rc = AST_TEST_PASS;
+	int gen;
+	uint8_t instance;
+
+	switch (cmd) {
+		case TEST_INIT:
+			info->name = "fanout";
+			info->category = test_category;
+			info->summary = "chan-sccp-b devstate fan-out ordering";
+			info->description = "chan-sccp-b a devstate button always ends up with the latest state, when fan-outs of older generations are overtaken by newer ones";
+			return AST_TEST_NOT_RUN;
+		case TEST_EXECUTE:
+			break;
+	}
+	memset(&devstate_test, 0, sizeof(devstate_test));
+	pbx_test_validate(test, (device = sccp_device_create("SEPDEVSTATETEST")) != NULL);
+	devstate_test.generation = sccp_calloc(sizeof *devstate_test.generation, 1);
+	pbx_test_validate_cleanup(test, devstate_test.generation != NULL, rc, cleanup);
+	devstate_test.generation->refcount = 1;
+	devstate_test.generation->seq = 1;
+	devstate_test.generation->featureState = 1;
+
+	/* generation 1 is sent first, every send is overtaken by the fan-out of the next generation (states toggle) */
+	pbx_test_validate_cleanup(test, (fanout = sccp_devstate_test_fanout(devstate_test.generation, 1, 1, device)) != NULL, rc, cleanup);
+	for (gen = 0; gen < DEVSTATE_TEST_GENERATIONS; gen++) {
+		featureState = (gen + 2) % 2;
+		devstate_test.newer[gen] = sccp_devstate_test_fanout(devstate_test.generation, gen + 2, featureState, device);
+		pbx_test_validate_cleanup(test, devstate_test.newer[gen] != NULL, rc, cleanup);
+	}
+	pbx_test_status_update(test, "run %d interleaved generations over %d buttons\n", DEVSTATE_TEST_GENERATIONS + 1, DEVSTATE_TEST_INSTANCES);
+	sccp_devstate_fanout_send = sccp_devstate_test_send;
+	sccp_devstate_fanout_run(fanout);
+	fanout = NULL;
+	sccp_devstate_fanout_send = sccp_devstate_sendFeatureState;
+
+	pbx_test_validate_cleanup(test, devstate_test.next == DEVSTATE_TEST_GENERATIONS, rc, cleanup);
+	pbx_test_validate_cleanup(test, devstate_test.generation->seq == DEVSTATE_TEST_GENERATIONS + 1 && devstate_test.generation->featureState == featureState, rc, cleanup);
+	for (instance = 1; instance <= DEVSTATE_TEST_INSTANCES; instance++) {
+		pbx_test_status_update(test, "button %d ends with state %u (latest %u)\n", instance, devstate_test.last[instance], featureState);
+		pbx_test_validate_cleanup(test, devstate_test.last[instance] == featureState, rc, cleanup);
+	}
+	/* the newest generation notifies every button, each overtaken one sent to the first button once and repeated the latest state there */
+	pbx_test_status_update(test, "%d sends in total\n", devstate_test.sends);
+	pbx_test_validate_cleanup(test, devstate_test.sends == DEVSTATE_TEST_INSTANCES + 2 * DEVSTATE_TEST_GENERATIONS, rc, cleanup);
+	pbx_test_validate_cleanup(test, devstate_test.generation->refcount == 1, rc, cleanup);
+
+cleanup:
+	sccp_devstate_fanout_send = sccp_devstate_sendFeatureState;
+	if (fanout) {
+		sccp_devstate_test_dropFanout(fanout);
+	}
+	for (gen = 0; gen < DEVSTATE_TEST_GENERATIONS; gen++) {
+		if (devstate_test.newer[gen]) {
+			sccp_devstate_test_dropFanout(devstate_test.newer[gen]);
+		}
+	}
+	sccp_devstate_generation_release(devstate_test.generation);
+	if (device) {
+		sccp_device_release(&device);									/* explicit release */
+	}
+	return rc;
+}
+
+static void __attribute__((constructor)) sccp_register_tests(void)
+{
+	AST_TEST_REGISTER(sccp_devstate_index_tests);
+	AST_TEST_REGISTER(sccp_devstate_fanout_tests);
+}
+
+static void __attribute__((destructor)) sccp_unregister_tests(void)
+{
+	AST_TEST_UNREGISTER(sccp_devstate_index_tests);
+	AST_TEST_UNREGISTER(sccp_devstate_fanout_tests);
+}
+#endif
 #endif
 // kate: indent-width 8; replace-tabs off; indent-mode cstyle; auto-insert-doxygen on; line-numbers on; tab-indents on; keep-extra-spaces off; auto-brackets off;
@@ -19,6 +19,7 @@
 #include "sccp_device.h"
 #include "sccp_event.h"
 #include "sccp_line.h"
+#include "sccp_utils.h"
 #include "sccp_vector.h"
 
 SCCP_FILE_VERSION(__FILE__, "");
@@ -35,11 +36,12 @@ void sccp_event_destroy(sccp_event_t * event);
 /* type declarations */
 typedef struct sccp_event_subscriber sccp_event_subscriber_t;
 typedef struct sccp_event_subscriptions sccp_event_subscriptions_t;
+typedef struct sccp_event_lane sccp_event_lane_t;
+typedef struct sccp_event_snapshot sccp_event_snapshot_t;
 typedef SCCP_VECTOR_RW(, sccp_event_subscriber_t) sccp_event_vector_t;
 
 /* vector compare functions */
 #define SUBSCRIBER_CB_CMP(elem, value) ((elem).callback_function == (value))
-#define SUBSCRIBER_EXEC_CMP(elem, value) ((elem).execution == (value))
 
 /*!
  * \brief Execution Mode Enum
@@ -58,6 +60,22 @@ struct sccp_event_subscriber {
 	sccp_event_callback_t callback_function;
 };
 
+/*!
+ * \brief Immutable, pre-split copy of the subscribers of one event type
+ *
+ * A new snapshot is built and published by sccp_event_subscribe/unsubscribe (under the vector write lock), the fire path
+ * only takes a reference on the current one. A snapshot is freed when the last reference (publisher, firing thread or
+ * queued async event) is dropped.
+ */
+struct sccp_event_snapshot {
+	volatile int refcount;
+	uint32_t num_sync;
+	uint32_t num_async;
+	sccp_event_callback_t *sync;							/*!< points into callbacks */
+	sccp_event_callback_t *async;							/*!< points into callbacks, after the sync ones */
+	sccp_event_callback_t callbacks[0];
+};
+
 /*!
  * \brief SCCP Event Subscriptions Structure
  */
@@ -66,8 +84,13 @@ static struct sccp_event_subscriptions {
 							// same as: SCCP_VECTOR_RW(sccp_event_vector, sccp_event_subscriber_t) subscribers;
 							// typedef struct sccp_event_vector sccp_event_vector_t;
 							// but using predeclared type instead
+	sccp_event_snapshot_t * volatile snapshot;					/*!< published subscribers, NULL when there are none */
+	volatile int readers;								/*!< threads in between loading snapshot and taking their reference */
 } event_subscriptions[NUMBER_OF_EVENT_TYPES] = {{{0}}};
 
+/* only used by the ATOMIC_* fallback on platforms without atomic builtins */
+AST_MUTEX_DEFINE_STATIC(event_snapshot_lock);
+
 /*
  * \brief release held references when we are finished processing this event
  */
@@ -109,8 +132,8 @@ void sccp_event_destroy(sccp_event_t * event)
 			break;
 #if CS_TEST_FRAMEWORK
 		case SCCP_EVENT_TEST:
-			pbx_log(LOG_NOTICE, "SCCP: TestEvent Destroy Event\n");
 			if (event->event.TestEvent.str) {
+				pbx_log(LOG_NOTICE, "SCCP: TestEvent Destroy Event\n");
 				sccp_free(event->event.TestEvent.str);
 			}
 			break;
@@ -123,6 +146,76 @@ void sccp_event_destroy(sccp_event_t * event)
 }
 
 static volatile boolean_t sccp_event_running = FALSE;
+static void __event_lane_drain(sccp_event_lane_t * lane);
+static void __event_envelope_pool_init(void);
+static void __event_envelope_pool_destroy(void);
+
+static void __event_snapshot_release(sccp_event_snapshot_t * snapshot)
+{
+	if (snapshot && ATOMIC_DECR(&snapshot->refcount, 1, &event_snapshot_lock) == 1) {
+		sccp_free(snapshot);
+	}
+}
+
+/*!
+ * \brief Take a reference on the current snapshot of subscribers, without locking
+ * \note readers is raised while the pointer is loaded, so that a publisher can tell when nobody can still be about to
+ *       reference the snapshot it just replaced
+ */
+static gcc_inline sccp_event_snapshot_t *__event_snapshot_acquire(struct sccp_event_subscriptions *subscriptions)
+{
+	sccp_event_snapshot_t *snapshot = NULL;
+
+	ATOMIC_INCR(&subscriptions->readers, 1, &event_snapshot_lock);
+	if ((snapshot = subscriptions->snapshot)) {
+		ATOMIC_INCR(&snapshot->refcount, 1, &event_snapshot_lock);
+	}
+	ATOMIC_DECR(&subscriptions->readers, 1, &event_snapshot_lock);
+	return snapshot;
+}
+
+/*!
+ * \brief Build a new snapshot from the subscribers vector and swap it in
+ * \note subscribers vector needs to be write locked
+ */
+static boolean_t __event_snapshot_publish(struct sccp_event_subscriptions *subscriptions)
+{
+	sccp_event_vector_t *subscribers = &subscriptions->subscribers;
+	sccp_event_snapshot_t *snapshot = NULL, *old = NULL;
+	uint32_t n = 0, size = SCCP_VECTOR_SIZE(subscribers);
+
+	if (size) {
+		if (!(snapshot = sccp_calloc(sizeof(sccp_event_snapshot_t) + size * sizeof(sccp_event_callback_t), 1))) {
+			pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+			return FALSE;
+		}
+		snapshot->refcount = 1;
+		snapshot->sync = snapshot->callbacks;
+		for (n = 0; n < size; n++) {
+			sccp_event_subscriber_t *subscriber = SCCP_VECTOR_GET_ADDR(subscribers, n);
+			if (subscriber->execution == SCCP_EVENT_SYNC) {
+				snapshot->sync[snapshot->num_sync++] = subscriber->callback_function;
+			}
+		}
+		snapshot->async = snapshot->callbacks + snapshot->num_sync;
+		for (n = 0; n < size; n++) {
+			sccp_event_subscriber_t *subscriber = SCCP_VECTOR_GET_ADDR(subscribers, n);
+			if (subscriber->execution == SCCP_EVENT_ASYNC) {
+				snapshot->async[snapshot->num_async++] = subscriber->callback_function;
+			}
+		}
+	}
+	do {
+		old = subscriptions->snapshot;
+	} while (!CAS_PTR(&subscriptions->snapshot, old, snapshot, &event_snapshot_lock));
+
+	/* wait until every reader which might have loaded the old pointer holds its own reference */
+	while (ATOMIC_FETCH(&subscriptions->readers, &event_snapshot_lock) > 0) {
+		sched_yield();
+	}
+	__event_snapshot_release(old);
+	return TRUE;
+}
 
 //static void __attribute__((constructor)) sccp_event_module_init(void)
 void sccp_event_module_start(void)
@@ -136,6 +229,11 @@ void sccp_event_module_start(void)
 				return;
 			}
 		}
+		for (_idx = 0; _idx < SCCP_EVENT_LANES; _idx++) {
+			memset(&event_lanes[_idx], 0, sizeof(sccp_event_lane_t));
+			pbx_mutex_init(&event_lanes[_idx].lock);
+		}
+		__event_envelope_pool_init();
 		sccp_event_running = TRUE;
 	}
 }
@@ -147,9 +245,17 @@ void sccp_event_module_stop(void)
 	if (sccp_event_running) {
 		sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_2 "Stopping event system\n");
 		sccp_event_running = FALSE;
+		for (_idx = 0; _idx < SCCP_EVENT_LANES; _idx++) {
+			__event_lane_drain(&event_lanes[_idx]);
+		}
 		for (_idx = 0; _idx < NUMBER_OF_EVENT_TYPES; _idx++) {
+			SCCP_VECTOR_RW_WRLOCK(&event_subscriptions[_idx].subscribers);
+			SCCP_VECTOR_RESET(&event_subscriptions[_idx].subscribers, SCCP_VECTOR_ELEM_CLEANUP_NOOP);
+			__event_snapshot_publish(&event_subscriptions[_idx]);
+			SCCP_VECTOR_RW_UNLOCK(&event_subscriptions[_idx].subscribers);
 			SCCP_VECTOR_RW_FREE(&event_subscriptions[_idx].subscribers);
 		}
+		__event_envelope_pool_destroy();
 	}
 }
 
@@ -176,7 +282,7 @@ boolean_t sccp_event_subscribe(sccp_event_type_t eventType, sccp_event_callback_
 			sccp_event_vector_t *subscribers = &(event_subscriptions[_idx].subscribers);
 			SCCP_VECTOR_RW_WRLOCK(subscribers);
 			if (SCCP_VECTOR_APPEND(subscribers, subscriber) == 0) {
-				res = TRUE;
+				res = __event_snapshot_publish(&event_subscriptions[_idx]);
 			} else {
 				pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
 			}
@@ -203,7 +309,7 @@ boolean_t sccp_event_unsubscribe(sccp_event_type_t eventType, sccp_event_callbac
 			{
 				SCCP_VECTOR_RW_WRLOCK(subscribers);
 				if (SCCP_VECTOR_REMOVE_CMP_UNORDERED(subscribers, cb, SUBSCRIBER_CB_CMP, SCCP_VECTOR_ELEM_CLEANUP_NOOP) == 0) {
-					res = TRUE;
+					res = __event_snapshot_publish(&event_subscriptions[_idx]);
 				} else {
 					pbx_log(LOG_ERROR, "SCCP: (sccp_event_subscribe) Failed to remove subscriber from subscribers vector\n");
 				}
@@ -216,23 +322,18 @@ boolean_t sccp_event_unsubscribe(sccp_event_type_t eventType, sccp_event_callbac
 
 /* helpers */
 /*!
- * \brief execute the callback off each subscriber in the subscribers array, for a particular event
- * \note should be handed an copied non-lockedable vector
+ * \brief execute each callback in the callbacks array (taken from a snapshot), for a particular event
  */
-static gcc_inline boolean_t __execute_callback_helper(const sccp_event_t *event, sccp_event_vector_t *subs_vector) 
+static gcc_inline boolean_t __execute_callback_helper(const sccp_event_t *event, sccp_event_callback_t * const callbacks, uint32_t num_callbacks)
 {
 	boolean_t res = FALSE;
-	if (subs_vector) {
-		uint32_t n = 0;
-		for (n = 0; n < SCCP_VECTOR_SIZE(subs_vector) && sccp_event_running; n++) {
-			sccp_event_subscriber_t subscriber = SCCP_VECTOR_GET(subs_vector, n);
-			if (subscriber.callback_function != NULL) {
-				//sccp_log((DEBUGCAT_EVENT)) (VERBOSE_PREFIX_3 "Processing Event %p of Type %s via %d callback:%p\n", event, sccp_event_type2str(event->type), n, subscriber.callback_function);
-				subscriber.callback_function(event);
-				res = TRUE;
-			}
+	uint32_t n = 0;
+	for (n = 0; n < num_callbacks && sccp_event_running; n++) {
+		if (callbacks[n] != NULL) {
+			//sccp_log((DEBUGCAT_EVENT)) (VERBOSE_PREFIX_3 "Processing Event %p of Type %s via %d callback:%p\n", event, sccp_event_type2str(event->type), n, callbacks[n]);
+			callbacks[n](event);
+			res = TRUE;
 		}
-		SCCP_VECTOR_PTR_FREE(subs_vector);
 	}
 	return res;
 }
@@ -260,8 +361,109 @@ typedef struct __aSyncEventProcessorThreadArg
 {
 	uint8_t idx;
 	sccp_event_t event;
-	sccp_event_vector_t *async_subscribers;
+	sccp_event_snapshot_t *snapshot;								/*!< referenced subscribers snapshot */
+	struct sccp_event_envelope_pool_shard *pool;							/*!< shard the envelope was taken from, it is returned there */
+	struct __aSyncEventProcessorThreadArg *next;							/*!< next event on the same lane / in the envelope pool */
 } AsyncArgs_t;
+
+/*!
+ * \brief Pool of async event envelopes
+ * Sharded on the calling thread like the packet and refcount pools, so that firing threads do not contend on a single
+ * free list lock. Envelopes are taken on the firing thread but released on a threadpool worker, so they remember their
+ * shard and go back there, otherwise the firing thread's shard would never be refilled.
+ */
+#define SCCP_EVENT_POOL_SHARDS 8
+#define SCCP_EVENT_POOL_SHARD_SIZE 64
+
+static struct sccp_event_envelope_pool_shard {
+	pbx_mutex_t lock;
+	AsyncArgs_t *freelist;
+	int numfree;
+	int hits;											/*!< envelopes served from the free list */
+	int misses;											/*!< envelopes which had to be allocated */
+} __attribute__ ((aligned (64))) event_envelope_pool[SCCP_EVENT_POOL_SHARDS];
+
+static gcc_inline struct sccp_event_envelope_pool_shard *__event_envelope_pool_shard(void)
+{
+	uintptr_t hash = (uintptr_t) pthread_self();
+
+	hash ^= hash >> 17;
+	hash ^= hash >> 11;
+	hash = (hash * 0x9E3779B1U) & 0xFFFFFFFF;
+	return &event_envelope_pool[(hash >> 16) % SCCP_EVENT_POOL_SHARDS];
+}
+
+static void __event_envelope_pool_init(void)
+{
+	int shard;
+
+	memset(event_envelope_pool, 0, sizeof(event_envelope_pool));
+	for (shard = 0; shard < SCCP_EVENT_POOL_SHARDS; shard++) {
+		pbx_mutex_init(&event_envelope_pool[shard].lock);
+	}
+}
+
+static void __event_envelope_pool_destroy(void)
+{
+	AsyncArgs_t *arg = NULL;
+	int shard;
+
+	for (shard = 0; shard < SCCP_EVENT_POOL_SHARDS; shard++) {
+		struct sccp_event_envelope_pool_shard *pool = &event_envelope_pool[shard];
+
+		pbx_mutex_lock(&pool->lock);
+		while ((arg = pool->freelist)) {
+			pool->freelist = arg->next;
+			sccp_free(arg);
+		}
+		pool->numfree = 0;
+		pbx_mutex_unlock(&pool->lock);
+		pbx_mutex_destroy(&pool->lock);
+	}
+}
+
+static gcc_inline AsyncArgs_t *__event_envelope_get(void)
+{
+	struct sccp_event_envelope_pool_shard *pool = __event_envelope_pool_shard();
+	AsyncArgs_t *arg = NULL;
+
+	pbx_mutex_lock(&pool->lock);
+	if ((arg = pool->freelist)) {
+		pool->freelist = arg->next;
+		pool->numfree--;
+		pool->hits++;
+	} else {
+		pool->misses++;
+	}
+	pbx_mutex_unlock(&pool->lock);
+	if (!arg) {
+		arg = sccp_malloc(sizeof *arg);
+	}
+	if (arg) {
+		arg->pool = pool;
+	}
+	return arg;
+}
+
+static gcc_inline void __event_envelope_put(AsyncArgs_t * arg)
+{
+	struct sccp_event_envelope_pool_shard *pool = arg->pool;
+
+	if (sccp_event_running) {									/* pool is gone after module stop */
+		pbx_mutex_lock(&pool->lock);
+		if (pool->numfree < SCCP_EVENT_POOL_SHARD_SIZE) {
+			arg->next = pool->freelist;
+			pool->freelist = arg;
+			pool->numfree++;
+			arg = NULL;
+		}
+		pbx_mutex_unlock(&pool->lock);
+	}
+	if (arg) {
+		sccp_free(arg);
+	}
+}
+
 /*!
  * async thread run within threadpool
  */
@@ -270,13 +472,175 @@ static void *sccp_event_processor(void *data)
 	AsyncArgs_t *arg = data;
 	if (arg) {
 		//sccp_log((DEBUGCAT_EVENT)) (VERBOSE_PREFIX_3 "Async Processing Event Callbacks Type %s\n", sccp_event_type2str(arg->event.type));
-		__execute_callback_helper(&arg->event, arg->async_subscribers);
+		__execute_callback_helper(&arg->event, arg->snapshot->async, arg->snapshot->num_async);
+		__event_snapshot_release(arg->snapshot);
 		sccp_event_destroy(&arg->event);
-		sccp_free(arg);
+		__event_envelope_put(arg);
+	}
+	return NULL;
+}
+
+/*!
+ * \brief Ordered Event Lanes
+ *
+ * Async events which carry a device or line are hashed on that object onto one of the lanes below. Each lane is a
+ * fifo which is drained by at most one threadpool job at a time, so events about the same device/line are delivered
+ * to the async subscribers one after the other and in the order they were fired, while events about different objects
+ * still run in parallel. Events without a key are handed to the threadpool as independent jobs, like before.
+ */
+#define SCCP_EVENT_LANES 32							/* power of two */
+#define SCCP_EVENT_LANE_BATCH 32						/* events processed per job before the lane yields its thread */
+
+struct sccp_event_lane {
+	pbx_mutex_t lock;
+	AsyncArgs_t *head;
+	AsyncArgs_t *tail;
+	boolean_t scheduled;								/*!< a threadpool job owns this lane */
+	uint32_t depth;
+	uint32_t highwater;
+	uint64_t processed;
+} __attribute__ ((aligned (64)));
+
+static sccp_event_lane_t event_lanes[SCCP_EVENT_LANES];
+
+/*!
+ * \brief Return the object which orders this event, or NULL when the event can be delivered in any order
+ */
+static const void *__event_lane_key(const sccp_event_t * event)
+{
+	switch (event->type) {
+		case SCCP_EVENT_DEVICE_REGISTERED:
+		case SCCP_EVENT_DEVICE_UNREGISTERED:
+		case SCCP_EVENT_DEVICE_PREREGISTERED:
+			return event->event.deviceRegistered.device;
+		case SCCP_EVENT_FEATURE_CHANGED:
+			return event->event.featureChanged.device;
+		case SCCP_EVENT_DEVICE_ATTACHED:
+		case SCCP_EVENT_DEVICE_DETACHED:
+			return event->event.deviceAttached.linedevice ? event->event.deviceAttached.linedevice->device : NULL;
+		case SCCP_EVENT_LINE_CREATED:
+			return event->event.lineCreated.line;
+		case SCCP_EVENT_LINESTATUS_CHANGED:
+			return event->event.lineStatusChanged.line;
+#if CS_TEST_FRAMEWORK
+		case SCCP_EVENT_TEST:
+			return event->event.TestEvent.key;
+#endif
+		default:
+			return NULL;
 	}
+}
+
+static gcc_inline sccp_event_lane_t *__event_lane_get(const void *key)
+{
+	uintptr_t hash = (uintptr_t) key >> 4;
+	hash ^= hash >> 15;
+	return &event_lanes[(hash * 2654435761u) & (SCCP_EVENT_LANES - 1)];
+}
+
+/*!
+ * \brief drain a lane in fifo order, runs within threadpool
+ */
+static void *sccp_event_lane_processor(void *data)
+{
+	sccp_event_lane_t *lane = data;
+	AsyncArgs_t *arg = NULL;
+	uint processed = 0;
+
+	do {
+		pbx_mutex_lock(&lane->lock);
+		if (processed == SCCP_EVENT_LANE_BATCH && lane->head) {
+			/* give other lanes a chance, the lane stays scheduled while it waits in the threadpool */
+			pbx_mutex_unlock(&lane->lock);
+			if (sccp_threadpool_add_work(GLOB(general_threadpool), sccp_event_lane_processor, lane)) {
+				return NULL;
+			}
+			processed = 0;
+			pbx_mutex_lock(&lane->lock);
+		}
+		if ((arg = lane->head)) {
+			lane->head = arg->next;
+			if (!lane->head) {
+				lane->tail = NULL;
+			}
+			lane->depth--;
+			lane->processed++;
+		} else {
+			lane->scheduled = FALSE;
+		}
+		pbx_mutex_unlock(&lane->lock);
+
+		if (arg) {
+			sccp_event_processor(arg);
+			processed++;
+		}
+	} while (arg);
 	return NULL;
 }
 
+/*!
+ * \brief queue an async event on the lane belonging to key
+ * \return FALSE when the lane could not be scheduled, arg has not been queued in that case
+ */
+static boolean_t __event_lane_push(const void *key, AsyncArgs_t * arg)
+{
+	sccp_event_lane_t *lane = __event_lane_get(key);
+
+	arg->next = NULL;
+	pbx_mutex_lock(&lane->lock);
+	if (!lane->scheduled) {
+		if (!sccp_threadpool_add_work(GLOB(general_threadpool), sccp_event_lane_processor, lane)) {
+			pbx_mutex_unlock(&lane->lock);
+			return FALSE;
+		}
+		lane->scheduled = TRUE;
+	}
+	if (lane->tail) {
+		lane->tail->next = arg;
+	} else {
+		lane->head = arg;
+	}
+	lane->tail = arg;
+	if (++lane->depth > lane->highwater) {
+		lane->highwater = lane->depth;
+	}
+	pbx_mutex_unlock(&lane->lock);
+	return TRUE;
+}
+
+/*!
+ * \brief wait for the running lane job to finish and discard what is still queued (module stop)
+ * \note sccp_event_running is already FALSE, so the lane job only releases the events it still finds
+ * \note the general threadpool is destroyed after the event system, so a scheduled lane job will always get to run; we have
+ *       to wait for it, destroying the lock (or the subscriptions / envelope pool afterwards) underneath it is not an option
+ */
+static void __event_lane_drain(sccp_event_lane_t * lane)
+{
+	AsyncArgs_t *arg = NULL;
+	int loopcount = 0;
+
+	pbx_mutex_lock(&lane->lock);
+	while (lane->scheduled) {
+		if (++loopcount % 100 == 0) {
+			pbx_log(LOG_WARNING, "SCCP: (event_lane_drain) still waiting for event lane %p to finish after %d ms (depth:%u)\n", lane, loopcount * 10, lane->depth);
+		}
+		pbx_mutex_unlock(&lane->lock);
+		sccp_safe_sleep(10);
+		pbx_mutex_lock(&lane->lock);
+	}
+	arg = lane->head;
+	lane->head = lane->tail = NULL;
+	lane->depth = 0;
+	pbx_mutex_unlock(&lane->lock);
+
+	while (arg) {
+		AsyncArgs_t *next = arg->next;
+		sccp_event_processor(arg);
+		arg = next;
+	}
+	pbx_mutex_destroy(&lane->lock);
+}
+
 /*!
  * \brief Fire an Event
  * \param event SCCP Event
@@ -289,55 +653,40 @@ boolean_t sccp_event_fire(sccp_event_t * event)
 {
 	boolean_t res = FALSE;
 	if (event) {
-		sccp_event_vector_t *sync_subscribers_cpy = NULL, *async_subscribers_cpy = NULL;
-		size_t subsize = 0, syncsize = 0, asyncsize = 0;
 		uint8_t _idx = __search_for_position_in_event_array(event->type);
-		
-		/* copy both vectors to a local copy while holding the rwlock */
-		sccp_event_vector_t *subscribers = &event_subscriptions[_idx].subscribers;
-		SCCP_VECTOR_RW_RDLOCK(subscribers);
-		if ((subsize = SCCP_VECTOR_SIZE(subscribers))) {
-			sync_subscribers_cpy = SCCP_VECTOR_CALLBACK_MULTIPLE(subscribers, SUBSCRIBER_EXEC_CMP, SCCP_EVENT_SYNC);
-			async_subscribers_cpy = SCCP_VECTOR_CALLBACK_MULTIPLE(subscribers, SUBSCRIBER_EXEC_CMP, SCCP_EVENT_ASYNC);
-			syncsize = sync_subscribers_cpy ? SCCP_VECTOR_SIZE(sync_subscribers_cpy) : 0;
-			asyncsize = async_subscribers_cpy ? SCCP_VECTOR_SIZE(async_subscribers_cpy) : 0;
-		}
-		SCCP_VECTOR_RW_UNLOCK(subscribers);
+		sccp_event_snapshot_t *snapshot = NULL;
 
-		// handle synchronous events first (if any)
-		if (sync_subscribers_cpy) {
-			if (syncsize) {
-				res |= __execute_callback_helper(event, sync_subscribers_cpy);
-			} else {
-				SCCP_VECTOR_PTR_FREE(sync_subscribers_cpy);
+		/* take a reference on the published subscribers, no locking or copying required */
+		if (_idx < NUMBER_OF_EVENT_TYPES && (snapshot = __event_snapshot_acquire(&event_subscriptions[_idx]))) {
+			// handle synchronous events first (if any)
+			if (snapshot->num_sync) {
+				res |= __execute_callback_helper(event, snapshot->sync, snapshot->num_sync);
 			}
-		}
 
-		// handle the others asynchonously via threadpool (if any)
-		do {
-			if (async_subscribers_cpy) {
-				if (asyncsize) {
-					AsyncArgs_t *arg = NULL;
-					if (GLOB(general_threadpool) && sccp_event_running && (arg = sccp_malloc(sizeof *arg))) {
-						arg->idx = _idx;
-						memcpy(&arg->event, event, sizeof(sccp_event_t));
-						arg->async_subscribers = async_subscribers_cpy;
-						if (sccp_threadpool_add_work(GLOB(general_threadpool), (void *) sccp_event_processor, (void *) arg)) {
-							//sccp_log((DEBUGCAT_EVENT)) (VERBOSE_PREFIX_3 "Work added to threadpool for event: %p, type: %s\n", event, sccp_event_type2str(event->type));
-							event = NULL;					// set to NULL, thread will clean event up later.
-							res |= true;
-							break;						// break out of do/while loop, no further processing needed
-						} else {
-							pbx_log(LOG_ERROR, "Could not add work to threadpool for event: %s\n", sccp_event_type2str(event->type));
-							sccp_free(arg);					// explicit failure release
-						}
+			// handle the others asynchonously via threadpool (if any)
+			if (snapshot->num_async) {
+				AsyncArgs_t *arg = NULL;
+				if (GLOB(general_threadpool) && sccp_event_running && (arg = __event_envelope_get())) {
+					arg->idx = _idx;
+					memcpy(&arg->event, event, sizeof(sccp_event_t));
+					arg->snapshot = snapshot;
+					const void *key = __event_lane_key(event);
+					if (key ? __event_lane_push(key, arg) : sccp_threadpool_add_work(GLOB(general_threadpool), (void *) sccp_event_processor, (void *) arg)) {
+						//sccp_log((DEBUGCAT_EVENT)) (VERBOSE_PREFIX_3 "Work added to threadpool for event: %p, type: %s\n", event, sccp_event_type2str(event->type));
+						event = NULL;						// set to NULL, thread will clean event up later.
+						snapshot = NULL;					// reference handed over to the async processor
+						res |= TRUE;
+					} else {
+						pbx_log(LOG_ERROR, "Could not add work to threadpool for event: %s\n", sccp_event_type2str(event->type));
+						__event_envelope_put(arg);				// explicit failure release
 					}
-					res |= __execute_callback_helper(event, async_subscribers_cpy);	// fallback to handling synchronously in case something prevented async
-				} else {
-					SCCP_VECTOR_PTR_FREE(async_subscribers_cpy);
+				}
+				if (event) {
+					res |= __execute_callback_helper(event, snapshot->async, snapshot->num_async);	// fallback to handling synchronously in case something prevented async
 				}
 			}
-		} while (0);
+			__event_snapshot_release(snapshot);
+		}
 
 		/* cleanup */
 		if (event) {
@@ -348,7 +697,6 @@ boolean_t sccp_event_fire(sccp_event_t * event)
 }
 
 #if CS_TEST_FRAMEWORK
-#include "sccp_utils.h"
 static uint32_t _sccp_event_TestValue = 25;
 static char *_sccp_event_TestStr = "^YTHnjMK<MJHBgF";
 static uint32_t _sccp_event_TestEventReceived = 0;
@@ -502,11 +850,254 @@ cleanup:
 	return rc;
 }
 
+#define LANE_TEST_KEYS 8
+#define LANE_TEST_EVENTS 2000
+#define LANE_TEST_UNORDERED 0x80000000
+AST_MUTEX_DEFINE_STATIC(lane_test_lock);
+static char _sccp_event_laneTestKeys[LANE_TEST_KEYS];
+static uint32_t _sccp_event_laneTestExpected[LANE_TEST_KEYS];
+static volatile int _sccp_event_laneTestReceived = 0;
+static volatile int _sccp_event_laneTestOutOfOrder = 0;
+static volatile int _sccp_event_laneTestConcurrent = 0;
+static volatile int _sccp_event_laneTestActive[LANE_TEST_KEYS];
+
+static void sccp_event_laneTestListener(const sccp_event_t * event)
+{
+	uint32_t keyidx = (event->event.TestEvent.value & ~LANE_TEST_UNORDERED) >> 16;
+	uint32_t seq = event->event.TestEvent.value & 0xffff;
+
+	if (keyidx >= LANE_TEST_KEYS) {
+		return;
+	}
+	if (!(event->event.TestEvent.value & LANE_TEST_UNORDERED)) {
+		if (ATOMIC_INCR(&_sccp_event_laneTestActive[keyidx], 1, &lane_test_lock) != 0) {
+			ATOMIC_INCR(&_sccp_event_laneTestConcurrent, 1, &lane_test_lock);
+		}
+		if (_sccp_event_laneTestExpected[keyidx] != seq) {
+			ATOMIC_INCR(&_sccp_event_laneTestOutOfOrder, 1, &lane_test_lock);
+		}
+		_sccp_event_laneTestExpected[keyidx] = seq + 1;
+		ATOMIC_DECR(&_sccp_event_laneTestActive[keyidx], 1, &lane_test_lock);
+	}
+	ATOMIC_INCR(&_sccp_event_laneTestReceived, 1, &lane_test_lock);
+}
+
+/* fire LANE_TEST_EVENTS events round robin over all keys and return the time it took until all of them were delivered */
+static int64_t sccp_event_laneTestRun(boolean_t keyed)
+{
+	struct timeval start = pbx_tvnow();
+	uint32_t n = 0;
+	int loopcount = 0;
+
+	memset(_sccp_event_laneTestExpected, 0, sizeof(_sccp_event_laneTestExpected));
+	_sccp_event_laneTestReceived = 0;
+	for (n = 0; n < LANE_TEST_EVENTS; n++) {
+		uint32_t keyidx = n % LANE_TEST_KEYS;
+		sccp_event_t event = {{{0}}};
+		event.type = SCCP_EVENT_TEST;
+		event.event.TestEvent.value = (keyidx << 16) | (n / LANE_TEST_KEYS) | (keyed ? 0 : LANE_TEST_UNORDERED);
+		event.event.TestEvent.key = keyed ? &_sccp_event_laneTestKeys[keyidx] : NULL;
+		sccp_event_fire(&event);
+	}
+	while (ATOMIC_FETCH(&_sccp_event_laneTestReceived, &lane_test_lock) < LANE_TEST_EVENTS && 500 > loopcount++) {
+		sccp_safe_sleep(10);
+	}
+	return ast_tvdiff_ms(pbx_tvnow(), start);
+}
+
+AST_TEST_DEFINE(sccp_event_test_lanes)
+{
+	int rc = AST_TEST_PASS;
+	int64_t keyed_ms = 0, unkeyed_ms = 0;
+	switch(cmd) {
+		case TEST_INIT:
+			info->name = "lanes";
+			info->category = "/channels/chan_sccp/event/";
+			info->summary = "chan-sccp-b event ordered lanes";
+			info->description = "chan-sccp-b fire interleaved async events for multiple keys and verify per key ordering and throughput";
+			return AST_TEST_NOT_RUN;
+		case TEST_EXECUTE:
+			break;
+	}
+	pbx_test_validate(test, GLOB(general_threadpool) != NULL);
+	pbx_test_status_update(test, "subscribe to SCCP_EVENT_TEST asynchronously\n");
+	pbx_test_validate(test, sccp_event_subscribe(SCCP_EVENT_TEST, sccp_event_laneTestListener, TRUE));
+
+	_sccp_event_laneTestOutOfOrder = 0;
+	_sccp_event_laneTestConcurrent = 0;
+
+	unkeyed_ms = sccp_event_laneTestRun(FALSE);
+	pbx_test_status_update(test, "unkeyed: %d events delivered in %ld ms\n", _sccp_event_laneTestReceived, (long) unkeyed_ms);
+	pbx_test_validate_cleanup(test, _sccp_event_laneTestReceived == LANE_TEST_EVENTS, rc, cleanup);
+
+	keyed_ms = sccp_event_laneTestRun(TRUE);
+	pbx_test_status_update(test, "keyed: %d events over %d keys delivered in %ld ms, out of order:%d, concurrent:%d\n", _sccp_event_laneTestReceived, LANE_TEST_KEYS, (long) keyed_ms, _sccp_event_laneTestOutOfOrder, _sccp_event_laneTestConcurrent);
+	pbx_test_validate_cleanup(test, _sccp_event_laneTestReceived == LANE_TEST_EVENTS, rc, cleanup);
+	pbx_test_validate_cleanup(test, _sccp_event_laneTestOutOfOrder == 0, rc, cleanup);
+	pbx_test_validate_cleanup(test, _sccp_event_laneTestConcurrent == 0, rc, cleanup);
+
+cleanup:
+	pbx_test_status_update(test, "unsubscribe from SCCP_EVENT_TEST\n");
+	pbx_test_validate(test, sccp_event_unsubscribe(SCCP_EVENT_TEST, sccp_event_laneTestListener));
+	return rc;
+}
+
+#define FIRE_BENCHMARK_EVENTS 100000
+static volatile int _sccp_event_benchmarkReceived = 0;
+AST_MUTEX_DEFINE_STATIC(benchmark_test_lock);
+
+static void sccp_event_benchmarkListener(const sccp_event_t * event)
+{
+	ATOMIC_INCR(&_sccp_event_benchmarkReceived, 1, &benchmark_test_lock);
+}
+
+/* sum of the envelope pool counters over all shards */
+static void sccp_event_benchmarkPoolStats(int *hits, int *misses)
+{
+	int shard;
+
+	*hits = *misses = 0;
+	for (shard = 0; shard < SCCP_EVENT_POOL_SHARDS; shard++) {
+		pbx_mutex_lock(&event_envelope_pool[shard].lock);
+		*hits += event_envelope_pool[shard].hits;
+		*misses += event_envelope_pool[shard].misses;
+		pbx_mutex_unlock(&event_envelope_pool[shard].lock);
+	}
+}
+
+/* free envelopes in the calling thread's shard */
+static int sccp_event_benchmarkPoolFree(void)
+{
+	struct sccp_event_envelope_pool_shard *pool = __event_envelope_pool_shard();
+	int numfree = 0;
+
+	pbx_mutex_lock(&pool->lock);
+	numfree = pool->numfree;
+	pbx_mutex_unlock(&pool->lock);
+	return numfree;
+}
+
+/* what sccp_event_fire used to do to find its subscribers: copy both filtered vectors under the rwlock */
+#define SUBSCRIBER_EXEC_CMP(elem, value) ((elem).execution == (value))
+static void sccp_event_benchmarkVectorCopy(sccp_event_vector_t * subscribers)
+{
+	sccp_event_vector_t *sync_subscribers_cpy = NULL, *async_subscribers_cpy = NULL;
+
+	SCCP_VECTOR_RW_RDLOCK(subscribers);
+	if (SCCP_VECTOR_SIZE(subscribers)) {
+		sync_subscribers_cpy = SCCP_VECTOR_CALLBACK_MULTIPLE(subscribers, SUBSCRIBER_EXEC_CMP, SCCP_EVENT_SYNC);
+		async_subscribers_cpy = SCCP_VECTOR_CALLBACK_MULTIPLE(subscribers, SUBSCRIBER_EXEC_CMP, SCCP_EVENT_ASYNC);
+	}
+	SCCP_VECTOR_RW_UNLOCK(subscribers);
+	if (sync_subscribers_cpy) {
+		SCCP_VECTOR_PTR_FREE(sync_subscribers_cpy);
+	}
+	if (async_subscribers_cpy) {
+		SCCP_VECTOR_PTR_FREE(async_subscribers_cpy);
+	}
+}
+
+AST_TEST_DEFINE(sccp_event_test_fire_benchmark)
+{
+	int rc = AST_TEST_PASS;
+	struct timeval start;
+	int64_t copy_ms = 0, snapshot_ms = 0, sync_ms = 0, async_ms = 0;
+	uint8_t _idx = 0;
+	int n = 0, burst = 0, loopcount = 0;
+	int hits = 0, misses = 0, warm_hits = 0, warm_misses = 0;
+	sccp_event_t event = {{{0}}};
+
+	switch(cmd) {
+		case TEST_INIT:
+			info->name = "fire_benchmark";
+			info->category = "/channels/chan_sccp/event/";
+			info->summary = "chan-sccp-b event fire rate";
+			info->description = "chan-sccp-b compare subscriber lookup via vector copies and via snapshots, and measure the sync and async fire rate";
+			return AST_TEST_NOT_RUN;
+		case TEST_EXECUTE:
+			break;
+	}
+	pbx_test_status_update(test, "subscribe to SCCP_EVENT_TEST synchronously and asynchronously\n");
+	pbx_test_validate(test, sccp_event_subscribe(SCCP_EVENT_TEST, sccp_event_benchmarkListener, FALSE));
+	pbx_test_validate_cleanup(test, sccp_event_subscribe(SCCP_EVENT_TEST, sccp_event_testListener, TRUE), rc, cleanup_sync);
+	_idx = __search_for_position_in_event_array(SCCP_EVENT_TEST);
+
+	start = pbx_tvnow();
+	for (n = 0; n < FIRE_BENCHMARK_EVENTS; n++) {
+		sccp_event_benchmarkVectorCopy(&event_subscriptions[_idx].subscribers);
+	}
+	copy_ms = ast_tvdiff_ms(pbx_tvnow(), start);
+
+	start = pbx_tvnow();
+	for (n = 0; n < FIRE_BENCHMARK_EVENTS; n++) {
+		__event_snapshot_release(__event_snapshot_acquire(&event_subscriptions[_idx]));
+	}
+	snapshot_ms = ast_tvdiff_ms(pbx_tvnow(), start);
+	pbx_test_status_update(test, "subscriber lookup x %d: vector copies %ld ms, snapshot %ld ms\n", FIRE_BENCHMARK_EVENTS, (long) copy_ms, (long) snapshot_ms);
+	pbx_test_validate_cleanup(test, sccp_event_unsubscribe(SCCP_EVENT_TEST, sccp_event_testListener), rc, cleanup_sync);
+
+	/* sync only: the complete fire path runs on this thread */
+	_sccp_event_benchmarkReceived = 0;
+	event.type = SCCP_EVENT_TEST;
+	start = pbx_tvnow();
+	for (n = 0; n < FIRE_BENCHMARK_EVENTS; n++) {
+		sccp_event_fire(&event);
+	}
+	sync_ms = ast_tvdiff_ms(pbx_tvnow(), start);
+	pbx_test_status_update(test, "sync fire x %d: %ld ms (%ld events/s)\n", FIRE_BENCHMARK_EVENTS, (long) sync_ms, (long) (FIRE_BENCHMARK_EVENTS * 1000LL / (sync_ms ? sync_ms : 1)));
+	pbx_test_validate_cleanup(test, _sccp_event_benchmarkReceived == FIRE_BENCHMARK_EVENTS, rc, cleanup_sync);
+	pbx_test_validate(test, sccp_event_unsubscribe(SCCP_EVENT_TEST, sccp_event_benchmarkListener));
+
+	/* async: envelopes are taken from the pool and handed to the threadpool */
+	pbx_test_validate(test, sccp_event_subscribe(SCCP_EVENT_TEST, sccp_event_benchmarkListener, TRUE));
+	_sccp_event_benchmarkReceived = 0;
+	start = pbx_tvnow();
+	for (n = 0; n < FIRE_BENCHMARK_EVENTS; n++) {
+		sccp_event_fire(&event);
+	}
+	while (ATOMIC_FETCH(&_sccp_event_benchmarkReceived, &benchmark_test_lock) < FIRE_BENCHMARK_EVENTS && 1000 > loopcount++) {
+		sccp_safe_sleep(10);
+	}
+	async_ms = ast_tvdiff_ms(pbx_tvnow(), start);
+	pbx_test_status_update(test, "async fire and deliver x %d: %ld ms (%ld events/s)\n", FIRE_BENCHMARK_EVENTS, (long) async_ms, (long) (FIRE_BENCHMARK_EVENTS * 1000LL / (async_ms ? async_ms : 1)));
+	pbx_test_validate_cleanup(test, _sccp_event_benchmarkReceived == FIRE_BENCHMARK_EVENTS, rc, cleanup_sync);
+
+	/* warmed up: as long as no more than a shard's worth of envelopes is in flight, the fire path must not allocate */
+	pbx_test_status_update(test, "async fire in bursts of %d after warm-up, envelopes have to come from the pool\n", SCCP_EVENT_POOL_SHARD_SIZE);
+	_sccp_event_benchmarkReceived = 0;
+	for (burst = -1; burst < 100; burst++) {
+		if (burst == 0) {									/* the first burst fills this thread's shard */
+			sccp_event_benchmarkPoolStats(&warm_hits, &warm_misses);
+			_sccp_event_benchmarkReceived = 0;
+		}
+		for (n = 0; n < SCCP_EVENT_POOL_SHARD_SIZE; n++) {
+			sccp_event_fire(&event);
+		}
+		loopcount = 0;
+		/* the listener runs before the envelope is released, wait for the envelopes to be back as well */
+		while ((ATOMIC_FETCH(&_sccp_event_benchmarkReceived, &benchmark_test_lock) < (burst < 0 ? 1 : burst + 1) * SCCP_EVENT_POOL_SHARD_SIZE || sccp_event_benchmarkPoolFree() < SCCP_EVENT_POOL_SHARD_SIZE) && 1000 > loopcount++) {
+			sccp_safe_sleep(1);
+		}
+	}
+	sccp_event_benchmarkPoolStats(&hits, &misses);
+	pbx_test_status_update(test, "envelope pool after %d bursts: %d hits, %d misses\n", burst, hits - warm_hits, misses - warm_misses);
+	pbx_test_validate_cleanup(test, _sccp_event_benchmarkReceived == burst * SCCP_EVENT_POOL_SHARD_SIZE, rc, cleanup_sync);
+	pbx_test_validate_cleanup(test, misses == warm_misses, rc, cleanup_sync);
+	pbx_test_validate_cleanup(test, hits - warm_hits == burst * SCCP_EVENT_POOL_SHARD_SIZE, rc, cleanup_sync);
+
+cleanup_sync:
+	pbx_test_status_update(test, "unsubscribe from SCCP_EVENT_TEST\n");
+	pbx_test_validate(test, sccp_event_unsubscribe(SCCP_EVENT_TEST, sccp_event_benchmarkListener));
+	return rc;
+}
+
 static void __attribute__((constructor)) sccp_register_tests(void)
 {
 	AST_TEST_REGISTER(sccp_event_test_subscribe_single);
 	AST_TEST_REGISTER(sccp_event_test_subscribe_multi);
 	AST_TEST_REGISTER(sccp_event_test_subscribe_multi_sync);
+	AST_TEST_REGISTER(sccp_event_test_lanes);
+	AST_TEST_REGISTER(sccp_event_test_fire_benchmark);
 }
 
 static void __attribute__((destructor)) sccp_unregister_tests(void)
@@ -514,6 +1105,8 @@ static void __attribute__((destructor)) sccp_unregister_tests(void)
 	AST_TEST_UNREGISTER(sccp_event_test_subscribe_single);
 	AST_TEST_UNREGISTER(sccp_event_test_subscribe_multi);
 	AST_TEST_UNREGISTER(sccp_event_test_subscribe_multi_sync);
+	AST_TEST_UNREGISTER(sccp_event_test_lanes);
+	AST_TEST_UNREGISTER(sccp_event_test_fire_benchmark);
 }
 #endif
 
@@ -37,6 +37,7 @@ typedef struct sccp_event {
 		struct {
 			uint32_t value;
 			char *str;
+			const void *key;									/*!< lane key (optional) */
 		} TestEvent;											/*!< Event feature changed Structure */
 #endif
 	} event;												/*!< SCCP Event Data Union */
@@ -0,0 +1,589 @@
+/*!
+ * \file        sccp_featurestore.c
+ * \brief       SCCP Feature Store Class
+ * \note        This program is free software and may be modified and distributed under the terms of the GNU Public License.
+ *              See the LICENSE file at the top of the source tree.
+ *
+ * The "SCCP" astdb family is read once (bulk) when the module is loaded or reloaded. From then on reads are answered from
+ * memory and writes only update memory and queue the key. A queued key is written by the next flush, which runs
+ * SCCP_FEATURESTORE_FLUSH_DELAY ms after the first change on the general threadpool, so repeated changes of the same key in
+ * between (cfwd on/off, dnd toggling) end up as a single database write. Keys outside of the "SCCP" family, and all keys
+ * while the store is not loaded, are passed straight through to the database.
+ */
+
+#include "config.h"
+#include "common.h"
+#include "sccp_featurestore.h"
+#include "sccp_threadpool.h"
+#include "sccp_utils.h"
+
+SCCP_FILE_VERSION(__FILE__, "");
+
+#include <asterisk/cli.h>
+
+#define SCCP_FEATURESTORE_FAMILY "SCCP"
+#define SCCP_FEATURESTORE_FLUSH_DELAY 250									/* ms */
+#define SCCP_FEATURESTORE_PATH_LEN 256
+
+typedef struct sccp_featurestore_entry sccp_featurestore_entry_t;
+
+struct sccp_featurestore_entry {
+	sccp_featurestore_entry_t *next;									/*!< all entries, to free them */
+	sccp_featurestore_entry_t *next_pending;
+	char *value;												/*!< current value, NULL when the key is not set */
+	boolean_t pending;											/*!< value has not been written yet */
+	boolean_t inDatabase;											/*!< key exists in the database (as far as we know) */
+	struct timeval queued;											/*!< time of the first unwritten change */
+	size_t familylen;											/*!< path[familylen] is the '/' between family and key */
+	char path[];												/*!< family/key, hash key */
+};
+
+typedef struct sccp_featurestore_op {
+	char *path;
+	size_t familylen;
+	char *value;												/*!< NULL -> remove */
+} sccp_featurestore_op_t;
+
+static struct {
+	sccp_hashtable_t *table;
+	sccp_featurestore_entry_t *entries;
+	sccp_featurestore_entry_t *pending;
+	int sched_id;
+	sccp_featurestore_stats_t stats;
+} featurestore = {
+	.sched_id = -1,
+};
+
+AST_MUTEX_DEFINE_STATIC(featurestore_lock);									/*!< protects featurestore */
+AST_MUTEX_DEFINE_STATIC(featurestore_flush_lock);								/*!< keeps flushes in order, taken before featurestore_lock */
+
+static int sccp_featurestore_flush_cb(const void *data);
+
+/*!
+ * \brief Is this family kept in memory
+ * \note needs featurestore_lock
+ */
+static boolean_t sccp_featurestore_covers(const char *family)
+{
+	return featurestore.stats.loaded && (!strcmp(family, SCCP_FEATURESTORE_FAMILY) || !strncmp(family, SCCP_FEATURESTORE_FAMILY "/", sizeof(SCCP_FEATURESTORE_FAMILY)));
+}
+
+/*!
+ * \brief Find (or create) the entry of family/key
+ * \note needs featurestore_lock
+ */
+static sccp_featurestore_entry_t *sccp_featurestore_lookup(const char *family, const char *key, boolean_t create)
+{
+	sccp_featurestore_entry_t *entry = NULL;
+	char path[SCCP_FEATURESTORE_PATH_LEN];
+	int len = snprintf(path, sizeof(path), "%s/%s", family, key);
+
+	if (len < 0 || (size_t) len >= sizeof(path) || !featurestore.table) {
+		return NULL;
+	}
+	if ((entry = sccp_hashtable_find(featurestore.table, path)) || !create) {
+		return entry;
+	}
+	if (!(entry = sccp_calloc(1, sizeof(*entry) + len + 1))) {
+		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+		return NULL;
+	}
+	memcpy(entry->path, path, len + 1);
+	entry->familylen = strlen(family);
+	if (!sccp_hashtable_insert(featurestore.table, entry->path, entry)) {
+		sccp_free(entry);
+		return NULL;
+	}
+	entry->next = featurestore.entries;
+	featurestore.entries = entry;
+	return entry;
+}
+
+/*!
+ * \brief Queue the entry for the next flush, changes of a key that is already queued are coalesced
+ * \note needs featurestore_lock
+ */
+static void sccp_featurestore_queue(sccp_featurestore_entry_t * entry)
+{
+	featurestore.stats.changes++;
+	if (entry->pending) {
+		featurestore.stats.coalesced++;
+		return;
+	}
+	entry->pending = TRUE;
+	entry->queued = pbx_tvnow();
+	entry->next_pending = featurestore.pending;
+	featurestore.pending = entry;
+	featurestore.stats.pending++;
+
+	if (featurestore.sched_id < 0 && (featurestore.sched_id = iPbx.sched_add(SCCP_FEATURESTORE_FLUSH_DELAY, sccp_featurestore_flush_cb, NULL)) < 0) {
+		pbx_log(LOG_WARNING, "SCCP: (sccp_featurestore_queue) Unable to schedule a feature store flush, retrying on the next change\n");
+	}
+}
+
+/*!
+ * \brief Take all pending entries as a list of database operations
+ * \note needs featurestore_lock
+ */
+static sccp_featurestore_op_t *sccp_featurestore_takePending(uint *count, struct timeval *oldest)
+{
+	sccp_featurestore_op_t *ops = NULL;
+	sccp_featurestore_entry_t *entry = NULL;
+	uint n = 0;
+
+	*count = 0;
+	if (!featurestore.pending) {
+		return NULL;
+	}
+	if (!(ops = sccp_calloc(featurestore.stats.pending, sizeof(*ops)))) {
+		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+		return NULL;
+	}
+	*oldest = pbx_tvnow();
+	while ((entry = featurestore.pending) && n < featurestore.stats.pending) {
+		featurestore.pending = entry->next_pending;
+		entry->next_pending = NULL;
+		entry->pending = FALSE;
+		if (ast_tvdiff_ms(*oldest, entry->queued) > 0) {
+			*oldest = entry->queued;
+		}
+		if (!entry->value && !entry->inDatabase) {
+			continue;										/* set and removed again before it was ever written */
+		}
+		if (!(ops[n].path = pbx_strdup(entry->path)) || (entry->value && !(ops[n].value = pbx_strdup(entry->value)))) {
+			/* keep it for the next flush */
+			if (ops[n].path) {
+				sccp_free(ops[n].path);
+			}
+			entry->pending = TRUE;
+			entry->next_pending = featurestore.pending;
+			featurestore.pending = entry;
+			break;
+		}
+		ops[n].familylen = entry->familylen;
+		entry->inDatabase = entry->value ? TRUE : FALSE;
+		n++;
+	}
+	featurestore.stats.pending = 0;
+	for (entry = featurestore.pending; entry; entry = entry->next_pending) {
+		featurestore.stats.pending++;
+	}
+	*count = n;
+	return ops;
+}
+
+/*!
+ * \brief Write a list of database operations and free it
+ */
+static void sccp_featurestore_write(sccp_featurestore_op_t * ops, uint count)
+{
+	uint i;
+
+	for (i = 0; i < count; i++) {
+		ops[i].path[ops[i].familylen] = '\0';
+		if (ops[i].value) {
+			iPbx.feature_addToDatabase(ops[i].path, ops[i].path + ops[i].familylen + 1, ops[i].value);
+			sccp_free(ops[i].value);
+		} else {
+			iPbx.feature_removeFromDatabase(ops[i].path, ops[i].path + ops[i].familylen + 1);
+		}
+		sccp_free(ops[i].path);
+	}
+	if (ops) {
+		sccp_free(ops);
+	}
+}
+
+/*!
+ * \note needs featurestore_lock
+ */
+static void sccp_featurestore_updateFlushStats(uint count, struct timeval started, struct timeval oldest)
+{
+	int64_t latency = ast_tvdiff_ms(pbx_tvnow(), oldest);
+
+	if (!count) {
+		return;
+	}
+	featurestore.stats.writes += count;
+	featurestore.stats.flushes++;
+	featurestore.stats.last_flush_ms = ast_tvdiff_ms(pbx_tvnow(), started);
+	featurestore.stats.last_latency_ms = latency;
+	if (latency > featurestore.stats.max_latency_ms) {
+		featurestore.stats.max_latency_ms = latency;
+	}
+}
+
+/*!
+ * \brief Drop all entries (pending ones have to be taken before)
+ * \note needs featurestore_lock
+ */
+static void sccp_featurestore_clear(void)
+{
+	sccp_featurestore_entry_t *entry = NULL;
+
+	sccp_hashtable_destroy(&featurestore.table);
+	while ((entry = featurestore.entries)) {
+		featurestore.entries = entry->next;
+		if (entry->value) {
+			sccp_free(entry->value);
+		}
+		sccp_free(entry);
+	}
+	featurestore.table = sccp_hashtable_create(0, sccp_hash_string, sccp_hash_match_string);
+	featurestore.pending = NULL;
+	featurestore.stats.keys = 0;
+	featurestore.stats.pending = 0;
+}
+
+/*!
+ * \brief Bulk load callback, key is the full database key: /SCCP/<subfamily>/<key>
+ * \note called with featurestore_lock held
+ */
+static void sccp_featurestore_load_cb(const char *dbkey, const char *value, void *data)
+{
+	sccp_featurestore_entry_t *entry = NULL;
+	char *family = NULL;
+	char *key = NULL;
+
+	if (sccp_strlen_zero(dbkey) || !value) {
+		return;
+	}
+	family = pbx_strdupa(dbkey[0] == '/' ? dbkey + 1 : dbkey);
+	if (!(key = strrchr(family, '/'))) {
+		return;
+	}
+	*key++ = '\0';
+	if ((entry = sccp_featurestore_lookup(family, key, TRUE)) && !entry->value && (entry->value = pbx_strdup(value))) {
+		entry->inDatabase = TRUE;
+		featurestore.stats.keys++;
+	}
+}
+
+/*!
+ * \brief (Re)load the "SCCP" family from the database into memory
+ *
+ * Pending changes are written first, so a reload sees everything that was set through the store, plus whatever has been
+ * changed in the database directly in the mean time.
+ */
+void sccp_featurestore_load(void)
+{
+	sccp_featurestore_op_t *ops = NULL;
+	uint count = 0;
+	struct timeval oldest = { 0 };
+	struct timeval started = pbx_tvnow();
+
+	pbx_mutex_lock(&featurestore_flush_lock);
+	pbx_mutex_lock(&featurestore_lock);
+	ops = sccp_featurestore_takePending(&count, &oldest);
+	sccp_featurestore_write(ops, count);
+	sccp_featurestore_updateFlushStats(count, started, oldest);
+
+	started = pbx_tvnow();
+	sccp_featurestore_clear();
+	featurestore.stats.loaded = FALSE;
+	if (featurestore.table && iPbx.feature_getTreeFromDatabase) {
+		featurestore.stats.loaded = iPbx.feature_getTreeFromDatabase(SCCP_FEATURESTORE_FAMILY, sccp_featurestore_load_cb, NULL);
+	}
+	if (!featurestore.stats.loaded) {
+		sccp_featurestore_clear();
+		pbx_log(LOG_NOTICE, "SCCP: Feature store could not be loaded, reading and writing the database directly\n");
+	}
+	featurestore.stats.load_ms = ast_tvdiff_ms(pbx_tvnow(), started);
+	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_2 "SCCP: Feature store loaded %u keys in %" PRId64 " ms\n", featurestore.stats.keys, featurestore.stats.load_ms);
+	pbx_mutex_unlock(&featurestore_lock);
+	pbx_mutex_unlock(&featurestore_flush_lock);
+}
+
+/*!
+ * \brief Write all pending changes and go back to reading and writing the database directly
+ */
+void sccp_featurestore_unload(void)
+{
+	sccp_featurestore_op_t *ops = NULL;
+	uint count = 0;
+	int sched_id = -1;
+	struct timeval oldest = { 0 };
+	struct timeval started = pbx_tvnow();
+
+	pbx_mutex_lock(&featurestore_lock);
+	sched_id = featurestore.sched_id;
+	featurestore.sched_id = -1;
+	pbx_mutex_unlock(&featurestore_lock);
+	if (sched_id > -1) {
+		iPbx.sched_del(sched_id);								/* outside of the lock, the callback takes it */
+	}
+
+	pbx_mutex_lock(&featurestore_flush_lock);
+	pbx_mutex_lock(&featurestore_lock);
+	featurestore.stats.loaded = FALSE;
+	ops = sccp_featurestore_takePending(&count, &oldest);
+	sccp_featurestore_write(ops, count);
+	sccp_featurestore_updateFlushStats(count, started, oldest);
+	sccp_featurestore_clear();
+	sccp_hashtable_destroy(&featurestore.table);
+	pbx_mutex_unlock(&featurestore_lock);
+	pbx_mutex_unlock(&featurestore_flush_lock);
+}
+
+/*!
+ * \brief Write all pending changes to the database
+ */
+void sccp_featurestore_flush(void)
+{
+	sccp_featurestore_op_t *ops = NULL;
+	uint count = 0;
+	struct timeval oldest = { 0 };
+	struct timeval started = pbx_tvnow();
+
+	pbx_mutex_lock(&featurestore_flush_lock);
+	pbx_mutex_lock(&featurestore_lock);
+	ops = sccp_featurestore_takePending(&count, &oldest);
+	pbx_mutex_unlock(&featurestore_lock);
+
+	sccp_featurestore_write(ops, count);
+
+	pbx_mutex_lock(&featurestore_lock);
+	sccp_featurestore_updateFlushStats(count, started, oldest);
+	pbx_mutex_unlock(&featurestore_lock);
+	pbx_mutex_unlock(&featurestore_flush_lock);
+}
+
+static void *sccp_featurestore_flush_work(void *data)
+{
+	sccp_featurestore_flush();
+	return NULL;
+}
+
+/*!
+ * \brief Scheduled flush: hand it to the threadpool, so the scheduler thread does not wait for the database
+ */
+static int sccp_featurestore_flush_cb(const void *data)
+{
+	pbx_mutex_lock(&featurestore_lock);
+	featurestore.sched_id = -1;
+	pbx_mutex_unlock(&featurestore_lock);
+
+	if (!GLOB(general_threadpool) || !sccp_threadpool_add_work(GLOB(general_threadpool), sccp_featurestore_flush_work, NULL)) {
+		sccp_featurestore_flush();
+	}
+	return 0;
+}
+
+/*!
+ * \brief Set family/key to value
+ * \return TRUE when the value has been stored (or queued to be stored)
+ */
+boolean_t sccp_featurestore_put(const char *family, const char *key, const char *value)
+{
+	sccp_featurestore_entry_t *entry = NULL;
+	char *newvalue = NULL;
+
+	if (sccp_strlen_zero(family) || sccp_strlen_zero(key) || sccp_strlen_zero(value)) {
+		return FALSE;
+	}
+	pbx_mutex_lock(&featurestore_lock);
+	if (!sccp_featurestore_covers(family) || !(entry = sccp_featurestore_lookup(family, key, TRUE))) {
+		pbx_mutex_unlock(&featurestore_lock);
+		return iPbx.feature_addToDatabase(family, key, value);
+	}
+	if (entry->value && sccp_strequals(entry->value, value)) {
+		pbx_mutex_unlock(&featurestore_lock);
+		return TRUE;
+	}
+	if (!(newvalue = pbx_strdup(value))) {
+		pbx_mutex_unlock(&featurestore_lock);
+		return FALSE;
+	}
+	if (entry->value) {
+		sccp_free(entry->value);
+	} else {
+		featurestore.stats.keys++;
+	}
+	entry->value = newvalue;
+	sccp_featurestore_queue(entry);
+	pbx_mutex_unlock(&featurestore_lock);
+	return TRUE;
+}
+
+/*!
+ * \brief Get the value of family/key
+ * \return TRUE when the key is set
+ */
+boolean_t sccp_featurestore_get(const char *family, const char *key, char *out, int outlen)
+{
+	sccp_featurestore_entry_t *entry = NULL;
+	boolean_t res = FALSE;
+
+	if (sccp_strlen_zero(family) || sccp_strlen_zero(key)) {
+		return FALSE;
+	}
+	pbx_mutex_lock(&featurestore_lock);
+	if (!sccp_featurestore_covers(family)) {
+		pbx_mutex_unlock(&featurestore_lock);
+		return iPbx.feature_getFromDatabase(family, key, out, outlen);
+	}
+	if ((entry = sccp_featurestore_lookup(family, key, FALSE)) && entry->value) {
+		sccp_copy_string(out, entry->value, outlen);
+		res = TRUE;
+	}
+	pbx_mutex_unlock(&featurestore_lock);
+	return res;
+}
+
+/*!
+ * \brief Remove family/key
+ * \return TRUE when the key was set
+ */
+boolean_t sccp_featurestore_remove(const char *family, const char *key)
+{
+	sccp_featurestore_entry_t *entry = NULL;
+
+	if (sccp_strlen_zero(family) || sccp_strlen_zero(key)) {
+		return FALSE;
+	}
+	pbx_mutex_lock(&featurestore_lock);
+	if (!sccp_featurestore_covers(family)) {
+		pbx_mutex_unlock(&featurestore_lock);
+		return iPbx.feature_removeFromDatabase(family, key);
+	}
+	if (!(entry = sccp_featurestore_lookup(family, key, FALSE)) || !entry->value) {
+		pbx_mutex_unlock(&featurestore_lock);
+		return FALSE;
+	}
+	sccp_free(entry->value);
+	featurestore.stats.keys--;
+	sccp_featurestore_queue(entry);
+	pbx_mutex_unlock(&featurestore_lock);
+	return TRUE;
+}
+
+void sccp_featurestore_getStats(sccp_featurestore_stats_t * stats)
+{
+	pbx_mutex_lock(&featurestore_lock);
+	memcpy(stats, &featurestore.stats, sizeof(*stats));
+	pbx_mutex_unlock(&featurestore_lock);
+}
+
+/* ---------------------------------------------------------------------------------------------------SHOW FEATURESTORE- */
+/*!
+ * \brief Show Feature Store
+ * \param fd Fd as int
+ * \param totals Total number of lines as int
+ * \param s AMI Session
+ * \param m Message
+ * \param argc Argc as int
+ * \param argv[] Argv[] as char
+ * \return Result as int
+ *
+ * \called_from_asterisk
+ *
+ */
+int sccp_cli_show_featurestore(int fd, sccp_cli_totals_t *totals, struct mansession *s, const struct message *m, int argc, char *argv[])
+{
+	sccp_featurestore_stats_t stats;
+	int local_line_total = 0;
+	const char *actionid = "";
+
+	sccp_featurestore_getStats(&stats);
+
+	if (!s) {
+		CLI_AMI_OUTPUT(fd, s, "\n--- SCCP feature store ---------------------------------------------------------------------------------------------------\n");
+	} else {
+		astman_append(s, "Response: Success\r\n");
+		astman_append(s, "Message: SCCPFeatureStore\r\n");
+		actionid = astman_get_header(m, "ActionID");
+		if (!pbx_strlen_zero(actionid)) {
+			astman_append(s, "ActionID: %s\r\n", actionid);
+		}
+		local_line_total++;
+	}
+	CLI_AMI_OUTPUT_BOOL("Loaded", CLI_AMI_LIST_WIDTH, stats.loaded);
+	CLI_AMI_OUTPUT_PARAM("Keys", CLI_AMI_LIST_WIDTH, "%u (loaded in %" PRId64 " ms)", stats.keys, stats.load_ms);
+	CLI_AMI_OUTPUT_PARAM("Pending Writes", CLI_AMI_LIST_WIDTH, "%u", stats.pending);
+	CLI_AMI_OUTPUT_PARAM("Changes", CLI_AMI_LIST_WIDTH, "%u", stats.changes);
+	CLI_AMI_OUTPUT_PARAM("Coalesced Changes", CLI_AMI_LIST_WIDTH, "%u", stats.coalesced);
+	CLI_AMI_OUTPUT_PARAM("Database Writes", CLI_AMI_LIST_WIDTH, "%u in %u flushes", stats.writes, stats.flushes);
+	CLI_AMI_OUTPUT_PARAM("Last Flush", CLI_AMI_LIST_WIDTH, "%" PRId64 " ms", stats.last_flush_ms);
+	CLI_AMI_OUTPUT_PARAM("Flush Latency", CLI_AMI_LIST_WIDTH, "last %" PRId64 " ms, max %" PRId64 " ms", stats.last_latency_ms, stats.max_latency_ms);
+
+	if (s) {
+		totals->lines = local_line_total;
+	}
+	return RESULT_SUCCESS;
+}
+
+#if CS_TEST_FRAMEWORK
+#include <asterisk/test.h>
+#define test_category "/channels/chan_sccp/featurestore/"
+
+AST_TEST_DEFINE(sccp_featurestore_tests)
+{
+	sccp_featurestore_stats_t before, after;
+	char buf[32] = "";
+	const char *family = SCCP_FEATURESTORE_FAMILY "/featurestore_test";
+
+	switch (cmd) {
+		case TEST_INIT:
+			info->name = "writebehind";
+			info->category = test_category;
+			info->summary = "chan-sccp-b feature store";
+			info->description = "chan-sccp-b feature store: coalesced write-behind and reads from memory";
+			return AST_TEST_NOT_RUN;
+		case TEST_EXECUTE:
+			break;
+	}
+
+	sccp_featurestore_getStats(&before);
+	if (!before.loaded) {
+		pbx_test_status_update(test, "Feature store not loaded, skipping\n");
+		return AST_TEST_NOT_RUN;
+	}
+	iPbx.feature_removeTreeFromDatabase(family, "cfwdAll");
+
+	/* four changes of the same key end up as one write of the last value */
+	pbx_test_validate(test, sccp_featurestore_put(family, "cfwdAll", "100"));
+	pbx_test_validate(test, sccp_featurestore_put(family, "cfwdAll", "200"));
+	pbx_test_validate(test, sccp_featurestore_remove(family, "cfwdAll"));
+	pbx_test_validate(test, sccp_featurestore_put(family, "cfwdAll", "300"));
+	pbx_test_validate(test, sccp_featurestore_get(family, "cfwdAll", buf, sizeof(buf)) && sccp_strequals(buf, "300"));
+	sccp_featurestore_getStats(&after);
+	pbx_test_validate(test, after.changes - before.changes == 4);
+
+	sccp_featurestore_flush();
+	buf[0] = '\0';
+	pbx_test_validate(test, iPbx.feature_getFromDatabase(family, "cfwdAll", buf, sizeof(buf)) && sccp_strequals(buf, "300"));
+	sccp_featurestore_getStats(&after);
+	pbx_test_validate(test, after.pending == 0);
+	pbx_test_status_update(test, "%u changes, %u coalesced, %u writes\n", after.changes - before.changes, after.coalesced - before.coalesced, after.writes - before.writes);
+
+	/* setting a value that is already set does not queue anything */
+	sccp_featurestore_getStats(&before);
+	pbx_test_validate(test, sccp_featurestore_put(family, "cfwdAll", "300"));
+	sccp_featurestore_getStats(&after);
+	pbx_test_validate(test, after.changes == before.changes);
+
+	/* set and removed again before the flush: never written */
+	pbx_test_validate(test, sccp_featurestore_put(family, "cfwdBusy", "400"));
+	pbx_test_validate(test, sccp_featurestore_remove(family, "cfwdBusy"));
+	pbx_test_validate(test, !sccp_featurestore_get(family, "cfwdBusy", buf, sizeof(buf)));
+	sccp_featurestore_flush();
+	pbx_test_validate(test, !iPbx.feature_getFromDatabase(family, "cfwdBusy", buf, sizeof(buf)));
+
+	pbx_test_validate(test, sccp_featurestore_remove(family, "cfwdAll"));
+	sccp_featurestore_flush();
+	pbx_test_validate(test, !iPbx.feature_getFromDatabase(family, "cfwdAll", buf, sizeof(buf)));
+	return AST_TEST_PASS;
+}
+
+static void __attribute__((constructor)) sccp_register_tests(void)
+{
+	AST_TEST_REGISTER(sccp_featurestore_tests);
+}
+
+static void __attribute__((destructor)) sccp_unregister_tests(void)
+{
+	AST_TEST_UNREGISTER(sccp_featurestore_tests);
+}
+#endif
+
+// kate: indent-width 8; replace-tabs off; indent-mode cstyle; auto-insert-doxygen on; line-numbers on; tab-indents on; keep-extra-spaces off; auto-brackets off;
@@ -0,0 +1,40 @@
+/*!
+ * \file        sccp_featurestore.h
+ * \brief       SCCP Feature Store Header
+ * \note        This program is free software and may be modified and distributed under the terms of the GNU Public License.
+ *              See the LICENSE file at the top of the source tree.
+ *
+ * In memory copy of the "SCCP" astdb family (persisted feature state: cfwd, dnd, privacy, monitor, last dialed number,
+ * messages), with a write-behind queue in front of the database.
+ */
+#pragma once
+#include "sccp_cli.h"
+
+__BEGIN_C_EXTERN__
+/*!
+ * \brief SCCP Feature Store Statistics
+ */
+typedef struct sccp_featurestore_stats {
+	boolean_t loaded;											/*!< Family has been bulk loaded, reads are served from memory */
+	uint32_t keys;												/*!< Number of keys held in memory */
+	uint32_t pending;											/*!< Number of keys waiting to be written */
+	uint32_t changes;											/*!< Number of changes made through the store */
+	uint32_t coalesced;											/*!< Number of changes merged into a write that was already pending */
+	uint32_t writes;											/*!< Number of database puts/deletes issued */
+	uint32_t flushes;											/*!< Number of flushes that wrote something */
+	int64_t load_ms;											/*!< Duration of the bulk load */
+	int64_t last_flush_ms;											/*!< Duration of the last flush */
+	int64_t last_latency_ms;										/*!< Age of the oldest change written by the last flush */
+	int64_t max_latency_ms;											/*!< Highest age of a change when it was written */
+} sccp_featurestore_stats_t;
+
+SCCP_API void SCCP_CALL sccp_featurestore_load(void);
+SCCP_API void SCCP_CALL sccp_featurestore_unload(void);
+SCCP_API boolean_t SCCP_CALL sccp_featurestore_put(const char *family, const char *key, const char *value);
+SCCP_API boolean_t SCCP_CALL sccp_featurestore_get(const char *family, const char *key, char *out, int outlen);
+SCCP_API boolean_t SCCP_CALL sccp_featurestore_remove(const char *family, const char *key);
+SCCP_API void SCCP_CALL sccp_featurestore_flush(void);
+SCCP_API void SCCP_CALL sccp_featurestore_getStats(sccp_featurestore_stats_t * stats);
+SCCP_API int SCCP_CALL sccp_cli_show_featurestore(int fd, sccp_cli_totals_t *totals, struct mansession *s, const struct message *m, int argc, char *argv[]);
+__END_C_EXTERN__
+// kate: indent-width 8; replace-tabs off; indent-mode cstyle; auto-insert-doxygen on; line-numbers on; tab-indents on; keep-extra-spaces off; auto-brackets off;
@@ -50,6 +50,12 @@ struct sccp_global_vars {
 	SCCP_RWLIST_HEAD (, sccp_session_t) sessions;								/*!< SCCP Sessions */
 	SCCP_RWLIST_HEAD (, sccp_device_t) devices;								/*!< SCCP Devices */
 	SCCP_RWLIST_HEAD (, sccp_line_t) lines;									/*!< SCCP Lines */
+	sccp_hashtable_t *session_index;									/*!< Index on GLOB(sessions) by ip-address (protected by the sessions list lock) */
+	sccp_hashtable_t *device_index;										/*!< Index on GLOB(devices) by id (protected by the devices list lock) */
+	sccp_hashtable_t *line_index;										/*!< Index on GLOB(lines) by name (protected by the lines list lock) */
+	pbx_rwlock_t channel_index_lock;									/*!< Protects the channel indexes */
+	sccp_hashtable_t *channel_callid_index;									/*!< Index on all line->channels by callid */
+	sccp_hashtable_t *channel_passthrupartyid_index;							/*!< Index on all line->channels by passthrupartyid */
 
 	sccp_mutex_t socket_lock;										/*!< Socket Lock */
 #ifndef SCCP_ATOMIC	
@@ -148,6 +154,17 @@ struct sccp_global_vars {
 	char *token_fallback;											/*!< Fall back immediatly on TokenReq (true/false/odd/even) */
 	int token_backoff_time;											/*!< Backoff time on TokenReject */
 	int server_priority;											/*!< Server Priority to fallback to */
+	int token_load_threshold;										/*!< Load score at which TokenReq is rejected when fallback=load */
+	int token_load_max_sessions;										/*!< Number of sessions counted as full load when fallback=load (0 = not counted) */
+
+	boolean_t session_eventloop;										/*!< Serve sessions from epoll event loops instead of one thread per session (read at module load) */
+	int session_eventloop_threads;										/*!< Number of session event loops (0 = one per online cpu) */
+	int session_sendqueue_depth;										/*!< Max number of messages waiting in a session send queue */
+	boolean_t session_sendqueue_disconnect;									/*!< Disconnect the session instead of dropping the message when the send queue is full */
+	int session_admission_rate;										/*!< Max number of new connections admitted per second (0 = unlimited) */
+	int session_admission_max_pending;									/*!< Max number of registrations in progress at the same time (0 = unlimited) */
+	int config_load_threads;										/*!< Number of threads building devices/lines on initial load (0 = sequential) */
+	int hint_notify_window;											/*!< Millisecs hint notifications are coalesced before they are sent to the subscribers (0 = immediately) */
 
 
 	boolean_t reload_in_progress;										/*!< Reload in Progress */
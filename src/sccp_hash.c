@@ -0,0 +1,442 @@
+/*!
+ * \file        sccp_hash.c
+ * \brief       SCCP Hash Index Class
+ * \note        This program is free software and may be modified and distributed under the terms of the GNU Public License.
+ *              See the LICENSE file at the top of the source tree.
+ *
+ * Chained hash table with a power of two number of buckets, which doubles when the number of entries exceeds the number
+ * of buckets. The hash value of every entry is stored with it, so growing never calls the hash callback again and a
+ * lookup only calls the match callback on real candidates.
+ */
+
+#include "config.h"
+#include "common.h"
+#include "sccp_hash.h"
+#include "sccp_netsock.h"
+#include "sccp_utils.h"
+
+SCCP_FILE_VERSION(__FILE__, "");
+
+#define SCCP_HASHTABLE_MIN_BUCKETS 64
+#define SCCP_HASHTABLE_MAX_BUCKETS (1 << 24)
+
+typedef struct sccp_hashtable_entry sccp_hashtable_entry_t;
+
+struct sccp_hashtable_entry {
+	sccp_hashtable_entry_t *next;
+	unsigned int hash;
+	const void *key;											/*!< points into value, needs to stay valid as long as the entry exists */
+	void *value;
+};
+
+struct sccp_hashtable {
+	sccp_hashtable_entry_t **buckets;
+	unsigned int mask;											/*!< number of buckets - 1 */
+	unsigned int size;											/*!< number of entries */
+	sccp_hashtable_hash_cb hash;
+	sccp_hashtable_match_cb match;
+};
+
+/*!
+ * \brief Create a new hash table
+ * \param buckets Initial number of buckets (rounded up to a power of two)
+ * \param hash Hash Callback
+ * \param match Match Callback
+ */
+sccp_hashtable_t *sccp_hashtable_create(unsigned int buckets, sccp_hashtable_hash_cb hash, sccp_hashtable_match_cb match)
+{
+	sccp_hashtable_t *table = NULL;
+	unsigned int numbuckets = SCCP_HASHTABLE_MIN_BUCKETS;
+
+	while (numbuckets < buckets && numbuckets < SCCP_HASHTABLE_MAX_BUCKETS) {
+		numbuckets <<= 1;
+	}
+	if (!(table = sccp_calloc(sizeof *table, 1))) {
+		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+		return NULL;
+	}
+	if (!(table->buckets = sccp_calloc(sizeof(sccp_hashtable_entry_t *), numbuckets))) {
+		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+		sccp_free(table);
+		return NULL;
+	}
+	table->mask = numbuckets - 1;
+	table->hash = hash;
+	table->match = match;
+	return table;
+}
+
+/*!
+ * \brief Destroy a hash table (the values are not touched)
+ */
+void sccp_hashtable_destroy(sccp_hashtable_t ** table)
+{
+	sccp_hashtable_entry_t *entry = NULL;
+	unsigned int bucket;
+
+	if (!table || !*table) {
+		return;
+	}
+	for (bucket = 0; bucket <= (*table)->mask; bucket++) {
+		while ((entry = (*table)->buckets[bucket])) {
+			(*table)->buckets[bucket] = entry->next;
+			sccp_free(entry);
+		}
+	}
+	sccp_free((*table)->buckets);
+	sccp_free(*table);
+	*table = NULL;
+}
+
+/*!
+ * \brief Double the number of buckets, failure is not fatal (the chains just get longer)
+ */
+static void sccp_hashtable_grow(sccp_hashtable_t * table)
+{
+	sccp_hashtable_entry_t **buckets = NULL;
+	sccp_hashtable_entry_t *entry = NULL;
+	unsigned int newmask = (table->mask << 1) | 1;
+	unsigned int bucket;
+
+	if (table->mask + 1 >= SCCP_HASHTABLE_MAX_BUCKETS || !(buckets = sccp_calloc(sizeof(sccp_hashtable_entry_t *), newmask + 1))) {
+		return;
+	}
+	for (bucket = 0; bucket <= table->mask; bucket++) {
+		while ((entry = table->buckets[bucket])) {
+			table->buckets[bucket] = entry->next;
+			entry->next = buckets[entry->hash & newmask];
+			buckets[entry->hash & newmask] = entry;
+		}
+	}
+	sccp_free(table->buckets);
+	table->buckets = buckets;
+	table->mask = newmask;
+}
+
+/*!
+ * \brief Insert a value into the hash table
+ * \param table Hash Table
+ * \param key Key (needs to stay valid until the value is removed again)
+ * \param value Value
+ * \note duplicate keys are allowed, find returns the most recently inserted one
+ */
+boolean_t sccp_hashtable_insert(sccp_hashtable_t * table, const void *key, void *value)
+{
+	sccp_hashtable_entry_t *entry = NULL;
+
+	if (!table || !key) {
+		return FALSE;
+	}
+	if (!(entry = sccp_malloc(sizeof *entry))) {
+		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+		return FALSE;
+	}
+	if (table->size >= table->mask + 1) {
+		sccp_hashtable_grow(table);
+	}
+	entry->hash = table->hash(key);
+	entry->key = key;
+	entry->value = value;
+	entry->next = table->buckets[entry->hash & table->mask];
+	table->buckets[entry->hash & table->mask] = entry;
+	table->size++;
+	return TRUE;
+}
+
+/*!
+ * \brief Remove a value from the hash table
+ * \param table Hash Table
+ * \param key Key the value was inserted with
+ * \param value Value to remove (NULL removes the first entry matching key)
+ * \return removed value or NULL
+ */
+void *sccp_hashtable_remove(sccp_hashtable_t * table, const void *key, const void *value)
+{
+	sccp_hashtable_entry_t **entryp = NULL;
+	sccp_hashtable_entry_t *entry = NULL;
+	void *res = NULL;
+	unsigned int hash;
+
+	if (!table || !key) {
+		return NULL;
+	}
+	hash = table->hash(key);
+	for (entryp = &table->buckets[hash & table->mask]; (entry = *entryp); entryp = &entry->next) {
+		if (entry->hash == hash && (value ? entry->value == value : table->match(entry->key, key))) {
+			*entryp = entry->next;
+			res = entry->value;
+			sccp_free(entry);
+			table->size--;
+			break;
+		}
+	}
+	return res;
+}
+
+/*!
+ * \brief Find a value by key
+ * \return value or NULL (not retained)
+ */
+void *sccp_hashtable_find(const sccp_hashtable_t * table, const void *key)
+{
+	sccp_hashtable_entry_t *entry = NULL;
+	unsigned int hash;
+
+	if (!table || !key) {
+		return NULL;
+	}
+	hash = table->hash(key);
+	for (entry = table->buckets[hash & table->mask]; entry; entry = entry->next) {
+		if (entry->hash == hash && table->match(entry->key, key)) {
+			return entry->value;
+		}
+	}
+	return NULL;
+}
+
+unsigned int sccp_hashtable_size(const sccp_hashtable_t * table)
+{
+	return table ? table->size : 0;
+}
+
+unsigned int sccp_hashtable_buckets(const sccp_hashtable_t * table)
+{
+	return table ? table->mask + 1 : 0;
+}
+
+/* FNV-1a */
+#define SCCP_HASH_FNV_OFFSET 2166136261U
+#define SCCP_HASH_FNV_PRIME 16777619U
+
+static gcc_inline unsigned int sccp_hash_bytes(unsigned int hash, const unsigned char *data, size_t len)
+{
+	while (len--) {
+		hash = (hash ^ *data++) * SCCP_HASH_FNV_PRIME;
+	}
+	return hash;
+}
+
+/*!
+ * \brief Case insensitive string hash (matches sccp_strcaseequals)
+ */
+unsigned int sccp_hash_string_nocase(const void *key)
+{
+	const unsigned char *str = key;
+	unsigned int hash = SCCP_HASH_FNV_OFFSET;
+
+	while (*str) {
+		hash = (hash ^ (unsigned char) tolower(*str++)) * SCCP_HASH_FNV_PRIME;
+	}
+	return hash;
+}
+
+boolean_t sccp_hash_match_string_nocase(const void *key_a, const void *key_b)
+{
+	return sccp_strcaseequals((const char *) key_a, (const char *) key_b);
+}
+
+/*!
+ * \brief Case sensitive string hash (matches sccp_strequals)
+ */
+unsigned int sccp_hash_string(const void *key)
+{
+	const unsigned char *str = key;
+	unsigned int hash = SCCP_HASH_FNV_OFFSET;
+
+	while (*str) {
+		hash = (hash ^ *str++) * SCCP_HASH_FNV_PRIME;
+	}
+	return hash;
+}
+
+boolean_t sccp_hash_match_string(const void *key_a, const void *key_b)
+{
+	return sccp_strequals((const char *) key_a, (const char *) key_b);
+}
+
+/*!
+ * \brief Socket Address hash, only covers the ip-address (matches sccp_netsock_cmp_addr, ipv4 mapped ipv6 addresses hash like their ipv4 counterpart)
+ */
+unsigned int sccp_hash_sockaddr(const void *key)
+{
+	const struct sockaddr_storage *sas = key;
+	struct sockaddr_storage ipv4_mapped;
+
+	if (sas->ss_family == AF_INET6 && sccp_netsock_ipv4_mapped(sas, &ipv4_mapped)) {
+		sas = &ipv4_mapped;
+	}
+	if (sas->ss_family == AF_INET) {
+		return sccp_hash_bytes(SCCP_HASH_FNV_OFFSET, (const unsigned char *) &((const struct sockaddr_in *) sas)->sin_addr, sizeof(struct in_addr));
+	}
+	return sccp_hash_bytes(SCCP_HASH_FNV_OFFSET, (const unsigned char *) &((const struct sockaddr_in6 *) sas)->sin6_addr, sizeof(struct in6_addr));
+}
+
+boolean_t sccp_hash_match_sockaddr(const void *key_a, const void *key_b)
+{
+	return sccp_netsock_cmp_addr((const struct sockaddr_storage *) key_a, (const struct sockaddr_storage *) key_b) == 0;
+}
+
+unsigned int sccp_hash_uint32(const void *key)
+{
+	return sccp_hash_bytes(SCCP_HASH_FNV_OFFSET, key, sizeof(uint32_t));
+}
+
+boolean_t sccp_hash_match_uint32(const void *key_a, const void *key_b)
+{
+	return *(const uint32_t *) key_a == *(const uint32_t *) key_b;
+}
+
+#if CS_TEST_FRAMEWORK
+#include <asterisk/test.h>
+#define test_category "/channels/chan_sccp/hash/"
+
+struct hash_test_object {
+	char name[StationMaxDeviceNameSize];
+	SCCP_LIST_ENTRY (struct hash_test_object) list;
+};
+
+AST_TEST_DEFINE(sccp_hash_tests)
+{
+	sccp_hashtable_t *table = NULL;
+	struct hash_test_object *objects = NULL;
+	struct sockaddr_storage sas[2];
+	int num_objects = 1000;
+	int i;
+
+	switch (cmd) {
+		case TEST_INIT:
+			info->name = "index";
+			info->category = test_category;
+			info->summary = "chan-sccp-b hash index";
+			info->description = "chan-sccp-b hash index insert/find/remove/grow";
+			return AST_TEST_NOT_RUN;
+		case TEST_EXECUTE:
+			break;
+	}
+
+	pbx_test_validate(test, (objects = sccp_calloc(sizeof(struct hash_test_object), num_objects)) != NULL);
+	pbx_test_validate(test, (table = sccp_hashtable_create(0, sccp_hash_string_nocase, sccp_hash_match_string_nocase)) != NULL);
+	pbx_test_validate(test, sccp_hashtable_buckets(table) == SCCP_HASHTABLE_MIN_BUCKETS);
+	for (i = 0; i < num_objects; i++) {
+		snprintf(objects[i].name, sizeof(objects[i].name), "SEP%012X", i);
+		pbx_test_validate(test, sccp_hashtable_insert(table, objects[i].name, &objects[i]));
+	}
+	pbx_test_status_update(test, "Inserted %d entries, %d buckets\n", sccp_hashtable_size(table), sccp_hashtable_buckets(table));
+	pbx_test_validate(test, sccp_hashtable_size(table) == (unsigned int) num_objects);
+	pbx_test_validate(test, sccp_hashtable_buckets(table) >= (unsigned int) num_objects);
+	pbx_test_validate(test, sccp_hashtable_find(table, "SEP00000000002A") == &objects[42]);
+	pbx_test_validate(test, sccp_hashtable_find(table, "sep00000000002a") == &objects[42]);
+	pbx_test_validate(test, sccp_hashtable_find(table, "SEP0000DEADBEEF") == NULL);
+	pbx_test_validate(test, sccp_hashtable_remove(table, "SEP00000000002A", &objects[43]) == NULL);
+	pbx_test_validate(test, sccp_hashtable_remove(table, "SEP00000000002A", &objects[42]) == &objects[42]);
+	pbx_test_validate(test, sccp_hashtable_find(table, "SEP00000000002A") == NULL);
+	pbx_test_validate(test, sccp_hashtable_size(table) == (unsigned int) num_objects - 1);
+	sccp_hashtable_destroy(&table);
+	pbx_test_validate(test, table == NULL);
+
+	pbx_test_status_update(test, "Socket Address Keys (ipv4 / ipv4-mapped ipv6)\n");
+	memset(sas, 0, sizeof(sas));
+	sas[0].ss_family = AF_INET;
+	((struct sockaddr_in *) &sas[0])->sin_addr.s_addr = htonl(0xC0A80001);
+	((struct sockaddr_in *) &sas[0])->sin_port = htons(2000);
+	sas[1].ss_family = AF_INET6;
+	((struct sockaddr_in6 *) &sas[1])->sin6_addr.s6_addr[10] = 0xff;
+	((struct sockaddr_in6 *) &sas[1])->sin6_addr.s6_addr[11] = 0xff;
+	memcpy(&((struct sockaddr_in6 *) &sas[1])->sin6_addr.s6_addr[12], &((struct sockaddr_in *) &sas[0])->sin_addr, sizeof(struct in_addr));
+	pbx_test_validate(test, sccp_hash_sockaddr(&sas[0]) == sccp_hash_sockaddr(&sas[1]));
+	pbx_test_validate(test, (table = sccp_hashtable_create(0, sccp_hash_sockaddr, sccp_hash_match_sockaddr)) != NULL);
+	pbx_test_validate(test, sccp_hashtable_insert(table, &sas[0], &objects[0]));
+	pbx_test_validate(test, sccp_hashtable_find(table, &sas[1]) == &objects[0]);
+	sccp_hashtable_destroy(&table);
+
+	sccp_free(objects);
+	return AST_TEST_PASS;
+}
+
+AST_TEST_DEFINE(sccp_hash_lookup_benchmark)
+{
+	SCCP_LIST_HEAD (, struct hash_test_object) list;
+	sccp_hashtable_t *table = NULL;
+	struct hash_test_object *objects = NULL;
+	struct hash_test_object *obj = NULL;
+	const int sizes[] = { 1000, 10000, 50000 };
+	const int num_lookups = 2000;
+	struct timeval start;
+	int64_t linear_ms, hashed_ms;
+	int found;
+	uint32_t size_idx;
+	int i;
+
+	switch (cmd) {
+		case TEST_INIT:
+			info->name = "lookup_benchmark";
+			info->category = test_category;
+			info->summary = "chan-sccp-b name lookup benchmark";
+			info->description = "chan-sccp-b compare linear list lookup with hash index lookup at 1k/10k/50k entries";
+			return AST_TEST_NOT_RUN;
+		case TEST_EXECUTE:
+			break;
+	}
+
+	for (size_idx = 0; size_idx < ARRAY_LEN(sizes); size_idx++) {
+		int num_objects = sizes[size_idx];
+
+		pbx_test_validate(test, (objects = sccp_calloc(sizeof(struct hash_test_object), num_objects)) != NULL);
+		pbx_test_validate(test, (table = sccp_hashtable_create(0, sccp_hash_string_nocase, sccp_hash_match_string_nocase)) != NULL);
+		SCCP_LIST_HEAD_INIT(&list);
+		for (i = 0; i < num_objects; i++) {
+			snprintf(objects[i].name, sizeof(objects[i].name), "SEP%012X", i);
+			SCCP_LIST_INSERT_TAIL(&list, &objects[i], list);
+			sccp_hashtable_insert(table, objects[i].name, &objects[i]);
+		}
+
+		/* old path: linear case insensitive scan */
+		found = 0;
+		start = pbx_tvnow();
+		for (i = 0; i < num_lookups; i++) {
+			const char *name = objects[(i * 7919) % num_objects].name;
+			SCCP_LIST_TRAVERSE(&list, obj, list) {
+				if (sccp_strcaseequals(obj->name, name)) {
+					found++;
+					break;
+				}
+			}
+		}
+		linear_ms = ast_tvdiff_ms(pbx_tvnow(), start);
+		pbx_test_validate(test, found == num_lookups);
+
+		/* new path: hash index */
+		found = 0;
+		start = pbx_tvnow();
+		for (i = 0; i < num_lookups; i++) {
+			if (sccp_hashtable_find(table, objects[(i * 7919) % num_objects].name)) {
+				found++;
+			}
+		}
+		hashed_ms = ast_tvdiff_ms(pbx_tvnow(), start);
+		pbx_test_validate(test, found == num_lookups);
+
+		pbx_test_status_update(test, "%6d entries, %d lookups: linear %6" PRId64 " ms, hashed %6" PRId64 " ms\n", num_objects, num_lookups, linear_ms, hashed_ms);
+
+		while (SCCP_LIST_REMOVE_HEAD(&list, list));
+		SCCP_LIST_HEAD_DESTROY(&list);
+		sccp_hashtable_destroy(&table);
+		sccp_free(objects);
+	}
+	return AST_TEST_PASS;
+}
+
+static void __attribute__((constructor)) sccp_register_tests(void)
+{
+	AST_TEST_REGISTER(sccp_hash_tests);
+	AST_TEST_REGISTER(sccp_hash_lookup_benchmark);
+}
+
+static void __attribute__((destructor)) sccp_unregister_tests(void)
+{
+	AST_TEST_UNREGISTER(sccp_hash_tests);
+	AST_TEST_UNREGISTER(sccp_hash_lookup_benchmark);
+}
+#endif
+
+// kate: indent-width 8; replace-tabs off; indent-mode cstyle; auto-insert-doxygen on; line-numbers on; tab-indents on; keep-extra-spaces off; auto-brackets off;
@@ -0,0 +1,38 @@
+/*!
+ * \file        sccp_hash.h
+ * \brief       SCCP Hash Index Header
+ * \note        This program is free software and may be modified and distributed under the terms of the GNU Public License.
+ *              See the LICENSE file at the top of the source tree.
+ *
+ * Small chained hash table, used as a secondary index next to the global (sorted) lists. The table does not own the
+ * values it stores and does not do any locking; it is protected by the lock of the list it indexes (insert/remove with
+ * the list write-locked, find with the list read-locked).
+ */
+#pragma once
+
+__BEGIN_C_EXTERN__
+
+typedef struct sccp_hashtable sccp_hashtable_t;
+typedef unsigned int (*sccp_hashtable_hash_cb) (const void *key);						/*!< return the hash value of a key */
+typedef boolean_t (*sccp_hashtable_match_cb) (const void *key_a, const void *key_b);				/*!< return TRUE when both keys are equal */
+
+SCCP_API sccp_hashtable_t * SCCP_CALL sccp_hashtable_create(unsigned int buckets, sccp_hashtable_hash_cb hash, sccp_hashtable_match_cb match);
+SCCP_API void SCCP_CALL sccp_hashtable_destroy(sccp_hashtable_t ** table);
+SCCP_API boolean_t SCCP_CALL sccp_hashtable_insert(sccp_hashtable_t * table, const void *key, void *value);
+SCCP_API void * SCCP_CALL sccp_hashtable_remove(sccp_hashtable_t * table, const void *key, const void *value);
+SCCP_API void * SCCP_CALL sccp_hashtable_find(const sccp_hashtable_t * table, const void *key);
+SCCP_API unsigned int SCCP_CALL sccp_hashtable_size(const sccp_hashtable_t * table);
+SCCP_API unsigned int SCCP_CALL sccp_hashtable_buckets(const sccp_hashtable_t * table);
+
+/* key types */
+SCCP_API unsigned int SCCP_CALL sccp_hash_string(const void *key);
+SCCP_API boolean_t SCCP_CALL sccp_hash_match_string(const void *key_a, const void *key_b);
+SCCP_API unsigned int SCCP_CALL sccp_hash_string_nocase(const void *key);
+SCCP_API boolean_t SCCP_CALL sccp_hash_match_string_nocase(const void *key_a, const void *key_b);
+SCCP_API unsigned int SCCP_CALL sccp_hash_sockaddr(const void *key);
+SCCP_API boolean_t SCCP_CALL sccp_hash_match_sockaddr(const void *key_a, const void *key_b);
+SCCP_API unsigned int SCCP_CALL sccp_hash_uint32(const void *key);
+SCCP_API boolean_t SCCP_CALL sccp_hash_match_uint32(const void *key_a, const void *key_b);
+
+__END_C_EXTERN__
+// kate: indent-width 8; replace-tabs off; indent-mode cstyle; auto-insert-doxygen on; line-numbers on; tab-indents on; keep-extra-spaces off; auto-brackets off;
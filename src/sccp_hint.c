@@ -28,10 +28,12 @@
 #include "sccp_hint.h"
 SCCP_FILE_VERSION(__FILE__, "");
 
+#include "sccp_atomic.h"
 #include "sccp_channel.h"
 #include "sccp_device.h"
 #include "sccp_indicate.h"											// only for SCCP_CHANNELSTATE_Idling
 #include "sccp_line.h"
+#include "sccp_session.h"
 #include "sccp_utils.h"
 
 #if defined(CS_AST_HAS_EVENT) && defined(HAVE_PBX_EVENT_H) 	// ast_event_subscribe
@@ -54,6 +56,12 @@ struct sccp_hint_SubscribingDevice
 	sccp_device_t *device;											/*!< SCCP Device */
 	uint8_t instance;											/*!< Instance */
 	uint8_t positionOnDevice;										/*!< Instance */
+
+	int cacheGeneration;											/*!< hint_cache_generation the fields below were resolved for */
+	boolean_t dynamicSpeeddial;										/*!< Device handles FeatureStatDynamicMessage */
+	boolean_t showCID;											/*!< Caller ID fits on this button */
+	char label[StationMaxNameSize];										/*!< Resolved speeddial name */
+	sccp_msg_t *blfTemplate;										/*!< Prebuilt FeatureStatDynamicMessage (index, id and label filled in) */
 };														/*!< SCCP Hint Subscribing Device Structure */
 
 /*!
@@ -63,6 +71,7 @@ struct sccp_hint_lineState
 {
 	sccp_line_t *line;
 	sccp_channelstate_t state;
+	char name[StationMaxNameSize];										/*!< Line Name (lineStateIndex key) */
 
 	/*!
 	 * \brief Call Information Structure
@@ -105,10 +114,53 @@ struct sccp_hint_list {
 	PBX_EVENT_SUBSCRIPTION *device_state_sub;									/*!< asterisk distributed device state subscription */
 #endif
 
+	boolean_t notifyPending;										/*!< Subscribers will be notified when the coalescing window closes (protected by hint_notify_lock) */
+	sccp_hint_list_t *notifyNext;										/*!< Next hint waiting for notification (protected by hint_notify_lock) */
+
 	SCCP_LIST_HEAD (, sccp_hint_SubscribingDevice_t) subscribers;						/*!< Hint Type Subscribers Linked List Entry */
 	SCCP_LIST_ENTRY (sccp_hint_list_t) list;								/*!< Hint Type Linked List Entry */
 };														/*!< SCCP Hint List Structure */
 
+/*!
+ * \brief SCCP Hint Notification Batch Entry: BLF messages for one device
+ */
+typedef struct sccp_hint_batchEntry sccp_hint_batchEntry_t;
+struct sccp_hint_batchEntry {
+	sccp_device_t *device;											/*!< SCCP Device (retained) */
+	uint count;												/*!< Number of messages */
+	uint size;												/*!< Allocated size of msgs */
+	sccp_msg_t **msgs;											/*!< Messages */
+	sccp_hint_batchEntry_t *next;										/*!< Next Entry */
+};
+
+/*!
+ * \brief SCCP Hint Notification Batch: BLF messages collected during one notification pass, sent with one write per device
+ */
+typedef struct sccp_hint_batch {
+	sccp_hashtable_t *devices;										/*!< device name -> sccp_hint_batchEntry_t */
+	sccp_hint_batchEntry_t *entries;									/*!< All entries */
+} sccp_hint_batch_t;
+
+/*!
+ * \brief SCCP Hint Index Entry: the hints that refer to one line name, or that one device is subscribed to
+ */
+typedef struct sccp_hint_indexEntry sccp_hint_indexEntry_t;
+struct sccp_hint_indexEntry {
+	char name[StationMaxNameSize];										/*!< Line Name / Device Name (key) */
+	unsigned int count;											/*!< Number of hints */
+	unsigned int size;											/*!< Allocated size of hints */
+	sccp_hint_list_t **hints;										/*!< Hints */
+	SCCP_LIST_ENTRY (sccp_hint_indexEntry_t) list;								/*!< Hint Index Entry Linked List Entry */
+};
+
+/*!
+ * \brief SCCP Hint Index (protected by the sccp_hint_subscriptions lock)
+ */
+struct sccp_hint_index {
+	sccp_hashtable_t *table;										/*!< name -> sccp_hint_indexEntry_t */
+	SCCP_LIST_HEAD (, sccp_hint_indexEntry_t) entries;							/*!< All entries, used to free them */
+};
+
 /* ========================================================================================================================= Declarations */
 static void sccp_hint_updateLineState(struct sccp_hint_lineState *lineState);
 static void sccp_hint_updateLineStateForMultipleChannels(struct sccp_hint_lineState *lineState);
@@ -116,6 +168,7 @@ static void sccp_hint_updateLineStateForSingleChannel(struct sccp_hint_lineState
 static void sccp_hint_checkForDND(struct sccp_hint_lineState *lineState);
 static sccp_hint_list_t *sccp_hint_create(char *hint_exten, char *hint_context);
 static void sccp_hint_notifySubscribers(sccp_hint_list_t * hint);			/* old */
+static void sccp_hint_notifySubscribersNow(sccp_hint_list_t * hint, sccp_hint_batch_t * batch);
 static void sccp_hint_notifyLineStateUpdate(struct sccp_hint_lineState *linestate); 	/* new */
 static void sccp_hint_deviceRegistered(const sccp_device_t * device);
 static void sccp_hint_deviceUnRegistered(const char *deviceName);
@@ -128,6 +181,14 @@ static void sccp_hint_eventListener(const sccp_event_t * event);
 #ifdef CS_DYNAMIC_SPEEDDIAL
 static gcc_inline boolean_t sccp_hint_isCIDavailabe(const sccp_device_t * device, const uint8_t positionOnDevice);
 #endif
+static void sccp_hint_index_init(struct sccp_hint_index *index);
+static void sccp_hint_index_destroy(struct sccp_hint_index *index);
+static boolean_t sccp_hint_index_add(struct sccp_hint_index *index, const char *name, sccp_hint_list_t * hint);
+static void sccp_hint_index_addLines(struct sccp_hint_index *index, sccp_hint_list_t * hint);
+static void sccp_hint_index_remove(struct sccp_hint_index *index, sccp_hint_indexEntry_t * entry);
+#ifdef CS_DYNAMIC_SPEEDDIAL
+static void sccp_hint_subscriber_buildCache(sccp_hint_SubscribingDevice_t * subscriber, constDevicePtr d);
+#endif
 
 #ifdef CS_USE_ASTERISK_DISTRIBUTED_DEVSTATE
 #if ASTERISK_VERSION_GROUP >= 112
@@ -191,6 +252,26 @@ static void sccp_hint_distributed_devstate_cb(const pbx_event_t * event, void *d
 /* ========================================================================================================================= List Declarations */
 static SCCP_LIST_HEAD (, struct sccp_hint_lineState) lineStates;
 static SCCP_LIST_HEAD (, sccp_hint_list_t) sccp_hint_subscriptions;
+static sccp_hashtable_t *lineStateIndex;									/*!< line name -> lineState (protected by the lineStates lock) */
+static struct sccp_hint_index lineIndex;									/*!< line name -> hints referring to SCCP/<line name> */
+static struct sccp_hint_index deviceIndex;									/*!< device name -> hints the device is subscribed to */
+
+/*!
+ * \brief Coalesced Hint Notifications (protected by hint_notify_lock)
+ */
+static struct {
+	sccp_hint_list_t *pending;										/*!< Hints waiting for the coalescing window to close */
+	int sched_id;												/*!< Scheduled flush of the pending hints, -1 when none */
+	uint32_t notifications;											/*!< Number of subscriber notifications sent */
+	uint32_t suppressed;											/*!< Number of subscriber notifications merged into a pending one */
+	uint32_t messages;											/*!< Number of BLF messages sent in batches */
+	uint32_t batches;											/*!< Number of batched writes to a device */
+	uint32_t flushes;											/*!< Number of coalescing windows closed */
+} hint_notify = {
+	.sched_id = -1,
+};
+AST_MUTEX_DEFINE_STATIC(hint_notify_lock);
+static volatile int hint_cache_generation = 1;								/*!< Bumped when button configuration changes, invalidates the subscriber caches */
 
 /* ========================================================================================================================= Module Start/Stop */
 /*!
@@ -201,6 +282,9 @@ void sccp_hint_module_start(void)
 	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_2 "SCCP: Starting hint system\n");
 	SCCP_LIST_HEAD_INIT(&lineStates);
 	SCCP_LIST_HEAD_INIT(&sccp_hint_subscriptions);
+	lineStateIndex = sccp_hashtable_create(0, sccp_hash_string_nocase, sccp_hash_match_string_nocase);
+	sccp_hint_index_init(&lineIndex);
+	sccp_hint_index_init(&deviceIndex);
 	sccp_event_subscribe(SCCP_EVENT_DEVICE_REGISTERED | SCCP_EVENT_DEVICE_UNREGISTERED | SCCP_EVENT_DEVICE_DETACHED | SCCP_EVENT_DEVICE_ATTACHED | SCCP_EVENT_LINESTATUS_CHANGED, sccp_hint_eventListener, TRUE);
 	sccp_event_subscribe(SCCP_EVENT_FEATURE_CHANGED, sccp_hint_handleFeatureChangeEvent, TRUE);
 #ifdef CS_USE_ASTERISK_DISTRIBUTED_DEVSTATE
@@ -215,6 +299,18 @@ void sccp_hint_module_start(void)
 void sccp_hint_module_stop(void)
 {
 	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_2 "SCCP: Stopping hint system\n");
+	{
+		int sched_id;
+
+		pbx_mutex_lock(&hint_notify_lock);
+		sched_id = hint_notify.sched_id;
+		hint_notify.sched_id = -1;
+		hint_notify.pending = NULL;
+		pbx_mutex_unlock(&hint_notify_lock);
+		if (sched_id > -1) {
+			iPbx.sched_del(sched_id);								/* outside of the lock, the callback takes it */
+		}
+	}
 	{
 		struct sccp_hint_lineState *lineState;
 
@@ -225,6 +321,7 @@ void sccp_hint_module_stop(void)
 			}
 			sccp_free(lineState);
 		}
+		sccp_hashtable_destroy(&lineStateIndex);
 		SCCP_LIST_UNLOCK(&lineStates);
 	}
 
@@ -246,6 +343,9 @@ void sccp_hint_module_stop(void)
 
 				if (device) {
 					sccp_device_release(&subscriber->device);		/* explicit release*/
+					if (subscriber->blfTemplate) {
+						sccp_free_packet(subscriber->blfTemplate);
+					}
 					sccp_free(subscriber);
 				}
 			}
@@ -254,6 +354,8 @@ void sccp_hint_module_stop(void)
 			iCallInfo.Destructor(&hint->callInfo);
 			sccp_free(hint);
 		}
+		sccp_hint_index_destroy(&lineIndex);
+		sccp_hint_index_destroy(&deviceIndex);
 		SCCP_LIST_UNLOCK(&sccp_hint_subscriptions);
 	}
 
@@ -462,9 +564,16 @@ static void sccp_hint_deviceUnRegistered(const char *deviceName)
 {
 	sccp_hint_list_t *hint = NULL;
 	sccp_hint_SubscribingDevice_t *subscriber;
+	sccp_hint_indexEntry_t *entry = NULL;
+	unsigned int idx;
 
 	SCCP_LIST_LOCK(&sccp_hint_subscriptions);
-	SCCP_LIST_TRAVERSE(&sccp_hint_subscriptions, hint, list) {
+	if (!(entry = sccp_hashtable_find(deviceIndex.table, deviceName))) {					/* device is not subscribed to any hint */
+		SCCP_LIST_UNLOCK(&sccp_hint_subscriptions);
+		return;
+	}
+	for (idx = 0; idx < entry->count; idx++) {
+		hint = entry->hints[idx];
 
 		/* All subscriptions that have this device should be removed */
 		SCCP_LIST_LOCK(&hint->subscribers);
@@ -473,12 +582,16 @@ static void sccp_hint_deviceUnRegistered(const char *deviceName)
 				sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_2 "%s: Freeing subscriber from hint exten: %s in %s\n", deviceName, hint->exten, hint->context);
 				SCCP_LIST_REMOVE_CURRENT(list);
 				sccp_device_release(&subscriber->device);		/* explicit release*/
+				if (subscriber->blfTemplate) {
+					sccp_free_packet(subscriber->blfTemplate);
+				}
 				sccp_free(subscriber);
 			}
 		}
 		SCCP_LIST_TRAVERSE_SAFE_END;
 		SCCP_LIST_UNLOCK(&hint->subscribers);
 	}
+	sccp_hint_index_remove(&deviceIndex, entry);
 	SCCP_LIST_UNLOCK(&sccp_hint_subscriptions);
 }
 
@@ -546,6 +659,7 @@ static void sccp_hint_addSubscription4Device(const sccp_device_t * device, const
 		}
 		SCCP_LIST_LOCK(&sccp_hint_subscriptions);
 		SCCP_LIST_INSERT_HEAD(&sccp_hint_subscriptions, hint, list);
+		sccp_hint_index_addLines(&lineIndex, hint);
 		SCCP_LIST_UNLOCK(&sccp_hint_subscriptions);
 	}
 
@@ -562,10 +676,17 @@ static void sccp_hint_addSubscription4Device(const sccp_device_t * device, const
 	subscriber->device = sccp_device_retain((sccp_device_t *) device);
 	subscriber->instance = instance;
 	subscriber->positionOnDevice = positionOnDevice;
+#ifdef CS_DYNAMIC_SPEEDDIAL
+	sccp_hint_subscriber_buildCache(subscriber, device);
+#endif
 
 	sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "%s: (sccp_hint_addSubscription4Device) Adding subscription for hint %s@%s\n", DEV_ID_LOG(device), hint->exten, hint->context);
 	SCCP_LIST_INSERT_HEAD(&hint->subscribers, subscriber, list);
 
+	SCCP_LIST_LOCK(&sccp_hint_subscriptions);
+	sccp_hint_index_add(&deviceIndex, device->id, hint);
+	SCCP_LIST_UNLOCK(&sccp_hint_subscriptions);
+
 	sccp_dev_set_keyset(device, subscriber->instance, 0, KEYMODE_ONHOOK);
 
 	sccp_hint_notifySubscribers(hint);
@@ -658,10 +779,9 @@ static void sccp_hint_attachLine(sccp_line_t * line, sccp_device_t * device)
 	struct sccp_hint_lineState *lineState = NULL;
 
 	SCCP_LIST_LOCK(&lineStates);
-	SCCP_LIST_TRAVERSE(&lineStates, lineState, list) {
-		if (lineState->line == line) {
-			break;
-		}
+	lineState = sccp_hashtable_find(lineStateIndex, line->name);
+	if (lineState && lineState->line && lineState->line != line) {	/* line has been recreated under the same name, take over its lineState */
+		sccp_line_release(&lineState->line);		/* explicit release*/
 	}
 	if (!lineState) {		/* create new lineState if necessary */
 		sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_3 "%s: (sccp_hint_attachLine) Create new hint_lineState for line: %s\n", DEV_ID_LOG(device), line->name);
@@ -671,7 +791,9 @@ static void sccp_hint_attachLine(sccp_line_t * line, sccp_device_t * device)
 			SCCP_LIST_UNLOCK(&lineStates);
 			return;
 		}
+		sccp_copy_string(lineState->name, line->name, sizeof(lineState->name));
 		SCCP_LIST_INSERT_HEAD(&lineStates, lineState, list);
+		sccp_hashtable_insert(lineStateIndex, lineState->name, lineState);
 	}
 
 	if (!lineState->line) {		/* retain one instance of line in lineState->line */
@@ -691,18 +813,14 @@ static void sccp_hint_detachLine(sccp_line_t * line, sccp_device_t * device)
 	if (line->statistic.numberOfActiveDevices == 0) {		/* release last instance of lineState->line */
 		//sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_3 "%s: (sccp_hint_detachLine) detaching line: %s, \n", DEV_ID_LOG(device), line->name);
 		SCCP_LIST_LOCK(&lineStates);
-		SCCP_LIST_TRAVERSE_SAFE_BEGIN(&lineStates, lineState, list) {
-			if (lineState->line == line) {
-				//sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "%s: (sccp_hint_detachLine) line: %s detached\n", DEV_ID_LOG(device), line->name);
-				if (lineState->line) {
-					sccp_line_release(&lineState->line);		/* explicit release*/
-				}
-				SCCP_LIST_REMOVE_CURRENT(list);
-				sccp_free(lineState)
-				break;
-			}
+		lineState = sccp_hashtable_find(lineStateIndex, line->name);
+		if (lineState && lineState->line == line) {
+			//sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "%s: (sccp_hint_detachLine) line: %s detached\n", DEV_ID_LOG(device), line->name);
+			sccp_hashtable_remove(lineStateIndex, lineState->name, lineState);
+			SCCP_LIST_REMOVE(&lineStates, lineState, list);
+			sccp_line_release(&lineState->line);		/* explicit release*/
+			sccp_free(lineState);
 		}
-		SCCP_LIST_TRAVERSE_SAFE_END;
 		SCCP_LIST_UNLOCK(&lineStates);
 	}
 }
@@ -718,10 +836,9 @@ static void sccp_hint_lineStatusChanged(sccp_line_t * line, sccp_device_t * devi
 	struct sccp_hint_lineState *lineState = NULL;
 
 	SCCP_LIST_LOCK(&lineStates);
-	SCCP_LIST_TRAVERSE(&lineStates, lineState, list) {
-		if (lineState->line == line) {
-			break;
-		}
+	lineState = sccp_hashtable_find(lineStateIndex, line->name);
+	if (lineState && lineState->line != line) {
+		lineState = NULL;
 	}
 	SCCP_LIST_UNLOCK(&lineStates);
 	
@@ -1097,15 +1214,209 @@ static enum ast_device_state sccp_hint_hint2DeviceState(sccp_channelstate_t stat
 }
 
 /* ========================================================================================================================= Subscriber Notify : Updates Speeddial */
+/* ========================================================================================================================= Subscriber Cache */
+#ifdef CS_DYNAMIC_SPEEDDIAL
+/*!
+ * \brief resolve the speeddial label of a subscriber and prebuild its BLF message
+ * \note called with the subscriber not yet added, or with hint->subscribers locked
+ */
+static void sccp_hint_subscriber_buildCache(sccp_hint_SubscribingDevice_t * subscriber, constDevicePtr d)
+{
+	sccp_speed_t k;
+	sccp_msg_t *msg = NULL;
+	int generation = ATOMIC_FETCH(&hint_cache_generation, &hint_notify_lock);				/* taken before resolving, a concurrent invalidate forces another rebuild */
+
+	if (subscriber->blfTemplate) {
+		sccp_free_packet(subscriber->blfTemplate);
+		subscriber->blfTemplate = NULL;
+	}
+	memset(&k, 0, sizeof(k));
+	sccp_dev_speed_find_byindex(d, subscriber->instance, TRUE, &k);
+	sccp_copy_string(subscriber->label, k.name, sizeof(subscriber->label));
+	subscriber->showCID = sccp_hint_isCIDavailabe(d, subscriber->positionOnDevice);
+	subscriber->dynamicSpeeddial = (d->inuseprotocolversion >= 15) ? TRUE : FALSE;
+	if (subscriber->dynamicSpeeddial) {
+		REQ(msg, FeatureStatDynamicMessage);
+		if (msg) {
+			msg->data.FeatureStatDynamicMessage.lel_featureIndex = htolel(subscriber->instance);
+			msg->data.FeatureStatDynamicMessage.lel_featureID = htolel(SKINNY_BUTTONTYPE_BLFSPEEDDIAL);
+			sccp_copy_string(msg->data.FeatureStatDynamicMessage.featureTextLabel, subscriber->label, sizeof(msg->data.FeatureStatDynamicMessage.featureTextLabel));
+			subscriber->blfTemplate = msg;
+		}
+	}
+	subscriber->cacheGeneration = generation;
+}
+#endif
+
+/*!
+ * \brief invalidate the cached speeddial labels and BLF messages of all subscribers (button configuration changed)
+ */
+void sccp_hint_invalidateSubscriptionCache(void)
+{
+	ATOMIC_INCR(&hint_cache_generation, 1, &hint_notify_lock);						/* called from the parallel config load threads */
+}
+
+/* ========================================================================================================================= Notification Batches */
+static void sccp_hint_batch_init(sccp_hint_batch_t * batch)
+{
+	batch->devices = sccp_hashtable_create(0, sccp_hash_string_nocase, sccp_hash_match_string_nocase);
+	batch->entries = NULL;
+}
+
+/*!
+ * \brief add a message for device d to the batch (sent right away when it cannot be batched)
+ */
+static void sccp_hint_batch_add(sccp_hint_batch_t * batch, constDevicePtr d, sccp_msg_t * msg)
+{
+	sccp_hint_batchEntry_t *entry = NULL;
+
+	if (!batch || !batch->devices) {
+		sccp_dev_send(d, msg);
+		return;
+	}
+	if (!(entry = sccp_hashtable_find(batch->devices, d->id))) {
+		if (!(entry = sccp_calloc(sizeof *entry, 1))) {
+			pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, DEV_ID_LOG(d));
+			sccp_dev_send(d, msg);
+			return;
+		}
+		if (!(entry->device = sccp_device_retain((sccp_device_t *) d)) || !sccp_hashtable_insert(batch->devices, entry->device->id, entry)) {
+			if (entry->device) {
+				sccp_device_release(&entry->device);					/* explicit release */
+			}
+			sccp_free(entry);
+			sccp_dev_send(d, msg);
+			return;
+		}
+		entry->next = batch->entries;
+		batch->entries = entry;
+	}
+	if (entry->count == entry->size) {
+		uint size = entry->size ? entry->size * 2 : 8;
+		sccp_msg_t **msgs = sccp_realloc(entry->msgs, size * sizeof(*msgs));
+
+		if (!msgs) {
+			pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, DEV_ID_LOG(d));
+			sccp_dev_send(d, msg);
+			return;
+		}
+		entry->msgs = msgs;
+		entry->size = size;
+	}
+	entry->msgs[entry->count++] = msg;
+}
+
+/*!
+ * \brief send the collected messages, one batch per device
+ */
+static void sccp_hint_batch_send(sccp_hint_batch_t * batch)
+{
+	sccp_hint_batchEntry_t *entry = NULL;
+	uint32_t messages = 0;
+	uint32_t batches = 0;
+
+	while ((entry = batch->entries)) {
+		batch->entries = entry->next;
+		if (entry->count) {
+			sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "%s: (sccp_hint_batch_send) sending %u hint message(s) in one batch\n", DEV_ID_LOG(entry->device), entry->count);
+			sccp_session_sendBatch(entry->device, entry->msgs, entry->count);
+			messages += entry->count;
+			batches++;
+		}
+		sccp_device_release(&entry->device);							/* explicit release */
+		sccp_free(entry->msgs);
+		sccp_free(entry);
+	}
+	sccp_hashtable_destroy(&batch->devices);
+
+	pbx_mutex_lock(&hint_notify_lock);
+	hint_notify.messages += messages;
+	hint_notify.batches += batches;
+	pbx_mutex_unlock(&hint_notify_lock);
+}
+
+/* ========================================================================================================================= Coalesced Notification */
+/*!
+ * \brief scheduled callback, closes the coalescing window and notifies the subscribers of all pending hints
+ */
+static int sccp_hint_notifyPending_cb(const void *data)
+{
+	sccp_hint_list_t *pending = NULL;
+	sccp_hint_list_t *hint = NULL;
+	sccp_hint_batch_t batch;
+
+	pbx_mutex_lock(&hint_notify_lock);
+	pending = hint_notify.pending;
+	hint_notify.pending = NULL;
+	hint_notify.sched_id = -1;
+	hint_notify.flushes++;
+	pbx_mutex_unlock(&hint_notify_lock);
+
+	sccp_hint_batch_init(&batch);
+	while ((hint = pending)) {
+		pbx_mutex_lock(&hint_notify_lock);							/* changes from here on open a new window for this hint */
+		pending = hint->notifyNext;
+		hint->notifyNext = NULL;
+		hint->notifyPending = FALSE;
+		pbx_mutex_unlock(&hint_notify_lock);
+		sccp_hint_notifySubscribersNow(hint, &batch);
+	}
+	sccp_hint_batch_send(&batch);
+	return 0;
+}
+
+/*!
+ * \brief notify the subscribers of hint
+ * \param hint SCCP Hint Linked List Pointer
+ *
+ * Within hint_notify_window, repeated changes of the same hint are merged, so that every subscriber (device, instance)
+ * only receives the latest state. All messages for the same device are sent in one batch.
+ */
+static void sccp_hint_notifySubscribers(sccp_hint_list_t * hint)
+{
+	sccp_hint_batch_t batch;
+	boolean_t scheduled = TRUE;
+
+	if (!hint) {
+		pbx_log(LOG_ERROR, "SCCP: (sccp_hint_notifySubscribers) no hint provided to notifySubscribers about\n");
+		return;
+	}
+
+	if (GLOB(hint_notify_window) > 0) {
+		pbx_mutex_lock(&hint_notify_lock);
+		if (hint->notifyPending) {
+			hint_notify.suppressed += SCCP_LIST_GETSIZE(&hint->subscribers);
+		} else {
+			hint->notifyPending = TRUE;
+			hint->notifyNext = hint_notify.pending;
+			hint_notify.pending = hint;
+			if (hint_notify.sched_id < 0 && (hint_notify.sched_id = iPbx.sched_add(GLOB(hint_notify_window), sccp_hint_notifyPending_cb, NULL)) < 0) {
+				scheduled = FALSE;
+			}
+		}
+		pbx_mutex_unlock(&hint_notify_lock);
+		if (!scheduled) {
+			sccp_hint_notifyPending_cb(NULL);							/* could not schedule, notify right away */
+		}
+		return;
+	}
+
+	sccp_hint_batch_init(&batch);
+	sccp_hint_notifySubscribersNow(hint, &batch);
+	sccp_hint_batch_send(&batch);
+}
+
 /*!
  * \brief send hint status to subscriber
  * \param hint SCCP Hint Linked List Pointer
+ * \param batch Notification Batch collecting the BLF messages
  *
  * \todo Check if the actual device still exists while going throughthe hint->subscribers and not pointing at rubish
  */
-static void sccp_hint_notifySubscribers(sccp_hint_list_t * hint)
+static void sccp_hint_notifySubscribersNow(sccp_hint_list_t * hint, sccp_hint_batch_t * batch)
 {
 	sccp_hint_SubscribingDevice_t *subscriber = NULL;
+	uint32_t notifications = 0;
 
 	if (!hint) {
 		pbx_log(LOG_ERROR, "SCCP: (sccp_hint_notifySubscribers) no hint provided to notifySubscribers about\n");
@@ -1119,109 +1430,103 @@ static void sccp_hint_notifySubscribers(sccp_hint_list_t * hint)
 
 	sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_3 "%s: (sccp_hint_notifySubscribers) notify %u subscriber(s) of %s's state %s\n", hint->exten, SCCP_LIST_GETSIZE(&hint->subscribers), hint->hint_dialplan, sccp_channelstate2str(hint->currentState));
 
-	SCCP_LIST_LOCK(&hint->subscribers);
-	SCCP_LIST_TRAVERSE(&hint->subscribers, subscriber, list) {
-		AUTO_RELEASE sccp_device_t *d = sccp_device_retain((sccp_device_t *) subscriber->device);
-
-		if (d) {
-			sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "%s: (sccp_hint_notifySubscribers) notify subscriber %s of %s's state %s (%d)\n", DEV_ID_LOG(d), d->id, hint->hint_dialplan, sccp_channelstate2str(hint->currentState), hint->currentState);
 #ifdef CS_DYNAMIC_SPEEDDIAL
-			sccp_msg_t *msg = NULL;
-			sccp_speed_t k;
-			char displayMessage[80] = "";
-			skinny_busylampfield_state_t status = SKINNY_BLF_STATUS_UNKNOWN;
-			if (d->inuseprotocolversion >= 15) {
-				sccp_dev_speed_find_byindex( d, subscriber->instance, TRUE, &k);
-
-				REQ(msg, FeatureStatDynamicMessage);
-				if (msg) {
-					char cidName[StationMaxNameSize] = "";
-					char cidNumber[StationMaxDirnumSize] = "";
-
-					switch (hint->currentState) {
-					case SCCP_CHANNELSTATE_DOWN:
-						snprintf(displayMessage, sizeof(displayMessage), "%s", k.name);
-						status = SKINNY_BLF_STATUS_UNKNOWN;	/* default state */
-						break;
+	/* BLF status and label prefix only depend on the hint, resolve them once for all subscribers */
+	skinny_busylampfield_state_t status = SKINNY_BLF_STATUS_UNKNOWN;
+	char prefix[StationMaxNameSize + 8] = "";
+	boolean_t prefixIsCID = FALSE;
 
-					case SCCP_CHANNELSTATE_ONHOOK:
-						snprintf(displayMessage, sizeof(displayMessage), "%s", k.name);
-						status = SKINNY_BLF_STATUS_IDLE;
-						break;
+	switch (hint->currentState) {
+		case SCCP_CHANNELSTATE_DOWN:
+			status = SKINNY_BLF_STATUS_UNKNOWN;	/* default state */
+			break;
 
-					case SCCP_CHANNELSTATE_DND:
-						//snprintf(displayMessage, sizeof(displayMessage), k.name, sizeof(displayMessage));
-						snprintf(displayMessage, sizeof(displayMessage), "(DND) %s", k.name);
-						status = SKINNY_BLF_STATUS_DND;	/* dnd */
-						break;
+		case SCCP_CHANNELSTATE_ONHOOK:
+			status = SKINNY_BLF_STATUS_IDLE;
+			break;
 
-					case SCCP_CHANNELSTATE_CONGESTION:
-						snprintf(displayMessage, sizeof(displayMessage), "%s", k.name);
-						status = SKINNY_BLF_STATUS_UNKNOWN;	/* device/line not found */
-						break;
+		case SCCP_CHANNELSTATE_DND:
+			snprintf(prefix, sizeof(prefix), "(DND) ");
+			status = SKINNY_BLF_STATUS_DND;	/* dnd */
+			break;
 
-					case SCCP_CHANNELSTATE_RINGING:
-						status = SKINNY_BLF_STATUS_ALERTING;	/* ringin */
-						/* fall through */
+		case SCCP_CHANNELSTATE_CONGESTION:
+			status = SKINNY_BLF_STATUS_UNKNOWN;	/* device/line not found */
+			break;
 
-					default:
-#ifdef CS_DYNAMIC_SPEEDDIAL
-						if (sccp_hint_isCIDavailabe(d, subscriber->positionOnDevice) == TRUE) {
-							if (hint->calltype == SKINNY_CALLTYPE_INBOUND) {
-								iCallInfo.Getter(hint->callInfo, 
-									SCCP_CALLINFO_CALLINGPARTY_NAME, &cidName, 
-									SCCP_CALLINFO_CALLINGPARTY_NUMBER, &cidNumber, 
-									SCCP_CALLINFO_KEY_SENTINEL);
-							} else {
-								iCallInfo.Getter(hint->callInfo, 
-									SCCP_CALLINFO_CALLEDPARTY_NAME, &cidName, 
-									SCCP_CALLINFO_CALLEDPARTY_NUMBER, &cidNumber, 
-									SCCP_CALLINFO_KEY_SENTINEL);
-							}
-							if (strlen(cidName) > 0) {
-								snprintf(displayMessage, sizeof(displayMessage), "%s %s %s", cidName, (SCCP_CHANNELSTATE_CONNECTED == hint->currentState) ? "<=>" : ((hint->calltype == SKINNY_CALLTYPE_OUTBOUND) ? "<-" : "->"), k.name);
-							} else if (strlen(cidNumber) > 0) {
-								snprintf(displayMessage, sizeof(displayMessage), "%s %s %s", cidNumber, (SCCP_CHANNELSTATE_CONNECTED == hint->currentState) ? "<=>" : ((hint->calltype == SKINNY_CALLTYPE_OUTBOUND) ? "<-" : "->"), k.name);
-							} else {
-								snprintf(displayMessage, sizeof(displayMessage), "%s", k.name);
-							}
-						} else 
+		case SCCP_CHANNELSTATE_RINGING:
+			status = SKINNY_BLF_STATUS_ALERTING;	/* ringin */
+			/* fall through */
+
+		default:
+			{
+				char cidName[StationMaxNameSize] = "";
+				char cidNumber[StationMaxDirnumSize] = "";
+				const char *direction = (SCCP_CHANNELSTATE_CONNECTED == hint->currentState) ? "<=>" : ((hint->calltype == SKINNY_CALLTYPE_OUTBOUND) ? "<-" : "->");
+
+				if (hint->calltype == SKINNY_CALLTYPE_INBOUND) {
+					iCallInfo.Getter(hint->callInfo, 
+						SCCP_CALLINFO_CALLINGPARTY_NAME, &cidName, 
+						SCCP_CALLINFO_CALLINGPARTY_NUMBER, &cidNumber, 
+						SCCP_CALLINFO_KEY_SENTINEL);
+				} else {
+					iCallInfo.Getter(hint->callInfo, 
+						SCCP_CALLINFO_CALLEDPARTY_NAME, &cidName, 
+						SCCP_CALLINFO_CALLEDPARTY_NUMBER, &cidNumber, 
+						SCCP_CALLINFO_KEY_SENTINEL);
+				}
+				if (strlen(cidName) > 0) {
+					snprintf(prefix, sizeof(prefix), "%s %s ", cidName, direction);
+				} else if (strlen(cidNumber) > 0) {
+					snprintf(prefix, sizeof(prefix), "%s %s ", cidNumber, direction);
+				}
+				prefixIsCID = TRUE;							/* only shown on buttons with room for the caller id */
+			}
+			if (status == SKINNY_BLF_STATUS_UNKNOWN) {	/* still default value --> set */
+				status = SKINNY_BLF_STATUS_INUSE;
+			}
+			break;
+	}
 #endif
-						{
-							snprintf(displayMessage, sizeof(displayMessage), "%s", k.name);
-						}
-						if (status == SKINNY_BLF_STATUS_UNKNOWN) {	/* still default value --> set */
-							status = SKINNY_BLF_STATUS_INUSE;
-						}
-						break;
-					}
-					sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "%s: (sccp_hint_notifySubscribers) set display name to: \"%s\"\n", DEV_ID_LOG(d), displayMessage);
-					sccp_copy_string(msg->data.FeatureStatDynamicMessage.featureTextLabel, displayMessage, sizeof(msg->data.FeatureStatDynamicMessage.featureTextLabel));
-					msg->data.FeatureStatDynamicMessage.featureTextLabel[strlen(displayMessage)-1] = '\0';
-					sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "%s: (sccp_hint_notifySubscribers) notify device: %s@%d state: %d(%d)\n", DEV_ID_LOG(d), DEV_ID_LOG(d), subscriber->instance, hint->currentState, msg->data.FeatureStatDynamicMessage.lel_featureStatus);
-					
-					msg->data.FeatureStatDynamicMessage.lel_featureIndex = htolel(subscriber->instance);
-					msg->data.FeatureStatDynamicMessage.lel_featureID = htolel(SKINNY_BUTTONTYPE_BLFSPEEDDIAL);
+
+	SCCP_LIST_LOCK(&hint->subscribers);
+	SCCP_LIST_TRAVERSE(&hint->subscribers, subscriber, list) {
+		AUTO_RELEASE sccp_device_t *d = sccp_device_retain((sccp_device_t *) subscriber->device);
+
+		if (d) {
+			notifications++;
+			sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "%s: (sccp_hint_notifySubscribers) notify subscriber %s of %s's state %s (%d)\n", DEV_ID_LOG(d), d->id, hint->hint_dialplan, sccp_channelstate2str(hint->currentState), hint->currentState);
+#ifdef CS_DYNAMIC_SPEEDDIAL
+			if (subscriber->cacheGeneration != ATOMIC_FETCH(&hint_cache_generation, &hint_notify_lock)) {				/* button configuration changed since the subscription */
+				sccp_hint_subscriber_buildCache(subscriber, d);
+			}
+			if (subscriber->dynamicSpeeddial) {
+				sccp_msg_t *msg = NULL;
+				char displayMessage[80] = "";
+				size_t len = 0;
+
+				snprintf(displayMessage, sizeof(displayMessage), "%s%s", (!prefixIsCID || subscriber->showCID) ? prefix : "", subscriber->label);
+				sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "%s: (sccp_hint_notifySubscribers) set display name to: \"%s\"\n", DEV_ID_LOG(d), displayMessage);
+				sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "%s: (sccp_hint_notifySubscribers) notify device: %s@%d state: %d(%d)\n", DEV_ID_LOG(d), DEV_ID_LOG(d), subscriber->instance, hint->currentState, status);
+
+				/*!
+				* hack to fix the white text without shadow issue -MC
+				*
+				* first send a label which is 1-character shorter than the correct one. 
+				* then send another message with a longer label (correct/final label) will force an update (in white over the back drop in black)
+				*/
+				if (subscriber->blfTemplate && (msg = sccp_clone_packet(subscriber->blfTemplate))) {
 					msg->data.FeatureStatDynamicMessage.lel_featureStatus = htolel(status);
-					
-					/*!
-					* hack to fix the white text without shadow issue -MC
-					*
-					* first send a label which is 1-character shorter than the correct one. 
-					* then send another message with a longer label (correct/final label) will force an update (in white over the back drop in black)
-					*/
-					sccp_dev_send(d, msg);
-					
-					
-					REQ(msg, FeatureStatDynamicMessage);
 					sccp_copy_string(msg->data.FeatureStatDynamicMessage.featureTextLabel, displayMessage, sizeof(msg->data.FeatureStatDynamicMessage.featureTextLabel));
-					msg->data.FeatureStatDynamicMessage.lel_featureIndex = htolel(subscriber->instance);
-					msg->data.FeatureStatDynamicMessage.lel_featureID = htolel(SKINNY_BUTTONTYPE_BLFSPEEDDIAL);
+					if ((len = strlen(msg->data.FeatureStatDynamicMessage.featureTextLabel)) > 0) {
+						msg->data.FeatureStatDynamicMessage.featureTextLabel[len - 1] = '\0';
+					}
+					sccp_hint_batch_add(batch, d, msg);
+				}
+				if (subscriber->blfTemplate && (msg = sccp_clone_packet(subscriber->blfTemplate))) {
 					msg->data.FeatureStatDynamicMessage.lel_featureStatus = htolel(status);
-					
-					sccp_dev_send(d, msg);
-				} else {
-					sccp_free(msg);
+					sccp_copy_string(msg->data.FeatureStatDynamicMessage.featureTextLabel, displayMessage, sizeof(msg->data.FeatureStatDynamicMessage.featureTextLabel));
+					sccp_hint_batch_add(batch, d, msg);
 				}
 			} else
 #endif
@@ -1304,6 +1609,10 @@ static void sccp_hint_notifySubscribers(sccp_hint_list_t * hint)
 		}
 	}
 	SCCP_LIST_UNLOCK(&hint->subscribers);
+
+	pbx_mutex_lock(&hint_notify_lock);
+	hint_notify.notifications += notifications;
+	pbx_mutex_unlock(&hint_notify_lock);
 }
 
 /* ========================================================================================================================= PBX Notify */
@@ -1337,33 +1646,111 @@ static void sccp_hint_notifySubscribersViaPbx(sccp_hint_list_t *hint, struct scc
 #endif /* CS_USE_ASTERISK_DISTRIBUTED_DEVSTATE */ 
 }
 
-/* ========================================================================================================================= PBX Notify */
+/* ========================================================================================================================= Hint Indexes */
+/*!
+ * \brief initialize a hint index
+ */
+static void sccp_hint_index_init(struct sccp_hint_index *index)
+{
+	index->table = sccp_hashtable_create(0, sccp_hash_string_nocase, sccp_hash_match_string_nocase);
+	SCCP_LIST_HEAD_INIT(&index->entries);
+}
+
+/*!
+ * \brief free all entries of a hint index (the hints themselves are not owned by the index)
+ */
+static void sccp_hint_index_destroy(struct sccp_hint_index *index)
+{
+	sccp_hint_indexEntry_t *entry = NULL;
+
+	while ((entry = SCCP_LIST_REMOVE_HEAD(&index->entries, list))) {
+		sccp_free(entry->hints);
+		sccp_free(entry);
+	}
+	SCCP_LIST_HEAD_DESTROY(&index->entries);
+	sccp_hashtable_destroy(&index->table);
+}
+
 /*!
- * \brief helper function to parse aggegated hint_dialplan to search for a match with lineName
+ * \brief add hint to the index entry for name, creating the entry if necessary
+ * \note called with sccp_hint_subscriptions locked
+ */
+static boolean_t sccp_hint_index_add(struct sccp_hint_index *index, const char *name, sccp_hint_list_t * hint)
+{
+	sccp_hint_indexEntry_t *entry = NULL;
+	unsigned int idx;
+
+	if (!index->table || sccp_strlen_zero(name) || sccp_strlen(name) >= sizeof(entry->name)) {
+		return FALSE;
+	}
+	if (!(entry = sccp_hashtable_find(index->table, name))) {
+		if (!(entry = sccp_calloc(sizeof *entry, 1))) {
+			pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+			return FALSE;
+		}
+		sccp_copy_string(entry->name, name, sizeof(entry->name));
+		if (!sccp_hashtable_insert(index->table, entry->name, entry)) {
+			sccp_free(entry);
+			return FALSE;
+		}
+		SCCP_LIST_INSERT_HEAD(&index->entries, entry, list);
+	}
+	for (idx = 0; idx < entry->count; idx++) {
+		if (entry->hints[idx] == hint) {
+			return TRUE;
+		}
+	}
+	if (entry->count == entry->size) {
+		unsigned int size = entry->size ? entry->size * 2 : 4;
+		sccp_hint_list_t **hints = sccp_realloc(entry->hints, size * sizeof(*hints));
+
+		if (!hints) {
+			pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+			return FALSE;
+		}
+		entry->hints = hints;
+		entry->size = size;
+	}
+	entry->hints[entry->count++] = hint;
+	return TRUE;
+}
+
+/*!
+ * \brief remove and free an index entry
+ * \note called with sccp_hint_subscriptions locked
+ */
+static void sccp_hint_index_remove(struct sccp_hint_index *index, sccp_hint_indexEntry_t * entry)
+{
+	sccp_hashtable_remove(index->table, entry->name, entry);
+	SCCP_LIST_REMOVE(&index->entries, entry, list);
+	sccp_free(entry->hints);
+	sccp_free(entry);
+}
+
+/*!
+ * \brief parse aggegated hint_dialplan and add the hint to the line index for every SCCP line it refers to
  *
  * \note: We need to be able to parse a hint like this:
  * exten => 112,hint, SIP/123&Meetme:444&SCCP/98011&SCCP/98031&Custom:DND112,CustomPresence:112,Meetme:444
- * and match on the lineName we are looking for, i.e.: SCCP/98011 and SCCP/98031
+ * and index it under the lineNames it refers to, i.e.: 98011 and 98031
  */
-static boolean_t sccp_match_dialplan2lineName(char *hint_app, char *lineName)
+static void sccp_hint_index_addLines(struct sccp_hint_index *index, sccp_hint_list_t * hint)
 {
-	char *rest = strdupa(hint_app);
-        char *cur;
-        char *tmp;
-
-        // get the device portion of the hint string
-        if ((tmp = strrchr(rest, ','))) {
-                *tmp = '\0';
-        }
-        
-        // check for match for aggregated entry
-        while ((cur = strsep(&rest, "&"))) {
-        	if (sccp_strcaseequals(cur, lineName)) {
-			//sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_3 "SCCP: (parse_hint_device) cur:%s matches lineName:%s\n", cur, lineName);
-        		return TRUE;
-        	}
-        }
-        return FALSE;
+	char *rest = pbx_strdupa(hint->hint_dialplan);
+	char *cur;
+	char *tmp;
+
+	// get the device portion of the hint string
+	if ((tmp = strrchr(rest, ','))) {
+		*tmp = '\0';
+	}
+
+	// index every SCCP entry of the aggregate
+	while ((cur = strsep(&rest, "&"))) {
+		if (!strncasecmp(cur, "SCCP/", 5)) {
+			sccp_hint_index_add(index, cur + 5, hint);
+		}
+	}
 }
 
 /*
@@ -1377,6 +1764,8 @@ static boolean_t sccp_match_dialplan2lineName(char *hint_app, char *lineName)
 static void sccp_hint_notifyLineStateUpdate(struct sccp_hint_lineState *lineState)
 {
 	sccp_hint_list_t *hint = NULL;
+	sccp_hint_indexEntry_t *entry = NULL;
+	unsigned int idx;
 	char lineName[StationMaxNameSize + 5];
 
 	{
@@ -1390,36 +1779,36 @@ static void sccp_hint_notifyLineStateUpdate(struct sccp_hint_lineState *lineStat
 	enum ast_device_state newDeviceState = sccp_hint_hint2DeviceState(lineState->state);
 	enum ast_device_state oldDeviceState = AST_DEVICE_UNKNOWN;
 
-	/* Local Update */
+	/* Local Update: only the hints referring to this line */
  	SCCP_LIST_LOCK(&sccp_hint_subscriptions);
-	SCCP_LIST_TRAVERSE(&sccp_hint_subscriptions, hint, list) {
-		if (!sccp_strlen_zero(hint->hint_dialplan) && sccp_match_dialplan2lineName(hint->hint_dialplan, lineName)) {
-			sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "SCCP: (sccp_hint_notifyLineStateUpdate) matched lineName:%s to dialplan:%s\n", lineName, hint->hint_dialplan);
-
-			hint->calltype = lineState->callInfo.calltype;
-			if (hint->calltype == SKINNY_CALLTYPE_INBOUND) {
-				iCallInfo.Setter(hint->callInfo, 
-					SCCP_CALLINFO_CALLINGPARTY_NAME, lineState->callInfo.partyName,
-					SCCP_CALLINFO_CALLINGPARTY_NUMBER, lineState->callInfo.partyNumber,
-					SCCP_CALLINFO_KEY_SENTINEL);
-			} else {
-				iCallInfo.Setter(hint->callInfo, 
-					SCCP_CALLINFO_CALLEDPARTY_NAME, lineState->callInfo.partyName,
-					SCCP_CALLINFO_CALLEDPARTY_NUMBER, lineState->callInfo.partyNumber,
-					SCCP_CALLINFO_KEY_SENTINEL);
-			}
-			oldDeviceState = sccp_hint_hint2DeviceState(hint->currentState);
+	entry = sccp_hashtable_find(lineIndex.table, lineName + 5);
+	for (idx = 0; entry && idx < entry->count; idx++) {
+		hint = entry->hints[idx];
+		sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_4 "SCCP: (sccp_hint_notifyLineStateUpdate) matched lineName:%s to dialplan:%s\n", lineName, hint->hint_dialplan);
 
-			sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_3 "SCCP: (sccp_hint_notifyLineStateUpdate) Notify asterisk to set state to sccp channelstate '%s' (%d) on line 'SCCP/%s'\n", sccp_channelstate2str(lineState->state), lineState->state, lineState->line->name);
-			sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_3 "SCCP: (sccp_hint_notifyLineStateUpdate) => asterisk: '%s' (%d) => '%s' (%d) on line SCCP/%s\n", pbxsccp_devicestate2str(oldDeviceState), oldDeviceState, pbxsccp_devicestate2str(newDeviceState), newDeviceState, lineState->line->name);
-			if (newDeviceState == oldDeviceState) {
-				sccp_hint_notifySubscribers(hint);								/* shortcut to inform sccp subscribers about cid update changes only */
-			} else {
-				sccp_hint_notifySubscribersViaPbx(hint, lineState, lineName, newDeviceState);			/* go through pbx to inform subscribers about both state and cid */
-			}
-			
-			/*! note: do not break after the first match, but update all matching hints */
+		hint->calltype = lineState->callInfo.calltype;
+		if (hint->calltype == SKINNY_CALLTYPE_INBOUND) {
+			iCallInfo.Setter(hint->callInfo, 
+				SCCP_CALLINFO_CALLINGPARTY_NAME, lineState->callInfo.partyName,
+				SCCP_CALLINFO_CALLINGPARTY_NUMBER, lineState->callInfo.partyNumber,
+				SCCP_CALLINFO_KEY_SENTINEL);
+		} else {
+			iCallInfo.Setter(hint->callInfo, 
+				SCCP_CALLINFO_CALLEDPARTY_NAME, lineState->callInfo.partyName,
+				SCCP_CALLINFO_CALLEDPARTY_NUMBER, lineState->callInfo.partyNumber,
+				SCCP_CALLINFO_KEY_SENTINEL);
 		}
+		oldDeviceState = sccp_hint_hint2DeviceState(hint->currentState);
+
+		sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_3 "SCCP: (sccp_hint_notifyLineStateUpdate) Notify asterisk to set state to sccp channelstate '%s' (%d) on line 'SCCP/%s'\n", sccp_channelstate2str(lineState->state), lineState->state, lineState->line->name);
+		sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_3 "SCCP: (sccp_hint_notifyLineStateUpdate) => asterisk: '%s' (%d) => '%s' (%d) on line SCCP/%s\n", pbxsccp_devicestate2str(oldDeviceState), oldDeviceState, pbxsccp_devicestate2str(newDeviceState), newDeviceState, lineState->line->name);
+		if (newDeviceState == oldDeviceState) {
+			sccp_hint_notifySubscribers(hint);								/* shortcut to inform sccp subscribers about cid update changes only */
+		} else {
+			sccp_hint_notifySubscribersViaPbx(hint, lineState, lineName, newDeviceState);			/* go through pbx to inform subscribers about both state and cid */
+		}
+		
+		/*! note: do not break after the first match, but update all matching hints */
 	}
 	SCCP_LIST_UNLOCK(&sccp_hint_subscriptions);
 	sccp_log((DEBUGCAT_HINT)) (VERBOSE_PREFIX_3 "SCCP: (sccp_hint_notifyLineStateUpdate) Notified asterisk to set state to sccp channelstate '%s' (%d) => asterisk: '%s' (%d) on channel SCCP/%s\n", sccp_channelstate2str(lineState->state), lineState->state, pbxsccp_devicestate2str(newDeviceState), newDeviceState, lineState->line->name);
@@ -1486,14 +1875,12 @@ sccp_channelstate_t sccp_hint_getLinestate(const char *linename, const char *dev
 	sccp_channelstate_t state = SCCP_CHANNELSTATE_CONGESTION;
 
 	SCCP_LIST_LOCK(&lineStates);
-	SCCP_LIST_TRAVERSE(&lineStates, lineState, list) {
-		if (lineState->line && sccp_strcaseequals(lineState->line->name, linename)) {
-                	sccp_log(DEBUGCAT_HINT)(VERBOSE_PREFIX_3 "%s (getLinestate) state:%s, party:%s/%s, calltype:%s\n", lineState->line->name, sccp_channelstate2str(lineState->state),
-                	        lineState->callInfo.partyNumber,lineState->callInfo.partyName,
-                	        (!SCCP_CHANNELSTATE_Idling(lineState->state) && lineState->callInfo.calltype) ? skinny_calltype2str(lineState->callInfo.calltype) : "INACTIVE");
-                        state = lineState->state;
-			break;
-		}
+	lineState = sccp_hashtable_find(lineStateIndex, linename);
+	if (lineState && lineState->line) {
+		sccp_log(DEBUGCAT_HINT)(VERBOSE_PREFIX_3 "%s (getLinestate) state:%s, party:%s/%s, calltype:%s\n", lineState->line->name, sccp_channelstate2str(lineState->state),
+			lineState->callInfo.partyNumber,lineState->callInfo.partyName,
+			(!SCCP_CHANNELSTATE_Idling(lineState->state) && lineState->callInfo.calltype) ? skinny_calltype2str(lineState->callInfo.calltype) : "INACTIVE");
+		state = lineState->state;
 	}
 	SCCP_LIST_UNLOCK(&lineStates);
 	return state;
@@ -1601,4 +1988,174 @@ int sccp_show_hint_subscriptions(int fd, sccp_cli_totals_t *totals, struct manse
 	return RESULT_SUCCESS;
 }
 
+/*!
+ * \brief Show Hint Notification Statistics
+ * \param fd Fd as int
+ * \param totals Total number of lines as int
+ * \param s AMI Session
+ * \param m Message
+ * \param argc Argc as int
+ * \param argv[] Argv[] as char
+ * \return Result as int
+ *
+ * \called_from_asterisk
+ */
+int sccp_show_hint_stats(int fd, sccp_cli_totals_t *totals, struct mansession *s, const struct message *m, int argc, char *argv[])
+{
+	int local_line_total = 0;
+	const char *actionid = "";
+	uint32_t notifications, suppressed, messages, batches, flushes;
+
+	pbx_mutex_lock(&hint_notify_lock);
+	notifications = hint_notify.notifications;
+	suppressed = hint_notify.suppressed;
+	messages = hint_notify.messages;
+	batches = hint_notify.batches;
+	flushes = hint_notify.flushes;
+	pbx_mutex_unlock(&hint_notify_lock);
+
+	if (!s) {
+		CLI_AMI_OUTPUT(fd, s, "\n--- SCCP hint notifications ----------------------------------------------------------------------------------------------\n");
+	} else {
+		astman_append(s, "Response: Success\r\n");
+		astman_append(s, "Message: SCCPHintStats\r\n");
+		actionid = astman_get_header(m, "ActionID");
+		if (!pbx_strlen_zero(actionid)) {
+			astman_append(s, "ActionID: %s\r\n", actionid);
+		}
+		local_line_total++;
+	}
+	CLI_AMI_OUTPUT_PARAM("Coalescing Window", CLI_AMI_LIST_WIDTH, "%d ms", GLOB(hint_notify_window));
+	CLI_AMI_OUTPUT_PARAM("Hint Subscriptions", CLI_AMI_LIST_WIDTH, "%d", SCCP_LIST_GETSIZE(&sccp_hint_subscriptions));
+	CLI_AMI_OUTPUT_PARAM("Notifications Sent", CLI_AMI_LIST_WIDTH, "%u", notifications);
+	CLI_AMI_OUTPUT_PARAM("Notifications Suppressed", CLI_AMI_LIST_WIDTH, "%u (in %u windows)", suppressed, flushes);
+	CLI_AMI_OUTPUT_PARAM("Batched Messages", CLI_AMI_LIST_WIDTH, "%u in %u device writes", messages, batches);
+
+	if (s) {
+		totals->lines = local_line_total;
+	}
+	return RESULT_SUCCESS;
+}
+
+#if CS_TEST_FRAMEWORK
+#include <asterisk/test.h>
+#define test_category "/channels/chan_sccp/hint/"
+
+/* old path: match lineName against every token of the aggregated hint_dialplan */
+static boolean_t sccp_hint_test_matchDialplan(const char *hint_app, const char *lineName)
+{
+	char *rest = pbx_strdupa(hint_app);
+	char *cur;
+	char *tmp;
+
+	if ((tmp = strrchr(rest, ','))) {
+		*tmp = '\0';
+	}
+	while ((cur = strsep(&rest, "&"))) {
+		if (sccp_strcaseequals(cur, lineName)) {
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+AST_TEST_DEFINE(sccp_hint_storm_benchmark)
+{
+	SCCP_LIST_HEAD (, sccp_hint_list_t) hints;
+	struct sccp_hint_index index;
+	sccp_hint_list_t *hint_objects = NULL;
+	sccp_hint_list_t *hint = NULL;
+	sccp_hint_indexEntry_t *entry = NULL;
+	const int num_hints = 8000;
+	const int num_changes = 2000;
+	char lineName[StationMaxNameSize + 5];
+	struct timeval start;
+	int64_t linear_ms, indexed_ms;
+	int linear_found = 0, indexed_found = 0;
+	int i;
+
+	switch (cmd) {
+		case TEST_INIT:
+			info->name = "storm_benchmark";
+			info->category = test_category;
+			info->summary = "chan-sccp-b hint storm benchmark";
+			info->description = "chan-sccp-b compare matching line state changes against all hints with the line and device hint indexes (8k hints)";
+			return AST_TEST_NOT_RUN;
+		case TEST_EXECUTE:
+			break;
+	}
+
+	pbx_test_validate(test, (hint_objects = sccp_calloc(sizeof(sccp_hint_list_t), num_hints)) != NULL);
+	SCCP_LIST_HEAD_INIT(&hints);
+	sccp_hint_index_init(&index);
+	pbx_test_validate(test, index.table != NULL);
+	for (i = 0; i < num_hints; i++) {
+		if (i % 10) {
+			snprintf(hint_objects[i].hint_dialplan, sizeof(hint_objects[i].hint_dialplan), "SCCP/%05d", i);
+		} else {												/* every 10th hint aggregates a foreign device and the next line */
+			snprintf(hint_objects[i].hint_dialplan, sizeof(hint_objects[i].hint_dialplan), "SIP/%05d&SCCP/%05d&SCCP/%05d,CustomPresence:%05d", i, i, (i + 1) % num_hints, i);
+		}
+		SCCP_LIST_INSERT_TAIL(&hints, &hint_objects[i], list);
+		sccp_hint_index_addLines(&index, &hint_objects[i]);
+	}
+	pbx_test_validate(test, sccp_hashtable_size(index.table) == (unsigned int) num_hints);
+	pbx_test_validate(test, (entry = sccp_hashtable_find(index.table, "00011")) != NULL && entry->count == 2);
+	pbx_test_validate(test, sccp_hashtable_find(index.table, "CustomPresence:00010") == NULL);
+
+	/* old path: every line state change walks all hints */
+	start = pbx_tvnow();
+	for (i = 0; i < num_changes; i++) {
+		snprintf(lineName, sizeof(lineName), "SCCP/%05d", (i * 7919) % num_hints);
+		SCCP_LIST_TRAVERSE(&hints, hint, list) {
+			if (sccp_hint_test_matchDialplan(hint->hint_dialplan, lineName)) {
+				linear_found++;
+			}
+		}
+	}
+	linear_ms = ast_tvdiff_ms(pbx_tvnow(), start);
+
+	/* new path: line index */
+	start = pbx_tvnow();
+	for (i = 0; i < num_changes; i++) {
+		snprintf(lineName, sizeof(lineName), "SCCP/%05d", (i * 7919) % num_hints);
+		if ((entry = sccp_hashtable_find(index.table, lineName + 5))) {
+			indexed_found += entry->count;
+		}
+	}
+	indexed_ms = ast_tvdiff_ms(pbx_tvnow(), start);
+	pbx_test_validate(test, linear_found == indexed_found);
+	pbx_test_status_update(test, "%d hints, %d line state changes (%d hint updates): linear %6" PRId64 " ms, indexed %6" PRId64 " ms\n", num_hints, num_changes, indexed_found, linear_ms, indexed_ms);
+	sccp_hint_index_destroy(&index);
+
+	/* device index: subscriptions are recorded once per hint and dropped as a whole on unregister */
+	sccp_hint_index_init(&index);
+	for (i = 0; i < num_hints; i++) {
+		snprintf(lineName, sizeof(lineName), "SEP%012X", i % 500);
+		pbx_test_validate(test, sccp_hint_index_add(&index, lineName, &hint_objects[i]));
+		pbx_test_validate(test, sccp_hint_index_add(&index, lineName, &hint_objects[i]));
+	}
+	pbx_test_validate(test, sccp_hashtable_size(index.table) == 500);
+	pbx_test_validate(test, (entry = sccp_hashtable_find(index.table, "sep00000000002a")) != NULL && entry->count == (unsigned int) num_hints / 500);
+	sccp_hint_index_remove(&index, entry);
+	pbx_test_validate(test, sccp_hashtable_find(index.table, "SEP00000000002A") == NULL);
+	pbx_test_validate(test, SCCP_LIST_GETSIZE(&index.entries) == 499);
+	sccp_hint_index_destroy(&index);
+
+	while (SCCP_LIST_REMOVE_HEAD(&hints, list));
+	SCCP_LIST_HEAD_DESTROY(&hints);
+	sccp_free(hint_objects);
+	return AST_TEST_PASS;
+}
+
+static void __attribute__((constructor)) sccp_register_tests(void)
+{
+	AST_TEST_REGISTER(sccp_hint_storm_benchmark);
+}
+
+static void __attribute__((destructor)) sccp_unregister_tests(void)
+{
+	AST_TEST_UNREGISTER(sccp_hint_storm_benchmark);
+}
+#endif
+
 // kate: indent-width 8; replace-tabs off; indent-mode cstyle; auto-insert-doxygen on; line-numbers on; tab-indents on; keep-extra-spaces off; auto-brackets off;
@@ -49,6 +49,8 @@ void sccp_line_pre_reload(void)
 				sccp_line_removeDevice(linedevice->line, linedevice->device);
 			}
 			SCCP_LIST_TRAVERSE_SAFE_END;
+		} else if (l->configUnchanged) {								/* section unchanged, leave the line alone */
+			continue;
 		} else {											/* Don't want to include the hotline line */
 #ifdef CS_SCCP_REALTIME
 			if (l->realtime == FALSE)
@@ -171,6 +173,7 @@ void sccp_line_addToGlobals(sccp_line_t * line)
 		/* add to list */
 		sccp_line_retain(l);										/* add retained line to the list */
 		SCCP_RWLIST_INSERT_SORTALPHA(&GLOB(lines), l, list, cid_num);
+		sccp_hashtable_insert(GLOB(line_index), l->name, l);
 		sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "Added line '%s' to Glob(lines)\n", l->name);
 
 		/* emit event */
@@ -184,6 +187,64 @@ void sccp_line_addToGlobals(sccp_line_t * line)
 	SCCP_RWLIST_UNLOCK(&GLOB(lines));
 }
 
+static int sccp_line_sortcmp(const void *a, const void *b)
+{
+	return sccp_strversioncmp((*(sccp_line_t * const *) a)->cid_num, (*(sccp_line_t * const *) b)->cid_num);
+}
+
+/*!
+ * Add a batch of lines to the global line list, taking the list lock only once.
+ * \param lines array of lines (sorted in place)
+ * \param count number of lines in the array
+ *
+ * The batch is sorted first and then merged into the sorted list in one pass, instead of walking the list for every line.
+ *
+ * \note needs to be called with retained lines
+ * \note adds a retained line to the list for every entry (refcount + 1)
+ */
+void sccp_line_addBatchToGlobals(sccp_line_t ** lines, uint count)
+{
+	sccp_line_t *cur = NULL;
+	sccp_line_t *prev = NULL;
+	sccp_line_t *l = NULL;
+	uint i;
+
+	if (!lines || !count) {
+		return;
+	}
+	qsort(lines, count, sizeof(*lines), sccp_line_sortcmp);
+
+	SCCP_RWLIST_WRLOCK(&GLOB(lines));
+	cur = SCCP_RWLIST_FIRST(&GLOB(lines));
+	for (i = 0; i < count; i++) {
+		if (!(l = sccp_line_retain(lines[i]))) {						/* add retained line to the list */
+			continue;
+		}
+		while (cur && sccp_strversioncmp(cur->cid_num, l->cid_num) < 0) {
+			cur = SCCP_RWLIST_NEXT(cur, list);
+		}
+		if (!cur) {
+			SCCP_RWLIST_INSERT_TAIL(&GLOB(lines), l, list);
+		} else if (!(prev = cur->list.prev)) {
+			SCCP_RWLIST_INSERT_HEAD(&GLOB(lines), l, list);
+		} else {
+			SCCP_RWLIST_INSERT_AFTER(&GLOB(lines), prev, l, list);
+		}
+		sccp_hashtable_insert(GLOB(line_index), l->name, l);
+	}
+	SCCP_RWLIST_UNLOCK(&GLOB(lines));
+	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "Added %u lines to Glob(lines)\n", count);
+
+	/* emit events, outside of the list lock */
+	for (i = 0; i < count; i++) {
+		sccp_event_t event = {{{0}}};
+		event.type = SCCP_EVENT_LINE_CREATED;
+		if ((event.event.lineCreated.line = sccp_line_retain(lines[i]))) {
+			sccp_event_fire(&event);
+		}
+	}
+}
+
 /*!
  * Remove a line from the global line list.
  * \param line SCCP line pointer
@@ -196,7 +257,9 @@ void sccp_line_removeFromGlobals(sccp_line_t * line)
 	sccp_line_t *removed_line = NULL;
 	if (line) {
 		SCCP_RWLIST_WRLOCK(&GLOB(lines));
-		removed_line = SCCP_RWLIST_REMOVE(&GLOB(lines), line, list);
+		if ((removed_line = SCCP_RWLIST_REMOVE(&GLOB(lines), line, list))) {
+			sccp_hashtable_remove(GLOB(line_index), removed_line->name, removed_line);
+		}
 		SCCP_RWLIST_UNLOCK(&GLOB(lines));
 
 		sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "Removed line '%s' from Glob(lines)\n", removed_line->name);
@@ -372,6 +435,7 @@ int __sccp_line_destroy(const void *ptr)
 
 	SCCP_LIST_LOCK(&l->channels);
 	while ((c = SCCP_LIST_REMOVE_HEAD(&l->channels, list))) {
+		sccp_channel_removeFromIndex(c);
 		sccp_channel_endcall(c);
 		sccp_channel_release(&c);									// explicit release channel retain in list
 	}
@@ -678,6 +742,7 @@ void sccp_line_addChannel(constLinePtr line, constChannelPtr channel)
 			} else {
 				SCCP_LIST_INSERT_HEAD(&l->channels, c, list);					// add to list
 			}
+			sccp_channel_addToIndex(c);
 		}
 		SCCP_LIST_UNLOCK(&l->channels);
 	}
@@ -704,6 +769,7 @@ void sccp_line_removeChannel(sccp_line_t * line, sccp_channel_t * channel)
 	if (l) {
 		SCCP_LIST_LOCK(&l->channels);
 		if ((c = SCCP_LIST_REMOVE(&l->channels, channel, list))) {
+			sccp_channel_removeFromIndex(c);
 			sccp_log((DEBUGCAT_LINE)) (VERBOSE_PREFIX_1 "SCCP: Removing channel %d from line %s\n", c->callid, l->name);
 			sccp_channel_release(&c);					/* explicit release of channel from list */
 		}
@@ -850,7 +916,9 @@ sccp_line_t *sccp_line_find_byname(const char *name, uint8_t useRealtime)
 	sccp_line_t *l = NULL;
 
 	SCCP_RWLIST_RDLOCK(&GLOB(lines));
-	l = SCCP_RWLIST_FIND(&GLOB(lines), sccp_line_t, tmpl, list, (sccp_strcaseequals(tmpl->name, name)), TRUE, __FILE__, __LINE__, __PRETTY_FUNCTION__);
+	if ((l = sccp_hashtable_find(GLOB(line_index), name))) {
+		l = sccp_line_retain(l);
+	}
 	SCCP_RWLIST_UNLOCK(&GLOB(lines));
 #ifdef CS_SCCP_REALTIME
 	if (!l && useRealtime) {
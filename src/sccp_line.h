@@ -97,6 +97,8 @@ struct sccp_line {
 	/* this is for reload routines */
 	boolean_t pendingDelete;										/*!< this bit will tell the scheduler to delete this line when unused */
 	boolean_t pendingUpdate;										/*!< this bit will tell the scheduler to update this line when unused */
+	uint32_t configHash;											/*!< hash of the sccp.conf section (and [general]) this line was last built from (0: not built from sccp.conf) */
+	boolean_t configUnchanged;										/*!< section did not change since the last (re)load, skipped by the running reload */
 };														/*!< SCCP Line Structure */
 
 /*!
@@ -141,6 +143,7 @@ SCCP_API void SCCP_CALL sccp_line_post_reload(void);
 SCCP_API void * SCCP_CALL sccp_create_hotline(void);
 SCCP_API sccp_line_t * SCCP_CALL sccp_line_create(const char *name);
 SCCP_API void SCCP_CALL sccp_line_addToGlobals(sccp_line_t * line);
+SCCP_API void SCCP_CALL sccp_line_addBatchToGlobals(sccp_line_t ** lines, uint count);
 SCCP_API void SCCP_CALL sccp_line_removeFromGlobals(sccp_line_t * line);
 SCCP_API void SCCP_CALL sccp_line_addDevice(sccp_line_t * line, sccp_device_t * d, uint8_t lineInstance, sccp_subscription_id_t *subscriptionId);
 SCCP_API void SCCP_CALL sccp_line_removeDevice(sccp_line_t * l, sccp_device_t * device);
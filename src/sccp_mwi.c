@@ -12,7 +12,9 @@
 #include "sccp_mwi.h"
 #include "sccp_atomic.h"
 #include "sccp_channel.h"
+#include "sccp_hash.h"
 #include "sccp_line.h"
+#include "sccp_session.h"
 #include "sccp_utils.h"
 
 SCCP_FILE_VERSION(__FILE__, "");
@@ -27,6 +29,7 @@ SCCP_FILE_VERSION(__FILE__, "");
 #ifndef CS_AST_HAS_EVENT
 #define SCCP_MWI_CHECK_INTERVAL 30
 #endif
+#define SCCP_MWI_NOTIFY_INTERVAL 100										/* ms, mailbox updates within this window are sent to a device in one go */
 
 /*!
  * \brief SCCP Mailbox Line Type Definition
@@ -61,6 +64,7 @@ typedef struct sccp_mailbox_subscriber_list sccp_mailbox_subscriber_list_t;
 struct sccp_mailbox_subscriber_list {
 	char mailbox[60];
 	char context[60];
+	char key[121];												/*!< mailbox@context, key of sccp_mailbox_index */
 
 	SCCP_LIST_HEAD (, sccp_mailboxLine_t) sccp_mailboxLine;
 	SCCP_LIST_ENTRY (sccp_mailbox_subscriber_list_t) list;
@@ -99,6 +103,33 @@ void sccp_mwi_addMailboxSubscription(char *mailbox, char *context, sccp_line_t *
 void sccp_mwi_lineStatusChangedEvent(const sccp_event_t * event);
 
 static SCCP_LIST_HEAD (, sccp_mailbox_subscriber_list_t) sccp_mailbox_subscriptions;
+static sccp_hashtable_t *sccp_mailbox_index;									/*!< mailbox@context -> subscription (protected by the sccp_mailbox_subscriptions lock) */
+
+/*!
+ * \brief SCCP MWI Pending Device Update
+ */
+typedef struct sccp_mwi_pending sccp_mwi_pending_t;
+struct sccp_mwi_pending {
+	sccp_device_t *device;											/*!< Retained Device */
+	uint32_t instances;											/*!< Line instances whose mwi lamp needs to be checked (bit field) */
+	sccp_mwi_pending_t *next;										/*!< Next Pending Device */
+};
+
+/*!
+ * \brief Pending MWI Device Updates (protected by mwi_notify_lock)
+ */
+static struct {
+	sccp_hashtable_t *devices;										/*!< device name -> sccp_mwi_pending_t */
+	sccp_mwi_pending_t *entries;										/*!< All pending devices */
+	int sched_id;												/*!< Scheduled update of the pending devices, -1 when none */
+} mwi_notify = {
+	.sched_id = -1,
+};
+AST_MUTEX_DEFINE_STATIC(mwi_notify_lock);
+
+static sccp_msg_t *sccp_mwi_lineLamp(sccp_linedevices_t * lineDevice);
+static sccp_msg_t *sccp_mwi_deviceLamp(sccp_device_t * device);
+static int sccp_mwi_notifyPending_cb(const void *data);
 
 /*!
  * start mwi module.
@@ -106,6 +137,10 @@ static SCCP_LIST_HEAD (, sccp_mailbox_subscriber_list_t) sccp_mailbox_subscripti
 void sccp_mwi_module_start(void)
 {
 	SCCP_LIST_HEAD_INIT(&sccp_mailbox_subscriptions);
+	sccp_mailbox_index = sccp_hashtable_create(0, sccp_hash_string, sccp_hash_match_string);
+	pbx_mutex_lock(&mwi_notify_lock);
+	mwi_notify.devices = sccp_hashtable_create(0, sccp_hash_string_nocase, sccp_hash_match_string_nocase);
+	pbx_mutex_unlock(&mwi_notify_lock);
 	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_2 "SCCP: Starting MWI system\n");
 
 	sccp_event_subscribe(SCCP_EVENT_LINE_CREATED, sccp_mwi_linecreatedEvent, TRUE);
@@ -119,6 +154,8 @@ void sccp_mwi_module_start(void)
 void sccp_mwi_module_stop(void)
 {
 	sccp_mailbox_subscriber_list_t *subscription = NULL;
+	sccp_mwi_pending_t *entry = NULL;
+	int sched_id = -1;
 	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_2 "SCCP: Stopping MWI system\n");
 
 	sccp_event_unsubscribe(SCCP_EVENT_LINE_CREATED, sccp_mwi_linecreatedEvent);
@@ -127,12 +164,135 @@ void sccp_mwi_module_stop(void)
 
 	SCCP_LIST_LOCK(&sccp_mailbox_subscriptions);
 	while ((subscription = SCCP_LIST_REMOVE_HEAD(&sccp_mailbox_subscriptions, list))) {
+		sccp_hashtable_remove(sccp_mailbox_index, subscription->key, subscription);
 		sccp_mwi_destroySubscription(subscription);
 	}
+	sccp_hashtable_destroy(&sccp_mailbox_index);
 	SCCP_LIST_UNLOCK(&sccp_mailbox_subscriptions);
+
+	/* drop the pending device updates */
+	pbx_mutex_lock(&mwi_notify_lock);
+	sched_id = mwi_notify.sched_id;
+	mwi_notify.sched_id = -1;
+	while ((entry = mwi_notify.entries)) {
+		mwi_notify.entries = entry->next;
+		sccp_device_release(&entry->device);							/* explicit release */
+		sccp_free(entry);
+	}
+	sccp_hashtable_destroy(&mwi_notify.devices);
+	pbx_mutex_unlock(&mwi_notify_lock);
+	if (sched_id > -1) {
+		iPbx.sched_del(sched_id);								/* outside of the lock, the callback takes it */
+	}
 	SCCP_LIST_HEAD_DESTROY(&sccp_mailbox_subscriptions);
 }
 
+/*!
+ * \brief queue a mwi lamp check for lineDevice, all pending checks of a device are handled in one go
+ * \param lineDevice SCCP LineDevice
+ *
+ * Voicemail broadcasts update many mailboxes at once; collecting the line instances per device means sccp_mwi_check()
+ * only runs once per device per SCCP_MWI_NOTIFY_INTERVAL and the lamp messages are sent in a single batch.
+ */
+static void sccp_mwi_scheduleLineStatus(sccp_linedevices_t * lineDevice)
+{
+	sccp_mwi_pending_t *entry = NULL;
+	sccp_device_t *d = lineDevice->device;
+	boolean_t scheduled = TRUE;
+
+	if (lineDevice->lineInstance >= SCCP_DEVICE_MWILIGHT) {						/* does not fit in the bit field, handle right away */
+		sccp_mwi_setMWILineStatus(lineDevice);
+		return;
+	}
+
+	pbx_mutex_lock(&mwi_notify_lock);
+	if (!mwi_notify.devices) {
+		pbx_mutex_unlock(&mwi_notify_lock);
+		return;											/* module stopped */
+	}
+	if (!(entry = sccp_hashtable_find(mwi_notify.devices, d->id))) {
+		if (!(entry = sccp_calloc(sizeof *entry, 1)) || !(entry->device = sccp_device_retain(d)) || !sccp_hashtable_insert(mwi_notify.devices, entry->device->id, entry)) {
+			if (entry) {
+				if (entry->device) {
+					sccp_device_release(&entry->device);				/* explicit release */
+				}
+				sccp_free(entry);
+			}
+			pbx_mutex_unlock(&mwi_notify_lock);
+			sccp_mwi_setMWILineStatus(lineDevice);							/* could not queue, handle right away */
+			return;
+		}
+		entry->next = mwi_notify.entries;
+		mwi_notify.entries = entry;
+	}
+	entry->instances |= (1 << lineDevice->lineInstance);
+	if (mwi_notify.sched_id < 0 && (mwi_notify.sched_id = iPbx.sched_add(SCCP_MWI_NOTIFY_INTERVAL, sccp_mwi_notifyPending_cb, NULL)) < 0) {
+		scheduled = FALSE;
+	}
+	pbx_mutex_unlock(&mwi_notify_lock);
+	if (!scheduled) {
+		sccp_mwi_notifyPending_cb(NULL);								/* could not schedule, update right away */
+	}
+}
+
+/*!
+ * \brief update the mwi lamps of a device for the line instances in the bit field and check the device mwi light once
+ */
+static void sccp_mwi_updateDevice(sccp_device_t * d, uint32_t instances)
+{
+	sccp_msg_t *msgs[SCCP_DEVICE_MWILIGHT + 1];
+	sccp_msg_t *msg = NULL;
+	uint count = 0;
+	uint32_t instance = 0;
+
+	if (sccp_device_getRegistrationState(d) != SKINNY_DEVICE_RS_OK) {
+		sccp_log((DEBUGCAT_MWI)) (VERBOSE_PREFIX_3 "%s: (mwi_updateDevice) device no longer registered, dropping pending mwi update\n", DEV_ID_LOG(d));
+		return;
+	}
+	for (instance = SCCP_FIRST_LINEINSTANCE; instance < d->lineButtons.size && instance < SCCP_DEVICE_MWILIGHT; instance++) {
+		if ((instances & (1 << instance)) && d->lineButtons.instance[instance]) {
+			AUTO_RELEASE sccp_linedevices_t *linedevice = sccp_linedevice_retain(d->lineButtons.instance[instance]);
+
+			if (linedevice && (msg = sccp_mwi_lineLamp(linedevice))) {
+				msgs[count++] = msg;
+			}
+		}
+	}
+	if ((msg = sccp_mwi_deviceLamp(d))) {
+		msgs[count++] = msg;
+	}
+	if (count) {
+		sccp_log((DEBUGCAT_MWI)) (VERBOSE_PREFIX_3 "%s: (mwi_updateDevice) sending %u mwi lamp message(s) in one batch\n", DEV_ID_LOG(d), count);
+		sccp_session_sendBatch(d, msgs, count);
+	}
+}
+
+/*!
+ * \brief scheduled callback, updates all devices with pending mwi changes
+ */
+static int sccp_mwi_notifyPending_cb(const void *data)
+{
+	sccp_mwi_pending_t *entries = NULL;
+	sccp_mwi_pending_t *entry = NULL;
+
+	pbx_mutex_lock(&mwi_notify_lock);
+	entries = mwi_notify.entries;
+	mwi_notify.entries = NULL;
+	mwi_notify.sched_id = -1;
+	for (entry = entries; entry; entry = entry->next) {
+		sccp_hashtable_remove(mwi_notify.devices, entry->device->id, entry);
+	}
+	pbx_mutex_unlock(&mwi_notify_lock);
+
+	while ((entry = entries)) {
+		entries = entry->next;
+		sccp_mwi_updateDevice(entry->device, entry->instances);
+		sccp_device_release(&entry->device);							/* explicit release */
+		sccp_free(entry);
+	}
+	return 0;
+}
+
 /*!
  * \brief Generic update mwi count
  * \param subscription Pointer to a mailbox subscription
@@ -162,7 +322,7 @@ static void sccp_mwi_updatecount(sccp_mailbox_subscriber_list_t * subscription)
 			SCCP_LIST_LOCK(&line->devices);
 			SCCP_LIST_TRAVERSE(&line->devices, lineDevice, list) {
 				if (lineDevice && lineDevice->device) {
-					sccp_mwi_setMWILineStatus(lineDevice);
+					sccp_mwi_scheduleLineStatus(lineDevice);
 				} else {
 					pbx_log(LOG_ERROR, "error: null line device.\n");
 				}
@@ -321,6 +481,21 @@ void sccp_mwi_destroySubscription(sccp_mailbox_subscriber_list_t *subscription)
 	sccp_free(subscription);
 }
 
+/*!
+ * \brief Find Mailbox Subscription
+ * \note sccp_mailbox_subscriptions needs to be locked
+ */
+static sccp_mailbox_subscriber_list_t *sccp_mwi_findSubscription(const char *mailbox, const char *context)
+{
+	char key[121];
+
+	if (!mailbox || !context) {
+		return NULL;
+	}
+	snprintf(key, sizeof(key), "%s@%s", mailbox, context);
+	return sccp_hashtable_find(sccp_mailbox_index, key);
+}
+
 /*!
  * \brief Remove Mailbox Subscription
  * \param mailbox SCCP Mailbox
@@ -337,13 +512,11 @@ void sccp_mwi_unsubscribeMailbox(sccp_mailbox_t * mailbox)
 	sccp_mailbox_subscriber_list_t *subscription = NULL;
 
 	SCCP_LIST_LOCK(&sccp_mailbox_subscriptions);
-	SCCP_LIST_TRAVERSE_SAFE_BEGIN(&sccp_mailbox_subscriptions, subscription, list) {
-		if (sccp_strequals(mailbox->mailbox, subscription->mailbox) && sccp_strequals(mailbox->context, subscription->context)) {
-			SCCP_LIST_REMOVE_CURRENT(list);
-			sccp_mwi_destroySubscription(subscription);
-		}
+	if ((subscription = sccp_mwi_findSubscription(mailbox->mailbox, mailbox->context))) {
+		sccp_hashtable_remove(sccp_mailbox_index, subscription->key, subscription);
+		SCCP_LIST_REMOVE(&sccp_mailbox_subscriptions, subscription, list);
+		sccp_mwi_destroySubscription(subscription);
 	}
-	SCCP_LIST_TRAVERSE_SAFE_END;
 	SCCP_LIST_UNLOCK(&sccp_mailbox_subscriptions);
 }
 
@@ -446,18 +619,13 @@ void sccp_mwi_addMailboxSubscription(char *mailbox, char *context, sccp_line_t *
 	}
 	sccp_mailbox_subscriber_list_t *subscription = NULL;
 	sccp_mailboxLine_t *mailboxLine = NULL;
+	boolean_t created = FALSE;
 
 	SCCP_LIST_LOCK(&sccp_mailbox_subscriptions);
-	SCCP_LIST_TRAVERSE(&sccp_mailbox_subscriptions, subscription, list) {
-		if (sccp_strequals(mailbox, subscription->mailbox) && sccp_strequals(context, subscription->context)) {
-			break;
-		}
-	}
-	SCCP_LIST_UNLOCK(&sccp_mailbox_subscriptions);
-
-	if (!subscription) {
+	if (!(subscription = sccp_mwi_findSubscription(mailbox, context))) {
 		subscription = sccp_calloc(sizeof *subscription, 1);
 		if (!subscription) {
+			SCCP_LIST_UNLOCK(&sccp_mailbox_subscriptions);
 			pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, line->name);
 			return;
 		}
@@ -465,12 +633,16 @@ void sccp_mwi_addMailboxSubscription(char *mailbox, char *context, sccp_line_t *
 
 		sccp_copy_string(subscription->mailbox, mailbox, sizeof(subscription->mailbox));
 		sccp_copy_string(subscription->context, context, sizeof(subscription->context));
+		snprintf(subscription->key, sizeof(subscription->key), "%s@%s", subscription->mailbox, subscription->context);
 		sccp_log((DEBUGCAT_MWI)) (VERBOSE_PREFIX_3 "SCCP: (mwi_addMailboxSubscription) creating subscription for: %s@%s\n", subscription->mailbox, subscription->context);
 
-		SCCP_LIST_LOCK(&sccp_mailbox_subscriptions);
 		SCCP_LIST_INSERT_HEAD(&sccp_mailbox_subscriptions, subscription, list);
-		SCCP_LIST_UNLOCK(&sccp_mailbox_subscriptions);
+		sccp_hashtable_insert(sccp_mailbox_index, subscription->key, subscription);
+		created = TRUE;
+	}
+	SCCP_LIST_UNLOCK(&sccp_mailbox_subscriptions);
 
+	if (created) {
 		/* get initial value */
 
 #ifdef CS_AST_HAS_EVENT
@@ -562,7 +734,25 @@ void sccp_mwi_addMailboxSubscription(char *mailbox, char *context, sccp_line_t *
 void sccp_mwi_setMWILineStatus(sccp_linedevices_t * lineDevice)
 {
 	pbx_assert(lineDevice != NULL && lineDevice->device != NULL);
-	
+
+	sccp_device_t *d = lineDevice->device;
+	sccp_msg_t *msg = sccp_mwi_lineLamp(lineDevice);
+
+	if (msg) {
+		sccp_dev_send(d, msg);
+	}
+	if (sccp_device_getRegistrationState(d) == SKINNY_DEVICE_RS_OK) {
+		sccp_mwi_check(d); /* we need to check mwi status again, to enable/disable device mwi light */
+	}
+}
+
+/*!
+ * \brief Update the mwi line lamp state of lineDevice
+ * \param lineDevice SCCP LineDevice
+ * \return SetLampMessage to be sent to the device, NULL when the device already has this state
+ */
+static sccp_msg_t *sccp_mwi_lineLamp(sccp_linedevices_t * lineDevice)
+{
 	sccp_msg_t *msg = NULL;
 	sccp_line_t *l = lineDevice->line;
 	sccp_device_t *d = lineDevice->device;
@@ -590,17 +780,16 @@ void sccp_mwi_setMWILineStatus(sccp_linedevices_t * lineDevice)
 		}
 		sccp_log((DEBUGCAT_MWI)) (VERBOSE_PREFIX_3 "%s: (mwi_setMWILineStatus) new mwilight:%s value: %d\n", DEV_ID_LOG(lineDevice->device), sccp_dec2binstr(binstr, 32, d->mwilight), d->mwilight);
 		REQ(msg, SetLampMessage);
-		msg->data.SetLampMessage.lel_stimulus = htolel(SKINNY_STIMULUS_VOICEMAIL);
-		msg->data.SetLampMessage.lel_stimulusInstance = htolel(instance);
-		msg->data.SetLampMessage.lel_lampMode = state ? htolel(SKINNY_LAMP_ON) : htolel(SKINNY_LAMP_OFF);
-		sccp_dev_send(d, msg);
+		if (msg) {
+			msg->data.SetLampMessage.lel_stimulus = htolel(SKINNY_STIMULUS_VOICEMAIL);
+			msg->data.SetLampMessage.lel_stimulusInstance = htolel(instance);
+			msg->data.SetLampMessage.lel_lampMode = state ? htolel(SKINNY_LAMP_ON) : htolel(SKINNY_LAMP_OFF);
+		}
 		sccp_log((DEBUGCAT_MWI)) (VERBOSE_PREFIX_3 "%s: (mwi_setMWILineStatus) Turn %s the MWI on line %s (%d)\n", DEV_ID_LOG(d), state ? "ON" : "OFF", (l ? l->name : "unknown"), instance);
 	} else {
 		sccp_log((DEBUGCAT_MWI)) (VERBOSE_PREFIX_3 "%s: (mwi_setMWILineStatus) Device already knows this state %s on line %s (%d). skipping update\n", DEV_ID_LOG(d), status ? "ON" : "OFF", (l ? l->name : "unknown"), instance);
 	}
-	if (sccp_device_getRegistrationState(d) == SKINNY_DEVICE_RS_OK) {
-		sccp_mwi_check(d); /* we need to check mwi status again, to enable/disable device mwi light */
-	}
+	return msg;
 }
 
 /*!
@@ -610,14 +799,28 @@ void sccp_mwi_setMWILineStatus(sccp_linedevices_t * lineDevice)
  */
 void sccp_mwi_check(sccp_device_t * d)
 {
-	uint32_t oldmsgs = 0, newmsgs = 0;
-	boolean_t suppress_lamp = FALSE;
+	sccp_msg_t *msg = NULL;
 
 	AUTO_RELEASE sccp_device_t *device = sccp_device_retain(d);
 	if (!device) {
 		sccp_log((DEBUGCAT_MWI)) (VERBOSE_PREFIX_3 "SCCP: (mwi_check) called with NULL device!\n");
 		return;
 	}
+	if ((msg = sccp_mwi_deviceLamp(device))) {
+		sccp_dev_send(device, msg);
+	}
+}
+
+/*!
+ * \brief Collect the voicemail counts of all lines on device, update the voicemail display and the device mwi light state
+ * \param device SCCP Device (retained)
+ * \return SetLampMessage to be sent to the device, NULL when the device mwi light does not change
+ */
+static sccp_msg_t *sccp_mwi_deviceLamp(sccp_device_t * device)
+{
+	sccp_msg_t *msg = NULL;
+	uint32_t oldmsgs = 0, newmsgs = 0;
+	boolean_t suppress_lamp = FALSE;
 
 	uint32_t instance = SCCP_FIRST_LINEINSTANCE;
 	for (instance = SCCP_FIRST_LINEINSTANCE; instance < device->lineButtons.size; instance++) {
@@ -666,14 +869,13 @@ void sccp_mwi_check(sccp_device_t * d)
 			//devicelamp_active = TRUE;
 		}
 		//sccp_log((DEBUGCAT_MWI)) (VERBOSE_PREFIX_3 "%s: (mwi_check) new device->mwilight:%s\n", DEV_ID_LOG(device), sccp_dec2binstr(binstr1, 32, device->mwilight));
-		sccp_msg_t *msg = NULL;
-
 		REQ(msg, SetLampMessage);
-		msg->data.SetLampMessage.lel_stimulus = htolel(SKINNY_STIMULUS_VOICEMAIL);
-		msg->data.SetLampMessage.lel_stimulusInstance = 0;
-		msg->data.SetLampMessage.lel_lampMode = (device->mwilight & (1 << SCCP_DEVICE_MWILIGHT)) ? htolel(device->mwilamp) : htolel(SKINNY_LAMP_OFF);
-		//msg->data.SetLampMessage.lel_lampMode = devicelamp_active ? htolel(device->mwilamp) : htolel(SKINNY_LAMP_OFF);
-		sccp_dev_send(device, msg);
+		if (msg) {
+			msg->data.SetLampMessage.lel_stimulus = htolel(SKINNY_STIMULUS_VOICEMAIL);
+			msg->data.SetLampMessage.lel_stimulusInstance = 0;
+			msg->data.SetLampMessage.lel_lampMode = (device->mwilight & (1 << SCCP_DEVICE_MWILIGHT)) ? htolel(device->mwilamp) : htolel(SKINNY_LAMP_OFF);
+			//msg->data.SetLampMessage.lel_lampMode = devicelamp_active ? htolel(device->mwilamp) : htolel(SKINNY_LAMP_OFF);
+		}
 		sccp_log((DEBUGCAT_MWI)) (VERBOSE_PREFIX_3 "%s: (mwi_check) Turn %s the MWI light (newmsgs: %d->%d)\n", DEV_ID_LOG(device), (device->mwilight & (1 << SCCP_DEVICE_MWILIGHT)) ? "ON" : "OFF", newmsgs,  device->voicemailStatistic.newmsgs);
 	}
 	/* we should check the display only once, maybe we need a priority stack -MC */
@@ -688,6 +890,7 @@ void sccp_mwi_check(sccp_device_t * d)
 	}
 	device->voicemailStatistic.oldmsgs = oldmsgs;
 	device->voicemailStatistic.newmsgs = newmsgs;
+	return msg;
 }
 
 /*!
@@ -50,16 +50,59 @@
 
 SCCP_FILE_VERSION(__FILE__, "");
 
-//nb: SCCP_HASH_PRIME defined in config.h, default 563
-#define SCCP_SIMPLE_HASH(_a) (((unsigned long)(_a)) % SCCP_HASH_PRIME)
 #define SCCP_LIVE_MARKER 13
+#define SCCP_REFCOUNT_MAGIC 0x52454643										/* "REFC", identifies the header in front of every refcounted object */
 #define REF_FILE "/tmp/sccp_refs"
+#define REFCOUNT_CACHELINE 64											/* objects are carved out of slabs at cache line boundaries */
+#define REFCOUNT_SLAB_SIZE 65536										/* memory requested per slab (at least one object per slab) */
+#define REFCOUNT_POOL_SHARDS 4											/* number of free lists in front of the pool lock, threads are spread over them */
+#define REFCOUNT_SHARD_SIZE 16											/* max number of free objects kept per shard */
+#define REFCOUNT_BLOCKSIZE(_size) (((sizeof(RefCountedObject) + (_size)) + REFCOUNT_CACHELINE - 1) & ~((size_t) REFCOUNT_CACHELINE - 1))
 static enum sccp_refcount_runstate runState = SCCP_REF_STOPPED;
 
+typedef struct refcount_object RefCountedObject;
+
+/*!
+ * \brief Slab Header, occupies the first cache line of every slab
+ */
+typedef struct refcount_slab {
+	struct refcount_slab *next;
+	void *mem;												//!< unaligned memory returned by sccp_malloc
+} refcount_slab_t;
+
+/*!
+ * \brief Pool Shard, small free list with its own lock (on its own cache line) so that threads do not all contend on the pool lock
+ */
+struct sccp_refcount_pool_shard {
+	ast_mutex_t lock;
+	RefCountedObject *freelist;
+	int numfree;
+} __attribute__ ((aligned(REFCOUNT_CACHELINE)));
+
+/*!
+ * \brief Fixed Size Object Pool (one per refcounted type)
+ * The block size is fixed by the first allocation of a type, allocations of any other size bypass the pool.
+ */
+struct sccp_refcount_pool {
+	struct sccp_refcount_pool_shard shards[REFCOUNT_POOL_SHARDS];
+	ast_mutex_t lock;
+	size_t blocksize;											//!< header + data, rounded up to REFCOUNT_CACHELINE
+	RefCountedObject *freelist;										//!< free blocks, linked through obj->list.next
+	int numfree;
+	refcount_slab_t *slabs;
+	int numslabs;
+	volatile CAS32_TYPE live;										//!< objects currently allocated
+	volatile CAS32_TYPE highwater;										//!< max number of objects allocated at the same time
+	volatile CAS32_TYPE hits;										//!< allocations served from a free list
+	volatile CAS32_TYPE misses;										//!< allocations which required a new slab or bypassed the pool
+};
+
 static struct sccp_refcount_obj_info {
 	int (*destructor) (const void *ptr);
 	char datatype[StationMaxDeviceNameSize];
 	sccp_debug_category_t debugcat;
+	SCCP_RWLIST_HEAD (, RefCountedObject) objects;								//!< registry of all objects of this type, only used during alloc/destroy and for 'sccp show refcount'
+	struct sccp_refcount_pool pool;
 } obj_info[] = {
 /* *INDENT-OFF* */
 	[SCCP_REF_PARTICIPANT] = {NULL, "participant", DEBUGCAT_CONFERENCE},
@@ -75,19 +118,23 @@ static struct sccp_refcount_obj_info {
 /* *INDENT-ON* */
 };
 
-typedef struct refcount_object RefCountedObject;
-
 #ifdef SCCP_ATOMIC
 #define obj_lock NULL
 #else
 #define	obj_lock &obj->lock
 #endif
 
+/*!
+ * \brief Refcounted Object Header
+ * \note The header directly precedes the data pointer handed out to the caller, so retain/release can reach it without any lookup.
+ */
 struct refcount_object {
 #ifndef SCCP_ATOMIC
 	ast_mutex_t lock;
 #endif
 	volatile CAS32_TYPE refcount;
+	int magic;
+	boolean_t pooled;
 	enum sccp_refcounted_types type;
 	char identifier[REFCOUNT_INDENTIFIER_SIZE];
 	int len;
@@ -96,20 +143,203 @@ struct refcount_object {
 	unsigned char data[0] __attribute__((aligned(8)));
 };
 
-
-static ast_rwlock_t objectslock;										// general lock to modify hash table entries
-static struct refcount_objentry{
-	SCCP_RWLIST_HEAD (, RefCountedObject) refCountedObjects  __attribute__((aligned(8)));			//!< one rwlock per hash table entry, used to modify list
-} *objects[SCCP_HASH_PRIME];											//!< objects hash table
-
 #if CS_REFCOUNT_DEBUG
 static FILE *sccp_ref_debug_log;
 #endif
 
+/*!
+ * \brief Select the pool shard for the calling thread
+ * \note shards are used instead of per thread caches, because blocks cached by a (short lived pbx) thread would be lost when it exits
+ */
+static gcc_inline struct sccp_refcount_pool_shard *sccp_refcount_pool_shard(struct sccp_refcount_pool *pool)
+{
+	uintptr_t hash = (uintptr_t) pthread_self();
+
+	hash ^= hash >> 17;
+	hash ^= hash >> 11;
+	hash = (hash * 0x9E3779B1U) & 0xFFFFFFFF;
+	return &pool->shards[(hash >> 16) % REFCOUNT_POOL_SHARDS];
+}
+
+/*!
+ * \brief Add a new slab to the pool free list
+ * \note pool lock needs to be held
+ */
+static boolean_t sccp_refcount_pool_grow(struct sccp_refcount_pool *pool)
+{
+	union {	/* little union trick to prevent cast-alignment warning	*/
+		uintptr_t addr;
+		unsigned char *cdata;
+		refcount_slab_t *slab;
+		RefCountedObject *obj;
+	} block;
+	void *mem;
+	int numblocks = (REFCOUNT_SLAB_SIZE - REFCOUNT_CACHELINE) / pool->blocksize;
+	int i;
+
+	if (numblocks < 1) {
+		numblocks = 1;
+	}
+	if (!(mem = sccp_malloc(REFCOUNT_CACHELINE * 2 + numblocks * pool->blocksize))) {
+		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP: slab");
+		return FALSE;
+	}
+	block.addr = ((uintptr_t) mem + REFCOUNT_CACHELINE - 1) & ~((uintptr_t) REFCOUNT_CACHELINE - 1);
+	block.slab->mem = mem;
+	block.slab->next = pool->slabs;
+	pool->slabs = block.slab;
+	pool->numslabs++;
+
+	block.cdata += REFCOUNT_CACHELINE;
+	for (i = 0; i < numblocks; i++) {
+		block.obj->list.next = pool->freelist;
+		pool->freelist = block.obj;
+		pool->numfree++;
+		block.cdata += pool->blocksize;
+	}
+	return TRUE;
+}
+
+/*!
+ * \brief Get a zeroed, cache line aligned object of the requested size from the pool of this type
+ */
+static gcc_inline RefCountedObject *sccp_refcount_pool_get(enum sccp_refcounted_types type, size_t size)
+{
+	struct sccp_refcount_pool *pool = &obj_info[type].pool;
+	struct sccp_refcount_pool_shard *shard = NULL;
+	RefCountedObject *obj = NULL;
+	size_t blocksize = REFCOUNT_BLOCKSIZE(size);
+	boolean_t hit = TRUE;
+	int live;
+
+	if (dont_expect(!pool->blocksize)) {
+		ast_mutex_lock(&pool->lock);
+		if (!pool->blocksize) {
+			pool->blocksize = blocksize;
+		}
+		ast_mutex_unlock(&pool->lock);
+	}
+
+	if (do_expect(pool->blocksize == blocksize)) {
+		shard = sccp_refcount_pool_shard(pool);
+		ast_mutex_lock(&shard->lock);
+		if ((obj = shard->freelist)) {
+			shard->freelist = obj->list.next;
+			shard->numfree--;
+		} else {
+			ast_mutex_lock(&pool->lock);
+			if (!pool->freelist) {
+				hit = FALSE;
+				sccp_refcount_pool_grow(pool);
+			}
+			if ((obj = pool->freelist)) {
+				pool->freelist = obj->list.next;
+				pool->numfree--;
+				/* refill the shard with half its size, to reduce contention on the pool lock */
+				while (pool->freelist && shard->numfree < REFCOUNT_SHARD_SIZE / 2) {
+					RefCountedObject *tmp = pool->freelist;
+					pool->freelist = tmp->list.next;
+					pool->numfree--;
+					tmp->list.next = shard->freelist;
+					shard->freelist = tmp;
+					shard->numfree++;
+				}
+			}
+			ast_mutex_unlock(&pool->lock);
+		}
+		ast_mutex_unlock(&shard->lock);
+		if (obj) {
+			memset(obj, 0, blocksize);
+			obj->pooled = TRUE;
+		}
+	} else {
+		hit = FALSE;
+		if ((obj = sccp_calloc(size + (sizeof *obj), 1))) {
+			obj->pooled = FALSE;
+		}
+	}
+	if (obj) {
+		ATOMIC_INCR((hit ? &pool->hits : &pool->misses), 1, &pool->lock);
+		live = ATOMIC_INCR(&pool->live, 1, &pool->lock) + 1;
+		if (live > pool->highwater) {									/* statistics only, a lost update is harmless */
+			pool->highwater = live;
+		}
+	}
+	return obj;
+}
+
+/*!
+ * \brief Return an object to the pool it was taken from
+ */
+static gcc_inline void sccp_refcount_pool_put(RefCountedObject * obj, enum sccp_refcounted_types type, boolean_t pooled)
+{
+	struct sccp_refcount_pool *pool = &obj_info[type].pool;
+	struct sccp_refcount_pool_shard *shard = NULL;
+
+	ATOMIC_DECR(&pool->live, 1, &pool->lock);
+	if (!pooled) {
+		sccp_free(obj);
+		return;
+	}
+	shard = sccp_refcount_pool_shard(pool);
+	ast_mutex_lock(&shard->lock);
+	if (shard->numfree < REFCOUNT_SHARD_SIZE) {
+		obj->list.next = shard->freelist;
+		shard->freelist = obj;
+		shard->numfree++;
+		ast_mutex_unlock(&shard->lock);
+		return;
+	}
+	ast_mutex_unlock(&shard->lock);
+	ast_mutex_lock(&pool->lock);
+	obj->list.next = pool->freelist;
+	pool->freelist = obj;
+	pool->numfree++;
+	ast_mutex_unlock(&pool->lock);
+}
+
+/*!
+ * \brief Release all slabs of a pool
+ */
+static void sccp_refcount_pool_destroy(struct sccp_refcount_pool *pool)
+{
+	refcount_slab_t *slab;
+	int i;
+
+	for (i = 0; i < REFCOUNT_POOL_SHARDS; i++) {
+		ast_mutex_lock(&pool->shards[i].lock);
+		pool->shards[i].freelist = NULL;
+		pool->shards[i].numfree = 0;
+		ast_mutex_unlock(&pool->shards[i].lock);
+		ast_mutex_destroy(&pool->shards[i].lock);
+	}
+	ast_mutex_lock(&pool->lock);
+	while ((slab = pool->slabs)) {
+		pool->slabs = slab->next;
+		sccp_free(slab->mem);
+	}
+	pool->freelist = NULL;
+	pool->numfree = 0;
+	pool->numslabs = 0;
+	pool->blocksize = 0;
+	ast_mutex_unlock(&pool->lock);
+	ast_mutex_destroy(&pool->lock);
+}
+
 void sccp_refcount_init(void)
 {
+	uint32_t type;
+	int shard;
+
 	sccp_log((DEBUGCAT_REFCOUNT + DEBUGCAT_HIGH)) (VERBOSE_PREFIX_1 "SCCP: (Refcount) init\n");
-	pbx_rwlock_init_notracking(&objectslock);								// No tracking to safe cpu cycles
+	for (type = 0; type < ARRAY_LEN(obj_info); type++) {
+		SCCP_RWLIST_HEAD_INIT(&obj_info[type].objects);
+		memset(&obj_info[type].pool, 0, sizeof(struct sccp_refcount_pool));
+		ast_mutex_init(&obj_info[type].pool.lock);
+		for (shard = 0; shard < REFCOUNT_POOL_SHARDS; shard++) {
+			ast_mutex_init(&obj_info[type].pool.shards[shard].lock);
+		}
+	}
 #if CS_REFCOUNT_DEBUG
 	sccp_ref_debug_log = fopen(REF_FILE, "w");
 	if (!sccp_ref_debug_log) {
@@ -121,7 +351,7 @@ void sccp_refcount_init(void)
 
 void sccp_refcount_destroy(void)
 {
-	uint32_t hash, type;
+	uint32_t type;
 	RefCountedObject *obj;
 
 	pbx_log(LOG_NOTICE, "SCCP: (Refcount) Shutting Down. Checking Clean Shutdown...\n");
@@ -131,36 +361,31 @@ void sccp_refcount_destroy(void)
 	sched_yield();												//make sure all other threads can finish their work first.
 
 	// cleanup if necessary, if everything is well, this should not be necessary
-	ast_rwlock_wrlock(&objectslock);
 	for (type = 0; type < ARRAY_LEN(obj_info); type++) { 							// unwind in order of type priority
-		for (hash = 0; hash < SCCP_HASH_PRIME && objects[hash]; hash++) {
-			SCCP_RWLIST_WRLOCK(&(objects[hash]->refCountedObjects));
-			SCCP_RWLIST_TRAVERSE_SAFE_BEGIN(&(objects[hash]->refCountedObjects), obj, list) {
-				if (obj->type == type) {
-					pbx_log(LOG_NOTICE, "Cleaning up [%3d]=type:%17s, id:%25s, ptr:%15p, refcount:%4d, alive:%4s, size:%4d\n", hash, (obj_info[obj->type]).datatype, obj->identifier, obj, (int) obj->refcount, SCCP_LIVE_MARKER == obj->alive ? "yes" : "no", obj->len);
-					SCCP_RWLIST_REMOVE_CURRENT(list);
-					if ((&obj_info[obj->type])->destructor) {
-						(&obj_info[obj->type])->destructor(obj->data);
-					}
+		SCCP_RWLIST_WRLOCK(&obj_info[type].objects);
+		SCCP_RWLIST_TRAVERSE_SAFE_BEGIN(&obj_info[type].objects, obj, list) {
+			pbx_log(LOG_NOTICE, "Cleaning up type:%17s, id:%25s, ptr:%15p, refcount:%4d, alive:%4s, size:%4d\n", (obj_info[obj->type]).datatype, obj->identifier, obj, (int) obj->refcount, SCCP_LIVE_MARKER == obj->alive ? "yes" : "no", obj->len);
+			SCCP_RWLIST_REMOVE_CURRENT(list);
+			if ((&obj_info[obj->type])->destructor) {
+				(&obj_info[obj->type])->destructor(obj->data);
+			}
 #ifndef SCCP_ATOMIC
-					ast_mutex_destroy(&obj->lock);
+			ast_mutex_destroy(&obj->lock);
 #endif
-					memset(obj, 0, sizeof(RefCountedObject));
-					sccp_free(obj);
-					obj = NULL;
-					numObjects++;
-				}
-			}
-			SCCP_RWLIST_TRAVERSE_SAFE_END;
-			SCCP_RWLIST_UNLOCK(&(objects[hash]->refCountedObjects));
-			SCCP_RWLIST_HEAD_DESTROY(&(objects[hash]->refCountedObjects));
-
-			sccp_free(objects[hash]);								// free hashtable entry
-			objects[hash] = NULL;
+			boolean_t pooled = obj->pooled;
+			memset(obj, 0, sizeof(RefCountedObject));
+			sccp_refcount_pool_put(obj, type, pooled);
+			obj = NULL;
+			numObjects++;
 		}
+		SCCP_RWLIST_TRAVERSE_SAFE_END;
+		SCCP_RWLIST_UNLOCK(&obj_info[type].objects);
+	}
+	/* only tear down the lists and pools once every type has been unwound, destructors release objects of other types */
+	for (type = 0; type < ARRAY_LEN(obj_info); type++) {
+		SCCP_RWLIST_HEAD_DESTROY(&obj_info[type].objects);
+		sccp_refcount_pool_destroy(&obj_info[type].pool);
 	}
-	ast_rwlock_unlock(&objectslock);
-	pbx_rwlock_destroy(&objectslock);
 	if (numObjects) {
 		pbx_log(LOG_WARNING, "SCCP: (Refcount) Note: We found %d objects which had to be forcefulfy removed during refcount shutdown, see above.\n", numObjects);
 	}
@@ -189,14 +414,13 @@ void *const sccp_refcount_object_alloc(size_t size, enum sccp_refcounted_types t
 {
 	RefCountedObject *obj;
 	void *ptr = NULL;
-	uint32_t hash;
 
 	if (!runState) {
 		pbx_log(LOG_ERROR, "SCCP: (sccp_refcount_object_alloc) Not Running Yet!\n");
 		return NULL;
 	}
 
-	if (!(obj = sccp_calloc(size + (sizeof *obj), 1) )) {
+	if (!(obj = sccp_refcount_pool_get(type, size))) {
 		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP: obj");
 		return NULL;
 	}
@@ -208,38 +432,19 @@ void *const sccp_refcount_object_alloc(size_t size, enum sccp_refcounted_types t
 	obj->len = (int)size;
 	obj->type = type;
 	obj->refcount = 1;
+	obj->magic = SCCP_REFCOUNT_MAGIC;
 #ifndef SCCP_ATOMIC
 	ast_mutex_init(&obj->lock);
 #endif
 	sccp_copy_string(obj->identifier, identifier, sizeof(obj->identifier));
-
-	// generate hash
 	ptr = obj->data;
-	hash = SCCP_SIMPLE_HASH(ptr);
-
-	if (!objects[hash]) {
-		// create new hashtable head when necessary (should this possibly be moved to refcount_init, to avoid raceconditions ?)
-		ast_rwlock_wrlock(&objectslock);
-		if (!objects[hash]) {										// check again after getting the lock, to see if another thread did not create the head already
-			if (!(objects[hash] = sccp_calloc(sizeof *objects[hash], 1))) {
-				pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCC: hashtable");
-				sccp_free(obj);
-				obj = NULL;
-				ast_rwlock_unlock(&objectslock);
-				return NULL;
-			}
-			SCCP_RWLIST_HEAD_INIT(&(objects[hash]->refCountedObjects));
-			SCCP_RWLIST_INSERT_HEAD(&(objects[hash]->refCountedObjects), obj, list);
-		}
-		ast_rwlock_unlock(&objectslock);
-	} else {
-		// add object to hash table
-		SCCP_RWLIST_WRLOCK(&(objects[hash]->refCountedObjects));
-		SCCP_RWLIST_INSERT_HEAD(&(objects[hash]->refCountedObjects), obj, list);
-		SCCP_RWLIST_UNLOCK(&(objects[hash]->refCountedObjects));
-	}
 
-	sccp_log((DEBUGCAT_REFCOUNT)) (VERBOSE_PREFIX_1 "SCCP: (alloc_obj) Creating new %s %s (%p) inside %p at hash: %d\n", (&obj_info[obj->type])->datatype, identifier, ptr, obj, hash);
+	// add object to the registry
+	SCCP_RWLIST_WRLOCK(&obj_info[type].objects);
+	SCCP_RWLIST_INSERT_HEAD(&obj_info[type].objects, obj, list);
+	SCCP_RWLIST_UNLOCK(&obj_info[type].objects);
+
+	sccp_log((DEBUGCAT_REFCOUNT)) (VERBOSE_PREFIX_1 "SCCP: (alloc_obj) Creating new %s %s (%p) inside %p\n", (&obj_info[obj->type])->datatype, identifier, ptr, obj);
 	obj->alive = SCCP_LIVE_MARKER;
 
 #if CS_REFCOUNT_DEBUG
@@ -290,103 +495,78 @@ static gcc_inline int __sccp_refcount_debug(const void *ptr, RefCountedObject *
 }
 #endif
 
+/*!
+ * \brief Get the refcount header belonging to a data pointer
+ * \note no lookup required, the header lives directly in front of the data. The magic/alive markers are cleared before the memory is freed, which catches most stale pointers.
+ */
 static gcc_inline RefCountedObject *sccp_refcount_find_obj(const void *ptr, const char *filename, int lineno, const char *func)
 {
-	RefCountedObject *obj = NULL;
-	boolean_t found = FALSE;
+	union {	/* little union trick to prevent cast-alignment warning / discard const */
+		const void *ptr;
+		const unsigned char *cdata;
+		RefCountedObject *obj;
+	} header = {
+		.ptr = ptr,
+	};
 
 	if (ptr == NULL) {
 		return NULL;
 	}
+	header.cdata -= offsetof(RefCountedObject, data);
 
-	int hash = SCCP_SIMPLE_HASH(ptr);
-
-	if (objects[hash]) {
-		SCCP_RWLIST_RDLOCK(&(objects[hash])->refCountedObjects);
-		SCCP_RWLIST_TRAVERSE(&(objects[hash])->refCountedObjects, obj, list) {
-			if (obj->data == ptr) {
-				if (SCCP_LIVE_MARKER == obj->alive) {
-					found = TRUE;
-				} else {
+	if (dont_expect(header.obj->magic != SCCP_REFCOUNT_MAGIC)) {
+		sccp_log((DEBUGCAT_REFCOUNT)) (VERBOSE_PREFIX_1 "SCCP: (sccp_refcount_find_obj) %p is not a refcounted object\n", ptr);
+		return NULL;
+	}
+	if (dont_expect(SCCP_LIVE_MARKER != header.obj->alive)) {
 #if CS_REFCOUNT_DEBUG
-					__sccp_refcount_debug((void *) ptr, obj, 0, filename, lineno, func);
+		__sccp_refcount_debug((void *) ptr, header.obj, 0, filename, lineno, func);
 #endif
-					sccp_log((DEBUGCAT_REFCOUNT)) (VERBOSE_PREFIX_1 "SCCP: (sccp_refcount_find_obj) %p Already declared dead (hash: %d)\n", obj, hash);
-				}
-				break;
-			}
-		}
-		SCCP_RWLIST_UNLOCK(&(objects[hash])->refCountedObjects);
+		sccp_log((DEBUGCAT_REFCOUNT)) (VERBOSE_PREFIX_1 "SCCP: (sccp_refcount_find_obj) %p Already declared dead\n", header.obj);
+		return NULL;
 	}
-	return found ? obj : NULL;
+	return header.obj;
 }
 
-static gcc_inline void sccp_refcount_remove_obj(const void *ptr)
+static gcc_inline void sccp_refcount_remove_obj(RefCountedObject * obj)
 {
-	RefCountedObject *obj = NULL;
-	boolean_t cleanup_objects = FALSE;
+	enum sccp_refcounted_types type;
+	boolean_t pooled;
 
-	if (ptr == NULL) {
+	if (obj == NULL) {
 		return;
 	}
 
-	int hash = SCCP_SIMPLE_HASH(ptr);
+	sccp_log((DEBUGCAT_REFCOUNT)) (VERBOSE_PREFIX_1 "SCCP: (sccp_refcount_remove_obj) Removing %p from registry\n", obj->data);
 
-	sccp_log((DEBUGCAT_REFCOUNT)) (VERBOSE_PREFIX_1 "SCCP: (sccp_refcount_remove_obj) Removing %p from hash table at hash: %d\n", ptr, hash);
+	SCCP_RWLIST_WRLOCK(&obj_info[obj->type].objects);
+	SCCP_RWLIST_REMOVE(&obj_info[obj->type].objects, obj, list);
+	SCCP_RWLIST_UNLOCK(&obj_info[obj->type].objects);
 
-	if (objects[hash]) {
-		SCCP_RWLIST_WRLOCK(&(objects[hash])->refCountedObjects);
-		SCCP_RWLIST_TRAVERSE_SAFE_BEGIN(&(objects[hash])->refCountedObjects, obj, list) {
-			if (obj->data == ptr && SCCP_LIVE_MARKER != obj->alive) {
-				SCCP_RWLIST_REMOVE_CURRENT(list);
-				break;
-			}
-		}
-		SCCP_RWLIST_TRAVERSE_SAFE_END;
-		if (SCCP_RWLIST_GETSIZE(&(objects[hash])->refCountedObjects) == 0) {
-			cleanup_objects = TRUE;
-		}
-		SCCP_RWLIST_UNLOCK(&(objects[hash])->refCountedObjects);
-	}
-	if (obj) {
-		sched_yield();											// make sure all other threads can finish their work first.
-		// should resolve lockless refcount SMP issues
-		// BTW we are not allowed to sleep whilst haveing a reference
-		// fire destructor
-		if (obj && obj->data == ptr && SCCP_LIVE_MARKER != obj->alive) {
-			sccp_log((DEBUGCAT_REFCOUNT)) (VERBOSE_PREFIX_1 "SCCP: (sccp_refcount_remove_obj) Destroying %p at hash: %d\n", obj, hash);
-			if ((&obj_info[obj->type])->destructor) {
-				(&obj_info[obj->type])->destructor(ptr);
-			}
-			memset(obj, 0, sizeof(RefCountedObject));
-			sccp_free(obj);
-			obj = NULL;
-		}
-	}
-	if (cleanup_objects && runState == SCCP_REF_RUNNING && objects[hash]) {
-		ast_rwlock_wrlock(&objectslock);
-		SCCP_RWLIST_WRLOCK(&(objects[hash])->refCountedObjects);
-		if (SCCP_RWLIST_GETSIZE(&(objects[hash])->refCountedObjects) == 0) {			/* recheck size */
-			SCCP_RWLIST_HEAD_DESTROY(&(objects[hash])->refCountedObjects);
-			sccp_free(objects[hash]);
-			objects[hash] = NULL;
-		} else {
-			SCCP_RWLIST_UNLOCK(&(objects[hash])->refCountedObjects);
-		}
-		ast_rwlock_unlock(&objectslock);
+	sched_yield();												// make sure all other threads can finish their work first.
+	// should resolve lockless refcount SMP issues
+	// BTW we are not allowed to sleep whilst haveing a reference
+	// fire destructor
+	sccp_log((DEBUGCAT_REFCOUNT)) (VERBOSE_PREFIX_1 "SCCP: (sccp_refcount_remove_obj) Destroying %p\n", obj);
+	if ((&obj_info[obj->type])->destructor) {
+		(&obj_info[obj->type])->destructor(obj->data);
 	}
+#ifndef SCCP_ATOMIC
+	ast_mutex_destroy(&obj->lock);
+#endif
+	type = obj->type;
+	pooled = obj->pooled;
+	memset(obj, 0, sizeof(RefCountedObject));
+	sccp_refcount_pool_put(obj, type, pooled);
 }
 
 int sccp_show_refcount(int fd, sccp_cli_totals_t *totals, struct mansession *s, const struct message *m, int argc, char *argv[])
 {
 	int local_line_total = 0;
-	int bucket, prev = 0;
+	uint32_t type;
 	RefCountedObject *obj = NULL;
-	unsigned int maxdepth = 0;
-	unsigned int numentries = 0;
 	int check_inuse = 0;
 	boolean_t inuse = FALSE;
-	float fillfactor = 0.00;
 
 	if (argc == 4) {
 		if (sccp_strcaseequals(argv[3],"show")) {
@@ -396,24 +576,13 @@ int sccp_show_refcount(int fd, sccp_cli_totals_t *totals, struct mansession *s,
 		}
 	}
 
-	ast_rwlock_rdlock(&objectslock);
 #define CLI_AMI_TABLE_NAME Refcount
 #define CLI_AMI_TABLE_PER_ENTRY_NAME Entry
-#define CLI_AMI_TABLE_ITERATOR for(bucket = 0; bucket < SCCP_HASH_PRIME; bucket++)
+#define CLI_AMI_TABLE_ITERATOR for(type = 0; type < ARRAY_LEN(obj_info); type++)
 #define CLI_AMI_TABLE_BEFORE_ITERATION 											\
-		if (objects[bucket]) {											\
-			SCCP_RWLIST_RDLOCK(&(objects[bucket])->refCountedObjects);					\
-			SCCP_RWLIST_TRAVERSE(&(objects[bucket])->refCountedObjects, obj, list) {			\
-				char bucketstr[6];									\
-				if (!s) {										\
-					if (prev == bucket) {								\
-						snprintf(bucketstr, sizeof(bucketstr), " +-> ");						\
-					} else {									\
-						snprintf(bucketstr, sizeof(bucketstr), "[%3d]", bucket);					\
-					}										\
-				} else {										\
-					snprintf(bucketstr, sizeof(bucketstr), "%d", bucket);						\
-				}											\
+		{													\
+			SCCP_RWLIST_RDLOCK(&obj_info[type].objects);							\
+			SCCP_RWLIST_TRAVERSE(&obj_info[type].objects, obj, list) {					\
 				inuse = FALSE;										\
 				if (check_inuse && obj->alive) {							\
 					union {	/* little union trick to prevent cast-alignment warning	*/		\
@@ -456,17 +625,11 @@ int sccp_show_refcount(int fd, sccp_cli_totals_t *totals, struct mansession *s,
 				}
 				
 #define CLI_AMI_TABLE_AFTER_ITERATION											\
-				prev = bucket;										\
-				numentries++;										\
-			}												\
-			if (maxdepth < SCCP_RWLIST_GETSIZE(&(objects[bucket])->refCountedObjects)) {			\
-				maxdepth = SCCP_RWLIST_GETSIZE(&(objects[bucket])->refCountedObjects);			\
 			}												\
-			SCCP_RWLIST_UNLOCK(&(objects[bucket])->refCountedObjects);					\
+			SCCP_RWLIST_UNLOCK(&obj_info[type].objects);							\
 		}
 
 #define CLI_AMI_TABLE_FIELDS 												\
-	CLI_AMI_TABLE_FIELD(Hash,	"-5.5",		s,	5,	bucketstr)					\
 	CLI_AMI_TABLE_FIELD(Type,	"-17.17",	s,	17,	(obj_info[obj->type]).datatype)			\
 	CLI_AMI_TABLE_FIELD(Id,		"-25.25",	s,	25,	obj->identifier)				\
 	CLI_AMI_TABLE_FIELD(Ptr,	"-15",		p,	15,	obj)						\
@@ -476,29 +639,20 @@ int sccp_show_refcount(int fd, sccp_cli_totals_t *totals, struct mansession *s,
 	CLI_AMI_TABLE_FIELD(Size,	"-4.4",		d,	4,	obj->len)
 #include "sccp_cli_table.h"
 	local_line_total++;
-	ast_rwlock_unlock(&objectslock);
-
-	// FillFactor
-	fillfactor = (float) numentries / SCCP_HASH_PRIME;
-	int once;
-#define CLI_AMI_TABLE_NAME FillFactor
-#define CLI_AMI_TABLE_PER_ENTRY_NAME Factor
-#define CLI_AMI_TABLE_ITERATOR for(once=0;once<1;once++)
+
+	// Registry summary per type
+#define CLI_AMI_TABLE_NAME Registry
+#define CLI_AMI_TABLE_PER_ENTRY_NAME Type
+#define CLI_AMI_TABLE_ITERATOR for(type = 0; type < ARRAY_LEN(obj_info); type++)
+#define CLI_AMI_TABLE_BEFORE_ITERATION 											\
+		if (sccp_strlen_zero(obj_info[type].datatype)) {							\
+			continue;											\
+		}
 #define CLI_AMI_TABLE_FIELDS 												\
-	CLI_AMI_TABLE_FIELD(Entries,		"-8.8",		d,	8,	numentries)				\
-	CLI_AMI_TABLE_FIELD(Buckets,		"-8.8",		d,	8,	SCCP_HASH_PRIME)			\
-	CLI_AMI_TABLE_FIELD(Factor,		"08.02",	f,	8,	fillfactor)				\
-	CLI_AMI_TABLE_FIELD(MaxDepth,		"-8.8",		d,	8,	maxdepth)
+	CLI_AMI_TABLE_FIELD(Type,		"-17.17",	s,	17,	obj_info[type].datatype)		\
+	CLI_AMI_TABLE_FIELD(Entries,		"-8.8",		d,	8,	SCCP_RWLIST_GETSIZE(&obj_info[type].objects))
 #include "sccp_cli_table.h"
 	local_line_total++;
-	if (fillfactor > 1.00) {
-		if (!s) {
-			pbx_cli(fd, "\033[1m\033[41m\033[37mPlease keep fillfactor below 1.00. Check ./configure --with-hash-size.\033[0m\n");
-		} else {
-			astman_append(s, "Please keep fillfactor below 1.00. Check ./configure --with-hash-size.\r\n");
-			local_line_total++;
-		}
-	}
 
 	if (s) {
 		totals->lines = local_line_total;
@@ -507,26 +661,57 @@ int sccp_show_refcount(int fd, sccp_cli_totals_t *totals, struct mansession *s,
 	return RESULT_SUCCESS;
 }
 
+/*!
+ * \brief Show the object pool statistics per refcounted type
+ * \note Free only counts the blocks in the shared pool, not the ones held by the shards
+ */
+int sccp_show_refcount_pools(int fd, sccp_cli_totals_t *totals, struct mansession *s, const struct message *m, int argc, char *argv[])
+{
+	int local_line_total = 0;
+	uint32_t type;
+
+#define CLI_AMI_TABLE_NAME RefcountPools
+#define CLI_AMI_TABLE_PER_ENTRY_NAME Pool
+#define CLI_AMI_TABLE_ITERATOR for(type = 0; type < ARRAY_LEN(obj_info); type++)
+#define CLI_AMI_TABLE_BEFORE_ITERATION 											\
+		if (sccp_strlen_zero(obj_info[type].datatype)) {							\
+			continue;											\
+		}
+#define CLI_AMI_TABLE_FIELDS 												\
+	CLI_AMI_TABLE_FIELD(Type,		"-17.17",	s,	17,	obj_info[type].datatype)		\
+	CLI_AMI_TABLE_FIELD(BlockSize,		"-9.9",		d,	9,	(int) obj_info[type].pool.blocksize)	\
+	CLI_AMI_TABLE_FIELD(Live,		"-8.8",		d,	8,	obj_info[type].pool.live)		\
+	CLI_AMI_TABLE_FIELD(HighWater,		"-9.9",		d,	9,	obj_info[type].pool.highwater)		\
+	CLI_AMI_TABLE_FIELD(Hits,		"-10.10",	d,	10,	obj_info[type].pool.hits)		\
+	CLI_AMI_TABLE_FIELD(Misses,		"-8.8",		d,	8,	obj_info[type].pool.misses)		\
+	CLI_AMI_TABLE_FIELD(Free,		"-8.8",		d,	8,	obj_info[type].pool.numfree)		\
+	CLI_AMI_TABLE_FIELD(Slabs,		"-6.6",		d,	6,	obj_info[type].pool.numslabs)
+#include "sccp_cli_table.h"
+	local_line_total++;
+
+	if (s) {
+		totals->lines = local_line_total;
+		totals->tables = 1;
+	}
+	return RESULT_SUCCESS;
+}
+
 #ifdef CS_EXPERIMENTAL
 int sccp_refcount_force_release(long findobj, char *identifier)
 {
-	uint32_t hash;
+	uint32_t type;
 	RefCountedObject *obj = NULL;
 	void *ptr = NULL;
 
-	ast_rwlock_rdlock(&objectslock);
-	for (hash = 0; hash < SCCP_HASH_PRIME; hash++) {
-		if (objects[hash]) {
-			SCCP_RWLIST_RDLOCK(&(objects[hash]->refCountedObjects));
-			SCCP_RWLIST_TRAVERSE(&(objects[hash]->refCountedObjects), obj, list) {
-				if (sccp_strequals(obj->identifier, identifier) && (long) obj == findobj) {
-					ptr = obj->data;
-				}
+	for (type = 0; type < ARRAY_LEN(obj_info); type++) {
+		SCCP_RWLIST_RDLOCK(&obj_info[type].objects);
+		SCCP_RWLIST_TRAVERSE(&obj_info[type].objects, obj, list) {
+			if (sccp_strequals(obj->identifier, identifier) && (long) obj == findobj) {
+				ptr = obj->data;
 			}
-			SCCP_RWLIST_UNLOCK(&(objects[hash]->refCountedObjects));
 		}
+		SCCP_RWLIST_UNLOCK(&obj_info[type].objects);
 	}
-	ast_rwlock_unlock(&objectslock);
 	if (ptr) {
 		sccp_log(DEBUGCAT_CORE) (VERBOSE_PREFIX_1 "Forcefully releasing one instance of %s\n", identifier);
 		sccp_refcount_release(ptr, __FILE__, __LINE__, __PRETTY_FUNCTION__);
@@ -606,7 +791,7 @@ gcc_inline void * const sccp_refcount_release(const void * * const ptr, const ch
 		if (dont_expect(newrefcountval == 0)) {
 			alive = ATOMIC_DECR(&obj->alive, SCCP_LIVE_MARKER, &obj->lock);
 			sccp_log((DEBUGCAT_REFCOUNT)) (VERBOSE_PREFIX_1 "SCCP: %-15.15s:%-4.4d (%-35.35s)) (release) Finalizing %p (%p) (alive:%d)\n", filename, lineno, func, obj, *ptr, alive);
-			sccp_refcount_remove_obj(*ptr);
+			sccp_refcount_remove_obj(obj);
 		} else {
 			if (dont_expect( (sccp_globals->debug & ((debugcat + DEBUGCAT_REFCOUNT))) == (debugcat ^ DEBUGCAT_REFCOUNT))) {
 				pbx_log(__LOG_VERBOSE, __FILE__, 0, "", " %-15.15s:%-4.4d (%-35.35s) <%*.*s %*s refcount decreased %.2d  <- %.2d for %10s: %s (%p)\n", filename, lineno, func, newrefcountval, newrefcountval, "--------------------", 20 - newrefcountval, " ", newrefcountval, refcountval, (&obj_info[obj->type])->datatype, obj->identifier, obj);
@@ -796,19 +981,86 @@ AST_TEST_DEFINE(sccp_refcount_tests)
 	}
 	sleep(1);
 
-	/* peer directly inside refcounted objects to see if there are any stranded refcounted objects, which should have been destroyed */
-	ast_rwlock_rdlock(&objectslock);
-	RefCountedObject *obj = NULL;
-	for (loop = 0; loop < SCCP_HASH_PRIME; loop++) {
-		if (objects[loop]) {
-			SCCP_RWLIST_RDLOCK(&(objects[loop])->refCountedObjects);
-			SCCP_RWLIST_TRAVERSE(&(objects[loop])->refCountedObjects, obj, list) {
-				pbx_test_validate(test, obj->type != SCCP_REF_TEST);
-			}
-			SCCP_RWLIST_UNLOCK(&(objects[loop])->refCountedObjects);
+	/* peer directly inside the registry to see if there are any stranded refcounted objects, which should have been destroyed */
+	pbx_test_validate(test, SCCP_RWLIST_GETSIZE(&obj_info[SCCP_REF_TEST].objects) == 0);
+	pbx_test_validate(test, obj_info[SCCP_REF_TEST].pool.live == 0);
+	pbx_test_status_update(test, "Pool: blocksize:%d, highwater:%d, hits:%d, misses:%d\n", (int) obj_info[SCCP_REF_TEST].pool.blocksize, obj_info[SCCP_REF_TEST].pool.highwater, obj_info[SCCP_REF_TEST].pool.hits, obj_info[SCCP_REF_TEST].pool.misses);
+	sccp_free(object);
+	return AST_TEST_PASS;
+}
+
+#define BENCH_THREADS 8
+#define BENCH_OBJECTS 64
+#define BENCH_ITERATIONS 1000000
+struct refcount_benchmark {
+	int offset;
+	int failures;
+};
+
+static void *refcount_benchmark_thread(void *data)
+{
+	struct refcount_benchmark *bench = data;
+	struct refcount_test *obj = NULL;
+	int loop;
+
+	for (loop = 0; loop < BENCH_ITERATIONS; loop++) {
+		if ((obj = sccp_refcount_retain(object[(bench->offset + loop) % BENCH_OBJECTS], __FILE__, __LINE__, __PRETTY_FUNCTION__))) {
+			sccp_refcount_release((const void ** const)&obj, __FILE__, __LINE__, __PRETTY_FUNCTION__);
+		} else {
+			bench->failures++;
 		}
 	}
-	ast_rwlock_unlock(&objectslock);
+	return NULL;
+}
+
+AST_TEST_DEFINE(sccp_refcount_benchmark)
+{
+	switch(cmd) {
+		case TEST_INIT:
+			info->name = "refcount_benchmark";
+			info->category = "/channels/chan_sccp/";
+			info->summary = "chan-sccp-b refcount retain/release benchmark";
+			info->description = "Measures retain/release throughput with 1 to 8 threads contending for a small set of objects";
+			return AST_TEST_NOT_RUN;
+		case TEST_EXECUTE:
+			break;
+	}
+
+	pthread_t t[BENCH_THREADS];
+	struct refcount_benchmark bench[BENCH_THREADS];
+	int loop, thread, nthreads;
+	char id[23];
+	struct timeval start;
+	long long elapsed;
+
+	object = sccp_malloc(sizeof(struct refcount_test *) * BENCH_OBJECTS);
+	for (loop = 0; loop < BENCH_OBJECTS; loop++) {
+		snprintf(id, sizeof(id), "bench/%d", loop);
+		object[loop] = (struct refcount_test *) sccp_refcount_object_alloc(sizeof(struct refcount_test), SCCP_REF_TEST, id, refcount_test_destroy);
+		pbx_test_validate(test, object[loop] != NULL);
+		object[loop]->id = loop;
+		object[loop]->str = pbx_strdup(id);
+	}
+
+	for (nthreads = 1; nthreads <= BENCH_THREADS; nthreads *= 2) {
+		start = pbx_tvnow();
+		for (thread = 0; thread < nthreads; thread++) {
+			bench[thread].offset = thread * (BENCH_OBJECTS / BENCH_THREADS);
+			bench[thread].failures = 0;
+			pbx_pthread_create(&t[thread], NULL, refcount_benchmark_thread, &bench[thread]);
+		}
+		for (thread = 0; thread < nthreads; thread++) {
+			pthread_join(t[thread], NULL);
+			pbx_test_validate(test, bench[thread].failures == 0);
+		}
+		elapsed = ast_tvdiff_ms(pbx_tvnow(), start);
+		pbx_test_status_update(test, "%d thread(s): %d retain/release pairs in %lld ms (%.0f pairs/sec)\n", nthreads, nthreads * BENCH_ITERATIONS, elapsed, elapsed ? (double) nthreads * BENCH_ITERATIONS * 1000 / elapsed : 0);
+	}
+
+	for (loop = 0; loop < BENCH_OBJECTS; loop++) {
+		object[loop] = sccp_refcount_release((const void ** const)&object[loop], __FILE__, __LINE__, __PRETTY_FUNCTION__);
+	}
+	pbx_test_validate(test, SCCP_RWLIST_GETSIZE(&obj_info[SCCP_REF_TEST].objects) == 0);
 	sccp_free(object);
 	return AST_TEST_PASS;
 }
@@ -816,11 +1068,13 @@ AST_TEST_DEFINE(sccp_refcount_tests)
 static void __attribute__((constructor)) sccp_register_tests(void)
 {
 	AST_TEST_REGISTER(sccp_refcount_tests);
+	AST_TEST_REGISTER(sccp_refcount_benchmark);
 }
 
 static void __attribute__((destructor)) sccp_unregister_tests(void)
 {
 	AST_TEST_UNREGISTER(sccp_refcount_tests);
+	AST_TEST_UNREGISTER(sccp_refcount_benchmark);
 }
 #endif
 
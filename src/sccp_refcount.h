@@ -44,6 +44,7 @@ SCCP_API void * SCCP_CALL  const sccp_refcount_release(const void * * const ptr,
 SCCP_API void SCCP_CALL sccp_refcount_replace(const void * * const replaceptr, const void *const newptr, const char *filename, int lineno, const char *func);
 SCCP_API void SCCP_CALL sccp_refcount_print_hashtable(int fd);
 SCCP_API int SCCP_CALL sccp_show_refcount(int fd, sccp_cli_totals_t *totals, struct mansession *s, const struct message *m, int argc, char *argv[]);
+SCCP_API int SCCP_CALL sccp_show_refcount_pools(int fd, sccp_cli_totals_t *totals, struct mansession *s, const struct message *m, int argc, char *argv[]);
 SCCP_API void SCCP_CALL sccp_refcount_autorelease(void *ptr);
 
 #define AUTO_RELEASE auto __attribute__((cleanup(sccp_refcount_autorelease)))
@@ -19,8 +19,11 @@ SCCP_FILE_VERSION(__FILE__, "");
 #include "sccp_cli.h"
 #include "sccp_device.h"
 #include "sccp_netsock.h"
+#include "sccp_threadpool.h"
 #include "sccp_utils.h"
 #include <netinet/in.h>
+#include <sys/uio.h>
+#include <fcntl.h>
 
 #ifndef CS_USE_POLL_COMPAT
 #include <poll.h>
@@ -34,6 +37,9 @@ SCCP_FILE_VERSION(__FILE__, "");
 #else
 #define sccp_netsock_poll poll
 #endif
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
 #ifdef HAVE_PBX_ACL_H				// AST_SENSE_ALLOW
 #  include <asterisk/acl.h>
 #endif
@@ -57,8 +63,24 @@ SCCP_FILE_VERSION(__FILE__, "");
 
 #define SESSION_DEVICE_CLEANUP_TIME 10										/* wait time before destroying a device on thread exit */
 #define KEEPALIVE_ADDITIONAL_PERCENT 10										/* extra time allowed for device keepalive overrun (percentage of GLOB(keepalive)) */
-#define ACCEPT_UWAIT_ON_KNOWN_IP 2										/* wait time when ip-address is already known */
+#define ACCEPT_UWAIT_ON_KNOWN_IP 2										/* retry interval in seconds when ip-address is already known */
 #define ACCEPT_RETRIES 5											/* number of reqtries when we already know this ip-address */
+#define ACCEPT_MAX_DEFERRED 256											/* max number of connections waiting for the previous session of their ip-address */
+#define ACCEPT_BACKOFF_MIN 2											/* min backoff in seconds handed to a phone turned away by admission control */
+#define ACCEPT_BACKOFF_MAX 60											/* max backoff in seconds handed to a phone turned away by admission control */
+#define ACCEPT_ASSUMED_RATE 10											/* admissions per second assumed when computing a backoff without admission_rate */
+#define EVENTLOOP_MAX_EVENTS 64											/* number of epoll events handled per eventloop wakeup */
+#define EVENTLOOP_MAX_THREADS 64										/* upper limit for the number of session eventloops */
+#define EVENTLOOP_TICK 1000											/* eventloop housekeeping interval in millisecs (keepalive timeouts / pending device updates) */
+#define SESSION_RECVBUFFER_SIZE (SCCP_MAX_PACKET * 2)								/* receive buffer size, room for at least one complete max sized message */
+#define SESSION_SENDQUEUE_MIN 16										/* lower limit for the sendqueue_depth setting */
+#define SESSION_SENDQUEUE_BATCH 64										/* max number of queued messages written by a single writev() */
+#define SESSION_SENDQUEUE_OWNER_WAIT 500									/* max millisecs the session owner waits for a full send queue to drain, before applying the overflow policy */
+#define SESSION_SENDQUEUE_OWNER_STEP 50										/* millisecs between send queue drain attempts while waiting */
+#define SESSION_KEEPALIVE_WHEEL_SLOTS 256									/* keepalive timing wheel size, one slot per second (power of two) */
+#define SESSION_KEEPALIVE_TICK 1000										/* keepalive timing wheel tick in millisecs, used as listener poll timeout when running a thread per session */
+#define SESSION_KEEPALIVE_STATS_INTERVAL 60									/* interval in seconds over which keepalive timeouts are counted */
+#define SESSION_LOAD_JOBS_PER_THREAD 4										/* queued threadpool jobs per thread counted as full load */
 
 /* Lock Macro for Sessions */
 #define sccp_session_lock(x)			pbx_mutex_lock(&(x)->lock)
@@ -73,6 +95,20 @@ void *sccp_netsock_device_thread(void *session);
 sccp_session_t *sccp_session_findByDevice(const sccp_device_t * device);
 sccp_session_t *sccp_session_findByIP(const struct sockaddr_storage *sin);
 void sccp_session_destroySessionsByDeviceName(const char *name);
+static void __sccp_session_keepalive_disarm(sccp_session_t * s);
+
+/*!
+ * \brief SCCP Session Receive Buffer
+ * \note Messages are parsed in place. Consumed bytes are skipped by moving start, the (incomplete) remainder is only moved back
+ *       to the front of data when there is not enough room left behind it for a max sized message.
+ */
+typedef struct sccp_session_recvbuffer {
+	size_t start;												/*!< Offset of the first unprocessed byte */
+	size_t len;												/*!< Number of unprocessed bytes */
+	unsigned char data[SESSION_RECVBUFFER_SIZE] __attribute__ ((aligned (8)));				/*!< Received Bytes */
+} sccp_session_recvbuffer_t;											/*!< SCCP Session Receive Buffer */
+
+typedef int (*sccp_session_dispatch_cb) (constMessagePtr msg, constSessionPtr s);				/*!< handler for a complete received message (sccp_handle_message) */
 
 /*!
  * \brief SCCP Session Structure
@@ -82,7 +118,7 @@ struct sccp_session {
 	time_t lastKeepAlive;											/*!< Last KeepAlive Time */
 	SCCP_RWLIST_ENTRY (sccp_session_t) list;								/*!< Linked List Entry for this Session */
 	sccp_device_t *device;											/*!< Associated Device */
-	struct pollfd fds[1];											/*!< File Descriptor */
+	struct pollfd fds[2];											/*!< File Descriptors (socket, wakeup pipe read end) */
 	struct sockaddr_storage sin;										/*!< Incoming Socket Address */
 	uint32_t protocolType;
 	volatile boolean_t session_stop;									/*!< Signal Session Stop */
@@ -92,8 +128,52 @@ struct sccp_session {
 	struct sockaddr_storage ourip;										/*!< Our IP is for rtp use */
 	struct sockaddr_storage ourIPv4;
 	char designator[40];
+	int wakeup[2];												/*!< Wakeup Pipe, used to make the session thread watch for POLLOUT (session thread only) */
+	sccp_msg_t **sendqueue;											/*!< Outbound Message Ring (protected by write_lock) */
+	uint sendqueue_size;											/*!< Number of slots in sendqueue */
+	uint sendqueue_head;											/*!< Index of the oldest queued message */
+	uint sendqueue_len;											/*!< Number of queued messages */
+	uint sendqueue_highwater;										/*!< Max number of messages queued at the same time */
+	size_t sendqueue_offset;										/*!< Number of bytes of the oldest queued message already written */
+	uint32_t sendqueue_drops;										/*!< Number of messages dropped because the send queue was full */
+	uint64_t bytes_coalesced;										/*!< Number of bytes written by writev() calls carrying more than one message */
+	boolean_t want_write;											/*!< Owner is watching the socket for POLLOUT / EPOLLOUT */
+	uint corked;												/*!< Number of sccp_session_sendBatch calls in progress, other threads only queue while corked (protected by write_lock) */
+	int keepalive_slot;											/*!< Keepalive wheel slot, -1 when not armed (protected by the wheel lock) */
+	time_t keepalive_deadline;										/*!< Deadline this session was filed under in the keepalive wheel */
+	sccp_session_t *keepalive_next;										/*!< Next session in the same keepalive wheel slot */
+	sccp_session_t *keepalive_prev;										/*!< Previous session in the same keepalive wheel slot */
+	volatile boolean_t keepalive_expired;									/*!< Set by the keepalive wheel, the owner finishes the teardown */
+	uint32_t keepalive_fastpath;										/*!< Number of KeepAliveMessages answered by the receive path itself */
+	boolean_t admission_pending;										/*!< Counted as registration in progress by admission control (protected by lock) */
+	int admission_retries;											/*!< Number of times this deferred connection has been retried (listener only) */
+	time_t admission_retry;											/*!< Next time this deferred connection is retried (listener only) */
+	sccp_session_t *admission_next;										/*!< Next connection on the deferred queue (listener only) */
+#ifdef HAVE_SYS_EPOLL_H
+	struct sccp_session_eventloop *eventloop;								/*!< Eventloop serving this session (NULL when served by a session thread) */
+	SCCP_LIST_ENTRY (sccp_session_t) eventloop_list;							/*!< Linked List Entry for the Eventloop Session List */
+	sccp_session_recvbuffer_t *recvbuffer;									/*!< Receive Buffer (eventloop only, the session thread keeps it on the stack) */
+#endif
 };														/*!< SCCP Session Structure */
 
+#ifdef HAVE_SYS_EPOLL_H
+/*!
+ * \brief SCCP Session Eventloop Structure
+ * \note One epoll instance serving a share of all sessions, instead of one device thread per session
+ */
+typedef struct sccp_session_eventloop {
+	int id;													/*!< Eventloop Index */
+	int epfd;												/*!< epoll Descriptor */
+	pthread_t thread;											/*!< Eventloop Thread (eventloop 0 runs on the socket thread) */
+	volatile boolean_t stop;										/*!< Signal Eventloop Stop */
+	SCCP_LIST_HEAD (, sccp_session_t) sessions;								/*!< Sessions served by this Eventloop */
+} sccp_session_eventloop_t;											/*!< SCCP Session Eventloop Structure */
+
+static sccp_session_eventloop_t *eventloops = NULL;
+static int num_eventloops = 0;
+static boolean_t __sccp_session_eventloop_add(sccp_session_t * s);
+#endif
+
 boolean_t sccp_session_getOurIP(constSessionPtr session, struct sockaddr_storage * const sockAddrStorage, int family)
 {
 	if (session && sockAddrStorage) {
@@ -191,8 +271,12 @@ static void __sccp_session_stopthread(sessionPtr session, uint8_t newRegistratio
 	if (session->device) {
 		sccp_device_setRegistrationState(session->device, newRegistrationState);
 	}
-	if (AST_PTHREADT_NULL != session->session_thread) {
-		shutdown(session->fds[0].fd, SHUT_RD);								// this will also wake up poll
+	if (AST_PTHREADT_NULL != session->session_thread
+#ifdef HAVE_SYS_EPOLL_H
+	    || session->eventloop
+#endif
+	    ) {
+		shutdown(session->fds[0].fd, SHUT_RD);								// this will also wake up poll / epoll_wait
 		// which is waiting for a read event and close down the thread nicely
 	}
 }
@@ -218,6 +302,121 @@ static void socket_get_error(constSessionPtr s, const char* file, int line, cons
 	}
 }
 
+/*!
+ * \brief Is the calling thread the I/O owner of this session (session thread / serving eventloop)
+ */
+static boolean_t __sccp_session_isOwner(constSessionPtr s)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	if (s->eventloop) {
+		return pthread_equal(pthread_self(), s->eventloop->thread) ? TRUE : FALSE;
+	}
+#endif
+	return (AST_PTHREADT_NULL != s->session_thread && pthread_equal(pthread_self(), s->session_thread)) ? TRUE : FALSE;
+}
+
+/*!
+ * \brief Make the session owner (stop) watching the socket for writability
+ * \note called with s->write_lock held
+ */
+static void __sccp_session_sendqueue_setWantWrite(sccp_session_t * s, boolean_t want_write)
+{
+	if (s->want_write == want_write) {
+		return;
+	}
+	s->want_write = want_write;
+#ifdef HAVE_SYS_EPOLL_H
+	if (s->eventloop) {
+		struct epoll_event ev = {0};
+		ev.events = EPOLLIN | EPOLLPRI | EPOLLRDHUP | (want_write ? EPOLLOUT : 0);
+		ev.data.ptr = s;
+		if (epoll_ctl(s->eventloop->epfd, EPOLL_CTL_MOD, s->fds[0].fd, &ev) < 0) {
+			pbx_log(LOG_WARNING, "%s: eventloop %d failed to modify session %d. errno: %d (%s)\n", DEV_ID_LOG(s->device), s->eventloop->id, s->fds[0].fd, errno, strerror(errno));
+		}
+		return;
+	}
+#endif
+	/* the session thread picks up want_write before its next poll, wake it up when it is already waiting */
+	if (want_write && s->wakeup[1] > -1 && !__sccp_session_isOwner(s)) {
+		if (write(s->wakeup[1], "w", 1) < 0 && errno != EAGAIN) {
+			pbx_log(LOG_WARNING, "%s: Failed to wake up session thread. errno: %d (%s)\n", DEV_ID_LOG(s->device), errno, strerror(errno));
+		}
+	}
+}
+
+/*!
+ * \brief Write as much of the send queue as the socket accepts, coalescing up to SESSION_SENDQUEUE_BATCH messages per writev(), without blocking
+ * \return number of messages still queued, -1 on socket error
+ * \note called with s->write_lock held
+ */
+static int __sccp_session_sendqueue_flush(sccp_session_t * s)
+{
+	struct iovec iov[SESSION_SENDQUEUE_BATCH];
+	sccp_msg_t *msg = NULL;
+	ssize_t res = 0;
+	size_t remaining = 0;
+	uint i = 0;
+	uint cnt = 0;
+
+	while (s->sendqueue_len > 0 && s->fds[0].fd > 0) {
+		cnt = (s->sendqueue_len < SESSION_SENDQUEUE_BATCH) ? s->sendqueue_len : SESSION_SENDQUEUE_BATCH;
+		for (i = 0; i < cnt; i++) {
+			msg = s->sendqueue[(s->sendqueue_head + i) % s->sendqueue_size];
+			iov[i].iov_base = (uint8_t *) msg;
+			iov[i].iov_len = letohl(msg->header.length) + 8;
+		}
+		iov[0].iov_base = (uint8_t *) iov[0].iov_base + s->sendqueue_offset;
+		iov[0].iov_len -= s->sendqueue_offset;
+
+		res = writev(s->fds[0].fd, iov, cnt);
+		if (res < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				break;
+			}
+			socket_get_error(s, __FILE__, __LINE__, __PRETTY_FUNCTION__, errno);
+			return -1;
+		}
+		if (cnt > 1) {
+			s->bytes_coalesced += res;
+		}
+
+		/* release the messages which went out completely, remember how far we got with the next one */
+		remaining = (size_t) res;
+		for (i = 0; i < cnt && remaining >= iov[i].iov_len; i++) {
+			remaining -= iov[i].iov_len;
+			msg = s->sendqueue[s->sendqueue_head];
+			s->sendqueue[s->sendqueue_head] = NULL;
+			s->sendqueue_head = (s->sendqueue_head + 1) % s->sendqueue_size;
+			s->sendqueue_len--;
+			s->sendqueue_offset = 0;
+			sccp_free_packet(msg);
+		}
+		if (i < cnt) {											/* socket buffer full */
+			s->sendqueue_offset += remaining;
+			break;
+		}
+	}
+	__sccp_session_sendqueue_setWantWrite(s, s->sendqueue_len > 0 ? TRUE : FALSE);
+	return (int) s->sendqueue_len;
+}
+
+/*!
+ * \brief Write out the send queue, called by the session owner after handling socket events
+ * \return number of messages still queued, -1 on socket error
+ */
+static int __sccp_session_sendqueue_drain(sccp_session_t * s)
+{
+	int res = 0;
+
+	pbx_mutex_lock(&s->write_lock);
+	res = __sccp_session_sendqueue_flush(s);
+	pbx_mutex_unlock(&s->write_lock);
+	return res;
+}
+
 static int session_dissect_header(sccp_session_t * s, sccp_header_t * header)
 {
 	int result = -1;
@@ -261,7 +460,19 @@ static int session_dissect_header(sccp_session_t * s, sccp_header_t * header)
 	return result;
 }
 
-static gcc_inline int session_buffer2msg(sccp_session_t * s, unsigned char *buffer, int lenAccordingToPacketHeader, sccp_msg_t *msg) 
+/*!
+ * \brief Hand one complete message to dispatch
+ * \param s SCCP Session
+ * \param buffer Start of the message in the receive buffer
+ * \param lenAccordingToPacketHeader Number of bytes received for this message
+ * \param msg Scratch message, only used when the message can not be handled in place
+ * \param dispatch Message Handler
+ *
+ * Messages which are at least as big as the size we know for their messageId are handed over straight from the receive
+ * buffer. Only shorter (older protocol version) or misaligned messages are copied into msg, zeroing just the part we did
+ * not receive.
+ */
+static gcc_inline int session_buffer2msg(sccp_session_t * s, unsigned char *buffer, int lenAccordingToPacketHeader, sccp_msg_t *msg, sccp_session_dispatch_cb dispatch)
 {
 	sccp_header_t msg_header = {0};
 	memcpy(&msg_header, buffer, SCCP_PACKET_HEADER);
@@ -277,43 +488,145 @@ static gcc_inline int session_buffer2msg(sccp_session_t * s, unsigned char *buff
 		sccp_dump_packet(buffer, lenAccordingToPacketHeader);
 	}
 
-	memset(msg, 0, SCCP_MAX_PACKET);
-	memcpy(msg, buffer, lenAccordingToOurProtocolSpec);
+	if (expect(lenAccordingToOurProtocolSpec >= (int) SCCP_PACKET_HEADER && lenAccordingToPacketHeader >= lenAccordingToOurProtocolSpec && ((uintptr_t) buffer % sizeof(uint32_t)) == 0)) {
+		msg = (sccp_msg_t *) buffer;										// parse in place
+	} else {
+		int copyLen = (lenAccordingToPacketHeader < lenAccordingToOurProtocolSpec) ? lenAccordingToPacketHeader : lenAccordingToOurProtocolSpec;
+		int zeroLen = (lenAccordingToOurProtocolSpec > (int) SCCP_PACKET_HEADER) ? lenAccordingToOurProtocolSpec : (int) SCCP_PACKET_HEADER;
+		memcpy(msg, buffer, copyLen);
+		memset((unsigned char *) msg + copyLen, 0, zeroLen - copyLen);
+	}
 	msg->header.length = lenAccordingToOurProtocolSpec;								// patch up msg->header.length to new size
-	return sccp_handle_message(msg, s);
+	return dispatch(msg, s);
+}
+
+/*!
+ * \brief Preencoded KeepAliveAckMessage (little endian: length 4, protocol version 0, message id 0x0100)
+ */
+static const unsigned char session_keepAliveAck[SCCP_PACKET_HEADER] = {
+	0x04, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00,
+	0x00, 0x01, 0x00, 0x00,
+};
+
+/*!
+ * \brief Answer a KeepAliveMessage straight from the receive path, without going through sccp_handle_message
+ * \param s SCCP Session
+ * \param buffer Start of a complete message without payload
+ * \return TRUE when handled, FALSE when the message has to take the normal path
+ * \note the ack is written directly when nothing else is queued, otherwise it is queued behind the other messages by
+ *       handle_KeepAliveMessage, to keep the order in which messages go out
+ */
+static gcc_inline boolean_t __sccp_session_keepalive_fastpath(sccp_session_t * s, const unsigned char *buffer)
+{
+	sccp_header_t header = {0};
+	sccp_msg_t *msg = NULL;
+	ssize_t res = -1;
+
+	memcpy(&header, buffer, SCCP_PACKET_HEADER);
+	if (letohl(header.lel_messageId) != KeepAliveMessage || s->session_stop || s->fds[0].fd <= 0 || (GLOB(debug) & DEBUGCAT_MESSAGE) != 0) {
+		return FALSE;
+	}
+	pbx_mutex_lock(&s->write_lock);
+	if (s->sendqueue_len == 0) {
+		do {
+			res = send(s->fds[0].fd, session_keepAliveAck, sizeof(session_keepAliveAck), MSG_NOSIGNAL | MSG_DONTWAIT);
+		} while (res < 0 && errno == EINTR);
+		if (res > 0 && res < (ssize_t) sizeof(session_keepAliveAck)) {				/* socket buffer full, queue the rest */
+			if ((msg = sccp_build_packet(KeepAliveAckMessage, 0))) {
+				s->sendqueue[s->sendqueue_head] = msg;
+				s->sendqueue_len = 1;
+				s->sendqueue_offset = (size_t) res;
+				__sccp_session_sendqueue_setWantWrite(s, TRUE);
+			} else {
+				s->session_stop = TRUE;								/* the stream is out of sync now */
+			}
+		}
+	}
+	pbx_mutex_unlock(&s->write_lock);
+	if (res <= 0) {
+		return FALSE;
+	}
+	s->lastKeepAlive = time(0);
+	s->keepalive_fastpath++;
+	return TRUE;
 }
 
-static gcc_inline int process_buffer(sccp_session_t * s, sccp_msg_t *msg, unsigned char *buffer, size_t *len)
+/*!
+ * \brief Dispatch all complete messages in the receive buffer
+ * \param s SCCP Session
+ * \param msg Scratch message (see session_buffer2msg)
+ * \param rb Receive Buffer
+ * \param dispatch Message Handler
+ * \param keepalive_fastpath Answer KeepAliveMessages directly instead of dispatching them (see __sccp_session_keepalive_fastpath)
+ * \return 0 on success, -1 when the connection should be closed
+ */
+static gcc_inline int process_buffer(sccp_session_t * s, sccp_msg_t *msg, sccp_session_recvbuffer_t *rb, sccp_session_dispatch_cb dispatch, boolean_t keepalive_fastpath)
 {
 	int res = 0;
-	while (*len >= SCCP_PACKET_HEADER) {										// We have at least SCCP_PACKET_HEADER, so we have the payload length
+	while (rb->len >= SCCP_PACKET_HEADER) {										// We have at least SCCP_PACKET_HEADER, so we have the payload length
+		unsigned char *buffer = rb->data + rb->start;
 		uint32_t hdr_len = buffer[0] | (buffer[1] << 8) | (buffer[2] << 16) | (buffer[3] << 24);
 		uint32_t payload_len = letohl(hdr_len) + (SCCP_PACKET_HEADER - 4);
-		if (*len < payload_len) {
-			break;												// Too short - haven't received whole payload yet, go poll for more
-		}
-
-		pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);							// allow thread to be killed while handling the message
 		if (dont_expect(payload_len < SCCP_PACKET_HEADER || payload_len > SCCP_MAX_PACKET)) {
 			pbx_log(LOG_ERROR, "%s: (process_buffer) Size of the data payload in the packet is bigger than max packet, close connection !\n", DEV_ID_LOG(s->device));
 			res = -1;
 			break;
 		}
-		if (dont_expect(session_buffer2msg(s, buffer, payload_len, msg) != 0)) {
+		if (rb->len < payload_len) {
+			break;												// Too short - haven't received whole payload yet, go poll for more
+		}
+		if (keepalive_fastpath && payload_len == SCCP_PACKET_HEADER && __sccp_session_keepalive_fastpath(s, buffer)) {
+			rb->start += payload_len;									// answered already
+			rb->len -= payload_len;
+			continue;
+		}
+
+		pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);							// allow thread to be killed while handling the message
+		if (dont_expect(session_buffer2msg(s, buffer, payload_len, msg, dispatch) != 0)) {
 			res = -1;
 			break;
 		}
 		pthread_testcancel();
 		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
 
-		*len -= payload_len;
-		if (*len > 0) {												// Now shuffle the remaining data in the buffer back to the start
-			memmove(buffer + 0, buffer + payload_len, *len);
-		}
+		rb->start += payload_len;										// skip the consumed message, no need to shuffle the buffer
+		rb->len -= payload_len;
+	}
+	if (rb->len == 0) {
+		rb->start = 0;
 	}
 	return res;
 }
 
+/*!
+ * \brief Return the free space behind the unprocessed bytes, making sure it can hold a max sized message
+ */
+static gcc_inline unsigned char *session_recvbuffer_tail(sccp_session_recvbuffer_t *rb, size_t *room)
+{
+	if (rb->start > 0 && (SESSION_RECVBUFFER_SIZE - rb->start - rb->len) < SCCP_MAX_PACKET) {		// only part of a message left, move it to the front
+		memmove(rb->data, rb->data + rb->start, rb->len);
+		rb->start = 0;
+	}
+	*room = SESSION_RECVBUFFER_SIZE - rb->start - rb->len;
+	return rb->data + rb->start + rb->len;
+}
+
+/*!
+ * \brief Receive into the free space behind the unprocessed bytes
+ * \return result of recv()
+ */
+static gcc_inline ssize_t session_recv(sccp_session_t * s, sccp_session_recvbuffer_t *rb)
+{
+	size_t room = 0;
+	unsigned char *tail = session_recvbuffer_tail(rb, &room);
+	ssize_t result = recv(s->fds[0].fd, tail, room, 0);
+	if (result > 0) {
+		rb->len += result;
+	}
+	return result;
+}
+
 /*!
  * \brief Find Session in Globals Lists
  * \param s SCCP Session
@@ -354,6 +667,7 @@ static boolean_t sccp_session_addToGlobals(sccp_session_t * s)
 		if (!sccp_session_findBySession(s)) {;
 			SCCP_RWLIST_WRLOCK(&GLOB(sessions));
 			SCCP_LIST_INSERT_HEAD(&GLOB(sessions), s, list);
+			sccp_hashtable_insert(GLOB(session_index), &s->sin, s);
 			res = TRUE;
 			SCCP_RWLIST_UNLOCK(&GLOB(sessions));
 		}
@@ -379,6 +693,7 @@ static boolean_t sccp_session_removeFromGlobals(sccp_session_t * s)
 		SCCP_RWLIST_TRAVERSE_SAFE_BEGIN(&GLOB(sessions), session, list) {
 			if (session == s) {
 				SCCP_LIST_REMOVE_CURRENT(list);
+				sccp_hashtable_remove(GLOB(session_index), &s->sin, s);
 				res = TRUE;
 				break;
 			}
@@ -540,6 +855,15 @@ void destroy_session(sccp_session_t * s, uint8_t cleanupTime)
 	if (!s) {
 		return;
 	}
+#ifdef HAVE_SYS_EPOLL_H
+	if (s->eventloop) {
+		/* the owning eventloop still references this session, let it finish the teardown */
+		__sccp_session_stopthread(s, SKINNY_DEVICE_RS_NONE);
+		return;
+	}
+#endif
+	__sccp_session_keepalive_disarm(s);
+	__sccp_session_admission_release(s);
 
 	sccp_copy_string(addrStr, sccp_netsock_stringify_addr(&s->sin), sizeof(addrStr));
 
@@ -572,8 +896,30 @@ void destroy_session(sccp_session_t * s, uint8_t cleanupTime)
 		}
 		sccp_session_unlock(s);
 
+		/* releasing the messages which never made it out */
+		pbx_mutex_lock(&s->write_lock);
+		while (s->sendqueue && s->sendqueue_len > 0) {
+			sccp_free_packet(s->sendqueue[s->sendqueue_head]);
+			s->sendqueue_head = (s->sendqueue_head + 1) % s->sendqueue_size;
+			s->sendqueue_len--;
+		}
+		pbx_mutex_unlock(&s->write_lock);
+		if (s->sendqueue) {
+			sccp_free(s->sendqueue);
+		}
+		if (s->wakeup[0] > -1) {
+			close(s->wakeup[0]);
+			close(s->wakeup[1]);
+		}
+
 		/* destroying mutex and cleaning the session */
+		sccp_mutex_destroy(&s->write_lock);
 		sccp_mutex_destroy(&s->lock);
+#ifdef HAVE_SYS_EPOLL_H
+		if (s->recvbuffer) {
+			sccp_free(s->recvbuffer);
+		}
+#endif
 		sccp_free(s);
 		s = NULL;
 	}
@@ -595,129 +941,552 @@ void sccp_netsock_device_thread_exit(void *session)
 	}
 
 	sccp_log((DEBUGCAT_SOCKET)) (VERBOSE_PREFIX_3 "%s: cleanup session\n", DEV_ID_LOG(s->device));
+	__sccp_session_sendqueue_drain(s);									/* best effort, we don't wait for a phone which is not reading */
 	sccp_session_close(s);
 	s->session_thread = AST_PTHREADT_NULL;
 	destroy_session(s, SESSION_DEVICE_CLEANUP_TIME);
 }
 
 /*!
- * \brief Socket Device Thread
- * \param session SCCP Session
- *
- * \callgraph
- * \callergraph
+ * \brief Extra time allowed for device keepalive overrun (percentage of the keepalive interval)
+ * \note we increase additionalTime for wireless/slower devices
  */
-void *sccp_netsock_device_thread(void *session)
+static uint8_t __sccp_session_keepaliveAdditionalPercent(constSessionPtr s)
 {
-	sccp_session_t *s = (sccp_session_t *) session;
+	uint8_t keepaliveAdditionalTimePercent = KEEPALIVE_ADDITIONAL_PERCENT;
 
-	if (!s) {
-		return NULL;
+	if (s->device && (s->device->skinny_type == SKINNY_DEVICETYPE_CISCO7920 || s->device->skinny_type == SKINNY_DEVICETYPE_CISCO7921 || s->device->skinny_type == SKINNY_DEVICETYPE_CISCO7925 || s->device->skinny_type == SKINNY_DEVICETYPE_CISCO7926 || s->device->skinny_type == SKINNY_DEVICETYPE_CISCO7975 || s->device->skinny_type == SKINNY_DEVICETYPE_CISCO7970 || s->device->skinny_type == SKINNY_DEVICETYPE_CISCO6911)) {
+		keepaliveAdditionalTimePercent += KEEPALIVE_ADDITIONAL_PERCENT;
 	}
-	uint8_t keepaliveAdditionalTimePercent = KEEPALIVE_ADDITIONAL_PERCENT;
-	int res;
-	int maxWaitTime;
-	int pollTimeout;
-	
-	int result = 0;
-	unsigned char recv_buffer[SCCP_MAX_PACKET * 2] = "";
-	size_t recv_len = 0;
-	sccp_msg_t msg = { {0,} };
+	return keepaliveAdditionalTimePercent;
+}
 
-	char addrStr[INET6_ADDRSTRLEN];
+/*!
+ * \brief Number of seconds a session may stay silent before it is considered dead
+ */
+static int __sccp_session_keepaliveMaxWaitTime(constSessionPtr s)
+{
+	int maxWaitTime = (s->device) ? s->device->keepalive : GLOB(keepalive);
 
-	pthread_cleanup_push(sccp_netsock_device_thread_exit, session);
+	return maxWaitTime + (maxWaitTime / 100) * __sccp_session_keepaliveAdditionalPercent(s);
+}
 
-	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
+/*!
+ * \brief SCCP Session Keepalive Timing Wheel
+ *
+ * Hashed timing wheel holding one entry per session, filed under the second its keepalive deadline falls in. Receiving
+ * a message only stores lastKeepAlive; an entry whose session was heard from in the meantime is moved to the slot of
+ * its new deadline when its old slot comes up. A tick therefore only looks at the sessions which expire or have to be
+ * moved in that second, instead of at every session. The wheel is ticked by the session eventloops, or by the socket
+ * thread when running a thread per session.
+ */
+typedef struct sccp_session_keepalive_wheel {
+	sccp_session_t *slots[SESSION_KEEPALIVE_WHEEL_SLOTS];							/*!< Sessions per deadline second (modulo number of slots) */
+	time_t now;												/*!< Last second processed */
+	time_t interval_start;											/*!< Start of the current statistics interval */
+	uint armed;												/*!< Number of sessions in the wheel */
+	uint expired_total;											/*!< Number of sessions timed out */
+	uint expired_interval;											/*!< Number of sessions timed out in the current interval */
+	uint expired_last_interval;										/*!< Number of sessions timed out in the previous interval */
+	uint rescheduled_total;											/*!< Number of entries moved to a later slot */
+} sccp_session_keepalive_wheel_t;										/*!< SCCP Session Keepalive Timing Wheel */
+
+static sccp_session_keepalive_wheel_t keepalive_wheel;
+AST_MUTEX_DEFINE_STATIC(keepalive_wheel_lock);
 
-	/* we increase additionalTime for wireless/slower devices */
-	if (s->device && (s->device->skinny_type == SKINNY_DEVICETYPE_CISCO7920 || s->device->skinny_type == SKINNY_DEVICETYPE_CISCO7921 || s->device->skinny_type == SKINNY_DEVICETYPE_CISCO7925 || s->device->skinny_type == SKINNY_DEVICETYPE_CISCO7926 || s->device->skinny_type == SKINNY_DEVICETYPE_CISCO7975 || s->device->skinny_type == SKINNY_DEVICETYPE_CISCO7970 || s->device->skinny_type == SKINNY_DEVICETYPE_CISCO6911)) {
-		keepaliveAdditionalTimePercent += KEEPALIVE_ADDITIONAL_PERCENT;
+/*!
+ * \note keepalive_wheel_lock needs to be held
+ */
+static void __keepalive_wheel_unlink(sccp_session_keepalive_wheel_t * wheel, sccp_session_t * s)
+{
+	if (s->keepalive_slot < 0) {
+		return;
 	}
+	if (s->keepalive_prev) {
+		s->keepalive_prev->keepalive_next = s->keepalive_next;
+	} else {
+		wheel->slots[s->keepalive_slot] = s->keepalive_next;
+	}
+	if (s->keepalive_next) {
+		s->keepalive_next->keepalive_prev = s->keepalive_prev;
+	}
+	s->keepalive_next = s->keepalive_prev = NULL;
+	s->keepalive_slot = -1;
+	wheel->armed--;
+}
 
-	while (s->fds[0].fd > 0 && !s->session_stop) {
-		if (s->device && (s->device->pendingUpdate != FALSE || s->device->pendingDelete != FALSE)) {
-			pbx_rwlock_rdlock(&GLOB(lock));
-			boolean_t reload_in_progress = GLOB(reload_in_progress);
-			pbx_rwlock_unlock(&GLOB(lock));
-			if (reload_in_progress == FALSE) {
-				sccp_device_check_update(s->device);
-			}
-		}
-		/* calculate poll timout using keepalive interval */
-		maxWaitTime = (s->device) ? s->device->keepalive : GLOB(keepalive);
-		maxWaitTime += (maxWaitTime / 100) * keepaliveAdditionalTimePercent;
-		pollTimeout = maxWaitTime * 1000;
+/*!
+ * \note keepalive_wheel_lock needs to be held
+ */
+static void __keepalive_wheel_link(sccp_session_keepalive_wheel_t * wheel, sccp_session_t * s, time_t deadline)
+{
+	if (wheel->now && deadline <= wheel->now) {								/* already overdue, handle it on the next tick */
+		deadline = wheel->now + 1;
+	}
+	s->keepalive_deadline = deadline;
+	s->keepalive_slot = (int) (deadline & (SESSION_KEEPALIVE_WHEEL_SLOTS - 1));
+	s->keepalive_prev = NULL;
+	s->keepalive_next = wheel->slots[s->keepalive_slot];
+	if (s->keepalive_next) {
+		s->keepalive_next->keepalive_prev = s;
+	}
+	wheel->slots[s->keepalive_slot] = s;
+	wheel->armed++;
+}
 
-		sccp_log_and((DEBUGCAT_SOCKET + DEBUGCAT_HIGH)) (VERBOSE_PREFIX_4 "%s: set poll timeout %d for session %d\n", DEV_ID_LOG(s->device), (int) maxWaitTime, s->fds[0].fd);
+/*!
+ * \brief Time out a session: only flag it and wake up its owner, which finishes the teardown
+ * \note keepalive_wheel_lock needs to be held, which keeps the session from being destroyed
+ * \note s->device is not protected by the wheel lock (it is released under the session lock), so only the session designator is logged
+ */
+static void __keepalive_wheel_expire(sccp_session_t * s, int maxWaitTime)
+{
+	char addrStr[INET6_ADDRSTRLEN];
 
-		res = sccp_netsock_poll(s->fds, 1, pollTimeout);
-		if (-1 == res) {										/* poll data processing */
-			if (errno > 0 && (errno != EAGAIN) && (errno != EINTR)) {
-				sccp_copy_string(addrStr, sccp_netsock_stringify_addr(&s->sin), sizeof(addrStr));
-				pbx_log(LOG_ERROR, "%s: poll() returned %d. errno: %s, (ip-address: %s)\n", DEV_ID_LOG(s->device), errno, strerror(errno), addrStr);
-				__sccp_session_stopthread(s, SKINNY_DEVICE_RS_FAILED);
-				break;
-			}
-		} else if (0 == res) {										/* poll timeout */
-			if (((int) time(0) >= ((int) s->lastKeepAlive + maxWaitTime))) {
-				sccp_copy_string(addrStr, sccp_netsock_stringify_addr(&s->sin), sizeof(addrStr));
-				pbx_log(LOG_NOTICE, "%s: Closing session because connection timed out after %d seconds (ip-address: %s).\n", DEV_ID_LOG(s->device), maxWaitTime, addrStr);
-				__sccp_session_stopthread(s, SKINNY_DEVICE_RS_TIMEOUT);
-				break;
+	sccp_copy_string(addrStr, sccp_netsock_stringify_addr(&s->sin), sizeof(addrStr));
+	pbx_log(LOG_NOTICE, "%s: Closing session because connection timed out after %d seconds (ip-address: %s).\n", sccp_session_getDesignator(s), maxWaitTime, addrStr);
+	s->keepalive_expired = TRUE;
+	s->session_stop = TRUE;
+	if (s->fds[0].fd > 0) {
+		shutdown(s->fds[0].fd, SHUT_RD);								// wakes up poll / epoll_wait of the owner
+	}
+}
+
+/*!
+ * \brief Process all slots up to and including now
+ * \note keepalive_wheel_lock needs to be held
+ */
+static void __keepalive_wheel_advance(sccp_session_keepalive_wheel_t * wheel, time_t now)
+{
+	sccp_session_t *s = NULL, *next = NULL;
+	time_t t, deadline;
+	int maxWaitTime;
+
+	if (!wheel->now || now < wheel->now) {								/* first tick or clock set back */
+		wheel->now = now - 1;
+	} else if (now - wheel->now > SESSION_KEEPALIVE_WHEEL_SLOTS) {					/* clock jumped ahead, visit every slot once */
+		wheel->now = now - SESSION_KEEPALIVE_WHEEL_SLOTS;
+	}
+	if (!wheel->interval_start) {
+		wheel->interval_start = now;
+	}
+	for (t = wheel->now + 1; t <= now; t++) {
+		for (s = wheel->slots[t & (SESSION_KEEPALIVE_WHEEL_SLOTS - 1)]; s; s = next) {
+			next = s->keepalive_next;
+			if (s->session_stop) {									/* being torn down already */
+				__keepalive_wheel_unlink(wheel, s);
+				continue;
 			}
-		} else if (res > 0) {										/* poll data processing */
-			if (s->fds[0].revents & POLLIN || s->fds[0].revents & POLLPRI) {			/* POLLIN | POLLPRI */
-				//sccp_log_and((DEBUGCAT_SOCKET + DEBUGCAT_HIGH)) (VERBOSE_PREFIX_2 "%s: Session New Data Arriving at buffer position:%lu\n", DEV_ID_LOG(s->device), recv_len);
-				result = recv(s->fds[0].fd, recv_buffer + recv_len, (SCCP_MAX_PACKET * 2) - recv_len, 0);
-				if (!(result > 0 && (recv_len += result) && ((SCCP_MAX_PACKET * 2) - recv_len) && process_buffer(s, &msg, recv_buffer, &recv_len) == 0)) {
-					//socket_get_error(s, __FILE__, __LINE__, __PRETTY_FUNCTION__, errno);
-					if (s->device) {
-						sccp_device_sendReset(s->device, SKINNY_DEVICE_RESTART);
-					}
-					__sccp_session_stopthread(s, SKINNY_DEVICE_RS_FAILED);
-					break;
+			maxWaitTime = __sccp_session_keepaliveMaxWaitTime(s);
+			deadline = s->lastKeepAlive + maxWaitTime;
+			if (deadline > t) {
+				if ((deadline & (SESSION_KEEPALIVE_WHEEL_SLOTS - 1)) != (t & (SESSION_KEEPALIVE_WHEEL_SLOTS - 1))) {
+					__keepalive_wheel_unlink(wheel, s);
+					__keepalive_wheel_link(wheel, s, deadline);
+					wheel->rescheduled_total++;
 				}
-				s->lastKeepAlive = time(0);
-			} else {										/* POLLHUP / POLLERR */
-				pbx_log(LOG_NOTICE, "%s: Closing session because we received POLLPRI/POLLHUP/POLLERR\n", DEV_ID_LOG(s->device));
-				__sccp_session_stopthread(s, SKINNY_DEVICE_RS_FAILED);
-				break;
+				continue;
 			}
-		} else {											/* poll returned invalid res */
-			pbx_log(LOG_NOTICE, "%s: Poll Returned invalid result: %d.\n", DEV_ID_LOG(s->device), res);
+			__keepalive_wheel_unlink(wheel, s);
+			__keepalive_wheel_expire(s, maxWaitTime);
+			wheel->expired_total++;
+			wheel->expired_interval++;
 		}
 	}
-	sccp_log((DEBUGCAT_SOCKET)) (VERBOSE_PREFIX_3 "%s: Exiting sccp_socket device thread\n", DEV_ID_LOG(s->device));
+	wheel->now = now;
+	if (now - wheel->interval_start >= SESSION_KEEPALIVE_STATS_INTERVAL) {
+		wheel->expired_last_interval = wheel->expired_interval;
+		wheel->expired_interval = 0;
+		wheel->interval_start = now;
+	}
+}
 
-	pthread_cleanup_pop(1);
+/*!
+ * \brief Add a session to the keepalive wheel, using its current lastKeepAlive
+ */
+static void __sccp_session_keepalive_arm(sccp_session_t * s)
+{
+	pbx_mutex_lock(&keepalive_wheel_lock);
+	__keepalive_wheel_unlink(&keepalive_wheel, s);
+	__keepalive_wheel_link(&keepalive_wheel, s, s->lastKeepAlive + __sccp_session_keepaliveMaxWaitTime(s));
+	pbx_mutex_unlock(&keepalive_wheel_lock);
+}
 
-	return NULL;
+static void __sccp_session_keepalive_disarm(sccp_session_t * s)
+{
+	pbx_mutex_lock(&keepalive_wheel_lock);
+	__keepalive_wheel_unlink(&keepalive_wheel, s);
+	pbx_mutex_unlock(&keepalive_wheel_lock);
 }
 
-#define SCCP_SETSOCKETOPTION(_SOCKET, _LEVEL,_OPTIONNAME, _OPTIONVAL, _OPTIONLEN) 							\
-	if (setsockopt(_SOCKET, _LEVEL, _OPTIONNAME, (void*)(_OPTIONVAL), _OPTIONLEN) == -1) {						\
-		if (errno != ENOTSUP) {													\
-			pbx_log(LOG_WARNING, "Failed to set SCCP socket: " #_LEVEL ":" #_OPTIONNAME " error: '%s'\n", strerror(errno));	\
-		}															\
+/*!
+ * \brief Expire the sessions whose deadline has passed
+ * \note can be called by multiple eventloops, only one of them does the work
+ */
+static void __sccp_session_keepalive_tick(void)
+{
+	time_t now = time(0);
+
+	if (keepalive_wheel.now == now || pbx_mutex_trylock(&keepalive_wheel_lock) != 0) {
+		return;
 	}
+	__keepalive_wheel_advance(&keepalive_wheel, now);
+	pbx_mutex_unlock(&keepalive_wheel_lock);
+}
 
-void sccp_netsock_setoptions(int new_socket)
+/*!
+ * \brief Keepalive wheel statistics
+ * \param[out] armed Number of sessions supervised
+ * \param[out] expired_total Number of sessions timed out since module load
+ * \param[out] expired_last_interval Number of sessions timed out during the last statistics interval
+ * \param[out] rescheduled_total Number of wheel entries moved to the slot of their new deadline
+ */
+void sccp_session_keepalive_stats(uint * armed, uint * expired_total, uint * expired_last_interval, uint * rescheduled_total)
 {
-	int on = 1;
-	int value;
+	pbx_mutex_lock(&keepalive_wheel_lock);
+	*armed = keepalive_wheel.armed;
+	*expired_total = keepalive_wheel.expired_total;
+	*expired_last_interval = keepalive_wheel.expired_last_interval;
+	*rescheduled_total = keepalive_wheel.rescheduled_total;
+	pbx_mutex_unlock(&keepalive_wheel_lock);
+}
 
-	SCCP_SETSOCKETOPTION(new_socket, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
-	SCCP_SETSOCKETOPTION(new_socket, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
-	value = (int) GLOB(sccp_tos);
-	SCCP_SETSOCKETOPTION(new_socket, IPPROTO_IP, IP_TOS, &value, sizeof(value));
-#if defined(linux)
-	value = (int) GLOB(sccp_cos);
-	SCCP_SETSOCKETOPTION(new_socket, SOL_SOCKET, SO_PRIORITY, &value, sizeof(value));
+/*!
+ * \brief SCCP Session Admission Control
+ *
+ * Keeps the listener from blocking, and the rest of the module from being overrun, when a lot of phones connect at the
+ * same time. A connection from an ip-address which still has a session is parked on the deferred queue and retried by
+ * the listener tick, instead of making the listener sleep. Other connections need a token from a bucket refilled at
+ * admission_rate tokens per second, and have to stay below admission_max_pending registrations in progress. Phones over
+ * either limit get a RegisterTokenReject with a backoff, which grows with the number of phones already turned away.
+ * The bucket, backlog and deferred queue are only used by the listener (socket thread / eventloop 0).
+ */
+typedef struct sccp_session_admission {
+	uint64_t tokens;											/*!< Tokens available, in thousandths of a token */
+	struct timeval refilled;										/*!< Last time tokens were added to the bucket */
+	uint backlog;												/*!< Estimated number of turned away phones which still have to come back */
+	time_t backlog_decayed;											/*!< Last second the backlog was decayed */
+	sccp_session_t *deferred_head;										/*!< Oldest deferred connection */
+	sccp_session_t *deferred_tail;										/*!< Newest deferred connection */
+	uint deferred_len;											/*!< Number of deferred connections */
+	volatile int inprogress;										/*!< Number of admitted sessions which have not finished registering */
+	uint32_t admitted;											/*!< Number of connections admitted */
+	uint32_t deferred;											/*!< Number of connections deferred because their ip-address still had a session */
+	uint32_t rejected;											/*!< Number of connections turned away */
+} sccp_session_admission_t;											/*!< SCCP Session Admission Control */
+
+static sccp_session_admission_t session_admission;
+AST_MUTEX_DEFINE_STATIC(session_admission_lock);
 
-	/* timeeo */
-	//struct timeval mytv = { SOCKET_TIMEOUT_SEC, SOCKET_TIMEOUT_MILLISEC };					/* timeout after seven seconds when trying to read/write from/to a socket */
-	//SCCP_SETSOCKETOPTION(new_socket, SOL_SOCKET, SO_RCVTIMEO, &mytv, sizeof(mytv));
+/*!
+ * \brief Take a token from the admission bucket, which holds at most one second worth of tokens
+ * \return TRUE when a token was available, always TRUE when rate is 0 (unlimited)
+ */
+static boolean_t __sccp_session_admission_take(sccp_session_admission_t * adm, int rate, struct timeval now)
+{
+	uint64_t burst = (uint64_t) rate * 1000;
+	int64_t elapsed;
+
+	if (rate <= 0) {
+		return TRUE;
+	}
+	if (adm->refilled.tv_sec == 0) {									/* first connection, start with a full bucket */
+		adm->tokens = burst;
+	} else if ((elapsed = ast_tvdiff_ms(now, adm->refilled)) > 0) {
+		adm->tokens += (uint64_t) elapsed * rate;
+	}
+	if (adm->tokens > burst) {
+		adm->tokens = burst;
+	}
+	adm->refilled = now;
+	if (adm->tokens < 1000) {
+		return FALSE;
+	}
+	adm->tokens -= 1000;
+	return TRUE;
+}
+
+/*!
+ * \brief Forget about the turned away phones which should have been admitted by now
+ */
+static void __sccp_session_admission_decay(sccp_session_admission_t * adm, int rate, time_t now)
+{
+	uint64_t drained;
+
+	if (adm->backlog_decayed != 0 && now > adm->backlog_decayed) {
+		drained = (uint64_t) (now - adm->backlog_decayed) * (rate > 0 ? rate : ACCEPT_ASSUMED_RATE);
+		adm->backlog = (drained >= adm->backlog) ? 0 : adm->backlog - (uint) drained;
+	}
+	adm->backlog_decayed = now;
+}
+
+/*!
+ * \brief Backoff time in seconds for a phone turned away by admission control
+ * \note spreads the turned away phones over the time needed to admit the ones already waiting, with some jitter so they do not all come back in the same second
+ */
+static uint32_t __sccp_session_admission_backoff(sccp_session_admission_t * adm, int rate)
+{
+	uint32_t backoff = ACCEPT_BACKOFF_MIN + adm->backlog / (rate > 0 ? rate : ACCEPT_ASSUMED_RATE) + (uint32_t) (sccp_random() % ACCEPT_BACKOFF_MIN);
+
+	adm->backlog++;
+	return (backoff < ACCEPT_BACKOFF_MAX) ? backoff : ACCEPT_BACKOFF_MAX;
+}
+
+/*!
+ * \brief Stop counting a session as registration in progress
+ */
+static void __sccp_session_admission_release(sccp_session_t * s)
+{
+	boolean_t was_pending = FALSE;
+
+	if (!s->admission_pending) {
+		return;
+	}
+	sccp_session_lock(s);
+	was_pending = s->admission_pending;
+	s->admission_pending = FALSE;
+	sccp_session_unlock(s);
+	if (was_pending) {
+		ATOMIC_DECR(&session_admission.inprogress, 1, &session_admission_lock);
+	}
+}
+
+/*!
+ * \brief Release the admission slot once the device registered
+ */
+static void __sccp_session_admission_check(sccp_session_t * s)
+{
+	if (s->admission_pending && s->device && sccp_device_getRegistrationState(s->device) == SKINNY_DEVICE_RS_OK) {
+		__sccp_session_admission_release(s);
+	}
+}
+
+/*!
+ * \brief Admission control statistics
+ * \param[out] admitted Number of connections admitted since module load
+ * \param[out] deferred Number of connections deferred because their ip-address still had a session
+ * \param[out] rejected Number of connections turned away
+ * \param[out] inprogress Number of registrations in progress
+ */
+void sccp_session_admission_stats(uint * admitted, uint * deferred, uint * rejected, uint * inprogress)
+{
+	*admitted = session_admission.admitted;
+	*deferred = session_admission.deferred;
+	*rejected = session_admission.rejected;
+	*inprogress = (uint) ATOMIC_FETCH(&session_admission.inprogress, &session_admission_lock);
+}
+
+static sccp_session_load_t session_load;
+AST_MUTEX_DEFINE_STATIC(session_load_lock);
+
+/*!
+ * \brief Express value as a percentage of capacity, capped at 100 (0 when there is no capacity to compare with)
+ */
+static int __sccp_session_load_percentage(uint64_t value, uint64_t capacity)
+{
+	if (capacity == 0) {
+		return 0;
+	}
+	return (value >= capacity) ? 100 : (int) (value * 100 / capacity);
+}
+
+/*!
+ * \brief Combine the load signals into the component scores and the overall score
+ */
+static void __sccp_session_load_score(sccp_session_load_t * load, int max_sessions, int max_pending)
+{
+	load->jobs_score = __sccp_session_load_percentage(load->queued_jobs > 0 ? load->queued_jobs : 0, (uint64_t) (load->threads > 0 ? load->threads : 1) * SESSION_LOAD_JOBS_PER_THREAD);
+	load->sessions_score = __sccp_session_load_percentage(load->sessions, max_sessions > 0 ? max_sessions : 0);
+	load->registrations_score = __sccp_session_load_percentage(load->inprogress, max_pending > 0 ? max_pending : 0);
+	load->sendqueue_score = __sccp_session_load_percentage(load->queued_messages, (uint64_t) load->sessions * SESSION_SENDQUEUE_BATCH);
+
+	load->score = load->jobs_score;
+	if (load->sessions_score > load->score) {
+		load->score = load->sessions_score;
+	}
+	if (load->registrations_score > load->score) {
+		load->score = load->registrations_score;
+	}
+	if (load->sendqueue_score > load->score) {
+		load->score = load->sendqueue_score;
+	}
+}
+
+/*!
+ * \brief Current load of this server, sampled at most once per second
+ * \param[out] load Load Sample
+ *
+ * \lock
+ *      - sessions
+ */
+void sccp_session_getLoad(sccp_session_load_t * load)
+{
+	sccp_session_t *session = NULL;
+	time_t now = time(0);
+
+	pbx_mutex_lock(&session_load_lock);
+	if (session_load.sampled != now) {
+		session_load.queued_jobs = GLOB(general_threadpool) ? sccp_threadpool_jobqueue_count(GLOB(general_threadpool)) : 0;
+		session_load.threads = GLOB(general_threadpool) ? sccp_threadpool_thread_count(GLOB(general_threadpool)) : 0;
+		session_load.sessions = 0;
+		session_load.queued_messages = 0;
+		SCCP_RWLIST_RDLOCK(&GLOB(sessions));
+		SCCP_RWLIST_TRAVERSE(&GLOB(sessions), session, list) {
+			session_load.sessions++;
+			session_load.queued_messages += session->sendqueue_len;				/* read without the write_lock, a sample does not need to be exact */
+		}
+		SCCP_RWLIST_UNLOCK(&GLOB(sessions));
+		session_load.inprogress = (uint) ATOMIC_FETCH(&session_admission.inprogress, &session_admission_lock);
+		__sccp_session_load_score(&session_load, GLOB(token_load_max_sessions), GLOB(session_admission_max_pending));
+		session_load.sampled = now;
+	}
+	*load = session_load;
+	pbx_mutex_unlock(&session_load_lock);
+}
+
+/*!
+ * \brief Backoff time for a token request rejected because of load
+ * \note backoff_time at the threshold, growing to four times backoff_time at full load, plus up to a quarter of backoff_time jitter
+ */
+uint32_t sccp_session_loadBackoff(int score, int threshold, int backoff_time)
+{
+	uint32_t base = backoff_time > 0 ? (uint32_t) backoff_time : 0;
+	uint32_t backoff = base;
+	int range = 100 - threshold;
+	int over = score - threshold;
+
+	if (range > 0 && over > 0) {
+		backoff += base * 3 * (uint32_t) (over < range ? over : range) / (uint32_t) range;
+	}
+	return backoff + (uint32_t) sccp_random() % (base / 4 + 1);
+}
+
+/*!
+ * \brief Apply pending device configuration changes, unless a reload is still in progress
+ */
+static void __sccp_session_check_pendingUpdate(constSessionPtr s)
+{
+	if (s->device && (s->device->pendingUpdate != FALSE || s->device->pendingDelete != FALSE)) {
+		pbx_rwlock_rdlock(&GLOB(lock));
+		boolean_t reload_in_progress = GLOB(reload_in_progress);
+		pbx_rwlock_unlock(&GLOB(lock));
+		if (reload_in_progress == FALSE) {
+			sccp_device_check_update(s->device);
+		}
+	}
+}
+
+/*!
+ * \brief Socket Device Thread
+ * \param session SCCP Session
+ *
+ * \callgraph
+ * \callergraph
+ */
+void *sccp_netsock_device_thread(void *session)
+{
+	sccp_session_t *s = (sccp_session_t *) session;
+
+	if (!s) {
+		return NULL;
+	}
+	int res;
+	int pollTimeout;
+	
+	int result = 0;
+	sccp_session_recvbuffer_t recvbuffer = { 0 };
+	sccp_msg_t msg = { {0,} };
+	char wakeup_buffer[16];
+
+	char addrStr[INET6_ADDRSTRLEN];
+
+	pthread_cleanup_push(sccp_netsock_device_thread_exit, session);
+
+	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
+
+	while (s->fds[0].fd > 0 && !s->session_stop) {
+		__sccp_session_check_pendingUpdate(s);
+		__sccp_session_admission_check(s);
+		if (__sccp_session_sendqueue_drain(s) < 0) {							/* messages queued while handling the previous event */
+			__sccp_session_stopthread(s, SKINNY_DEVICE_RS_FAILED);
+			break;
+		}
+		/* keepalive timeouts are enforced by the keepalive wheel, the poll timeout only paces the housekeeping above */
+		pollTimeout = ((s->device) ? s->device->keepalive : GLOB(keepalive)) * 1000;
+
+		s->fds[0].events = POLLIN | POLLPRI | (s->want_write ? POLLOUT : 0);
+		res = sccp_netsock_poll(s->fds, (s->fds[1].fd > -1) ? 2 : 1, pollTimeout);
+		if (s->keepalive_expired) {									/* woken up by the keepalive wheel */
+			__sccp_session_stopthread(s, SKINNY_DEVICE_RS_TIMEOUT);
+			break;
+		}
+		if (-1 == res) {										/* poll data processing */
+			if (errno > 0 && (errno != EAGAIN) && (errno != EINTR)) {
+				sccp_copy_string(addrStr, sccp_netsock_stringify_addr(&s->sin), sizeof(addrStr));
+				pbx_log(LOG_ERROR, "%s: poll() returned %d. errno: %s, (ip-address: %s)\n", DEV_ID_LOG(s->device), errno, strerror(errno), addrStr);
+				__sccp_session_stopthread(s, SKINNY_DEVICE_RS_FAILED);
+				break;
+			}
+		} else if (0 == res) {										/* poll timeout */
+			continue;
+		} else if (res > 0) {										/* poll data processing */
+			if (s->fds[1].fd > -1 && (s->fds[1].revents & POLLIN)) {				/* woken up to watch for POLLOUT */
+				while (read(s->fds[1].fd, wakeup_buffer, sizeof(wakeup_buffer)) > 0);
+			}
+			if (s->fds[0].revents & POLLIN || s->fds[0].revents & POLLPRI) {			/* POLLIN | POLLPRI */
+				//sccp_log_and((DEBUGCAT_SOCKET + DEBUGCAT_HIGH)) (VERBOSE_PREFIX_2 "%s: Session New Data Arriving at buffer position:%lu\n", DEV_ID_LOG(s->device), recvbuffer.start + recvbuffer.len);
+				result = session_recv(s, &recvbuffer);
+				if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+					continue;
+				}
+				if (!(result > 0 && process_buffer(s, &msg, &recvbuffer, sccp_handle_message, TRUE) == 0)) {
+					//socket_get_error(s, __FILE__, __LINE__, __PRETTY_FUNCTION__, errno);
+					if (s->device) {
+						sccp_device_sendReset(s->device, SKINNY_DEVICE_RESTART);
+					}
+					__sccp_session_stopthread(s, SKINNY_DEVICE_RS_FAILED);
+					break;
+				}
+				s->lastKeepAlive = time(0);
+			} else if (s->fds[0].revents & (POLLHUP | POLLERR | POLLNVAL)) {			/* POLLHUP / POLLERR */
+				pbx_log(LOG_NOTICE, "%s: Closing session because we received POLLPRI/POLLHUP/POLLERR\n", DEV_ID_LOG(s->device));
+				__sccp_session_stopthread(s, SKINNY_DEVICE_RS_FAILED);
+				break;
+			}
+		} else {											/* poll returned invalid res */
+			pbx_log(LOG_NOTICE, "%s: Poll Returned invalid result: %d.\n", DEV_ID_LOG(s->device), res);
+		}
+	}
+	sccp_log((DEBUGCAT_SOCKET)) (VERBOSE_PREFIX_3 "%s: Exiting sccp_socket device thread\n", DEV_ID_LOG(s->device));
+
+	pthread_cleanup_pop(1);
+
+	return NULL;
+}
+
+#define SCCP_SETSOCKETOPTION(_SOCKET, _LEVEL,_OPTIONNAME, _OPTIONVAL, _OPTIONLEN) 							\
+	if (setsockopt(_SOCKET, _LEVEL, _OPTIONNAME, (void*)(_OPTIONVAL), _OPTIONLEN) == -1) {						\
+		if (errno != ENOTSUP) {													\
+			pbx_log(LOG_WARNING, "Failed to set SCCP socket: " #_LEVEL ":" #_OPTIONNAME " error: '%s'\n", strerror(errno));	\
+		}															\
+	}
+
+void sccp_netsock_setoptions(int new_socket)
+{
+	int on = 1;
+	int value;
+
+	SCCP_SETSOCKETOPTION(new_socket, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	SCCP_SETSOCKETOPTION(new_socket, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	value = (int) GLOB(sccp_tos);
+	SCCP_SETSOCKETOPTION(new_socket, IPPROTO_IP, IP_TOS, &value, sizeof(value));
+#if defined(linux)
+	value = (int) GLOB(sccp_cos);
+	SCCP_SETSOCKETOPTION(new_socket, SOL_SOCKET, SO_PRIORITY, &value, sizeof(value));
+
+	/* timeeo */
+	//struct timeval mytv = { SOCKET_TIMEOUT_SEC, SOCKET_TIMEOUT_MILLISEC };					/* timeout after seven seconds when trying to read/write from/to a socket */
+	//SCCP_SETSOCKETOPTION(new_socket, SOL_SOCKET, SO_RCVTIMEO, &mytv, sizeof(mytv));
 	//SCCP_SETSOCKETOPTION(new_socket, SOL_SOCKET, SO_SNDTIMEO, &mytv, sizeof(mytv));
 
 	/* keepalive */
@@ -750,6 +1519,183 @@ void sccp_netsock_setoptions(int new_socket)
 #undef SCCP_SETSOCKETOPTION
 
 
+/*!
+ * \brief Hand an admitted connection to an eventloop or a session thread
+ *
+ * \lock
+ *      - sessions
+ */
+static void __sccp_session_start(sccp_session_t * s)
+{
+	char addrStr[INET6_ADDRSTRLEN];
+
+	sccp_copy_string(addrStr, sccp_netsock_stringify(&s->sin), sizeof(addrStr));
+
+	sccp_session_addToGlobals(s);
+
+	/** set default handler for registration to sccp */
+	s->protocolType = SCCP_PROTOCOL;
+
+	s->lastKeepAlive = time(0);
+	__sccp_session_keepalive_arm(s);
+	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "SCCP: Accepted Client Connection from %s\n", addrStr);
+
+	if (sccp_netsock_is_any_addr(&GLOB(bindaddr))) {
+		__sccp_session_setOurAddressFromTheirs(&s->sin, &s->ourip);
+	} else {
+		memcpy(&s->ourip, &GLOB(bindaddr), sizeof(s->ourip));
+	}
+	sccp_copy_string(s->designator, sccp_netsock_stringify(&s->ourip), sizeof(s->designator));
+
+	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "SCCP: Connected on server via %s\n", s->designator);
+
+#ifdef HAVE_SYS_EPOLL_H
+	if (num_eventloops > 0) {
+		if (!__sccp_session_eventloop_add(s)) {
+			pbx_log(LOG_ERROR, "SCCP: Could not hand session %s to an eventloop, closing connection\n", addrStr);
+			destroy_session(s, 0);
+		}
+		return;
+	}
+#endif
+	if (pipe(s->wakeup) == 0) {
+		fcntl(s->wakeup[0], F_SETFL, fcntl(s->wakeup[0], F_GETFL, 0) | O_NONBLOCK);
+		fcntl(s->wakeup[1], F_SETFL, fcntl(s->wakeup[1], F_GETFL, 0) | O_NONBLOCK);
+		s->fds[1].fd = s->wakeup[0];
+	} else {
+		pbx_log(LOG_WARNING, "SCCP: Failed to create session wakeup pipe, send queue will only be drained on socket events. errno: %d (%s)\n", errno, strerror(errno));
+		s->wakeup[0] = s->wakeup[1] = -1;
+	}
+	size_t stacksize = 0;
+	pthread_attr_t attr;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	pbx_pthread_create(&s->session_thread, &attr, sccp_netsock_device_thread, s);
+	if (!pthread_attr_getstacksize(&attr, &stacksize)) {
+		sccp_log((DEBUGCAT_HIGH)) (VERBOSE_PREFIX_3 "SCCP: Using %d memory for this thread\n", (int) stacksize);
+	}
+}
+
+/*!
+ * \brief Turn a connection away with a RegisterTokenReject, telling the phone when to come back
+ */
+static void __sccp_session_admission_reject(sccp_session_t * s, const char *reason)
+{
+	uint32_t backoff = __sccp_session_admission_backoff(&session_admission, GLOB(session_admission_rate));
+
+	session_admission.rejected++;
+	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "SCCP: Rejecting Connection from %s: %s, backoff %d seconds\n", sccp_netsock_stringify(&s->sin), reason, backoff);
+	sccp_session_tokenReject(s, backoff);
+	destroy_session(s, 0);
+}
+
+/*!
+ * \brief Admit a connection when there is a token in the bucket and room for another registration in progress, turn it away otherwise
+ */
+static void __sccp_session_admission_control(sccp_session_t * s)
+{
+	int max_pending = GLOB(session_admission_max_pending);
+
+	__sccp_session_admission_decay(&session_admission, GLOB(session_admission_rate), time(0));
+	if (max_pending > 0 && ATOMIC_FETCH(&session_admission.inprogress, &session_admission_lock) >= max_pending) {
+		__sccp_session_admission_reject(s, "too many registrations in progress");
+		return;
+	}
+	if (!__sccp_session_admission_take(&session_admission, GLOB(session_admission_rate), pbx_tvnow())) {
+		__sccp_session_admission_reject(s, "admission rate exceeded");
+		return;
+	}
+	session_admission.admitted++;
+	s->admission_pending = TRUE;
+	ATOMIC_INCR(&session_admission.inprogress, 1, &session_admission_lock);
+	__sccp_session_start(s);
+}
+
+/*!
+ * \brief Park a connection whose ip-address still has a session, until that session is gone
+ */
+static void __sccp_session_admission_defer(sccp_session_t * s)
+{
+	if (session_admission.deferred_len >= ACCEPT_MAX_DEFERRED) {
+		__sccp_session_admission_reject(s, "deferred queue full");
+		return;
+	}
+	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "SCCP: Session with this IP-address is already known %s. deferring !\n", sccp_netsock_stringify(&s->sin));
+	s->admission_retries = 0;
+	s->admission_retry = time(0) + ACCEPT_UWAIT_ON_KNOWN_IP;
+	s->admission_next = NULL;
+	if (session_admission.deferred_tail) {
+		session_admission.deferred_tail->admission_next = s;
+	} else {
+		session_admission.deferred_head = s;
+	}
+	session_admission.deferred_tail = s;
+	session_admission.deferred_len++;
+	session_admission.deferred++;
+}
+
+/*!
+ * \brief Retry the deferred connections which are due, called by the listener once per second
+ */
+static void __sccp_session_admission_tick(void)
+{
+	sccp_session_t *s = NULL;
+	sccp_session_t *prev = NULL;
+	sccp_session_t *next = NULL;
+	time_t now = time(0);
+
+	for (s = session_admission.deferred_head; s; s = next) {
+		next = s->admission_next;
+		if (s->admission_retry > now) {
+			prev = s;
+			continue;
+		}
+		if (sccp_session_findByIP(&s->sin) != NULL && ++s->admission_retries < ACCEPT_RETRIES) {
+			s->admission_retry = now + ACCEPT_UWAIT_ON_KNOWN_IP;
+			prev = s;
+			continue;
+		}
+		/* unlink, the connection is either admitted or rejected now */
+		if (prev) {
+			prev->admission_next = next;
+		} else {
+			session_admission.deferred_head = next;
+		}
+		if (session_admission.deferred_tail == s) {
+			session_admission.deferred_tail = prev;
+		}
+		session_admission.deferred_len--;
+		s->admission_next = NULL;
+
+		if (s->admission_retries >= ACCEPT_RETRIES) {
+			sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "SCCP: Session with this IP-address is already known %s. exceeding wait time, denied connection !\n", sccp_netsock_stringify(&s->sin));
+			session_admission.rejected++;
+			sccp_session_reject(s, "Cross Device Session. Come back later");
+			destroy_session(s, 0);
+		} else {
+			__sccp_session_admission_control(s);
+		}
+	}
+}
+
+/*!
+ * \brief Close the deferred connections, called when the listener stops
+ */
+static void __sccp_session_admission_flush(void)
+{
+	sccp_session_t *s = NULL;
+
+	while ((s = session_admission.deferred_head)) {
+		session_admission.deferred_head = s->admission_next;
+		s->admission_next = NULL;
+		destroy_session(s, 0);
+	}
+	session_admission.deferred_tail = NULL;
+	session_admission.deferred_len = 0;
+}
+
 /*!
  * \brief Socket Accept Connection
  *
@@ -770,105 +1716,377 @@ static void sccp_accept_connection(void)
 		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
 		return;
 	}
+	s->keepalive_slot = -1;
+
+	if ((new_socket = accept(GLOB(descriptor), (struct sockaddr *) &incoming, &length)) < 0) {
+		pbx_log(LOG_ERROR, "Error accepting new socket %s\n", strerror(errno));
+		sccp_free(s);
+		return;
+	}
+	sccp_netsock_setoptions(new_socket);
+	
+	memcpy(&s->sin, &incoming, sizeof(s->sin));
+	sccp_mutex_init(&s->lock);
+	sccp_mutex_init(&s->write_lock);
+
+	/* outbound messages are queued and written without blocking the sending thread */
+	if (fcntl(new_socket, F_SETFL, fcntl(new_socket, F_GETFL, 0) | O_NONBLOCK) < 0) {
+		pbx_log(LOG_WARNING, "SCCP: Failed to set socket %d non-blocking. errno: %d (%s)\n", new_socket, errno, strerror(errno));
+	}
+	s->sendqueue_size = (GLOB(session_sendqueue_depth) > SESSION_SENDQUEUE_MIN) ? GLOB(session_sendqueue_depth) : SESSION_SENDQUEUE_MIN;
+	if (!(s->sendqueue = sccp_calloc(sizeof *s->sendqueue, s->sendqueue_size))) {
+		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+		close(new_socket);
+		sccp_mutex_destroy(&s->write_lock);
+		sccp_mutex_destroy(&s->lock);
+		sccp_free(s);
+		return;
+	}
+	s->wakeup[0] = s->wakeup[1] = -1;
+
+	s->fds[0].events = POLLIN | POLLPRI;
+	s->fds[0].revents = 0;
+	s->fds[0].fd = new_socket;
+	s->fds[1].events = POLLIN;
+	s->fds[1].revents = 0;
+	s->fds[1].fd = -1;
+
+	if (!GLOB(ha)) {
+		pbx_log(LOG_NOTICE, "No global ha list\n");
+	}
+
+	sccp_copy_string(addrStr, sccp_netsock_stringify(&s->sin), sizeof(addrStr));
+
+	/* check ip address against global permit/deny ACL */
+	if (GLOB(ha) && sccp_apply_ha(GLOB(ha), &s->sin) != AST_SENSE_ALLOW) {
+		struct ast_str *buf = pbx_str_alloca(DEFAULT_PBX_STR_BUFFERSIZE);
+		if (buf) {
+			sccp_print_ha(buf, DEFAULT_PBX_STR_BUFFERSIZE, GLOB(ha));
+			sccp_log(0) ("SCCP: Rejecting Connection: Ip-address '%s' denied. Check general deny/permit settings (%s).\n", addrStr, pbx_str_buffer(buf));
+			pbx_log(LOG_WARNING, "SCCP: Rejecting Connection: Ip-address '%s' denied. Check general deny/permit settings (%s).\n", addrStr, pbx_str_buffer(buf));
+		} else {
+			pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+		}
+		sccp_session_reject(s, "Device ip not authorized");
+		destroy_session(s, 0);
+		return;
+	}
+
+	if (sccp_session_findByIP(&s->sin) != NULL) {
+		__sccp_session_admission_defer(s);
+		return;
+	}
+	__sccp_session_admission_control(s);
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+/*!
+ * \brief Hand a freshly accepted session to the least loaded eventloop
+ * \param s SCCP Session
+ * \return boolean
+ *
+ * \lock
+ *      - eventloop->sessions
+ */
+static boolean_t __sccp_session_eventloop_add(sccp_session_t * s)
+{
+	sccp_session_eventloop_t *loop = &eventloops[0];
+	struct epoll_event ev = {0};
+	int i;
+
+	for (i = 1; i < num_eventloops; i++) {
+		if (SCCP_LIST_GETSIZE(&eventloops[i].sessions) < SCCP_LIST_GETSIZE(&loop->sessions)) {
+			loop = &eventloops[i];
+		}
+	}
+	if (!s->recvbuffer && !(s->recvbuffer = sccp_calloc(sizeof *s->recvbuffer, 1))) {
+		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+		return FALSE;
+	}
+	s->recvbuffer->start = 0;
+	s->recvbuffer->len = 0;
+	s->eventloop = loop;
+
+	SCCP_LIST_LOCK(&loop->sessions);
+	SCCP_LIST_INSERT_TAIL(&loop->sessions, s, eventloop_list);
+	SCCP_LIST_UNLOCK(&loop->sessions);
+
+	ev.events = EPOLLIN | EPOLLPRI | EPOLLRDHUP;
+	ev.data.ptr = s;
+	if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, s->fds[0].fd, &ev) < 0) {
+		pbx_log(LOG_ERROR, "SCCP: eventloop %d failed to add session %d. errno: %d (%s)\n", loop->id, s->fds[0].fd, errno, strerror(errno));
+		SCCP_LIST_LOCK(&loop->sessions);
+		SCCP_LIST_REMOVE(&loop->sessions, s, eventloop_list);
+		SCCP_LIST_UNLOCK(&loop->sessions);
+		s->eventloop = NULL;
+		return FALSE;
+	}
+	sccp_log((DEBUGCAT_SOCKET)) (VERBOSE_PREFIX_3 "SCCP: Session %d served by eventloop %d\n", s->fds[0].fd, loop->id);
+	return TRUE;
+}
+
+/*!
+ * \brief Detach a session from its eventloop and destroy it (eventloop equivalent of sccp_netsock_device_thread_exit)
+ * \note only to be called from the thread running the owning eventloop
+ *
+ * \lock
+ *      - eventloop->sessions
+ */
+static void __sccp_session_eventloop_remove(sccp_session_eventloop_t * loop, sccp_session_t * s)
+{
+	if (s->fds[0].fd > 0) {
+		epoll_ctl(loop->epfd, EPOLL_CTL_DEL, s->fds[0].fd, NULL);
+	}
+	SCCP_LIST_LOCK(&loop->sessions);
+	SCCP_LIST_REMOVE(&loop->sessions, s, eventloop_list);
+	SCCP_LIST_UNLOCK(&loop->sessions);
+	s->eventloop = NULL;
+
+	sccp_log((DEBUGCAT_SOCKET)) (VERBOSE_PREFIX_3 "%s: Removing session from eventloop %d\n", DEV_ID_LOG(s->device), loop->id);
+	sccp_netsock_device_thread_exit(s);
+}
+
+/*!
+ * \brief Handle an epoll event for one session (eventloop equivalent of the poll handling in sccp_netsock_device_thread)
+ */
+static void __sccp_session_eventloop_read(sccp_session_eventloop_t * loop, sccp_session_t * s, sccp_msg_t * msg, uint32_t revents)
+{
+	int result = 0;
+
+	if (s->keepalive_expired) {										/* woken up by the keepalive wheel */
+		__sccp_session_stopthread(s, SKINNY_DEVICE_RS_TIMEOUT);
+	}
+	if (s->session_stop || s->fds[0].fd <= 0) {
+		__sccp_session_eventloop_remove(loop, s);
+		return;
+	}
+	if (revents & (EPOLLIN | EPOLLPRI)) {
+		result = session_recv(s, s->recvbuffer);
+		if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+			result = 0;
+		} else if (!(result > 0 && process_buffer(s, msg, s->recvbuffer, sccp_handle_message, TRUE) == 0)) {
+			if (s->device) {
+				sccp_device_sendReset(s->device, SKINNY_DEVICE_RESTART);
+			}
+			__sccp_session_stopthread(s, SKINNY_DEVICE_RS_FAILED);
+			__sccp_session_eventloop_remove(loop, s);
+			return;
+		} else {
+			s->lastKeepAlive = time(0);
+			__sccp_session_check_pendingUpdate(s);
+			__sccp_session_admission_check(s);
+		}
+	} else if (revents & (EPOLLHUP | EPOLLERR | EPOLLRDHUP)) {					/* EPOLLHUP / EPOLLERR */
+		pbx_log(LOG_NOTICE, "%s: Closing session because we received EPOLLHUP/EPOLLERR\n", DEV_ID_LOG(s->device));
+		__sccp_session_stopthread(s, SKINNY_DEVICE_RS_FAILED);
+		__sccp_session_eventloop_remove(loop, s);
+		return;
+	}
+	if (__sccp_session_sendqueue_drain(s) < 0) {							/* EPOLLOUT / messages queued while handling the event */
+		__sccp_session_stopthread(s, SKINNY_DEVICE_RS_FAILED);
+		__sccp_session_eventloop_remove(loop, s);
+	}
+}
+
+/*!
+ * \brief Eventloop housekeeping: keepalive wheel tick, deferred connections (eventloop 0) and pending device updates for all sessions served by this eventloop
+ * \note timed out sessions are only shut down by the keepalive wheel, the resulting epoll event finishes the teardown
+ *
+ * \lock
+ *      - eventloop->sessions
+ */
+static void __sccp_session_eventloop_tick(sccp_session_eventloop_t * loop)
+{
+	sccp_session_t *s = NULL;
+
+	__sccp_session_keepalive_tick();
+	if (loop->id == 0) {											/* eventloop 0 owns the listener */
+		__sccp_session_admission_tick();
+	}
+
+	SCCP_LIST_LOCK(&loop->sessions);
+	SCCP_LIST_TRAVERSE(&loop->sessions, s, eventloop_list) {
+		if (s->session_stop) {
+			continue;
+		}
+		__sccp_session_check_pendingUpdate(s);
+		if (__sccp_session_sendqueue_drain(s) < 0) {
+			__sccp_session_stopthread(s, SKINNY_DEVICE_RS_FAILED);
+		}
+	}
+	SCCP_LIST_UNLOCK(&loop->sessions);
+}
+
+/*!
+ * \brief Handle a listener event on eventloop 0
+ * \return FALSE when the module is stopping
+ */
+static boolean_t __sccp_session_eventloop_listener(void)
+{
+	pbx_rwlock_rdlock(&GLOB(lock));
+	boolean_t reload_in_progress = GLOB(reload_in_progress);
+	boolean_t module_running = GLOB(module_running);
+	pbx_rwlock_unlock(&GLOB(lock));
+
+	if (!module_running) {
+		sccp_log((DEBUGCAT_SOCKET)) (VERBOSE_PREFIX_3 "SCCP: Module not running. exiting thread.\n");
+		return FALSE;
+	}
+	if (!reload_in_progress) {
+		sccp_log((DEBUGCAT_SOCKET)) (VERBOSE_PREFIX_3 "SCCP: Accept Connection\n");
+		sccp_accept_connection();
+	}
+	return TRUE;
+}
+
+/*!
+ * \brief Session Eventloop Thread
+ * \param data SCCP Session Eventloop
+ *
+ * Serves all sessions assigned to this eventloop. Eventloop 0 also owns the listening socket and is run from the socket thread.
+ */
+static void *sccp_session_eventloop_thread(void *data)
+{
+	sccp_session_eventloop_t *loop = (sccp_session_eventloop_t *) data;
+	struct epoll_event events[EVENTLOOP_MAX_EVENTS];
+	sccp_msg_t msg = { {0,} };
+	sccp_session_t *s = NULL;
+	time_t lastTick = time(0);
+	int res, i;
+
+	loop->thread = pthread_self();										/* identifies the owner of the sessions served by this loop */
+	sccp_log((DEBUGCAT_SOCKET)) (VERBOSE_PREFIX_3 "SCCP: Starting session eventloop %d\n", loop->id);
+	while (!loop->stop) {
+		res = epoll_wait(loop->epfd, events, EVENTLOOP_MAX_EVENTS, EVENTLOOP_TICK);
+		if (res < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			pbx_log(LOG_ERROR, "SCCP: eventloop %d epoll_wait() returned %d. errno: %d (%s)\n", loop->id, res, errno, strerror(errno));
+			break;
+		}
+		for (i = 0; i < res; i++) {
+			if (events[i].data.ptr) {
+				__sccp_session_eventloop_read(loop, (sccp_session_t *) events[i].data.ptr, &msg, events[i].events);
+			} else if (!__sccp_session_eventloop_listener()) {
+				loop->stop = TRUE;
+			}
+		}
+		if (time(0) != lastTick) {
+			lastTick = time(0);
+			__sccp_session_eventloop_tick(loop);
+		}
+	}
 
-	if ((new_socket = accept(GLOB(descriptor), (struct sockaddr *) &incoming, &length)) < 0) {
-		pbx_log(LOG_ERROR, "Error accepting new socket %s\n", strerror(errno));
-		sccp_free(s);
-		return;
+	/* tear down the sessions still served by this eventloop */
+	while ((s = SCCP_LIST_FIRST(&loop->sessions))) {
+		__sccp_session_stopthread(s, SKINNY_DEVICE_RS_NONE);
+		__sccp_session_eventloop_remove(loop, s);
 	}
-	sccp_netsock_setoptions(new_socket);
-	
-	memcpy(&s->sin, &incoming, sizeof(s->sin));
-	sccp_mutex_init(&s->lock);
-
-	s->fds[0].events = POLLIN | POLLPRI;
-	s->fds[0].revents = 0;
-	s->fds[0].fd = new_socket;
+	sccp_log((DEBUGCAT_SOCKET)) (VERBOSE_PREFIX_3 "SCCP: Exit from session eventloop %d\n", loop->id);
+	return NULL;
+}
 
-	if (!GLOB(ha)) {
-		pbx_log(LOG_NOTICE, "No global ha list\n");
+/*!
+ * \brief Release the resources of an eventloop which is not running (anymore)
+ */
+static void __sccp_session_eventloop_destroy(sccp_session_eventloop_t * loop)
+{
+	if (loop->epfd > -1) {
+		close(loop->epfd);
+		loop->epfd = -1;
 	}
+	SCCP_LIST_HEAD_DESTROY(&loop->sessions);
+}
 
-	sccp_copy_string(addrStr, sccp_netsock_stringify(&s->sin), sizeof(addrStr));
+/*!
+ * \brief Start the session eventloops and run eventloop 0 on the calling (socket) thread, until the module stops
+ * \return FALSE when the eventloops could not be started (the caller falls back to a thread per session)
+ */
+static boolean_t sccp_session_eventloop_run(void)
+{
+	struct epoll_event ev = {0};
+	int nloops = GLOB(session_eventloop_threads);
+	int i, j;
 
-	int retries=0;
-	while (sccp_session_findByIP(&incoming) != NULL && retries++ <= ACCEPT_RETRIES) {
-		sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "SCCP: Session with this IP-address is already known %s. wait !\n", addrStr);
-		if (retries == ACCEPT_RETRIES) {
-			sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "SCCP: Session with this IP-address is already known %s. exceeding wait time, denied connection !\n", addrStr);
-			sccp_session_reject(s, "Cross Device Session. Come back later");
-			destroy_session(s, 0);
-			return;
+	if (nloops <= 0) {
+		nloops = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if (nloops < 1) {
+		nloops = 1;
+	}
+	if (nloops > EVENTLOOP_MAX_THREADS) {
+		nloops = EVENTLOOP_MAX_THREADS;
+	}
+	if (!(eventloops = sccp_calloc(sizeof *eventloops, nloops))) {
+		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+		return FALSE;
+	}
+	for (i = 0; i < nloops; i++) {
+		eventloops[i].id = i;
+		eventloops[i].thread = AST_PTHREADT_NULL;
+		SCCP_LIST_HEAD_INIT(&eventloops[i].sessions);
+		if ((eventloops[i].epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+			pbx_log(LOG_ERROR, "SCCP: epoll_create1() failed. errno: %d (%s)\n", errno, strerror(errno));
+			SCCP_LIST_HEAD_DESTROY(&eventloops[i].sessions);
+			nloops = i;
+			break;
 		}
-		sleep(ACCEPT_UWAIT_ON_KNOWN_IP);
 	}
 
-	/* check ip address against global permit/deny ACL */
-	if (GLOB(ha) && sccp_apply_ha(GLOB(ha), &s->sin) != AST_SENSE_ALLOW) {
-		struct ast_str *buf = pbx_str_alloca(DEFAULT_PBX_STR_BUFFERSIZE);
-		if (buf) {
-			sccp_print_ha(buf, DEFAULT_PBX_STR_BUFFERSIZE, GLOB(ha));
-			sccp_log(0) ("SCCP: Rejecting Connection: Ip-address '%s' denied. Check general deny/permit settings (%s).\n", addrStr, pbx_str_buffer(buf));
-			pbx_log(LOG_WARNING, "SCCP: Rejecting Connection: Ip-address '%s' denied. Check general deny/permit settings (%s).\n", addrStr, pbx_str_buffer(buf));
-		} else {
-			pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+	ev.events = EPOLLIN | EPOLLPRI;
+	ev.data.ptr = NULL;											/* NULL marks the listening socket */
+	if (nloops == 0 || epoll_ctl(eventloops[0].epfd, EPOLL_CTL_ADD, GLOB(descriptor), &ev) < 0) {
+		pbx_log(LOG_WARNING, "SCCP: Could not start session eventloops, falling back to one thread per session\n");
+		for (i = 0; i < nloops; i++) {
+			__sccp_session_eventloop_destroy(&eventloops[i]);
+		}
+		sccp_free(eventloops);
+		eventloops = NULL;
+		return FALSE;
+	}
+	for (i = 1; i < nloops; i++) {
+		if (pbx_pthread_create(&eventloops[i].thread, NULL, sccp_session_eventloop_thread, &eventloops[i])) {
+			pbx_log(LOG_WARNING, "SCCP: Could not start session eventloop %d, continuing with %d eventloop(s)\n", i, i);
+			for (j = i; j < nloops; j++) {
+				__sccp_session_eventloop_destroy(&eventloops[j]);
+			}
+			nloops = i;
+			break;
 		}
-		sccp_session_reject(s, "Device ip not authorized");
-		destroy_session(s, 0);
-		return;
 	}
-	sccp_session_addToGlobals(s);
-
-	/** set default handler for registration to sccp */
-	s->protocolType = SCCP_PROTOCOL;
+	num_eventloops = nloops;
+	pbx_log(LOG_NOTICE, "SCCP: Serving sessions from %d eventloop(s)\n", num_eventloops);
 
-	s->lastKeepAlive = time(0);
-	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "SCCP: Accepted Client Connection from %s\n", addrStr);
+	sccp_session_eventloop_thread(&eventloops[0]);
 
-	if (sccp_netsock_is_any_addr(&GLOB(bindaddr))) {
-		__sccp_session_setOurAddressFromTheirs(&incoming, &s->ourip);
-	} else {
-		memcpy(&s->ourip, &GLOB(bindaddr), sizeof(s->ourip));
+	/* eventloop 0 stopped because the module is unloading, stop and join the others */
+	for (i = 1; i < num_eventloops; i++) {
+		eventloops[i].stop = TRUE;
 	}
-	sccp_copy_string(s->designator, sccp_netsock_stringify(&s->ourip), sizeof(s->designator));
-
-	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "SCCP: Connected on server via %s\n", s->designator);
-
-	size_t stacksize = 0;
-	pthread_attr_t attr;
-
-	pthread_attr_init(&attr);
-	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
-
-	pbx_pthread_create(&s->session_thread, &attr, sccp_netsock_device_thread, s);
-	if (!pthread_attr_getstacksize(&attr, &stacksize)) {
-		sccp_log((DEBUGCAT_HIGH)) (VERBOSE_PREFIX_3 "SCCP: Using %d memory for this thread\n", (int) stacksize);
+	for (i = 1; i < num_eventloops; i++) {
+		pthread_join(eventloops[i].thread, NULL);
+	}
+	for (i = 0; i < num_eventloops; i++) {
+		__sccp_session_eventloop_destroy(&eventloops[i]);
 	}
+	num_eventloops = 0;
+	sccp_free(eventloops);
+	eventloops = NULL;
+	return TRUE;
 }
+#endif
 
-static void sccp_netsock_cleanup_timed_out(void)
+/*!
+ * \brief Number of running session eventloops (0 when sessions are served by a thread per session)
+ */
+int sccp_session_eventloop_count(void)
 {
-	sccp_session_t *session;
-
-	pbx_rwlock_rdlock(&GLOB(lock));
-	boolean_t reload_in_progress = GLOB(reload_in_progress);
-	boolean_t module_running = GLOB(module_running);
-	pbx_rwlock_unlock(&GLOB(lock));
-	if (module_running && !reload_in_progress) {
-		SCCP_LIST_TRAVERSE_SAFE_BEGIN(&GLOB(sessions), session, list) {
-			if (session->lastKeepAlive == 0) {
-				// final resort
-				SCCP_LIST_REMOVE_CURRENT(list);
-				destroy_session(session, 0);
-				session = NULL;
-			} else if ((time(0) - session->lastKeepAlive) > (5 * GLOB(keepalive)) && (session->session_thread != AST_PTHREADT_NULL)) {
-				__sccp_session_stopthread(session, SKINNY_DEVICE_RS_FAILED);
-				session->session_thread = AST_PTHREADT_NULL;
-				session->lastKeepAlive = 0;
-			}
-		}
-		SCCP_LIST_TRAVERSE_SAFE_END;
-	}
+#ifdef HAVE_SYS_EPOLL_H
+	return num_eventloops;
+#else
+	return 0;
+#endif
 }
 
 
@@ -895,28 +2113,31 @@ void *sccp_netsock_thread(void * ignore)
 	fds[0].revents = 0;
 
 	int res = 0;
-	int keepaliveInterval;
 	boolean_t reload_in_progress = FALSE;
 	boolean_t module_running = TRUE;
 
 	pthread_attr_t attr;
 	pthread_attr_init(&attr);
 	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+#ifdef HAVE_SYS_EPOLL_H
+	if (GLOB(session_eventloop) && sccp_session_eventloop_run()) {
+		goto EXIT;
+	}
+#endif
 	while (GLOB(descriptor) > -1) {
 		pbx_rwlock_rdlock(&GLOB(lock));
 		fds[0].fd = GLOB(descriptor);
-		keepaliveInterval = GLOB(keepalive) * 5000;					/* 60 * 5 * 1000 = 300000 =(5 minutes) */
 		pbx_rwlock_unlock(&GLOB(lock));
 
-		res = sccp_netsock_poll(fds, 1, keepaliveInterval);
+		res = sccp_netsock_poll(fds, 1, SESSION_KEEPALIVE_TICK);
+		__sccp_session_keepalive_tick();
+		__sccp_session_admission_tick();
 		if (res < 0) {
 			if (!(errno == EINTR || errno == EAGAIN)) {
 				pbx_log(LOG_ERROR, "SCCP poll() returned %d. errno: %d (%s)\n", res, errno, strerror(errno));
 				break;
 			}
-		} else if (res == 0) {
-			sccp_netsock_cleanup_timed_out();
-		} else {
+		} else if (res > 0) {
 			pbx_rwlock_rdlock(&GLOB(lock));
 			reload_in_progress = GLOB(reload_in_progress);
 			module_running = GLOB(module_running);
@@ -931,6 +2152,10 @@ void *sccp_netsock_thread(void * ignore)
 			}
 		}
 	}
+#ifdef HAVE_SYS_EPOLL_H
+EXIT:
+#endif
+	__sccp_session_admission_flush();
 	pbx_rwlock_wrlock(&GLOB(lock));
 	GLOB(socket_thread) = AST_PTHREADT_NULL;
 	close(GLOB(descriptor));
@@ -974,6 +2199,7 @@ int sccp_session_send(constDevicePtr device, const sccp_msg_t * msg_in)
 	if (s && !s->session_stop) {
 		return sccp_session_send2(s, msg);
 	} 
+	sccp_free_packet(msg);
 	return -1;
 }
 
@@ -983,32 +2209,37 @@ int sccp_session_send(constDevicePtr device, const sccp_msg_t * msg_in)
  * \param msg Message Data Structure (sccp_msg_t) (Will be freed automatically at the end)
  * \return Result as Int
  *
+ * The message is appended to the session send queue. Other threads write the queue out right away (without blocking,
+ * whatever does not fit in the socket buffer is left for the session owner). When called by the session owner
+ * (session thread / eventloop), the write is deferred until it has finished handling the current event, so that all
+ * messages produced by one event go out in a single writev().
+ *
  * \lock
- *      - session
+ *      - session->write_lock
  */
 int sccp_session_send2(constSessionPtr session, sccp_msg_t * msg)
 {
 	sccp_session_t * const s = (sessionPtr) session;								/* discard const */
-	ssize_t res = 0;
+	int res = 0;
 	uint32_t msgid = letohl(msg->header.lel_messageId);
-	ssize_t bytesSent;
-	ssize_t bufLen;
-	uint8_t *bufAddr;
+	int bufLen = 0;
+	int waited = 0;
+	boolean_t owner = FALSE;
 
 	if (s && s->session_stop) {
+		sccp_free_packet(msg);
 		return -1;
 	}
 
-	if (!s || s->fds[0].fd <= 0) {
+	if (!s || s->fds[0].fd <= 0 || !s->sendqueue) {
 		sccp_log((DEBUGCAT_HIGH)) (VERBOSE_PREFIX_3 "SCCP: Tried to send packet over DOWN device.\n");
 		if (s) {
 			__sccp_session_stopthread(s, SKINNY_DEVICE_RS_FAILED);
 		}
-		sccp_free(msg);
+		sccp_free_packet(msg);
 		msg = NULL;
 		return -1;
 	}
-	int mysocket = s->fds[0].fd;
 
 	if (msgid == KeepAliveAckMessage || msgid == RegisterAckMessage || msgid == UnregisterAckMessage) {
 		msg->header.lel_protocolVer = 0;
@@ -1024,40 +2255,108 @@ int sccp_session_send2(constSessionPtr session, sccp_msg_t * msg)
 		pbx_log(LOG_NOTICE, "%s: Send Message: %s(0x%04X) %d bytes length\n", DEV_ID_LOG(s->device), msgtype2str(mid), mid, msg->header.length);
 		sccp_dump_msg(msg);
 	}
-
-	uint backoff = WRITE_BACKOFF;
-	bytesSent = 0;
-	bufAddr = ((uint8_t *) msg);
-	bufLen = (ssize_t) (letohl(msg->header.length) + 8);
-	do {
-		pbx_mutex_lock(&s->write_lock);									/* prevent two threads writing at the same time. That should happen in a synchronized way */
-		res = send(mysocket, bufAddr + bytesSent, bufLen - bytesSent, 0);
-		pbx_mutex_unlock(&s->write_lock);
-		if (res <= 0) {
-			if (errno == EINTR) {
-				usleep(backoff);								/* back off to give network/other threads some time */
-				backoff *= 2;
-				continue;
-			}
-			socket_get_error(s, __FILE__, __LINE__, __PRETTY_FUNCTION__, errno);
-			if (s) {
+	bufLen = (int) (letohl(msg->header.length) + 8);
+	owner = __sccp_session_isOwner(s);
+
+	pbx_mutex_lock(&s->write_lock);									/* prevent two threads writing at the same time. That should happen in a synchronized way */
+	if (s->sendqueue_len >= s->sendqueue_size) {
+		res = __sccp_session_sendqueue_flush(s);
+		/* nobody else is going to drain the queue while the owner is stuck in here, give the phone a little time to catch up */
+		while (owner && res >= (int) s->sendqueue_size && waited < SESSION_SENDQUEUE_OWNER_WAIT) {
+			struct pollfd pfd = { .fd = s->fds[0].fd, .events = POLLOUT, .revents = 0 };
+			pbx_mutex_unlock(&s->write_lock);
+			sccp_netsock_poll(&pfd, 1, SESSION_SENDQUEUE_OWNER_STEP);
+			waited += SESSION_SENDQUEUE_OWNER_STEP;
+			pbx_mutex_lock(&s->write_lock);
+			res = __sccp_session_sendqueue_flush(s);
+		}
+		if (res >= (int) s->sendqueue_size) {
+			s->sendqueue_drops++;
+			pbx_mutex_unlock(&s->write_lock);
+			sccp_free_packet(msg);
+			if (GLOB(session_sendqueue_disconnect)) {
+				pbx_log(LOG_WARNING, "%s: Send queue full (%d messages), disconnecting\n", DEV_ID_LOG(s->device), res);
 				__sccp_session_stopthread(s, SKINNY_DEVICE_RS_FAILED);
+			} else {
+				sccp_log((DEBUGCAT_SOCKET)) (VERBOSE_PREFIX_3 "%s: Send queue full (%d messages), dropping %s\n", DEV_ID_LOG(s->device), res, msgtype2str(msgid));
 			}
-			res = -1;
-			break;
+			return -1;
+		}
+	}
+	if (res >= 0) {
+		s->sendqueue[(s->sendqueue_head + s->sendqueue_len) % s->sendqueue_size] = msg;
+		s->sendqueue_len++;
+		if (s->sendqueue_len > s->sendqueue_highwater) {
+			s->sendqueue_highwater = s->sendqueue_len;
+		}
+		msg = NULL;
+		if ((!owner && !s->corked) || s->sendqueue_len >= SESSION_SENDQUEUE_BATCH) {
+			res = __sccp_session_sendqueue_flush(s);
+		}
+	}
+	pbx_mutex_unlock(&s->write_lock);
+
+	if (res < 0) {
+		if (msg) {
+			sccp_free_packet(msg);
 		}
-		bytesSent += res;
-	} while (bytesSent < bufLen && s && !s->session_stop && mysocket > 0);
+		__sccp_session_stopthread(s, SKINNY_DEVICE_RS_FAILED);
+		return -1;
+	}
+	return bufLen;
+}
 
-	sccp_free(msg);
-	msg = NULL;
+/*!
+ * \brief Send a batch of messages to a device
+ * \param device SCCP Device
+ * \param msgs Array of Messages (Will be freed automatically at the end, the array itself is not)
+ * \param count Number of Messages
+ * \return Number of messages queued, -1 when the device has no session
+ *
+ * The messages are queued back to back while the send queue is corked, and then written out together, so that a
+ * burst from a thread other than the session owner (e.g. hint notifications) leaves in a single writev().
+ *
+ * \lock
+ *      - session->write_lock
+ */
+int sccp_session_sendBatch(constDevicePtr device, sccp_msg_t ** msgs, uint count)
+{
+	sccp_session_t * const s = sccp_session_findByDevice(device);
+	int queued = 0;
+	int res = 0;
+	uint i;
+
+	if (!s || s->session_stop || !s->sendqueue) {
+		for (i = 0; i < count; i++) {
+			sccp_free_packet(msgs[i]);
+			msgs[i] = NULL;
+		}
+		return -1;
+	}
+
+	pbx_mutex_lock(&s->write_lock);
+	s->corked++;
+	pbx_mutex_unlock(&s->write_lock);
+
+	for (i = 0; i < count; i++) {
+		if (sccp_session_send2(s, msgs[i]) >= 0) {
+			queued++;
+		}
+		msgs[i] = NULL;
+	}
 
-	if (bytesSent < bufLen) {
-		pbx_log(LOG_ERROR, "%s: Could only send %d of %d bytes!\n", DEV_ID_LOG(s->device), (int) bytesSent, (int) bufLen);
-		res = -1;
+	pbx_mutex_lock(&s->write_lock);
+	s->corked--;
+	if (!s->corked && s->sendqueue_len > 0 && !__sccp_session_isOwner(s)) {
+		res = __sccp_session_sendqueue_flush(s);
 	}
+	pbx_mutex_unlock(&s->write_lock);
 
-	return res;
+	if (res < 0) {
+		__sccp_session_stopthread(s, SKINNY_DEVICE_RS_FAILED);
+		return -1;
+	}
+	return queued;
 }
 
 /*!
@@ -1099,11 +2398,8 @@ sccp_session_t *sccp_session_findByIP(const struct sockaddr_storage *sin)
 {
 	sccp_session_t *session = NULL;
 	SCCP_RWLIST_RDLOCK(&GLOB(sessions));
-	SCCP_RWLIST_TRAVERSE(&GLOB(sessions), session, list) {
-		if (sccp_netsock_cmp_addr(&session->sin, sin) == 0) {
-			sccp_log((DEBUGCAT_SOCKET)) (VERBOSE_PREFIX_3 "%s: (sccp_session_findByIP) Found session:%p\n", DEV_ID_LOG(session->device), session);
-			break;
-		}
+	if ((session = sccp_hashtable_find(GLOB(session_index), sin))) {
+		sccp_log((DEBUGCAT_SOCKET)) (VERBOSE_PREFIX_3 "%s: (sccp_session_findByIP) Found session:%p\n", DEV_ID_LOG(session->device), session);
 	}
 	SCCP_RWLIST_UNLOCK(&GLOB(sessions));
 	return session;
@@ -1276,6 +2572,7 @@ gcc_inline uint16_t sccp_session_getProtocol(constSessionPtr session)
  * \brief Reset Last KeepAlive
  * \param session SCCP Session
  * \param device SCCP Device
+ * \note only a store, the keepalive wheel picks up the new deadline when the old one comes up
  */
 gcc_inline void sccp_session_resetLastKeepAlive(constSessionPtr session)
 {
@@ -1341,6 +2638,54 @@ boolean_t sccp_session_isValid(constSessionPtr session)
 	return FALSE;
 }
 
+/* ----------------------------------------------------------------------------------------------------------SHOW LOAD- */
+/*!
+ * \brief Show Load
+ * \param fd Fd as int
+ * \param totals Total number of lines as int
+ * \param s AMI Session
+ * \param m Message
+ * \param argc Argc as int
+ * \param argv[] Argv[] as char
+ * \return Result as int
+ *
+ * \called_from_asterisk
+ *
+ */
+int sccp_cli_show_load(int fd, sccp_cli_totals_t *totals, struct mansession *s, const struct message *m, int argc, char *argv[])
+{
+	sccp_session_load_t load;
+	int local_line_total = 0;
+	const char *actionid = "";
+
+	sccp_session_getLoad(&load);
+
+	if (!s) {
+		CLI_AMI_OUTPUT(fd, s, "\n--- SCCP load ------------------------------------------------------------------------------------------------------------\n");
+	} else {
+		astman_append(s, "Response: Success\r\n");
+		astman_append(s, "Message: SCCPLoad\r\n");
+		actionid = astman_get_header(m, "ActionID");
+		if (!pbx_strlen_zero(actionid)) {
+			astman_append(s, "ActionID: %s\r\n", actionid);
+		}
+		local_line_total++;
+	}
+	CLI_AMI_OUTPUT_PARAM("Load Score", CLI_AMI_LIST_WIDTH, "%d", load.score);
+	CLI_AMI_OUTPUT_PARAM("Token Fallback", CLI_AMI_LIST_WIDTH, "%s", GLOB(token_fallback) ? GLOB(token_fallback) : "");
+	CLI_AMI_OUTPUT_PARAM("Load Threshold", CLI_AMI_LIST_WIDTH, "%d", GLOB(token_load_threshold));
+	CLI_AMI_OUTPUT_PARAM("Backoff At This Load", CLI_AMI_LIST_WIDTH, "%d", load.score >= GLOB(token_load_threshold) ? (int) sccp_session_loadBackoff(load.score, GLOB(token_load_threshold), GLOB(token_backoff_time)) : 0);
+	CLI_AMI_OUTPUT_PARAM("Threadpool Jobs", CLI_AMI_LIST_WIDTH, "%d queued, %d threads (score %d)", load.queued_jobs, load.threads, load.jobs_score);
+	CLI_AMI_OUTPUT_PARAM("Sessions", CLI_AMI_LIST_WIDTH, "%u of %d (score %d)", load.sessions, GLOB(token_load_max_sessions), load.sessions_score);
+	CLI_AMI_OUTPUT_PARAM("Registrations In Progress", CLI_AMI_LIST_WIDTH, "%u of %d (score %d)", load.inprogress, GLOB(session_admission_max_pending), load.registrations_score);
+	CLI_AMI_OUTPUT_PARAM("Send Queue Backlog", CLI_AMI_LIST_WIDTH, "%u messages (score %d)", load.queued_messages, load.sendqueue_score);
+
+	if (s) {
+		totals->lines = local_line_total;
+	}
+	return RESULT_SUCCESS;
+}
+
 /* -------------------------------------------------------------------------------------------------------SHOW SESSIONS- */
 /*!
  * \brief Show Sessions
@@ -1384,11 +2729,16 @@ int sccp_cli_show_sessions(int fd, sccp_cli_totals_t *totals, struct mansession
 		CLI_AMI_TABLE_FIELD(Port,		"-5",		d,	5,	sccp_netsock_getPort(&session->sin) )    		\
 		CLI_AMI_TABLE_FIELD(KA,			"-4",		d,	4,	(uint32_t) (time(0) - session->lastKeepAlive))		\
 		CLI_AMI_TABLE_FIELD(KAI,		"-4",		d,	4,	(d) ? d->keepaliveinterval : GLOB(keepalive))		\
+		CLI_AMI_TABLE_FIELD(KAFast,		"-6",		d,	6,	session->keepalive_fastpath)				\
 		CLI_AMI_TABLE_FIELD(DeviceName,		"15",		s,	15,	(d) ? d->id : "--")					\
 		CLI_AMI_TABLE_FIELD(State,		"-14.14",	s,	14,	(d) ? sccp_devicestate2str(sccp_device_getDeviceState(d)) : "--")		\
 		CLI_AMI_TABLE_FIELD(Type,		"-15.15",	s,	15,	(d) ? skinny_devicetype2str(d->skinny_type) : "--")	\
 		CLI_AMI_TABLE_FIELD(RegState,		"-10.10",	s,	10,	(d) ? skinny_registrationstate2str(sccp_device_getRegistrationState(d)) : "--")	\
-		CLI_AMI_TABLE_FIELD(Token,		"-10.10",	s,	10,	d ? sccp_tokenstate2str(d->status.token) : "--")
+		CLI_AMI_TABLE_FIELD(Token,		"-10.10",	s,	10,	d ? sccp_tokenstate2str(d->status.token) : "--")	\
+		CLI_AMI_TABLE_FIELD(SendQ,		"-5",		d,	5,	session->sendqueue_len)					\
+		CLI_AMI_TABLE_FIELD(SQMax,		"-5",		d,	5,	session->sendqueue_highwater)				\
+		CLI_AMI_TABLE_FIELD(Drops,		"-5",		d,	5,	session->sendqueue_drops)				\
+		CLI_AMI_TABLE_FIELD(Coalesced,		"-10",		lu,	10,	(unsigned long) session->bytes_coalesced)
 #include "sccp_cli_table.h"
 
 	if (s) {
@@ -1398,4 +2748,518 @@ int sccp_cli_show_sessions(int fd, sccp_cli_totals_t *totals, struct mansession
 	return RESULT_SUCCESS;
 }
 
+#if CS_TEST_FRAMEWORK
+#include <asterisk/test.h>
+#define test_category "/channels/chan_sccp/session/"
+
+static struct {
+	int messages;
+	uint64_t checksum;
+	sccp_msg_t last;
+} recv_test_result;
+
+static int recv_test_dispatch(constMessagePtr msg, constSessionPtr s)
+{
+	recv_test_result.messages++;
+	recv_test_result.checksum = recv_test_result.checksum * 31 + letohl(msg->header.lel_messageId) + msg->header.length;
+	memcpy(&recv_test_result.last, msg, msg->header.length);
+	return 0;
+}
+
+/* append one message, as a phone would put it on the wire, datalen bytes of payload */
+static size_t recv_test_put(unsigned char *stream, sccp_mid_t messageId, uint32_t datalen, uint32_t value)
+{
+	sccp_header_t header = { 0 };
+	uint32_t i;
+
+	header.length = htolel(datalen + 4);
+	header.lel_messageId = htolel(messageId);
+	memcpy(stream, &header, SCCP_PACKET_HEADER);
+	for (i = 0; i + sizeof(uint32_t) <= datalen; i += sizeof(uint32_t)) {
+		uint32_t lel_value = htolel(value + i);
+		memcpy(stream + SCCP_PACKET_HEADER + i, &lel_value, sizeof(uint32_t));
+	}
+	return SCCP_PACKET_HEADER + datalen;
+}
+
+/* recorded keepalive / keypad / stimulus burst */
+static size_t recv_test_stream(unsigned char *stream, int count)
+{
+	size_t len = 0;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		switch (i % 8) {
+			case 0:
+				len += recv_test_put(stream + len, KeepAliveMessage, 0, 0);
+				break;
+			case 1:
+			case 2:
+			case 3:
+			case 4:
+				len += recv_test_put(stream + len, KeypadButtonMessage, sccp_messagetypes[KeypadButtonMessage].size, i);
+				break;
+			case 5:
+				len += recv_test_put(stream + len, StimulusMessage, sccp_messagetypes[StimulusMessage].size, i);
+				break;
+			case 6:
+				len += recv_test_put(stream + len, OffHookMessage, sccp_messagetypes[OffHookMessage].size, i);
+				break;
+			case 7:
+				len += recv_test_put(stream + len, OnHookMessage, sccp_messagetypes[OnHookMessage].size, i);
+				break;
+		}
+	}
+	return len;
+}
+
+/* previous receive path: copy every message into a zeroed msg and shuffle the remainder to the front */
+static int recv_test_legacy_process(sccp_session_t * s, sccp_msg_t * msg, unsigned char *buffer, size_t * len)
+{
+	while (*len >= SCCP_PACKET_HEADER) {
+		uint32_t payload_len = letohl(buffer[0] | (buffer[1] << 8) | (buffer[2] << 16) | (buffer[3] << 24)) + (SCCP_PACKET_HEADER - 4);
+		if (*len < payload_len) {
+			break;
+		}
+		sccp_header_t msg_header = { 0 };
+		memcpy(&msg_header, buffer, SCCP_PACKET_HEADER);
+		int speclen = session_dissect_header(s, &msg_header);
+		if (speclen < 0) {
+			return -1;
+		}
+		memset(msg, 0, SCCP_MAX_PACKET);
+		memcpy(msg, buffer, speclen);
+		msg->header.length = speclen;
+		recv_test_dispatch(msg, s);
+		*len -= payload_len;
+		if (*len > 0) {
+			memmove(buffer + 0, buffer + payload_len, *len);
+		}
+	}
+	return 0;
+}
+
+AST_TEST_DEFINE(sccp_session_recvbuffer_tests)
+{
+	sccp_session_t s = { 0 };
+	sccp_session_recvbuffer_t *rb = NULL;
+	sccp_msg_t *msg = NULL;
+	unsigned char stream[SCCP_MAX_PACKET];
+	unsigned char *tail = NULL;
+	size_t room = 0;
+	size_t len = 0;
+	size_t pos = 0;
+
+	switch (cmd) {
+		case TEST_INIT:
+			info->name = "recvbuffer";
+			info->category = test_category;
+			info->summary = "chan-sccp-b session receive buffer";
+			info->description = "chan-sccp-b in place message parsing, split messages and short (old protocol) messages";
+			return AST_TEST_NOT_RUN;
+		case TEST_EXECUTE:
+			break;
+	}
+	s.protocolType = SCCP_PROTOCOL;
+	pbx_test_validate(test, (rb = sccp_calloc(sizeof *rb, 1)) != NULL);
+	pbx_test_validate(test, (msg = sccp_malloc(SCCP_MAX_PACKET)) != NULL);
+
+	pbx_test_status_update(test, "Messages split over receives\n");
+	memset(&recv_test_result, 0, sizeof(recv_test_result));
+	len = recv_test_stream(stream, 16);
+	for (pos = 0; pos < len; pos += 5) {
+		tail = session_recvbuffer_tail(rb, &room);
+		memcpy(tail, stream + pos, (len - pos < 5) ? len - pos : 5);
+		rb->len += (len - pos < 5) ? len - pos : 5;
+		pbx_test_validate(test, process_buffer(&s, msg, rb, recv_test_dispatch, FALSE) == 0);
+	}
+	pbx_test_validate(test, recv_test_result.messages == 16);
+	pbx_test_validate(test, rb->len == 0 && rb->start == 0);
+
+	pbx_test_status_update(test, "Short message gets the missing fields zeroed\n");
+	memset(msg, 0xff, SCCP_MAX_PACKET);
+	len = recv_test_put(stream, KeypadButtonMessage, sizeof(uint32_t), 7);
+	tail = session_recvbuffer_tail(rb, &room);
+	memcpy(tail, stream, len);
+	rb->len += len;
+	pbx_test_validate(test, process_buffer(&s, msg, rb, recv_test_dispatch, FALSE) == 0);
+	pbx_test_validate(test, letohl(recv_test_result.last.data.KeypadButtonMessage.lel_kpButton) == 7);
+	pbx_test_validate(test, recv_test_result.last.data.KeypadButtonMessage.lel_lineInstance == 0);
+	pbx_test_validate(test, recv_test_result.last.data.KeypadButtonMessage.lel_callReference == 0);
+
+	pbx_test_status_update(test, "Oversized length closes the connection\n");
+	memset(stream, 0xff, SCCP_PACKET_HEADER);
+	tail = session_recvbuffer_tail(rb, &room);
+	memcpy(tail, stream, SCCP_PACKET_HEADER);
+	rb->len += SCCP_PACKET_HEADER;
+	pbx_test_validate(test, process_buffer(&s, msg, rb, recv_test_dispatch, FALSE) == -1);
+
+	sccp_free(msg);
+	sccp_free(rb);
+	return AST_TEST_PASS;
+}
+
+AST_TEST_DEFINE(sccp_session_recvbuffer_benchmark)
+{
+	sccp_session_t s = { 0 };
+	sccp_session_recvbuffer_t *rb = NULL;
+	sccp_msg_t *msg = NULL;
+	unsigned char *stream = NULL;
+	unsigned char *legacy_buffer = NULL;
+	const size_t segments[] = { 1460, 64, 12 };
+	const int num_messages = 50000;
+	const int rounds = 10;
+	struct timeval start;
+	int64_t legacy_ms, inplace_ms;
+	uint64_t legacy_checksum;
+	unsigned char *tail = NULL;
+	size_t room, chunk, len, pos, legacy_len;
+	uint32_t seg_idx;
+	int round;
+
+	switch (cmd) {
+		case TEST_INIT:
+			info->name = "recvbuffer_benchmark";
+			info->category = test_category;
+			info->summary = "chan-sccp-b receive path benchmark";
+			info->description = "chan-sccp-b compare the copying receive path with in place parsing, feeding a recorded keepalive/keypad/stimulus stream in tcp segment sized chunks";
+			return AST_TEST_NOT_RUN;
+		case TEST_EXECUTE:
+			break;
+	}
+	s.protocolType = SCCP_PROTOCOL;
+	pbx_test_validate(test, (stream = sccp_malloc(num_messages * SCCP_MAX_PACKET / 8)) != NULL);
+	len = recv_test_stream(stream, num_messages);
+	pbx_test_validate(test, (rb = sccp_calloc(sizeof *rb, 1)) != NULL);
+	pbx_test_validate(test, (legacy_buffer = sccp_calloc(SESSION_RECVBUFFER_SIZE, 1)) != NULL);
+	pbx_test_validate(test, (msg = sccp_malloc(SCCP_MAX_PACKET)) != NULL);
+
+	for (seg_idx = 0; seg_idx < ARRAY_LEN(segments); seg_idx++) {
+		/* old path */
+		memset(&recv_test_result, 0, sizeof(recv_test_result));
+		start = pbx_tvnow();
+		for (round = 0; round < rounds; round++) {
+			legacy_len = 0;
+			for (pos = 0; pos < len; pos += chunk) {
+				chunk = (len - pos < segments[seg_idx]) ? len - pos : segments[seg_idx];
+				memcpy(legacy_buffer + legacy_len, stream + pos, chunk);
+				legacy_len += chunk;
+				recv_test_legacy_process(&s, msg, legacy_buffer, &legacy_len);
+			}
+		}
+		legacy_ms = ast_tvdiff_ms(pbx_tvnow(), start);
+		pbx_test_validate(test, recv_test_result.messages == num_messages * rounds);
+		legacy_checksum = recv_test_result.checksum;
+
+		/* new path */
+		memset(&recv_test_result, 0, sizeof(recv_test_result));
+		start = pbx_tvnow();
+		for (round = 0; round < rounds; round++) {
+			for (pos = 0; pos < len; pos += chunk) {
+				chunk = (len - pos < segments[seg_idx]) ? len - pos : segments[seg_idx];
+				tail = session_recvbuffer_tail(rb, &room);
+				memcpy(tail, stream + pos, chunk);
+				rb->len += chunk;
+				process_buffer(&s, msg, rb, recv_test_dispatch, FALSE);
+			}
+		}
+		inplace_ms = ast_tvdiff_ms(pbx_tvnow(), start);
+		pbx_test_validate(test, recv_test_result.messages == num_messages * rounds);
+		pbx_test_validate(test, recv_test_result.checksum == legacy_checksum);
+
+		pbx_test_status_update(test, "%6d messages x %d, %4d byte segments: copying %6" PRId64 " ms, in place %6" PRId64 " ms\n", num_messages, rounds, (int) segments[seg_idx], legacy_ms, inplace_ms);
+	}
+
+	sccp_free(msg);
+	sccp_free(legacy_buffer);
+	sccp_free(rb);
+	sccp_free(stream);
+	return AST_TEST_PASS;
+}
+
+AST_TEST_DEFINE(sccp_session_keepalive_wheel)
+{
+	sccp_session_keepalive_wheel_t wheel;
+	sccp_session_t *sessions = NULL;
+	const int num_sessions = 200;
+	time_t base = time(0), t, expected;
+	int maxWaitTime, i, expired = 0, early = 0, late = 0;
+	int rc = AST_TEST_PASS;
+
+	switch (cmd) {
+		case TEST_INIT:
+			info->name = "keepalive_wheel";
+			info->category = test_category;
+			info->summary = "chan-sccp-b session keepalive timing wheel";
+			info->description = "chan-sccp-b sessions expire exactly on their deadline, sessions heard from in between are moved once";
+			return AST_TEST_NOT_RUN;
+		case TEST_EXECUTE:
+			break;
+	}
+	memset(&wheel, 0, sizeof(wheel));
+	if (!(sessions = sccp_calloc(sizeof *sessions, num_sessions))) {
+		return AST_TEST_FAIL;
+	}
+	maxWaitTime = __sccp_session_keepaliveMaxWaitTime(&sessions[0]);
+	pbx_test_status_update(test, "arm %d sessions, max wait time %d seconds\n", num_sessions, maxWaitTime);
+	for (i = 0; i < num_sessions; i++) {
+		sessions[i].fds[0].fd = -1;
+		sessions[i].sin.ss_family = AF_INET;
+		sessions[i].keepalive_slot = -1;
+		sessions[i].lastKeepAlive = base + (i % 40);
+		__keepalive_wheel_link(&wheel, &sessions[i], sessions[i].lastKeepAlive + maxWaitTime);
+	}
+	pbx_test_validate_cleanup(test, wheel.armed == (uint) num_sessions, rc, cleanup);
+
+	/* odd sessions are heard from again, which is only a store */
+	for (i = 1; i < num_sessions; i += 2) {
+		sessions[i].lastKeepAlive = base + 40;
+	}
+
+	for (t = base; t <= base + 41 + maxWaitTime; t++) {
+		__keepalive_wheel_advance(&wheel, t);
+		for (i = 0; i < num_sessions; i++) {
+			expected = ((i % 2) ? base + 40 : base + (i % 40)) + maxWaitTime;
+			if (sessions[i].keepalive_expired && t < expected) {
+				early++;
+			} else if (!sessions[i].keepalive_expired && t >= expected) {
+				late++;
+			}
+		}
+	}
+	for (i = 0; i < num_sessions; i++) {
+		expired += sessions[i].keepalive_expired ? 1 : 0;
+	}
+	pbx_test_status_update(test, "expired:%d, early:%d, late:%d, rescheduled:%u, still armed:%u\n", expired, early, late, wheel.rescheduled_total, wheel.armed);
+	pbx_test_validate_cleanup(test, expired == num_sessions, rc, cleanup);
+	pbx_test_validate_cleanup(test, early == 0 && late == 0, rc, cleanup);
+	pbx_test_validate_cleanup(test, wheel.expired_total == (uint) num_sessions, rc, cleanup);
+	pbx_test_validate_cleanup(test, wheel.rescheduled_total == (uint) num_sessions / 2, rc, cleanup);
+	pbx_test_validate_cleanup(test, wheel.armed == 0, rc, cleanup);
+
+cleanup:
+	sccp_free(sessions);
+	return rc;
+}
+
+AST_TEST_DEFINE(sccp_session_admission_tests)
+{
+	sccp_session_admission_t adm;
+	struct timeval now = { 1000, 0 };
+	uint32_t backoff = 0, prev_backoff = 0;
+	const int rate = 10;
+	int i, granted = 0;
+	int rc = AST_TEST_PASS;
+
+	switch (cmd) {
+		case TEST_INIT:
+			info->name = "admission";
+			info->category = test_category;
+			info->summary = "chan-sccp-b session admission control";
+			info->description = "chan-sccp-b admission token bucket and the backoff handed to phones which are turned away";
+			return AST_TEST_NOT_RUN;
+		case TEST_EXECUTE:
+			break;
+	}
+	memset(&adm, 0, sizeof(adm));
+
+	pbx_test_status_update(test, "token bucket, rate %d per second\n", rate);
+	for (i = 0; i < rate * 2; i++) {
+		granted += __sccp_session_admission_take(&adm, rate, now) ? 1 : 0;
+	}
+	pbx_test_validate_cleanup(test, granted == rate, rc, cleanup);
+	now.tv_usec = 100000;											/* 100ms refills one token */
+	pbx_test_validate_cleanup(test, __sccp_session_admission_take(&adm, rate, now) == TRUE, rc, cleanup);
+	pbx_test_validate_cleanup(test, __sccp_session_admission_take(&adm, rate, now) == FALSE, rc, cleanup);
+	now.tv_sec += 60;											/* never more than one second worth of tokens */
+	for (granted = 0, i = 0; i < rate * 2; i++) {
+		granted += __sccp_session_admission_take(&adm, rate, now) ? 1 : 0;
+	}
+	pbx_test_validate_cleanup(test, granted == rate, rc, cleanup);
+	pbx_test_validate_cleanup(test, __sccp_session_admission_take(&adm, 0, now) == TRUE, rc, cleanup);
+
+	pbx_test_status_update(test, "backoff\n");
+	for (i = 0; i < rate * 20; i++) {
+		backoff = __sccp_session_admission_backoff(&adm, rate);
+		pbx_test_validate_cleanup(test, backoff >= ACCEPT_BACKOFF_MIN && backoff <= ACCEPT_BACKOFF_MAX, rc, cleanup);
+		pbx_test_validate_cleanup(test, backoff + ACCEPT_BACKOFF_MIN > prev_backoff, rc, cleanup);	/* only jitter may go down */
+		prev_backoff = backoff;
+	}
+	pbx_test_status_update(test, "backlog:%u, last backoff:%u\n", adm.backlog, backoff);
+	pbx_test_validate_cleanup(test, adm.backlog == (uint) rate * 20 && backoff >= ACCEPT_BACKOFF_MIN + 19, rc, cleanup);
+
+	__sccp_session_admission_decay(&adm, rate, 2000);
+	__sccp_session_admission_decay(&adm, rate, 2005);
+	pbx_test_validate_cleanup(test, adm.backlog == (uint) rate * 15, rc, cleanup);
+	__sccp_session_admission_decay(&adm, rate, 2100);
+	pbx_test_validate_cleanup(test, adm.backlog == 0, rc, cleanup);
+	backoff = __sccp_session_admission_backoff(&adm, rate);
+	pbx_test_validate_cleanup(test, backoff < ACCEPT_BACKOFF_MIN * 2, rc, cleanup);
+
+cleanup:
+	return rc;
+}
+
+AST_TEST_DEFINE(sccp_session_load_tests)
+{
+	sccp_session_load_t load;
+	uint32_t backoff;
+	int rc = AST_TEST_PASS;
+
+	switch (cmd) {
+		case TEST_INIT:
+			info->name = "load";
+			info->category = test_category;
+			info->summary = "chan-sccp-b session load score";
+			info->description = "chan-sccp-b load score used by fallback=load, and the token reject backoff derived from it";
+			return AST_TEST_NOT_RUN;
+		case TEST_EXECUTE:
+			break;
+	}
+	memset(&load, 0, sizeof(load));
+	load.threads = 4;
+	load.queued_jobs = 8;
+	load.sessions = 500;
+	load.inprogress = 450;
+	load.queued_messages = 0;
+	__sccp_session_load_score(&load, 1000, 500);
+	pbx_test_status_update(test, "score:%d (jobs:%d, sessions:%d, registrations:%d, sendqueue:%d)\n", load.score, load.jobs_score, load.sessions_score, load.registrations_score, load.sendqueue_score);
+	pbx_test_validate_cleanup(test, load.jobs_score == 50 && load.sessions_score == 50 && load.registrations_score == 90 && load.sendqueue_score == 0, rc, cleanup);
+	pbx_test_validate_cleanup(test, load.score == 90, rc, cleanup);
+
+	/* unconfigured limits do not count, components never exceed 100 */
+	load.queued_jobs = 1000;
+	load.queued_messages = 500 * SESSION_SENDQUEUE_BATCH / 4;
+	__sccp_session_load_score(&load, 0, 0);
+	pbx_test_validate_cleanup(test, load.sessions_score == 0 && load.registrations_score == 0, rc, cleanup);
+	pbx_test_validate_cleanup(test, load.jobs_score == 100 && load.sendqueue_score == 25 && load.score == 100, rc, cleanup);
+
+	backoff = sccp_session_loadBackoff(80, 80, 60);
+	pbx_test_validate_cleanup(test, backoff >= 60 && backoff <= 75, rc, cleanup);
+	backoff = sccp_session_loadBackoff(90, 80, 60);
+	pbx_test_validate_cleanup(test, backoff >= 150 && backoff <= 165, rc, cleanup);
+	backoff = sccp_session_loadBackoff(100, 80, 60);
+	pbx_test_validate_cleanup(test, backoff >= 240 && backoff <= 255, rc, cleanup);
+	backoff = sccp_session_loadBackoff(100, 100, 60);
+	pbx_test_validate_cleanup(test, backoff >= 60 && backoff <= 75, rc, cleanup);
+
+cleanup:
+	return rc;
+}
+
+AST_TEST_DEFINE(sccp_session_keepalive_fastpath_tests)
+{
+	sccp_session_t s = { 0 };
+	sccp_session_recvbuffer_t *rb = NULL;
+	sccp_msg_t *msg = NULL;
+	sccp_msg_t *queued = NULL;
+	unsigned char stream[SCCP_PACKET_HEADER * 10];
+	unsigned char acks[SCCP_PACKET_HEADER * 11];
+	int sv[2] = { -1, -1 };
+	ssize_t received = 0;
+	int i, rc = AST_TEST_PASS;
+	size_t len = 0;
+
+	switch (cmd) {
+		case TEST_INIT:
+			info->name = "keepalive_fastpath";
+			info->category = test_category;
+			info->summary = "chan-sccp-b session keepalive fast path";
+			info->description = "chan-sccp-b KeepAliveMessages are answered by the receive path with a preencoded ack, unless other messages are queued";
+			return AST_TEST_NOT_RUN;
+		case TEST_EXECUTE:
+			break;
+	}
+	if ((GLOB(debug) & DEBUGCAT_MESSAGE) != 0) {
+		pbx_test_status_update(test, "message debugging is enabled, which disables the fast path. skipping\n");
+		return AST_TEST_PASS;
+	}
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+		pbx_test_status_update(test, "socketpair failed: %s\n", strerror(errno));
+		return AST_TEST_FAIL;
+	}
+	sccp_mutex_init(&s.write_lock);
+	s.fds[0].fd = sv[0];
+	s.fds[1].fd = -1;
+	s.wakeup[0] = s.wakeup[1] = -1;
+	s.keepalive_slot = -1;
+	s.sendqueue_size = SESSION_SENDQUEUE_MIN;
+	s.sendqueue = sccp_calloc(sizeof *s.sendqueue, s.sendqueue_size);
+	rb = sccp_calloc(sizeof *rb, 1);
+	msg = sccp_calloc(1, SCCP_MAX_PACKET);
+	pbx_test_validate_cleanup(test, s.sendqueue && rb && msg, rc, cleanup);
+
+	pbx_test_status_update(test, "10 keepalives are answered without dispatching\n");
+	for (i = 0; i < 10; i++) {
+		len += recv_test_put(stream + len, KeepAliveMessage, 0, 0);
+	}
+	memcpy(rb->data, stream, len);
+	rb->len = len;
+	memset(&recv_test_result, 0, sizeof(recv_test_result));
+	pbx_test_validate_cleanup(test, process_buffer(&s, msg, rb, recv_test_dispatch, TRUE) == 0, rc, cleanup);
+	pbx_test_validate_cleanup(test, rb->len == 0 && s.keepalive_fastpath == 10 && s.lastKeepAlive != 0, rc, cleanup);
+	pbx_test_validate_cleanup(test, recv_test_result.messages == 0, rc, cleanup);
+	received = recv(sv[1], acks, sizeof(acks), MSG_DONTWAIT);
+	pbx_test_validate_cleanup(test, received == (ssize_t) (SCCP_PACKET_HEADER * 10), rc, cleanup);
+	for (i = 0; i < 10; i++) {
+		sccp_header_t *header = (sccp_header_t *) (acks + i * SCCP_PACKET_HEADER);
+		pbx_test_validate_cleanup(test, letohl(header->length) == 4 && letohl(header->lel_messageId) == KeepAliveAckMessage && header->lel_protocolVer == 0, rc, cleanup);
+	}
+
+	pbx_test_status_update(test, "with a message queued, the keepalive takes the normal path\n");
+	queued = sccp_build_packet(KeepAliveAckMessage, 0);
+	pbx_test_validate_cleanup(test, queued != NULL, rc, cleanup);
+	s.sendqueue[s.sendqueue_head] = queued;
+	s.sendqueue_len = 1;
+	rb->len = recv_test_put(rb->data, KeepAliveMessage, 0, 0);
+	pbx_test_validate_cleanup(test, process_buffer(&s, msg, rb, recv_test_dispatch, TRUE) == 0, rc, cleanup);
+	pbx_test_validate_cleanup(test, s.keepalive_fastpath == 10 && recv_test_result.messages == 1, rc, cleanup);
+	pbx_test_validate_cleanup(test, letohl(recv_test_result.last.header.lel_messageId) == KeepAliveMessage, rc, cleanup);
+
+	pbx_test_status_update(test, "other messages are never taken by the fast path\n");
+	s.sendqueue_len = 0;
+	rb->len = recv_test_put(rb->data, KeypadButtonMessage, 0, 0);
+	pbx_test_validate_cleanup(test, process_buffer(&s, msg, rb, recv_test_dispatch, TRUE) == 0, rc, cleanup);
+	pbx_test_validate_cleanup(test, s.keepalive_fastpath == 10 && recv_test_result.messages == 2, rc, cleanup);
+	pbx_test_validate_cleanup(test, letohl(recv_test_result.last.header.lel_messageId) == KeypadButtonMessage, rc, cleanup);
+
+	pbx_test_status_update(test, "without the fast path every keepalive is dispatched\n");
+	rb->len = recv_test_put(rb->data, KeepAliveMessage, 0, 0);
+	pbx_test_validate_cleanup(test, process_buffer(&s, msg, rb, recv_test_dispatch, FALSE) == 0, rc, cleanup);
+	pbx_test_validate_cleanup(test, s.keepalive_fastpath == 10 && recv_test_result.messages == 3, rc, cleanup);
+
+cleanup:
+	if (queued) {
+		sccp_free_packet(queued);
+	}
+	close(sv[0]);
+	close(sv[1]);
+	sccp_mutex_destroy(&s.write_lock);
+	sccp_free(s.sendqueue);
+	sccp_free(rb);
+	sccp_free(msg);
+	return rc;
+}
+
+static void __attribute__((constructor)) sccp_register_tests(void)
+{
+	AST_TEST_REGISTER(sccp_session_recvbuffer_tests);
+	AST_TEST_REGISTER(sccp_session_recvbuffer_benchmark);
+	AST_TEST_REGISTER(sccp_session_keepalive_wheel);
+	AST_TEST_REGISTER(sccp_session_keepalive_fastpath_tests);
+	AST_TEST_REGISTER(sccp_session_admission_tests);
+	AST_TEST_REGISTER(sccp_session_load_tests);
+}
+
+static void __attribute__((destructor)) sccp_unregister_tests(void)
+{
+	AST_TEST_UNREGISTER(sccp_session_recvbuffer_tests);
+	AST_TEST_UNREGISTER(sccp_session_recvbuffer_benchmark);
+	AST_TEST_UNREGISTER(sccp_session_keepalive_wheel);
+	AST_TEST_UNREGISTER(sccp_session_keepalive_fastpath_tests);
+	AST_TEST_UNREGISTER(sccp_session_admission_tests);
+	AST_TEST_UNREGISTER(sccp_session_load_tests);
+}
+#endif
+
 // kate: indent-width 8; replace-tabs off; indent-mode cstyle; auto-insert-doxygen on; line-numbers on; tab-indents on; keep-extra-spaces off; auto-brackets off;
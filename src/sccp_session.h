@@ -13,11 +13,30 @@
 struct sccp_session;
 
 __BEGIN_C_EXTERN__
+/*!
+ * \brief SCCP Session Load Sample
+ * \note every score is a percentage of what is considered full load, the overall score is the highest of them
+ */
+typedef struct sccp_session_load {
+	time_t sampled;												/*!< Time this sample was taken */
+	int score;												/*!< Overall load score (0-100) */
+	int jobs_score;												/*!< Threadpool job queue depth, relative to the number of threadpool threads */
+	int sessions_score;											/*!< Active sessions, relative to load_max_sessions */
+	int registrations_score;										/*!< Registrations in progress, relative to admission_max_pending */
+	int sendqueue_score;											/*!< Average send queue backlog per session, relative to one writev batch */
+	int queued_jobs;											/*!< Number of queued threadpool jobs */
+	int threads;												/*!< Number of threadpool threads */
+	uint sessions;												/*!< Number of active sessions */
+	uint inprogress;											/*!< Number of registrations in progress */
+	uint queued_messages;											/*!< Number of messages waiting in session send queues */
+} sccp_session_load_t;												/*!< SCCP Session Load Sample */
+
 SCCP_API void SCCP_CALL sccp_session_terminateAll(void);
 SCCP_API const char *const SCCP_CALL sccp_session_getDesignator(constSessionPtr session);
 SCCP_API void SCCP_CALL sccp_session_sendmsg(constDevicePtr device, sccp_mid_t t);
 SCCP_API int SCCP_CALL sccp_session_send(constDevicePtr device, const sccp_msg_t * msg_in);
 SCCP_API int SCCP_CALL sccp_session_send2(constSessionPtr session, sccp_msg_t * msg);
+SCCP_API int SCCP_CALL sccp_session_sendBatch(constDevicePtr device, sccp_msg_t ** msgs, uint count);
 SCCP_API int SCCP_CALL sccp_session_retainDevice(constSessionPtr session, constDevicePtr device);
 SCCP_API void SCCP_CALL sccp_session_releaseDevice(constSessionPtr volatile session);
 SCCP_API sccp_session_t * SCCP_CALL sccp_session_reject(constSessionPtr session, char *message);
@@ -35,6 +54,12 @@ SCCP_API void SCCP_CALL sccp_session_resetLastKeepAlive(constSessionPtr session)
 SCCP_API boolean_t SCCP_CALL sccp_session_check_crossdevice(constSessionPtr session, constDevicePtr device);
 SCCP_API sccp_device_t * const SCCP_CALL sccp_session_getDevice(constSessionPtr session, boolean_t required);
 SCCP_API boolean_t SCCP_CALL sccp_session_isValid(constSessionPtr session);
+SCCP_API int SCCP_CALL sccp_session_eventloop_count(void);
+SCCP_API void SCCP_CALL sccp_session_keepalive_stats(uint * armed, uint * expired_total, uint * expired_last_interval, uint * rescheduled_total);
+SCCP_API void SCCP_CALL sccp_session_admission_stats(uint * admitted, uint * deferred, uint * rejected, uint * inprogress);
+SCCP_API void SCCP_CALL sccp_session_getLoad(sccp_session_load_t * load);
+SCCP_API uint32_t SCCP_CALL sccp_session_loadBackoff(int score, int threshold, int backoff_time);
+SCCP_API int SCCP_CALL sccp_cli_show_load(int fd, sccp_cli_totals_t *totals, struct mansession *s, const struct message *m, int argc, char *argv[]);
 SCCP_API int SCCP_CALL sccp_cli_show_sessions(int fd, sccp_cli_totals_t *totals, struct mansession *s, const struct message *m, int argc, char *argv[]);
 __END_C_EXTERN__
 // kate: indent-width 8; replace-tabs off; indent-mode cstyle; auto-insert-doxygen on; line-numbers on; tab-indents on; keep-extra-spaces off; auto-brackets off;
@@ -966,6 +966,120 @@ gcc_inline static const sccp_softkeyMap_cb_t *sccp_getSoftkeyMap_by_SoftkeyEvent
 	return NULL;
 }
 
+/* =========================================================================================== Message Cache */
+/*!
+ * \brief Cached, already encoded SoftKeyTemplateRes / SoftKeySetRes message
+ *
+ * The encoded messages only depend on the softkeyset and a handful of device/line feature flags (folded into key by the
+ * caller), so a storm of (re-)registering devices can share them instead of rebuilding them for every device.
+ */
+typedef struct sccp_softkey_msgcache_entry sccp_softkey_msgcache_entry_t;
+struct sccp_softkey_msgcache_entry {
+	uint32_t messageId;											/*!< SoftKeyTemplateResMessage / SoftKeySetResMessage */
+	const sccp_softKeySetConfiguration_t *softkeyset;							/*!< SoftKeySet the message was built from (NULL for the template) */
+	uint32_t key;												/*!< Feature flags used while building the message */
+	sccp_msg_t *msg;											/*!< Encoded Message (never sent, only cloned) */
+	sccp_softkey_msgcache_entry_t *next;
+};
+
+static struct {
+	sccp_softkey_msgcache_entry_t *head;
+	uint32_t entries;
+	uint32_t hits;
+	uint32_t misses;
+} softkey_msgcache = { 0 };
+AST_MUTEX_DEFINE_STATIC(softkey_msgcache_lock);
+
+/*!
+ * \brief Flush the Softkey Message Cache
+ * \note has to be called whenever the softkeysets are released or re-attached (reload/unload), the entries are keyed by softkeyset pointer
+ */
+static void sccp_softkey_msgcache_flush(void)
+{
+	sccp_softkey_msgcache_entry_t *entry = NULL;
+
+	pbx_mutex_lock(&softkey_msgcache_lock);
+	while ((entry = softkey_msgcache.head)) {
+		softkey_msgcache.head = entry->next;
+		sccp_free_packet(entry->msg);
+		sccp_free(entry);
+	}
+	softkey_msgcache.entries = 0;
+	pbx_mutex_unlock(&softkey_msgcache_lock);
+}
+
+/*!
+ * \brief Fetch a copy of a cached Softkey Message
+ * \param messageId SoftKeyTemplateResMessage / SoftKeySetResMessage
+ * \param softkeyset SoftKeySet the message was built from (NULL for the template)
+ * \param key Feature flags used while building the message
+ * \return copy of the message (consumed by sccp_dev_send) or NULL when not cached
+ */
+sccp_msg_t *sccp_softkey_msgcache_fetch(uint32_t messageId, const sccp_softKeySetConfiguration_t * softkeyset, uint32_t key)
+{
+	sccp_softkey_msgcache_entry_t *entry = NULL;
+	sccp_msg_t *msg = NULL;
+
+	pbx_mutex_lock(&softkey_msgcache_lock);
+	for (entry = softkey_msgcache.head; entry; entry = entry->next) {
+		if (entry->messageId == messageId && entry->softkeyset == softkeyset && entry->key == key) {
+			msg = sccp_clone_packet(entry->msg);
+			break;
+		}
+	}
+	if (msg) {
+		softkey_msgcache.hits++;
+	} else {
+		softkey_msgcache.misses++;
+	}
+	pbx_mutex_unlock(&softkey_msgcache_lock);
+	return msg;
+}
+
+/*!
+ * \brief Store a copy of a freshly built Softkey Message in the cache
+ * \param messageId SoftKeyTemplateResMessage / SoftKeySetResMessage
+ * \param softkeyset SoftKeySet the message was built from (NULL for the template)
+ * \param key Feature flags used while building the message
+ * \param msg Message to store (not consumed, a copy is made)
+ */
+void sccp_softkey_msgcache_store(uint32_t messageId, const sccp_softKeySetConfiguration_t * softkeyset, uint32_t key, const sccp_msg_t * msg)
+{
+	sccp_softkey_msgcache_entry_t *entry = NULL;
+
+	pbx_mutex_lock(&softkey_msgcache_lock);
+	for (entry = softkey_msgcache.head; entry; entry = entry->next) {
+		if (entry->messageId == messageId && entry->softkeyset == softkeyset && entry->key == key) {
+			break;											/* concurrent registration beat us to it */
+		}
+	}
+	if (!entry && (entry = sccp_calloc(1, sizeof(sccp_softkey_msgcache_entry_t)))) {
+		if ((entry->msg = sccp_clone_packet(msg))) {
+			entry->messageId = messageId;
+			entry->softkeyset = softkeyset;
+			entry->key = key;
+			entry->next = softkey_msgcache.head;
+			softkey_msgcache.head = entry;
+			softkey_msgcache.entries++;
+		} else {
+			sccp_free(entry);
+		}
+	}
+	pbx_mutex_unlock(&softkey_msgcache_lock);
+}
+
+/*!
+ * \brief Softkey Message Cache Statistics
+ */
+void sccp_softkey_msgcache_stats(uint32_t * entries, uint32_t * hits, uint32_t * misses)
+{
+	pbx_mutex_lock(&softkey_msgcache_lock);
+	*entries = softkey_msgcache.entries;
+	*hits = softkey_msgcache.hits;
+	*misses = softkey_msgcache.misses;
+	pbx_mutex_unlock(&softkey_msgcache_lock);
+}
+
 /* =========================================================================================== Public */
 
 /*!
@@ -1020,6 +1134,8 @@ void sccp_softkey_post_reload(void)
 		}
 	}
 	SCCP_RWLIST_UNLOCK(&GLOB(devices));
+
+	sccp_softkey_msgcache_flush();									/* drop entries stored against the old softkeysets while reloading */
 }
 
 /*!
@@ -1030,6 +1146,7 @@ void sccp_softkey_clear(void)
 	sccp_softKeySetConfiguration_t *k;
 	uint8_t i;
 
+	sccp_softkey_msgcache_flush();									/* cached messages reference the softkeysets */
 	SCCP_LIST_LOCK(&softKeySetConfig);
 	while ((k = SCCP_LIST_REMOVE_HEAD(&softKeySetConfig, list))) {
 		for (i = 0; i < StationMaxSoftKeySetDefinition; i++) {
@@ -1137,4 +1254,66 @@ void sccp_softkey_setSoftkeyState(devicePtr device, uint8_t softKeySet, uint8_t
 	}
 }
 
+#if CS_TEST_FRAMEWORK
+#include <asterisk/test.h>
+#define test_category "/channels/chan_sccp/softkeys/"
+
+AST_TEST_DEFINE(sccp_softkey_msgcache_tests)
+{
+	sccp_softKeySetConfiguration_t softkeyset = { 0 };
+	sccp_msg_t *msg = NULL;
+	sccp_msg_t *copy = NULL;
+	uint32_t entries = 0, hits = 0, misses = 0;
+
+	switch (cmd) {
+		case TEST_INIT:
+			info->name = "msgcache";
+			info->category = test_category;
+			info->summary = "chan-sccp-b softkey message cache";
+			info->description = "chan-sccp-b softkey message cache store/fetch/flush";
+			return AST_TEST_NOT_RUN;
+		case TEST_EXECUTE:
+			break;
+	}
+
+	sccp_softkey_msgcache_flush();
+	pbx_test_validate(test, sccp_softkey_msgcache_fetch(SoftKeySetResMessage, &softkeyset, 1) == NULL);
+
+	REQ(msg, SoftKeySetResMessage);
+	pbx_test_validate(test, msg != NULL);
+	msg->data.SoftKeySetResMessage.lel_softKeySetCount = htolel(3);
+	sccp_softkey_msgcache_store(SoftKeySetResMessage, &softkeyset, 1, msg);
+	sccp_softkey_msgcache_store(SoftKeySetResMessage, &softkeyset, 1, msg);			/* duplicate store is ignored */
+	sccp_softkey_msgcache_stats(&entries, &hits, &misses);
+	pbx_test_validate(test, entries == 1);
+
+	pbx_test_validate(test, (copy = sccp_softkey_msgcache_fetch(SoftKeySetResMessage, &softkeyset, 1)) != NULL);
+	pbx_test_validate(test, copy != msg);
+	pbx_test_validate(test, memcmp(copy, msg, SCCP_PACKET_HEADER + letohl(msg->header.length) - 4) == 0);
+	sccp_free_packet(copy);
+
+	pbx_test_validate(test, sccp_softkey_msgcache_fetch(SoftKeySetResMessage, &softkeyset, 2) == NULL);
+	pbx_test_validate(test, sccp_softkey_msgcache_fetch(SoftKeySetResMessage, NULL, 1) == NULL);
+	pbx_test_validate(test, sccp_softkey_msgcache_fetch(SoftKeyTemplateResMessage, &softkeyset, 1) == NULL);
+
+	sccp_softkey_msgcache_flush();
+	sccp_softkey_msgcache_stats(&entries, &hits, &misses);
+	pbx_test_validate(test, entries == 0);
+	pbx_test_validate(test, sccp_softkey_msgcache_fetch(SoftKeySetResMessage, &softkeyset, 1) == NULL);
+	sccp_free_packet(msg);
+
+	return AST_TEST_PASS;
+}
+
+static void __attribute__((constructor)) sccp_register_tests(void)
+{
+	AST_TEST_REGISTER(sccp_softkey_msgcache_tests);
+}
+
+static void __attribute__((destructor)) sccp_unregister_tests(void)
+{
+	AST_TEST_UNREGISTER(sccp_softkey_msgcache_tests);
+}
+#endif
+
 // kate: indent-width 8; replace-tabs off; indent-mode cstyle; auto-insert-doxygen on; line-numbers on; tab-indents on; keep-extra-spaces off; auto-brackets off;
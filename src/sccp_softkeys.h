@@ -16,6 +16,9 @@ typedef struct sccp_softkeyMap_cb sccp_softkeyMap_cb_t;
 SCCP_API void SCCP_CALL sccp_softkey_pre_reload(void);
 SCCP_API void SCCP_CALL sccp_softkey_post_reload(void);
 SCCP_API void SCCP_CALL sccp_softkey_clear(void);
+SCCP_API sccp_msg_t * SCCP_CALL sccp_softkey_msgcache_fetch(uint32_t messageId, const sccp_softKeySetConfiguration_t * softkeyset, uint32_t key);
+SCCP_API void SCCP_CALL sccp_softkey_msgcache_store(uint32_t messageId, const sccp_softKeySetConfiguration_t * softkeyset, uint32_t key, const sccp_msg_t * msg);
+SCCP_API void SCCP_CALL sccp_softkey_msgcache_stats(uint32_t * entries, uint32_t * hits, uint32_t * misses);
 
 SCCP_API sccp_softkeyMap_cb_t * SCCP_CALL sccp_softkeyMap_copyStaticallyMapped(void);
 SCCP_API boolean_t SCCP_CALL sccp_softkeyMap_replaceCallBackByUriAction(sccp_softkeyMap_cb_t * const softkeyMap, uint32_t event, char *uriactionstr);
@@ -22,6 +22,7 @@ SCCP_FILE_VERSION(__FILE__, "");
 #endif
 #define SEMAPHORE_LOCKED	(0)
 #define SEMAPHORE_UNLOCKED	(1)
+#define THREADPOOL_JOB_CACHE	64										/* max number of recycled job nodes kept per queue */
 void sccp_threadpool_grow(sccp_threadpool_t * tp_p, int amount);
 void sccp_threadpool_shrink(sccp_threadpool_t * tp_p, int amount);
 
@@ -32,14 +33,37 @@ struct sccp_threadpool_thread {
 	sccp_threadpool_t *tp_p;
 	SCCP_LIST_ENTRY (sccp_threadpool_thread_t) list;
 	boolean_t die;
+	int queue;												/*!< Index of the job queue owned by this thread */
 };
 
+/*!
+ * \brief Job queue owned by one pool thread
+ * \note the queues outlive their threads: when a thread exits, the jobs left in its queue get stolen by the others, or run
+ *       by the next thread taking over the queue
+ */
+typedef struct sccp_threadpool_queue {
+	SCCP_LIST_HEAD (, sccp_threadpool_job_t) jobs;								/*!< Queued Jobs (the list lock protects all members) */
+	SCCP_LIST_HEAD (, sccp_threadpool_job_t) freejobs;							/*!< Recycled Job Nodes (not locked itself, uses jobs.lock) */
+	sccp_threadpool_thread_t *owner;									/*!< Thread owning this queue (NULL when unused) */
+	uint64_t runs;												/*!< Number of jobs run by the owner */
+	uint64_t steals;											/*!< Number of jobs the owner stole from other queues */
+	uint64_t latency_total;											/*!< Sum of the queue latency of the jobs taken from this queue (usecs) */
+	uint64_t latency_count;											/*!< Number of jobs taken from this queue */
+	int64_t latency_max;											/*!< Max queue latency of a job taken from this queue (usecs) */
+} __attribute__((aligned(64))) sccp_threadpool_queue_t;
+
 /* The threadpool */
 struct sccp_threadpool {
-	SCCP_LIST_HEAD (, sccp_threadpool_job_t) jobs;
+	sccp_threadpool_queue_t queues[THREADPOOL_MAX_SIZE];
 	SCCP_LIST_HEAD (, sccp_threadpool_thread_t) threads;
+	pbx_mutex_t lock;											/*!< Protects idle / work condition */
+	pbx_mutex_t counter_lock;										/*!< Only used by the ATOMIC_* fallback on platforms without atomic builtins */
 	pbx_cond_t work;
 	pbx_cond_t exit;
+	pthread_key_t self;											/*!< sccp_threadpool_thread_t of the calling pool thread */
+	volatile int pending;											/*!< Number of queued jobs over all queues */
+	volatile int idle;											/*!< Number of threads waiting for the work condition */
+	volatile int next_queue;										/*!< Round robin index for work added from outside the pool */
 	time_t last_size_check;											/*!< Time since last size check */
 	time_t last_resize;											/*!< Time since last resize */
 	int job_high_water_mark;										/*!< Highest number of jobs outstanding since last resize check */
@@ -62,6 +86,7 @@ sccp_threadpool_t *sccp_threadpool_init(int threadsN)
 {
 	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_2 "Starting Threadpool\n");
 	sccp_threadpool_t *tp_p;
+	int q;
 
 #if defined(__GNUC__) && __GNUC__ > 3 && defined(HAVE_SYS_INFO_H)
 	threadsN = get_nprocs_conf();										// get current number of active processors
@@ -77,18 +102,28 @@ sccp_threadpool_t *sccp_threadpool_init(int threadsN)
 		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
 		return NULL;
 	}
+	if (pthread_key_create(&tp_p->self, NULL)) {
+		pbx_log(LOG_ERROR, "SCCP: (sccp_threadpool_init) pthread_key_create failed\n");
+		sccp_free(tp_p);
+		return NULL;
+	}
 
 	/* initialize the thread pool */
 	SCCP_LIST_HEAD_INIT(&tp_p->threads);
 
-	/* Initialise the job queue */
-	SCCP_LIST_HEAD_INIT(&tp_p->jobs);
+	/* Initialise the job queues */
+	for (q = 0; q < THREADPOOL_MAX_SIZE; q++) {
+		SCCP_LIST_HEAD_INIT(&tp_p->queues[q].jobs);
+		SCCP_LIST_HEAD_INIT(&tp_p->queues[q].freejobs);
+	}
 	tp_p->last_size_check = time(0);
 	tp_p->job_high_water_mark = 0;
 	tp_p->last_resize = time(0);
 	tp_p->sccp_threadpool_shuttingdown = 0;
 
 	/* Initialise Condition */
+	pbx_mutex_init(&tp_p->lock);
+	pbx_mutex_init(&tp_p->counter_lock);
 	pbx_cond_init(&(tp_p->work), NULL);
 	pbx_cond_init(&(tp_p->exit), NULL);
 
@@ -101,21 +136,42 @@ sccp_threadpool_t *sccp_threadpool_init(int threadsN)
 	return tp_p;
 }
 
+/* wake up to count sleeping threads (does nothing when no thread is waiting for work) */
+static void sccp_threadpool_wakeup(sccp_threadpool_t * tp_p, int count)
+{
+	if (tp_p->idle > 0) {
+		pbx_mutex_lock(&tp_p->lock);
+		if (count > 1) {
+			pbx_cond_broadcast(&(tp_p->work));
+		} else {
+			pbx_cond_signal(&(tp_p->work));
+		}
+		pbx_mutex_unlock(&tp_p->lock);
+	}
+}
+
 // sccp_threadpool_grow needs to be called with locked &(tp_p->threads)->lock
 void sccp_threadpool_grow(sccp_threadpool_t * tp_p, int amount)
 {
 	pthread_attr_t attr;
 	sccp_threadpool_thread_t *tp_thread;
-	int t;
+	int t, q;
 
 	if (tp_p && !tp_p->sccp_threadpool_shuttingdown) {
 		for (t = 0; t < amount; t++) {
+			/* find a job queue without owner */
+			for (q = 0; q < THREADPOOL_MAX_SIZE && tp_p->queues[q].owner; q++);
+			if (q == THREADPOOL_MAX_SIZE) {
+				sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "Threadpool already at max size (%d)\n", THREADPOOL_MAX_SIZE);
+				return;
+			}
 			if (!(tp_thread = sccp_calloc(sizeof *tp_thread, 1))) {
                 		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
 				return;
 			}
 			tp_thread->die = FALSE;
 			tp_thread->tp_p = tp_p;
+			tp_thread->queue = q;
 
 			pthread_attr_init(&attr);
 			pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
@@ -124,9 +180,14 @@ void sccp_threadpool_grow(sccp_threadpool_t * tp_p, int amount)
 			SCCP_LIST_LOCK(&(tp_p->threads));
 			SCCP_LIST_INSERT_HEAD(&(tp_p->threads), tp_thread, list);
 			SCCP_LIST_UNLOCK(&(tp_p->threads));
+			SCCP_LIST_LOCK(&tp_p->queues[q].jobs);
+			tp_p->queues[q].owner = tp_thread;
+			SCCP_LIST_UNLOCK(&tp_p->queues[q].jobs);
 			pbx_pthread_create(&(tp_thread->thread), &attr, (void *) sccp_threadpool_thread_do, (void *) tp_thread);
-			sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "Created thread %d(%p) in pool \n", t, (void *) tp_thread->thread);
+			sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "Created thread %d(%p) in pool, owning queue %d\n", t, (void *) tp_thread->thread, q);
+			pbx_mutex_lock(&tp_p->lock);
 			pbx_cond_broadcast(&(tp_p->work));
+			pbx_mutex_unlock(&tp_p->lock);
 		}
 	}
 }
@@ -151,7 +212,9 @@ void sccp_threadpool_shrink(sccp_threadpool_t * tp_p, int amount)
 			if (tp_thread) {
 				// wake up all threads
 				sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "Sending die signal to thread %p in pool \n", (void *) tp_thread->thread);
+				pbx_mutex_lock(&tp_p->lock);
 				pbx_cond_broadcast(&(tp_p->work));
+				pbx_mutex_unlock(&tp_p->lock);
 			}
 		}
 	}
@@ -164,19 +227,20 @@ static void sccp_threadpool_check_size(sccp_threadpool_t * tp_p)
 		sccp_log((DEBUGCAT_THPOOL)) (VERBOSE_PREFIX_3 "(sccp_threadpool_check_resize) in thread: %p\n", (void *) pthread_self());
 		SCCP_LIST_LOCK(&(tp_p->threads));
 		{
-			if (SCCP_LIST_GETSIZE(&tp_p->jobs) > (SCCP_LIST_GETSIZE(&tp_p->threads) * 2) && SCCP_LIST_GETSIZE(&tp_p->threads) < THREADPOOL_MAX_SIZE) {	// increase
+			int jobs = tp_p->pending;
+			if (jobs > (SCCP_LIST_GETSIZE(&tp_p->threads) * 2) && SCCP_LIST_GETSIZE(&tp_p->threads) < THREADPOOL_MAX_SIZE) {	// increase
 				sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "Add new thread to threadpool %p\n", tp_p);
 				sccp_threadpool_grow(tp_p, 1);
 				tp_p->last_resize = time(0);
 			} else if (((time(0) - tp_p->last_resize) > THREADPOOL_RESIZE_INTERVAL * 3) &&		// wait a little longer to decrease
-				   (SCCP_LIST_GETSIZE(&tp_p->threads) > THREADPOOL_MIN_SIZE && SCCP_LIST_GETSIZE(&tp_p->jobs) < (SCCP_LIST_GETSIZE(&tp_p->threads) / 2))) {	// decrease
+				   (SCCP_LIST_GETSIZE(&tp_p->threads) > THREADPOOL_MIN_SIZE && jobs < (SCCP_LIST_GETSIZE(&tp_p->threads) / 2))) {	// decrease
 				sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "Remove thread %d from threadpool %p\n", SCCP_LIST_GETSIZE(&tp_p->threads) - 1, tp_p);
 				// kill last thread only if it is not executed by itself
 				sccp_threadpool_shrink(tp_p, 1);
 				tp_p->last_resize = time(0);
 			}
 			tp_p->last_size_check = time(0);
-			tp_p->job_high_water_mark = SCCP_LIST_GETSIZE(&tp_p->jobs);
+			tp_p->job_high_water_mark = jobs;
 			sccp_log((DEBUGCAT_THPOOL)) (VERBOSE_PREFIX_3 "(sccp_threadpool_check_resize) Number of threads: %d, job_high_water_mark: %d\n", SCCP_LIST_GETSIZE(&tp_p->threads), tp_p->job_high_water_mark);
 		}
 		SCCP_LIST_UNLOCK(&(tp_p->threads));
@@ -188,69 +252,128 @@ static void sccp_threadpool_thread_end(void *p)
 	sccp_threadpool_thread_t *tp_thread = (sccp_threadpool_thread_t *) p;
 	sccp_threadpool_thread_t *res = NULL;
 	sccp_threadpool_t *tp_p = tp_thread->tp_p;
+	sccp_threadpool_queue_t *queue = &tp_p->queues[tp_thread->queue];
+
+	SCCP_LIST_LOCK(&queue->jobs);
+	if (queue->owner == tp_thread) {
+		queue->owner = NULL;
+	}
+	SCCP_LIST_UNLOCK(&queue->jobs);
 
 	SCCP_LIST_LOCK(&(tp_p->threads));
 	res = SCCP_LIST_REMOVE(&(tp_p->threads), tp_thread, list);
+	pbx_cond_signal(&(tp_p->exit));
 	SCCP_LIST_UNLOCK(&(tp_p->threads));
 
-	pbx_cond_signal(&(tp_p->exit));
 	if (res) {
 		sccp_free(res);
 	}
 }
 
+/*!
+ * \brief Take the oldest job from a queue, recycling the job node
+ * \return TRUE when a job was taken
+ */
+static boolean_t sccp_threadpool_queue_take(sccp_threadpool_t * tp_p, sccp_threadpool_queue_t * queue, void *(**function_p) (void *), void **arg_p)
+{
+	sccp_threadpool_job_t *job = NULL;
+	boolean_t found = FALSE;
+	int64_t latency = 0;
+
+	if (SCCP_LIST_GETSIZE(&queue->jobs) == 0) {								/* unlocked peek, avoids taking the lock of empty queues while stealing */
+		return FALSE;
+	}
+	SCCP_LIST_LOCK(&queue->jobs);
+	if ((job = SCCP_LIST_REMOVE_HEAD(&queue->jobs, list))) {
+		found = TRUE;
+		*function_p = job->function;
+		*arg_p = job->arg;
+		struct timeval waited = ast_tvsub(pbx_tvnow(), job->enqueued);
+		latency = (int64_t) waited.tv_sec * 1000000 + waited.tv_usec;
+		queue->latency_total += latency;
+		queue->latency_count++;
+		if (latency > queue->latency_max) {
+			queue->latency_max = latency;
+		}
+		if (SCCP_LIST_GETSIZE(&queue->freejobs) < THREADPOOL_JOB_CACHE) {
+			SCCP_LIST_INSERT_HEAD(&queue->freejobs, job, list);
+			job = NULL;
+		}
+		(void) ATOMIC_DECR(&tp_p->pending, 1, &tp_p->counter_lock);
+	}
+	SCCP_LIST_UNLOCK(&queue->jobs);
+	if (job) {
+		sccp_free(job);											/* job node cache full */
+	}
+	return found;
+}
+
+/*!
+ * \brief Get the next job for a pool thread: from its own queue first, otherwise steal the oldest job from one of the other queues
+ * \return TRUE when a job was found
+ */
+static boolean_t sccp_threadpool_next_job(sccp_threadpool_thread_t * tp_thread, void *(**function_p) (void *), void **arg_p)
+{
+	sccp_threadpool_t *tp_p = tp_thread->tp_p;
+	sccp_threadpool_queue_t *own_queue = &tp_p->queues[tp_thread->queue];
+	int q, victim;
+
+	if (sccp_threadpool_queue_take(tp_p, own_queue, function_p, arg_p)) {
+		own_queue->runs++;										/* only updated by the owner */
+		return TRUE;
+	}
+	for (q = 1; q < THREADPOOL_MAX_SIZE; q++) {
+		victim = (tp_thread->queue + q) % THREADPOOL_MAX_SIZE;
+		if (sccp_threadpool_queue_take(tp_p, &tp_p->queues[victim], function_p, arg_p)) {
+			own_queue->runs++;
+			own_queue->steals++;
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
 /* What each individual thread is doing */
 void sccp_threadpool_thread_do(void *p)
 {
 	sccp_threadpool_thread_t *tp_thread = (sccp_threadpool_thread_t *) p;
 	sccp_threadpool_t *tp_p = tp_thread->tp_p;
 	void *thread = (void *) pthread_self();
+	void *(*func_buff) (void *arg) = NULL;
+	void *arg_buff = NULL;
 
 	pthread_cleanup_push(sccp_threadpool_thread_end, tp_thread);
+	pthread_setspecific(tp_p->self, tp_thread);
 
-	int jobs = 0, threads = 0;
-
-	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "Starting Threadpool JobQueue:%p\n", thread);
+	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "Starting Threadpool JobQueue:%p (queue %d)\n", thread, tp_thread->queue);
 	while (1) {
 		pthread_testcancel();
-		jobs = SCCP_LIST_GETSIZE(&tp_p->jobs);
-		threads = SCCP_LIST_GETSIZE(&tp_p->threads);
-
-		sccp_log((DEBUGCAT_THPOOL)) (VERBOSE_PREFIX_3 "(sccp_threadpool_thread_do) num_jobs: %d, thread: %p, num_threads: %d\n", jobs, thread, threads);
+		sccp_log((DEBUGCAT_THPOOL)) (VERBOSE_PREFIX_3 "(sccp_threadpool_thread_do) num_jobs: %d, thread: %p, num_threads: %d\n", tp_p->pending, thread, SCCP_LIST_GETSIZE(&tp_p->threads));
 
 		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
-		SCCP_LIST_LOCK(&(tp_p->jobs));									/* LOCK */
-		while (SCCP_LIST_GETSIZE(&tp_p->jobs) == 0 && !tp_thread->die) {
-			sccp_log((DEBUGCAT_THPOOL)) (VERBOSE_PREFIX_3 "(sccp_threadpool_thread_do) Thread %p Waiting for New Work Condition\n", thread);
-			pbx_cond_wait(&(tp_p->work), &(tp_p->jobs.lock));
-		}
-		if (tp_thread->die && SCCP_LIST_GETSIZE(&tp_p->jobs) == 0) {
-			sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "JobQueue Die. Exiting thread %p...\n", thread);
-			SCCP_LIST_UNLOCK(&(tp_p->jobs));
-			break;
-		}
-		sccp_log((DEBUGCAT_THPOOL)) (VERBOSE_PREFIX_3 "(sccp_threadpool_thread_do) Let's work. num_jobs: %d, thread: %p, num_threads: %d\n", jobs, thread, threads);
-		{
-			/* Read job from queue and execute it */
-			void *(*func_buff) (void *arg) = NULL;
-			void *arg_buff = NULL;
-			sccp_threadpool_job_t *job;
-
-			if ((job = SCCP_LIST_REMOVE_HEAD(&(tp_p->jobs), list))) {
-				func_buff = job->function;
-				arg_buff = job->arg;
+		if (!sccp_threadpool_next_job(tp_thread, &func_buff, &arg_buff)) {
+			if (tp_thread->die) {
+				sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "JobQueue Die. Exiting thread %p...\n", thread);
+				break;
 			}
-			SCCP_LIST_UNLOCK(&(tp_p->jobs));
-
-			sccp_log((DEBUGCAT_THPOOL)) (VERBOSE_PREFIX_3 "(sccp_threadpool_thread_do) executing %p in thread: %p\n", job, thread);
-			if (job) {
-				func_buff(arg_buff);								/* run function */
-				sccp_free(job);									/* DEALLOC job */
-			}
-			// check number of threads in threadpool
-			if ((time(0) - tp_p->last_size_check) > THREADPOOL_RESIZE_INTERVAL) {
-				sccp_threadpool_check_size(tp_p);						/* Check Resizing */
+			/* announce we are idle before checking pending again, so that a job added in between always wakes us up */
+			pbx_mutex_lock(&tp_p->lock);
+			tp_p->idle++;
+			while (ATOMIC_FETCH(&tp_p->pending, &tp_p->counter_lock) == 0 && !tp_thread->die) {
+				sccp_log((DEBUGCAT_THPOOL)) (VERBOSE_PREFIX_3 "(sccp_threadpool_thread_do) Thread %p Waiting for New Work Condition\n", thread);
+				pbx_cond_wait(&(tp_p->work), &tp_p->lock);
 			}
+			tp_p->idle--;
+			pbx_mutex_unlock(&tp_p->lock);
+			pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+			continue;
+		}
+		sccp_log((DEBUGCAT_THPOOL)) (VERBOSE_PREFIX_3 "(sccp_threadpool_thread_do) executing %p in thread: %p\n", func_buff, thread);
+		func_buff(arg_buff);										/* run function */
+
+		// check number of threads in threadpool
+		if ((time(0) - tp_p->last_size_check) > THREADPOOL_RESIZE_INTERVAL) {
+			sccp_threadpool_check_size(tp_p);							/* Check Resizing */
 		}
 		pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
 	}
@@ -259,30 +382,131 @@ void sccp_threadpool_thread_do(void *p)
 	return;
 }
 
+/*!
+ * \brief Choose the queue for new work: the own queue of a pool thread, round robin over the owned queues otherwise
+ */
+static sccp_threadpool_queue_t *sccp_threadpool_target_queue(sccp_threadpool_t * tp_p)
+{
+	sccp_threadpool_thread_t *self = pthread_getspecific(tp_p->self);
+	int q, tries;
+
+	if (self && self->tp_p == tp_p && !self->die) {
+		return &tp_p->queues[self->queue];
+	}
+	for (tries = 0; tries < THREADPOOL_MAX_SIZE; tries++) {
+		q = (int) ((unsigned int) ATOMIC_INCR(&tp_p->next_queue, 1, &tp_p->counter_lock) % THREADPOOL_MAX_SIZE);
+		if (tp_p->queues[q].owner) {									/* unlocked hint, a queue losing its owner still gets drained by stealing */
+			return &tp_p->queues[q];
+		}
+	}
+	return &tp_p->queues[0];
+}
+
+/*!
+ * \brief Append work to a queue, reusing a recycled job node when available
+ * \note called with queue->jobs locked
+ */
+static boolean_t sccp_threadpool_queue_put(sccp_threadpool_queue_t * queue, void *(*function_p) (void *), void *arg_p, struct timeval now)
+{
+	sccp_threadpool_job_t *job = SCCP_LIST_REMOVE_HEAD(&queue->freejobs, list);
+
+	if (!job && !(job = sccp_calloc(sizeof *job, 1))) {
+		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
+		return FALSE;
+	}
+	job->function = function_p;
+	job->arg = arg_p;
+	job->enqueued = now;
+	SCCP_LIST_INSERT_TAIL(&queue->jobs, job, list);
+	return TRUE;
+}
+
 /* Add work to the thread pool */
 int sccp_threadpool_add_work(sccp_threadpool_t * tp_p, void *(*function_p) (void *), void *arg_p)
 {
+	sccp_threadpool_queue_t *queue = NULL;
+	boolean_t added = FALSE;
+
 	// prevent new work while shutting down
 	if (!tp_p->sccp_threadpool_shuttingdown) {
-		sccp_threadpool_job_t *newJob;
-
-		if (!(newJob = sccp_calloc(sizeof *newJob, 1))) {
-        		pbx_log(LOG_ERROR, SS_Memory_Allocation_Error, "SCCP");
-			exit(1);
+		queue = sccp_threadpool_target_queue(tp_p);
+		SCCP_LIST_LOCK(&queue->jobs);
+		if (!tp_p->sccp_threadpool_shuttingdown) {
+			added = sccp_threadpool_queue_put(queue, function_p, arg_p, pbx_tvnow());
+		}
+		SCCP_LIST_UNLOCK(&queue->jobs);
+		if (added) {
+			if (ATOMIC_INCR(&tp_p->pending, 1, &tp_p->counter_lock) + 1 > tp_p->job_high_water_mark) {
+				tp_p->job_high_water_mark = tp_p->pending;
+			}
+			sccp_threadpool_wakeup(tp_p, 1);
+			return 1;
+		}
+		if (!tp_p->sccp_threadpool_shuttingdown) {
+			return 0;										/* out of memory */
 		}
-
-		/* add function and argument */
-		newJob->function = function_p;
-		newJob->arg = arg_p;
-
-		/* add job to queue */
-		sccp_threadpool_jobqueue_add(tp_p, newJob);
-		return 1;
 	} 
         pbx_log(LOG_ERROR, "sccp_threadpool_add_work(): Threadpool shutting down, denying new work\n");
         return 0;
 }
 
+/* Add a batch of work to the thread pool */
+int sccp_threadpool_add_work_batch(sccp_threadpool_t * tp_p, const sccp_threadpool_work_t * work, int count)
+{
+	sccp_threadpool_thread_t *self = NULL;
+	sccp_threadpool_queue_t *queue = NULL;
+	struct timeval now = pbx_tvnow();
+	int queues[THREADPOOL_MAX_SIZE];
+	int num_queues = 0;
+	int added = 0;
+	int chunk, i, q;
+
+	if (!tp_p || !work || count <= 0) {
+		return 0;
+	}
+	if (tp_p->sccp_threadpool_shuttingdown) {
+		pbx_log(LOG_ERROR, "sccp_threadpool_add_work_batch(): Threadpool shutting down, denying new work\n");
+		return 0;
+	}
+
+	/* a pool thread keeps the batch in its own queue (the idle threads will steal from it), others spread it over the owned queues */
+	self = pthread_getspecific(tp_p->self);
+	if (self && self->tp_p == tp_p && !self->die) {
+		queues[num_queues++] = self->queue;
+	} else {
+		for (q = 0; q < THREADPOOL_MAX_SIZE; q++) {
+			if (tp_p->queues[q].owner) {
+				queues[num_queues++] = q;
+			}
+		}
+		if (!num_queues) {
+			queues[num_queues++] = 0;
+		}
+	}
+	chunk = (count + num_queues - 1) / num_queues;
+	for (q = 0; q < num_queues && added < count; q++) {
+		queue = &tp_p->queues[queues[q]];
+		SCCP_LIST_LOCK(&queue->jobs);
+		for (i = 0; i < chunk && added < count && !tp_p->sccp_threadpool_shuttingdown; i++) {
+			if (!sccp_threadpool_queue_put(queue, work[added].function, work[added].arg, now)) {
+				break;
+			}
+			added++;
+		}
+		SCCP_LIST_UNLOCK(&queue->jobs);
+		if (i < chunk && added < count) {
+			break;
+		}
+	}
+	if (added) {
+		if (ATOMIC_INCR(&tp_p->pending, added, &tp_p->counter_lock) + added > tp_p->job_high_water_mark) {
+			tp_p->job_high_water_mark = tp_p->pending;
+		}
+		sccp_threadpool_wakeup(tp_p, added);
+	}
+	return added;
+}
+
 /* Destroy the threadpool */
 boolean_t sccp_threadpool_destroy(sccp_threadpool_t * tp_p)
 {
@@ -290,24 +514,31 @@ boolean_t sccp_threadpool_destroy(sccp_threadpool_t * tp_p)
 		return FALSE;
 	}
 	sccp_threadpool_thread_t *tp_thread = NULL;
+	sccp_threadpool_job_t *job = NULL;
+	int q;
 
-	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_2 "Destroying Threadpool %p with %d jobs\n", tp_p, SCCP_LIST_GETSIZE(&tp_p->jobs));
+	sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_2 "Destroying Threadpool %p with %d jobs\n", tp_p, tp_p->pending);
 
 	// After this point, no new jobs can be added
-	SCCP_LIST_LOCK(&(tp_p->jobs));
+	for (q = 0; q < THREADPOOL_MAX_SIZE; q++) {
+		SCCP_LIST_LOCK(&tp_p->queues[q].jobs);
+	}
 	tp_p->sccp_threadpool_shuttingdown = 1;
-	SCCP_LIST_UNLOCK(&(tp_p->jobs));
+	for (q = 0; q < THREADPOOL_MAX_SIZE; q++) {
+		SCCP_LIST_UNLOCK(&tp_p->queues[q].jobs);
+	}
 
 	// shutdown is a kind of work too
 	SCCP_LIST_LOCK(&(tp_p->threads));
 	SCCP_LIST_TRAVERSE(&(tp_p->threads), tp_thread, list) {
 		tp_thread->die = TRUE;
-		pbx_cond_broadcast(&(tp_p->work));
 	}
 	SCCP_LIST_UNLOCK(&(tp_p->threads));
 
 	// wake up jobs untill jobqueue is empty, before shutting down, to make sure all jobs have been processed
+	pbx_mutex_lock(&tp_p->lock);
 	pbx_cond_broadcast(&(tp_p->work));
+	pbx_mutex_unlock(&tp_p->lock);
 
 	// wait for all threads to exit
 	if (SCCP_LIST_GETSIZE(&tp_p->threads) != 0) {
@@ -322,7 +553,9 @@ boolean_t sccp_threadpool_destroy(sccp_threadpool_t * tp_p)
 			ts.tv_sec = tp.tv_sec;
 			ts.tv_nsec = tp.tv_usec * 1000;
 			ts.tv_sec += 1;										// wait max 2 second
+			pbx_mutex_lock(&tp_p->lock);
 			pbx_cond_broadcast(&(tp_p->work));
+			pbx_mutex_unlock(&tp_p->lock);
 			pbx_cond_timedwait(&tp_p->exit, &(tp_p->threads.lock), &ts);
 		}
 
@@ -339,9 +572,22 @@ boolean_t sccp_threadpool_destroy(sccp_threadpool_t * tp_p)
 	}
 
 	/* Dealloc */
+	for (q = 0; q < THREADPOOL_MAX_SIZE; q++) {
+		while ((job = SCCP_LIST_REMOVE_HEAD(&tp_p->queues[q].jobs, list))) {
+			pbx_log(LOG_WARNING, "Threadpool %p discarding unprocessed job %p\n", tp_p, job);
+			sccp_free(job);
+		}
+		while ((job = SCCP_LIST_REMOVE_HEAD(&tp_p->queues[q].freejobs, list))) {
+			sccp_free(job);
+		}
+		SCCP_LIST_HEAD_DESTROY(&tp_p->queues[q].jobs);
+		SCCP_LIST_HEAD_DESTROY(&tp_p->queues[q].freejobs);
+	}
 	pbx_cond_destroy(&(tp_p->work));									/* Remove Condition */
 	pbx_cond_destroy(&(tp_p->exit));									/* Remove Condition */
-	SCCP_LIST_HEAD_DESTROY(&(tp_p->jobs));
+	pbx_mutex_destroy(&tp_p->lock);
+	pbx_mutex_destroy(&tp_p->counter_lock);
+	pthread_key_delete(tp_p->self);
 	SCCP_LIST_HEAD_DESTROY(&(tp_p->threads));
 	sccp_free(tp_p);
 	tp_p = NULL;												/* DEALLOC thread pool */
@@ -359,35 +605,78 @@ int sccp_threadpool_thread_count(sccp_threadpool_t * tp_p)
 /* Add job to queue */
 void sccp_threadpool_jobqueue_add(sccp_threadpool_t * tp_p, sccp_threadpool_job_t * newjob_p)
 {
+	sccp_threadpool_queue_t *queue = NULL;
+
 	if (!tp_p || !newjob_p) {
 		pbx_log(LOG_ERROR, "(sccp_threadpool_jobqueue_add) no tp_p or no work pointer\n");
 		sccp_free(newjob_p);
 		return;
 	}
 
-	sccp_log((DEBUGCAT_THPOOL)) (VERBOSE_PREFIX_3 "(sccp_threadpool_jobqueue_add) tp_p: %p, jobCount: %d\n", tp_p, SCCP_LIST_GETSIZE(&tp_p->jobs));
-	SCCP_LIST_LOCK(&(tp_p->jobs));
+	sccp_log((DEBUGCAT_THPOOL)) (VERBOSE_PREFIX_3 "(sccp_threadpool_jobqueue_add) tp_p: %p, jobCount: %d\n", tp_p, tp_p->pending);
+	queue = sccp_threadpool_target_queue(tp_p);
+	SCCP_LIST_LOCK(&queue->jobs);
 	if (tp_p->sccp_threadpool_shuttingdown) {
 		pbx_log(LOG_ERROR, "(sccp_threadpool_jobqueue_add) shutting down. skipping work\n");
-		SCCP_LIST_UNLOCK(&(tp_p->jobs));
+		SCCP_LIST_UNLOCK(&queue->jobs);
 		sccp_free(newjob_p);
 		return;
 	}
-	SCCP_LIST_INSERT_TAIL(&(tp_p->jobs), newjob_p, list);
-	SCCP_LIST_UNLOCK(&(tp_p->jobs));
+	newjob_p->enqueued = pbx_tvnow();
+	SCCP_LIST_INSERT_TAIL(&queue->jobs, newjob_p, list);						/* the node ends up in the job node cache after it has run */
+	SCCP_LIST_UNLOCK(&queue->jobs);
 
-	if ((int)SCCP_LIST_GETSIZE(&tp_p->jobs) > tp_p->job_high_water_mark) {
-		tp_p->job_high_water_mark = SCCP_LIST_GETSIZE(&tp_p->jobs);
+	if (ATOMIC_INCR(&tp_p->pending, 1, &tp_p->counter_lock) + 1 > tp_p->job_high_water_mark) {
+		tp_p->job_high_water_mark = tp_p->pending;
 	}
-	pbx_cond_signal(&(tp_p->work));
+	sccp_threadpool_wakeup(tp_p, 1);
 }
 
 int sccp_threadpool_jobqueue_count(sccp_threadpool_t * tp_p)
 {
-	sccp_log((DEBUGCAT_THPOOL)) (VERBOSE_PREFIX_3 "(sccp_threadpool_jobqueue_count) tp_p: %p, jobCount: %d\n", tp_p, SCCP_LIST_GETSIZE(&tp_p->jobs));
-	return SCCP_LIST_GETSIZE(&tp_p->jobs);
+	sccp_log((DEBUGCAT_THPOOL)) (VERBOSE_PREFIX_3 "(sccp_threadpool_jobqueue_count) tp_p: %p, jobCount: %d\n", tp_p, tp_p->pending);
+	return tp_p->pending;
 }
 
+/*!
+ * \brief Show the per queue statistics of the general threadpool
+ */
+int sccp_show_threadpool(int fd, sccp_cli_totals_t *totals, struct mansession *s, const struct message *m, int argc, char *argv[])
+{
+	sccp_threadpool_t *tp_p = GLOB(general_threadpool);
+	sccp_threadpool_queue_t *queue = NULL;
+	int local_line_total = 0;
+	int q;
+
+	if (!tp_p) {
+		return RESULT_FAILURE;
+	}
+#define CLI_AMI_TABLE_NAME Threadpool
+#define CLI_AMI_TABLE_PER_ENTRY_NAME Queue
+#define CLI_AMI_TABLE_ITERATOR for(q = 0; q < THREADPOOL_MAX_SIZE; q++)
+#define CLI_AMI_TABLE_BEFORE_ITERATION 											\
+		queue = &tp_p->queues[q];										\
+		if (!queue->owner && !queue->latency_count && !SCCP_LIST_GETSIZE(&queue->jobs)) {			\
+			continue;											\
+		}
+#define CLI_AMI_TABLE_FIELDS 												\
+	CLI_AMI_TABLE_FIELD(Queue,		"-5",		d,	5,	q)					\
+	CLI_AMI_TABLE_FIELD(Active,		"-6.6",		s,	6,	queue->owner ? "yes" : "no")		\
+	CLI_AMI_TABLE_FIELD(Queued,		"-6",		d,	6,	SCCP_LIST_GETSIZE(&queue->jobs))	\
+	CLI_AMI_TABLE_FIELD(Runs,		"-10",		lu,	10,	(unsigned long) queue->runs)		\
+	CLI_AMI_TABLE_FIELD(Steals,		"-10",		lu,	10,	(unsigned long) queue->steals)		\
+	CLI_AMI_TABLE_FIELD(AvgLatUs,		"-10",		lu,	10,	(unsigned long) (queue->latency_count ? queue->latency_total / queue->latency_count : 0))	\
+	CLI_AMI_TABLE_FIELD(MaxLatUs,		"-10",		ld,	10,	(long) queue->latency_max)		\
+	CLI_AMI_TABLE_FIELD(FreeNodes,		"-9",		d,	9,	SCCP_LIST_GETSIZE(&queue->freejobs))
+#include "sccp_cli_table.h"
+	local_line_total++;
+
+	if (s) {
+		totals->lines = local_line_total;
+		totals->tables = 1;
+	}
+	return RESULT_SUCCESS;
+}
 
 #if CS_TEST_FRAMEWORK
 #include <asterisk/test.h>
@@ -485,16 +774,100 @@ AST_TEST_DEFINE(sccp_threadpool_work)
 	return AST_TEST_PASS;
 }
 
+AST_MUTEX_DEFINE_STATIC(threadpool_test_lock);
+static volatile int threadpool_test_done;
+static sccp_threadpool_t *threadpool_test_pool;
+
+static void *sccp_threadpool_test_count(void *data)
+{
+	usleep(1000);
+	(void) ATOMIC_INCR(&threadpool_test_done, 1, &threadpool_test_lock);
+	return 0;
+}
+
+/* runs inside the pool: the batch lands in the queue of this thread, so the others have to steal it */
+static void *sccp_threadpool_test_spawn(void *data)
+{
+	sccp_threadpool_work_t work[NUM_WORK];
+	int i;
+
+	for (i = 0; i < NUM_WORK; i++) {
+		work[i].function = sccp_threadpool_test_count;
+		work[i].arg = NULL;
+	}
+	sccp_threadpool_add_work_batch(threadpool_test_pool, work, NUM_WORK);
+	return 0;
+}
+
+AST_TEST_DEFINE(sccp_threadpool_steal)
+{
+	uint64_t runs = 0, steals = 0;
+	int q, loopcount = 0;
+
+	switch(cmd) {
+		case TEST_INIT:
+			info->name = "steal";
+			info->category = test_category;
+			info->summary = "chan-sccp-b threadpool work stealing";
+			info->description = "chan-sccp-b threadpool batch submission, job node recycling and work stealing";
+			return AST_TEST_NOT_RUN;
+	        case TEST_EXECUTE:
+	        	break;
+	}
+	pbx_test_status_update(test, "Create Test threadpool\n");
+	threadpool_test_pool = sccp_threadpool_init(THREADPOOL_MIN_SIZE);
+	pbx_test_validate(test, NULL != threadpool_test_pool);
+	threadpool_test_done = 0;
+
+	pbx_test_status_update(test, "Add a batch of %d jobs from inside the pool\n", NUM_WORK);
+	pbx_test_validate(test, sccp_threadpool_add_work(threadpool_test_pool, sccp_threadpool_test_spawn, NULL) == 1);
+	while (threadpool_test_done < NUM_WORK && loopcount++ < 100) {
+		usleep(100000);
+	}
+	pbx_test_validate(test, threadpool_test_done == NUM_WORK);
+	pbx_test_validate(test, sccp_threadpool_jobqueue_count(threadpool_test_pool) == 0);
+
+	for (q = 0; q < THREADPOOL_MAX_SIZE; q++) {
+		runs += threadpool_test_pool->queues[q].runs;
+		steals += threadpool_test_pool->queues[q].steals;
+	}
+	pbx_test_status_update(test, "Runs: %d, Steals: %d, Threads: %d\n", (int) runs, (int) steals, sccp_threadpool_thread_count(threadpool_test_pool));
+	pbx_test_validate(test, runs == NUM_WORK + 1);
+	pbx_test_validate(test, sccp_threadpool_thread_count(threadpool_test_pool) < 2 || steals > 0);
+
+	pbx_test_status_update(test, "Add a batch of %d jobs from outside the pool, reusing the job nodes\n", NUM_WORK);
+	{
+		sccp_threadpool_work_t work[NUM_WORK];
+		for (q = 0; q < NUM_WORK; q++) {
+			work[q].function = sccp_threadpool_test_count;
+			work[q].arg = NULL;
+		}
+		pbx_test_validate(test, sccp_threadpool_add_work_batch(threadpool_test_pool, work, NUM_WORK) == NUM_WORK);
+	}
+	loopcount = 0;
+	while (threadpool_test_done < NUM_WORK * 2 && loopcount++ < 100) {
+		usleep(100000);
+	}
+	pbx_test_validate(test, threadpool_test_done == NUM_WORK * 2);
+
+	pbx_test_status_update(test, "Destroy Test threadpool\n");
+	pbx_test_validate(test, sccp_threadpool_destroy(threadpool_test_pool) == TRUE);
+	threadpool_test_pool = NULL;
+	return AST_TEST_PASS;
+}
+
 static void __attribute__((constructor)) sccp_register_tests(void)
 {
         AST_TEST_REGISTER(sccp_threadpool_create_destroy);
         AST_TEST_REGISTER(sccp_threadpool_work);
+        AST_TEST_REGISTER(sccp_threadpool_steal);
 }
 
 static void __attribute__((destructor)) sccp_unregister_tests(void)
 {
         AST_TEST_UNREGISTER(sccp_threadpool_create_destroy);
         AST_TEST_UNREGISTER(sccp_threadpool_work);
+        AST_TEST_UNREGISTER(sccp_threadpool_steal);
 }
 #endif
 
@@ -11,6 +11,11 @@
 #pragma once
 //#include "config.h"
 //#include "common.h"
+#include "sccp_cli.h"
+
+/* forward declarations */
+struct mansession;
+struct message;
 
 __BEGIN_C_EXTERN__
 /* Description:         Library providing a threading pool where you can add work on the fly. The number
@@ -34,16 +39,19 @@ __BEGIN_C_EXTERN__
 
 /*                       _______________________________________________________        
  *                      /                                                       \
- *                      |   JOB QUEUE        | job1 | job2 | job3 | job4 | ..   |
+ *                      |   QUEUE 0         | job1 | job4 | ..                  |
+ *                      |   QUEUE 1         | job2 | ..                         |
+ *                      |   QUEUE 2         | job3 | job5 | job6 | ..           |
  *                      |                                                       |
- *                      |   threadpool      | thread1 | thread2 | ..            |
+ *                      |   threadpool      | thread0 | thread1 | thread2 | ..  |
  *                      \_______________________________________________________/
  *      
- * Description:         Jobs are added to the job queue. Once a thread in the pool
- *                      is idle, it is assigned with the first job from the queue(and
- *                      erased from the queue). It's each thread's job to read from 
- *                      the queue serially(using lock) and executing each job
- *                      until the queue is empty.
+ * Description:         Every thread owns a job queue (with its own lock). Work added
+ *                      by a pool thread goes to its own queue, work added from outside
+ *                      the pool is spread round robin over the queues. A thread runs
+ *                      the jobs from its own queue and, once that is empty, steals the
+ *                      oldest job from one of the other queues before going to sleep.
+ *                      Job nodes are recycled per queue instead of being freed.
  * 
  */
 /* ================================= STRUCTURES ================================================ */
@@ -54,9 +62,16 @@ typedef struct sccp_threadpool_job sccp_threadpool_job_t;
 struct sccp_threadpool_job {
 	void *(*function) (void *arg);										/*!< function pointer         */
 	void *arg;												/*!< function's argument      */
+	struct timeval enqueued;										/*!< time the job was queued  */
 	SCCP_LIST_ENTRY (sccp_threadpool_job_t) list;
 };
 
+/* Work item for sccp_threadpool_add_work_batch */
+typedef struct sccp_threadpool_work {
+	void *(*function) (void *arg);										/*!< function pointer         */
+	void *arg;												/*!< function's argument      */
+} sccp_threadpool_work_t;
+
 typedef struct sccp_threadpool sccp_threadpool_t;
 
 /* =========================== FUNCTIONS ================================================ */
@@ -102,6 +117,19 @@ SCCP_API void SCCP_CALL sccp_threadpool_thread_do(void *p);
  */
 SCCP_API int sccp_threadpool_add_work(sccp_threadpool_t * SCCP_CALL  tp_p, void *(*function_p) (void *), void *arg_p);
 
+/*!
+ * \brief Add a batch of work to the job queues
+ * 
+ * Like sccp_threadpool_add_work, but takes every queue lock only once for the whole batch and
+ * wakes up as many sleeping threads as needed in one go.
+ * 
+ * \param tp_p threadpool to which the work will be added to
+ * \param work array of function / argument pairs
+ * \param count number of entries in work
+ * \return number of jobs added
+ */
+SCCP_API int SCCP_CALL sccp_threadpool_add_work_batch(sccp_threadpool_t * tp_p, const sccp_threadpool_work_t * work, int count);
+
 /*!
  * \brief Destroy the threadpool
  * 
@@ -118,6 +146,11 @@ SCCP_API boolean_t SCCP_CALL sccp_threadpool_destroy(sccp_threadpool_t * tp_p);
  */
 SCCP_API int SCCP_CALL sccp_threadpool_thread_count(sccp_threadpool_t * tp_p);
 
+/*!
+ * \brief Show the per thread queue statistics (queued jobs, runs, steals and queue latency)
+ */
+SCCP_API int SCCP_CALL sccp_show_threadpool(int fd, sccp_cli_totals_t *totals, struct mansession *s, const struct message *m, int argc, char *argv[]);
+
 /* ------------------------- Queue specific ------------------------------ */
 
 /*!
@@ -142,7 +175,7 @@ SCCP_API int SCCP_CALL sccp_threadpool_jobqueue_init(sccp_threadpool_t * tp_p);
 SCCP_API void SCCP_CALL sccp_threadpool_jobqueue_add(sccp_threadpool_t * tp_p, sccp_threadpool_job_t * newjob_p);
 
 /*!
- * \brief Return Number of Jobs in the Queue
+ * \brief Return Number of Jobs waiting in the Queues
  * \param tp_p pointer to threadpool
  */
 SCCP_API int SCCP_CALL sccp_threadpool_jobqueue_count(sccp_threadpool_t * tp_p);
@@ -14,6 +14,7 @@
 #include "common.h"
 #include "sccp_channel.h"
 #include "sccp_device.h"
+#include "sccp_featurestore.h"
 #include "sccp_line.h"
 #include "sccp_session.h"
 #include "sccp_utils.h"
@@ -438,31 +439,31 @@ void sccp_util_featureStorageBackend(const sccp_event_t * event)
 				switch (event->event.featureChanged.featureType) {
 					case SCCP_FEATURE_CFWDALL:
 						if (linedevice->cfwdAll.enabled) {
-							iPbx.feature_addToDatabase(cfwdDeviceLineStore, "cfwdAll", linedevice->cfwdAll.number);
-							iPbx.feature_addToDatabase(cfwdLineDeviceStore, "cfwdAll", linedevice->cfwdAll.number);
+							sccp_featurestore_put(cfwdDeviceLineStore, "cfwdAll", linedevice->cfwdAll.number);
+							sccp_featurestore_put(cfwdLineDeviceStore, "cfwdAll", linedevice->cfwdAll.number);
 							sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "%s: db put %s\n", DEV_ID_LOG(device), cfwdDeviceLineStore);
 						} else {
-							iPbx.feature_removeFromDatabase(cfwdDeviceLineStore, "cfwdAll");
-							iPbx.feature_removeFromDatabase(cfwdLineDeviceStore, "cfwdAll");
+							sccp_featurestore_remove(cfwdDeviceLineStore, "cfwdAll");
+							sccp_featurestore_remove(cfwdLineDeviceStore, "cfwdAll");
 							sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "%s: db clear %s\n", DEV_ID_LOG(device), cfwdDeviceLineStore);
 						}
 						break;
 					case SCCP_FEATURE_CFWDBUSY:
 						if (linedevice->cfwdBusy.enabled) {
-							iPbx.feature_addToDatabase(cfwdDeviceLineStore, "cfwdBusy", linedevice->cfwdBusy.number);
-							iPbx.feature_addToDatabase(cfwdLineDeviceStore, "cfwdBusy", linedevice->cfwdBusy.number);
+							sccp_featurestore_put(cfwdDeviceLineStore, "cfwdBusy", linedevice->cfwdBusy.number);
+							sccp_featurestore_put(cfwdLineDeviceStore, "cfwdBusy", linedevice->cfwdBusy.number);
 							sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "%s: db put %s\n", DEV_ID_LOG(device), cfwdDeviceLineStore);
 						} else {
-							iPbx.feature_removeFromDatabase(cfwdDeviceLineStore, "cfwdBusy");
-							iPbx.feature_removeFromDatabase(cfwdLineDeviceStore, "cfwdBusy");
+							sccp_featurestore_remove(cfwdDeviceLineStore, "cfwdBusy");
+							sccp_featurestore_remove(cfwdLineDeviceStore, "cfwdBusy");
 							sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "%s: db clear %s\n", DEV_ID_LOG(device), cfwdDeviceLineStore);
 						}
 						break;
 					case SCCP_FEATURE_CFWDNONE:
-						iPbx.feature_removeFromDatabase(cfwdDeviceLineStore, "cfwdAll");
-						iPbx.feature_removeFromDatabase(cfwdDeviceLineStore, "cfwdBusy");
-						iPbx.feature_removeFromDatabase(cfwdLineDeviceStore, "cfwdAll");
-						iPbx.feature_removeFromDatabase(cfwdLineDeviceStore, "cfwdBusy");
+						sccp_featurestore_remove(cfwdDeviceLineStore, "cfwdAll");
+						sccp_featurestore_remove(cfwdDeviceLineStore, "cfwdBusy");
+						sccp_featurestore_remove(cfwdLineDeviceStore, "cfwdAll");
+						sccp_featurestore_remove(cfwdLineDeviceStore, "cfwdBusy");
 						sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "%s: cfwd cleared from db\n", DEV_ID_LOG(device));
 					default:
 						break;
@@ -474,14 +475,14 @@ void sccp_util_featureStorageBackend(const sccp_event_t * event)
 			if (device->dndFeature.previousStatus != device->dndFeature.status) {
 				if (!device->dndFeature.status) {
 					sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "%s: change dnd to off\n", DEV_ID_LOG(device));
-					iPbx.feature_removeFromDatabase(family, "dnd");
+					sccp_featurestore_remove(family, "dnd");
 				} else {
 					if (device->dndFeature.status == SCCP_DNDMODE_SILENT) {
 						sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "%s: change dnd to silent\n", DEV_ID_LOG(device));
-						iPbx.feature_addToDatabase(family, "dnd", "silent");
+						sccp_featurestore_put(family, "dnd", "silent");
 					} else {
 						sccp_log((DEBUGCAT_CORE)) (VERBOSE_PREFIX_3 "%s: change dnd to reject\n", DEV_ID_LOG(device));
-						iPbx.feature_addToDatabase(family, "dnd", "reject");
+						sccp_featurestore_put(family, "dnd", "reject");
 					}
 				}
 				device->dndFeature.previousStatus = device->dndFeature.status;
@@ -490,12 +491,12 @@ void sccp_util_featureStorageBackend(const sccp_event_t * event)
 		case SCCP_FEATURE_PRIVACY:
 			if (device->privacyFeature.previousStatus != device->privacyFeature.status) {
 				if (!device->privacyFeature.status) {
-					iPbx.feature_removeFromDatabase(family, "privacy");
+					sccp_featurestore_remove(family, "privacy");
 				} else {
 					char data[256];
 
 					snprintf(data, sizeof(data), "%d", device->privacyFeature.status);
-					iPbx.feature_addToDatabase(family, "privacy", data);
+					sccp_featurestore_put(family, "privacy", data);
 				}
 				device->privacyFeature.previousStatus = device->privacyFeature.status;
 			}
@@ -503,9 +504,9 @@ void sccp_util_featureStorageBackend(const sccp_event_t * event)
 		case SCCP_FEATURE_MONITOR:
 			if (device->monitorFeature.previousStatus != device->monitorFeature.status) {
 				if (device->monitorFeature.status & SCCP_FEATURE_MONITOR_STATE_REQUESTED) {
-					iPbx.feature_addToDatabase(family, "monitor", "on");
+					sccp_featurestore_put(family, "monitor", "on");
 				} else {
-					iPbx.feature_removeFromDatabase(family, "monitor");
+					sccp_featurestore_remove(family, "monitor");
 				}
 				device->monitorFeature.previousStatus = device->monitorFeature.status;
 			}